@@ -10,13 +10,15 @@
 static int eh_aucvt_output_verbatim(void *dst,int samplec,struct eh_aucvt *aucvt);
 static int eh_aucvt_output_formatonly(void *dst,int samplec,struct eh_aucvt *aucvt);
 static int eh_aucvt_output_fceu(void *dst,int samplec,struct eh_aucvt *aucvt);
+static int eh_aucvt_output_resample(void *dst,int samplec,struct eh_aucvt *aucvt);
 
 /* Cleanup.
  */
  
 void eh_aucvt_cleanup(struct eh_aucvt *aucvt) {
   aucvt->ready=0;
-  if (aucvt->buf) free(aucvt->buf);
+  eh_auring_cleanup(&aucvt->ring);
+  eh_auresample_cleanup(&aucvt->resample);
   memset(aucvt,0,sizeof(struct eh_aucvt));
 }
 
@@ -172,7 +174,22 @@ static eh_auframe_write_fn eh_aucvt_get_frame_writer(int fmt,int chanc) {
 /* Look for simple cases that we can prepare a better conversion implementation than the default.
  */
  
-static void eh_aucvt_check_optimizations(struct eh_aucvt *aucvt) {
+static int eh_aucvt_check_optimizations(struct eh_aucvt *aucvt,int quality) {
+
+  if (!quality) quality=EH_AURESAMPLE_DEFAULT;
+  
+  // Rate control needs the resampler, even if the rates match.
+  // At matching rates it's only trimming a few ppm, and linear is indistinguishable from sinc for that, at a fraction of the cost.
+  if (aucvt->drc) {
+    if (aucvt->srcrate==aucvt->dstrate) quality=EH_AURESAMPLE_LINEAR;
+    if (eh_auresample_init(&aucvt->resample,quality,aucvt->srcrate,aucvt->dstrate,aucvt->srcchanc)<0) return -1;
+    fprintf(stderr,
+      "aucvt: Resampling %d => %d Hz with rate control, quality '%s', %d taps.\n",
+      aucvt->srcrate,aucvt->dstrate,eh_auresample_quality_repr(aucvt->resample.quality),aucvt->resample.tapc
+    );
+    aucvt->output=eh_aucvt_output_resample;
+    return 0;
+  }
 
   if (
     (aucvt->dstrate==aucvt->srcrate)&&
@@ -182,16 +199,18 @@ static void eh_aucvt_check_optimizations(struct eh_aucvt *aucvt) {
     fprintf(stderr,"aucvt: Verbatim output.\n");
     aucvt->verbatim=1;
     aucvt->output=eh_aucvt_output_verbatim;
-    return;
+    return 0;
   }
   
   if (aucvt->srcrate==aucvt->dstrate) {
     fprintf(stderr,"aucvt: Same rate, convert format only.\n");
     aucvt->output=eh_aucvt_output_formatonly;
-    return;
+    return 0;
   }
   
+  // FCEU's shortcut is nearest-neighbor, so only if that's what was asked for.
   if (
+    (quality==EH_AURESAMPLE_NEAREST)&&
     (aucvt->srcrate<<1==aucvt->dstrate)&&
     (aucvt->srcchanc==1)&&
     (aucvt->dstchanc==2)&&
@@ -200,10 +219,16 @@ static void eh_aucvt_check_optimizations(struct eh_aucvt *aucvt) {
   ) {
     fprintf(stderr,"aucvt: FCEU quick-up possible\n");
     aucvt->output=eh_aucvt_output_fceu;
-    return;
+    return 0;
   }
   
-  fprintf(stderr,"aucvt: Will use generic conversion.\n");
+  if (eh_auresample_init(&aucvt->resample,quality,aucvt->srcrate,aucvt->dstrate,aucvt->srcchanc)<0) return -1;
+  fprintf(stderr,
+    "aucvt: Resampling %d => %d Hz, quality '%s', %d taps.\n",
+    aucvt->srcrate,aucvt->dstrate,eh_auresample_quality_repr(aucvt->resample.quality),aucvt->resample.tapc
+  );
+  aucvt->output=eh_aucvt_output_resample;
+  return 0;
 }
 
 /* Init.
@@ -212,7 +237,9 @@ static void eh_aucvt_check_optimizations(struct eh_aucvt *aucvt) {
 int eh_aucvt_init(
   struct eh_aucvt *aucvt,
   int dstrate,int dstchanc,int dstfmt,
-  int srcrate,int srcchanc,int srcfmt
+  int srcrate,int srcchanc,int srcfmt,
+  int quality,
+  int drc
 ) {
   memset(aucvt,0,sizeof(struct eh_aucvt));
   aucvt->dstrate=dstrate;
@@ -221,6 +248,9 @@ int eh_aucvt_init(
   aucvt->srcrate=srcrate;
   aucvt->srcchanc=srcchanc;
   aucvt->srcfmt=srcfmt;
+  aucvt->drc=drc?1:0;
+  aucvt->drc_fill=0.5;
+  aucvt->drc_ratio=aucvt->drc_ratio_lo=aucvt->drc_ratio_hi=1.0;
   
   if (!(aucvt->dstsamplesize=eh_audio_sample_size(aucvt->dstfmt))) return -1;
   if (!(aucvt->srcsamplesize=eh_audio_sample_size(aucvt->srcfmt))) return -1;
@@ -231,15 +261,12 @@ int eh_aucvt_init(
   if (!(aucvt->rdframe=eh_aucvt_get_frame_reader(aucvt->srcfmt,aucvt->srcchanc))) return -1;
   if (!(aucvt->wrframe=eh_aucvt_get_frame_writer(aucvt->dstfmt,aucvt->dstchanc))) return -1;
   
-  aucvt->bufa=4096; //TODO configurable?
-  if (!(aucvt->buf=calloc(aucvt->bufa,aucvt->srcsamplesize))) {
-    aucvt->bufa=0;
-    return -1;
-  }
+  // Room for a few video frames' worth, so one client update plus one driver period fit comfortably.
+  int capacity=(srcrate*srcchanc)/15;
+  if (capacity<4096) capacity=4096;
+  if (eh_auring_init(&aucvt->ring,capacity,aucvt->srcsamplesize,srcchanc)<0) return -1;
   
-  aucvt->fbufp=0.0;
-  aucvt->fbufpd=(double)aucvt->srcrate/(double)aucvt->dstrate;
-  eh_aucvt_check_optimizations(aucvt);
+  if (eh_aucvt_check_optimizations(aucvt,quality)<0) return -1;
   
   aucvt->ready=1;
   return 0;
@@ -252,7 +279,8 @@ void eh_aucvt_warn_if_converting(const struct eh_aucvt *aucvt) {
   if (aucvt->verbatim) {
   } else if (aucvt->srcrate!=aucvt->dstrate) {
     fprintf(stderr,
-      "Audio rate mismatch. We will convert and do a bad job of it. in=(%d ch @ %d Hz of %d) out=(%d ch @ %d Hz of %d)\n",
+      "Audio rate mismatch. We will resample (%s). in=(%d ch @ %d Hz of %d) out=(%d ch @ %d Hz of %d)\n",
+      aucvt->output==eh_aucvt_output_fceu?"nearest":eh_auresample_quality_repr(aucvt->resample.quality),
       aucvt->srcchanc,aucvt->srcrate,aucvt->srcfmt,
       aucvt->dstchanc,aucvt->dstrate,aucvt->dstfmt
     );
@@ -276,32 +304,11 @@ int eh_aucvt_input(struct eh_aucvt *aucvt,const void *src,int samplec) {
   if (eh.fastfwd) return samplec;
   if (eh.auto_collect_metadata) return samplec;
   
-  int okc=aucvt->bufa-aucvt->bufc;
-  if (okc>=samplec) okc=samplec;
-  else aucvt->overframec+=samplec-okc;
-  if (okc<1) return 0;
-  
-  int headc=0,tailc=0;
-  int dstp=aucvt->bufp+aucvt->bufc;
-  if (dstp>=aucvt->bufa) {
-    dstp-=aucvt->bufa;
-    headc=aucvt->bufp-dstp;
-    if (headc>okc) headc=okc;
-    else tailc=okc-headc;
-  } else {
-    headc=aucvt->bufa-dstp;
-    if (headc>okc) headc=okc;
-    else tailc=okc-headc;
-  }
-  
-  dstp*=aucvt->srcsamplesize;
-  memcpy((char*)aucvt->buf+dstp,src,headc*aucvt->srcsamplesize);
-  if (tailc) {
-    src=(char*)src+headc*aucvt->srcsamplesize;
-    memcpy(aucvt->buf,src,tailc*aucvt->srcsamplesize);
+  int okc=eh_auring_write(&aucvt->ring,src,samplec);
+  if (okc<samplec) {
+    aucvt->overframec+=samplec-okc;
+    aucvt->overrunc++;
   }
-  aucvt->bufc+=okc;
-  
   return okc;
 }
 
@@ -309,14 +316,11 @@ int eh_aucvt_input(struct eh_aucvt *aucvt,const void *src,int samplec) {
  */
  
 static int eh_aucvt_output_verbatim(void *dst,int samplec,struct eh_aucvt *aucvt) {
-  while (samplec>0) {
-    int cpc=aucvt->bufa-aucvt->bufp;
-    if (cpc>samplec) cpc=samplec;
-    memcpy(dst,(char*)aucvt->buf+aucvt->bufp*aucvt->srcsamplesize,cpc*aucvt->srcsamplesize);
-    if ((aucvt->bufp+=cpc)>=aucvt->bufa) aucvt->bufp=0;
-    if ((aucvt->bufc-=cpc)<0) aucvt->bufc=0;
-    dst=(char*)dst+cpc*aucvt->dstsamplesize;
-    samplec-=cpc;
+  int okc=eh_auring_read(&aucvt->ring,dst,samplec);
+  if (okc<samplec) {
+    memset((char*)dst+okc*aucvt->dstsamplesize,0,(samplec-okc)*aucvt->dstsamplesize);
+    __atomic_fetch_add(&aucvt->badframec,(samplec-okc)/aucvt->dstchanc,__ATOMIC_RELAXED);
+    __atomic_fetch_add(&aucvt->underrunc,1,__ATOMIC_RELAXED);
   }
   return 0;
 }
@@ -325,21 +329,25 @@ static int eh_aucvt_output_verbatim(void *dst,int samplec,struct eh_aucvt *aucvt
  */
  
 static int eh_aucvt_output_formatonly(void *dst,int samplec,struct eh_aucvt *aucvt) {
-  char *srcp=(char*)aucvt->buf+aucvt->bufp*aucvt->srcsamplesize;
   int dstframec=samplec/aucvt->dstchanc;
-  for (;dstframec-->0;dst=(char*)dst+aucvt->dstframesize) {
-  
-    struct eh_auframe frame=aucvt->rdframe(srcp);
-    srcp+=aucvt->srcframesize;
-    aucvt->bufp+=aucvt->srcchanc;
-    if (aucvt->bufp>=aucvt->bufa) {
-      aucvt->bufp=0;
-      srcp=aucvt->buf;
+  while (dstframec>0) {
+    const void *src=0;
+    int srcframec=eh_auring_peek(&aucvt->ring,&src)/aucvt->srcchanc;
+    if (srcframec<1) {
+      // Underrun. Emit silence for the remainder and make a note of it.
+      memset(dst,0,dstframec*aucvt->dstframesize);
+      __atomic_fetch_add(&aucvt->badframec,dstframec,__ATOMIC_RELAXED);
+      __atomic_fetch_add(&aucvt->underrunc,1,__ATOMIC_RELAXED);
+      break;
+    }
+    if (srcframec>dstframec) srcframec=dstframec;
+    const char *srcp=src;
+    int i=srcframec;
+    for (;i-->0;srcp+=aucvt->srcframesize,dst=(char*)dst+aucvt->dstframesize) {
+      aucvt->wrframe(dst,aucvt->rdframe(srcp));
     }
-    if (aucvt->bufc>0) aucvt->bufc--; // but we keep reading, even if zero
-    else aucvt->badframec++;
-    
-    aucvt->wrframe(dst,frame);
+    eh_auring_consume(&aucvt->ring,srcframec*aucvt->srcchanc);
+    dstframec-=srcframec;
   }
   return 0;
 }
@@ -350,21 +358,26 @@ static int eh_aucvt_output_formatonly(void *dst,int samplec,struct eh_aucvt *auc
 static int eh_aucvt_output_fceu(void *dst,int samplec,struct eh_aucvt *aucvt) {
   int srcsamplec=samplec>>2;
   if (srcsamplec<1) return 0;
-  if (srcsamplec>aucvt->bufc) { // if we overrun input, just keep going, but make a note of it.
-    aucvt->badframec+=srcsamplec-aucvt->bufc;
-    aucvt->bufc=0;
-  } else {
-    aucvt->bufc-=srcsamplec;
-  }
-  int32_t *srcp=(int32_t*)aucvt->buf+aucvt->bufp;
   int16_t *dstp=dst;
-  for (;srcsamplec-->0;dstp+=4) {
-    int16_t sample=*srcp++;
-    dstp[0]=dstp[1]=dstp[2]=dstp[3]=sample;
-    if ((aucvt->bufp+=1)>=aucvt->bufa) {
-      aucvt->bufp=0;
-      srcp=aucvt->buf;
+  while (srcsamplec>0) {
+    const void *src=0;
+    int cpc=eh_auring_peek(&aucvt->ring,&src);
+    if (cpc<1) { // if we overrun input, just keep going, but make a note of it.
+      memset(dstp,0,srcsamplec*4*sizeof(int16_t));
+      dstp+=srcsamplec*4;
+      __atomic_fetch_add(&aucvt->badframec,srcsamplec,__ATOMIC_RELAXED);
+      __atomic_fetch_add(&aucvt->underrunc,1,__ATOMIC_RELAXED);
+      break;
+    }
+    if (cpc>srcsamplec) cpc=srcsamplec;
+    const int32_t *srcp=src;
+    int i=cpc;
+    for (;i-->0;dstp+=4) {
+      int16_t sample=*srcp++;
+      dstp[0]=dstp[1]=dstp[2]=dstp[3]=sample;
     }
+    eh_auring_consume(&aucvt->ring,cpc);
+    srcsamplec-=cpc;
   }
   switch (samplec&3) {
     case 1: dstp[0]=dstp[-1]; break;
@@ -374,6 +387,71 @@ static int eh_aucvt_output_fceu(void *dst,int samplec,struct eh_aucvt *aucvt) {
   return 0;
 }
 
+/* Update rate control, at the start of each output.
+ * Fill level is a sawtooth against the client's update cadence, so smooth it heavily.
+ * Ratio deviates proportionally from 1.0 as the fill deviates from half, up to EH_AUCVT_DRC_LIMIT.
+ * A slow integral term on top of that takes up any steady clock mismatch, so the fill settles at half.
+ */
+ 
+#define EH_AUCVT_DRC_LIMIT 0.005
+#define EH_AUCVT_DRC_SMOOTH 0.05
+#define EH_AUCVT_DRC_INTEGRAL 0.00001
+ 
+static void eh_aucvt_drc_update(struct eh_aucvt *aucvt) {
+  double fill=(double)eh_auring_get_fill(&aucvt->ring)/(double)eh_auring_get_capacity(&aucvt->ring);
+  aucvt->drc_fill_sum+=fill;
+  aucvt->drc_fill_count++;
+  aucvt->drc_fill+=(fill-aucvt->drc_fill)*EH_AUCVT_DRC_SMOOTH;
+  double err=(aucvt->drc_fill-0.5)*2.0;
+  aucvt->drc_integral+=err*EH_AUCVT_DRC_INTEGRAL;
+  if (aucvt->drc_integral<-EH_AUCVT_DRC_LIMIT) aucvt->drc_integral=-EH_AUCVT_DRC_LIMIT;
+  else if (aucvt->drc_integral>EH_AUCVT_DRC_LIMIT) aucvt->drc_integral=EH_AUCVT_DRC_LIMIT;
+  double ratio=1.0+EH_AUCVT_DRC_LIMIT*err+aucvt->drc_integral;
+  if (ratio<1.0-EH_AUCVT_DRC_LIMIT*2.0) ratio=1.0-EH_AUCVT_DRC_LIMIT*2.0;
+  else if (ratio>1.0+EH_AUCVT_DRC_LIMIT*2.0) ratio=1.0+EH_AUCVT_DRC_LIMIT*2.0;
+  aucvt->drc_ratio=ratio;
+  if (ratio<aucvt->drc_ratio_lo) aucvt->drc_ratio_lo=ratio;
+  if (ratio>aucvt->drc_ratio_hi) aucvt->drc_ratio_hi=ratio;
+  eh_auresample_adjust(&aucvt->resample,ratio);
+}
+
+/* resample: Rates differ, or rate control in play. eh_auresample does the real work, we just feed it from the ring.
+ */
+ 
+static int eh_aucvt_output_resample(void *dst,int samplec,struct eh_aucvt *aucvt) {
+  if (aucvt->drc) eh_aucvt_drc_update(aucvt);
+  int underrun=0;
+  int dstframec=samplec/aucvt->dstchanc;
+  while (dstframec>0) {
+    int updc=dstframec;
+    if (updc>EH_AURESAMPLE_BLOCK) updc=EH_AURESAMPLE_BLOCK;
+    int wantc;
+    while ((wantc=eh_auresample_want(&aucvt->resample,updc))>0) {
+      const void *src=0;
+      int cpc=eh_auring_peek(&aucvt->ring,&src)/aucvt->srcchanc;
+      if (cpc<1) {
+        // Underrun. Hold the last input level and make a note of it.
+        eh_auresample_pad(&aucvt->resample,wantc);
+        __atomic_fetch_add(&aucvt->badframec,wantc,__ATOMIC_RELAXED);
+        underrun=1;
+        break;
+      }
+      if (cpc>wantc) cpc=wantc;
+      int err=eh_auresample_import(&aucvt->resample,src,cpc,aucvt->srcfmt);
+      if (err<1) {
+        eh_auresample_pad(&aucvt->resample,wantc);
+        break;
+      }
+      eh_auring_consume(&aucvt->ring,err*aucvt->srcchanc);
+    }
+    eh_auresample_export(&aucvt->resample,dst,updc,aucvt->dstfmt,aucvt->dstchanc);
+    dst=(char*)dst+updc*aucvt->dstframesize;
+    dstframec-=updc;
+  }
+  if (underrun) __atomic_fetch_add(&aucvt->underrunc,1,__ATOMIC_RELAXED);
+  return 0;
+}
+
 /* Produce output.
  */
  
@@ -387,25 +465,30 @@ int eh_aucvt_output(void *dst,int samplec,struct eh_aucvt *aucvt) {
   }
   
   if (aucvt->output) return aucvt->output(dst,samplec,aucvt);
-  
-  // Different rates, need to resample.
-  // I guess the nicest way would be to take the DFT of the input, then IFFT it back to the output rate.
-  // Too complicated of course. We're going to do a straight nearest-neighbor resample.
-  // (fbufp) is the source position in *frames*.
-  double bufframec=aucvt->bufa/aucvt->srcchanc;
-  int framemask=(1<<(aucvt->srcframesize))-1;
-  int dstframec=samplec/aucvt->dstchanc;
-  for (;dstframec-->0;dst=(char*)dst+aucvt->dstframesize) {
-    int ibufp=(int)(aucvt->fbufp)*aucvt->srcchanc; // samples
-    while (aucvt->bufp!=ibufp) {
-      if ((aucvt->bufp+=aucvt->srcchanc)>=aucvt->bufa) aucvt->bufp=0;
-      if ((aucvt->bufc-=aucvt->srcchanc)<0) aucvt->bufc=0;
-    }
-    struct eh_auframe frame=aucvt->rdframe((char*)aucvt->buf+ibufp*aucvt->srcsamplesize);
-    aucvt->fbufp+=aucvt->fbufpd;
-    if (aucvt->fbufp>=bufframec) aucvt->fbufp-=bufframec;
-    aucvt->wrframe(dst,frame);
-  }
-    
+  memset(dst,0,samplec*aucvt->dstsamplesize);
   return 0;
 }
+
+/* Report.
+ */
+ 
+int eh_aucvt_report(char *dst,int dsta,const struct eh_aucvt *aucvt) {
+  if (!dst||(dsta<1)) return -1;
+  dst[0]=0;
+  if (!aucvt->ready) return 0;
+  int dstc;
+  if (aucvt->drc) {
+    double avgfill=aucvt->drc_fill_count?(aucvt->drc_fill_sum/aucvt->drc_fill_count):0.0;
+    dstc=snprintf(dst,dsta,
+      "audio fill %.0f%%, ratio %.5f (%.5f..%.5f), %d underruns, %d overruns",
+      avgfill*100.0,aucvt->drc_ratio,aucvt->drc_ratio_lo,aucvt->drc_ratio_hi,__atomic_load_n(&aucvt->underrunc,__ATOMIC_RELAXED),aucvt->overrunc
+    );
+  } else {
+    dstc=snprintf(dst,dsta,"audio %d underruns, %d overruns",__atomic_load_n(&aucvt->underrunc,__ATOMIC_RELAXED),aucvt->overrunc);
+  }
+  if ((dstc<1)||(dstc>=dsta)) {
+    dst[0]=0;
+    return 0;
+  }
+  return dstc;
+}
@@ -4,6 +4,9 @@
 #ifndef EH_AUCVT_H
 #define EH_AUCVT_H
 
+#include "eh_auresample.h"
+#include "eh_auring.h"
+
 struct eh_auframe {
   float l,r;
 };
@@ -18,14 +21,27 @@ struct eh_aucvt {
   int dstsamplesize,dstframesize;
   int srcsamplesize,srcframesize;
   int verbatim;
-  void *buf;
-  int bufp,bufc,bufa; // src samples; circular
-  double fbufp; // true bufp if we are resampling
-  double fbufpd;
+  struct eh_auring ring; // src samples, in whole frames. Client thread writes, driver thread reads.
+  struct eh_auresample resample; // if rates differ
   eh_auframe_read_fn rdframe;
   eh_auframe_write_fn wrframe;
-  int badframec; // Too little input.
+  int badframec; // Too little input. Driver thread adds, main thread takes. Atomic access only.
   int overframec; // Too much input.
+  
+  /* Dynamic rate control.
+   * Instead of the host adding or dropping whole video frames to keep audio in sync,
+   * we nudge the resampler's ratio to hold the ring buffer near half full.
+   */
+  int drc;
+  double drc_fill; // 0..1, smoothed
+  double drc_ratio; // Adjustment currently applied, near 1.0.
+  double drc_integral;
+  double drc_ratio_lo,drc_ratio_hi;
+  double drc_fill_sum;
+  int drc_fill_count;
+  int underrunc; // Output calls that ran out of input. Cumulative, for reporting. Atomic, it's the driver thread's.
+  int overrunc; // Input calls that overflowed the ring. Cumulative, for reporting.
+  
   int (*output)(void *dst,int samplec,struct eh_aucvt *aucvt); // if not generic
 };
 
@@ -34,7 +50,9 @@ void eh_aucvt_cleanup(struct eh_aucvt *aucvt);
 int eh_aucvt_init(
   struct eh_aucvt *aucvt,
   int dstrate,int dstchanc,int dstfmt,
-  int srcrate,int srcchanc,int srcfmt
+  int srcrate,int srcchanc,int srcfmt,
+  int quality, // EH_AURESAMPLE_*, zero for default
+  int drc // Nonzero to resample even at matching rates (linear, then), and control the ratio dynamically.
 );
 
 void eh_aucvt_warn_if_converting(const struct eh_aucvt *aucvt);
@@ -42,6 +60,7 @@ void eh_aucvt_warn_if_converting(const struct eh_aucvt *aucvt);
 /* Add some PCM to our buffer, as provided by the emulator.
  * Returns the sample count consumed.
  * If <samplec, you should pump the output and wait, then send the rest.
+ * Safe to call concurrently with eh_aucvt_output(), no locking required.
  */
 int eh_aucvt_input(struct eh_aucvt *aucvt,const void *src,int samplec);
 
@@ -51,4 +70,9 @@ int eh_aucvt_input(struct eh_aucvt *aucvt,const void *src,int samplec);
  */
 int eh_aucvt_output(void *dst,int samplec,struct eh_aucvt *aucvt);
 
+/* Summarize fill level, ratio, and xruns, for eh_clock_report().
+ * Writes a NUL-terminated string, or empty if there's nothing to report.
+ */
+int eh_aucvt_report(char *dst,int dsta,const struct eh_aucvt *aucvt);
+
 #endif
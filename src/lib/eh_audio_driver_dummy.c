@@ -64,6 +64,11 @@ static void dummy_update_us(struct eh_audio_driver *driver,int64_t us) {
  */
  
 static int _dummy_update(struct eh_audio_driver *driver) {
+  // Unthrottled, real time means nothing. Consume one video frame's worth per update, as if we were keeping up.
+  if (eh.unthrottled&&(eh.delegate.video_rate>0.0)) {
+    dummy_update_us(driver,(int64_t)(1000000.0/eh.delegate.video_rate));
+    return 0;
+  }
   if (!DRIVER->last_update_time) DRIVER->last_update_time=eh_now_real_us();
   int64_t now=eh_now_real_us();
   int64_t elapsedus=now-DRIVER->last_update_time;
@@ -0,0 +1,386 @@
+#include "eh_internal.h"
+#include "eh_auresample.h"
+#include <math.h>
+
+/* Four floats at a time.
+ * GCC's generic vectors lower to SSE on x86 and NEON on the Pi, or plain scalar code elsewhere.
+ * We always load and store via memcpy, so no alignment requirements.
+ */
+typedef float eh_v4f __attribute__((vector_size(16)));
+
+static inline float eh_auresample_dot(const float *a,const float *b,int c) {
+  eh_v4f acc={0.0f,0.0f,0.0f,0.0f},va,vb;
+  for (;c>=4;c-=4,a+=4,b+=4) {
+    memcpy(&va,a,sizeof(va));
+    memcpy(&vb,b,sizeof(vb));
+    acc+=va*vb;
+  }
+  return acc[0]+acc[1]+acc[2]+acc[3];
+}
+
+/* Cleanup.
+ */
+
+void eh_auresample_cleanup(struct eh_auresample *rs) {
+  if (rs->coefv) free(rs->coefv);
+  if (rs->histv) free(rs->histv);
+  memset(rs,0,sizeof(struct eh_auresample));
+}
+
+/* Generate sinc table.
+ * Blackman-windowed, with cutoff a little below the lower of the two Nyquist rates.
+ * Each phase is normalized to unit DC gain.
+ */
+
+static int eh_auresample_init_sinc(struct eh_auresample *rs) {
+  rs->phasec=256;
+  if (!(rs->coefv=malloc(sizeof(float)*(rs->phasec+1)*rs->tapc))) return -1;
+  double cutoff=0.92;
+  if (rs->dstrate<rs->srcrate) cutoff*=(double)rs->dstrate/(double)rs->srcrate;
+  int half=rs->tapc>>1;
+  float *row=rs->coefv;
+  int p=0; for (;p<=rs->phasec;p++,row+=rs->tapc) {
+    double f=(double)p/(double)rs->phasec;
+    double sum=0.0;
+    int t=0; for (;t<rs->tapc;t++) {
+      double x=(double)(t-(half-1))-f;
+      double s=(x==0.0)?1.0:sin(M_PI*cutoff*x)/(M_PI*cutoff*x);
+      double wx=x/half,w;
+      if ((wx<=-1.0)||(wx>=1.0)) w=0.0;
+      else w=0.42+0.5*cos(M_PI*wx)+0.08*cos(2.0*M_PI*wx);
+      double h=s*w;
+      row[t]=h;
+      sum+=h;
+    }
+    if (sum!=0.0) for (t=0;t<rs->tapc;t++) row[t]/=sum;
+  }
+  return 0;
+}
+
+/* Init.
+ */
+
+int eh_auresample_init(struct eh_auresample *rs,int quality,int srcrate,int dstrate,int chanc) {
+  memset(rs,0,sizeof(struct eh_auresample));
+  if ((srcrate<1)||(dstrate<1)) return -1;
+  if ((chanc<1)||(chanc>2)) return -1;
+  if (!quality) quality=EH_AURESAMPLE_DEFAULT;
+  rs->quality=quality;
+  rs->srcrate=srcrate;
+  rs->dstrate=dstrate;
+  rs->chanc=chanc;
+  rs->step=rs->nominal_step=(double)srcrate/(double)dstrate;
+
+  switch (quality) {
+    case EH_AURESAMPLE_NEAREST: rs->tapc=1; break;
+    case EH_AURESAMPLE_LINEAR: rs->tapc=2; break;
+    case EH_AURESAMPLE_CUBIC: rs->tapc=4; break;
+    case EH_AURESAMPLE_SINC: {
+        // When downsampling, the kernel stretches to keep the same transition band in output terms.
+        rs->tapc=32;
+        if (rs->step>1.0) {
+          rs->tapc=((int)ceil(32.0*rs->step)+3)&~3;
+          if (rs->tapc>128) rs->tapc=128;
+        }
+        if (eh_auresample_init_sinc(rs)<0) return -1;
+      } break;
+    default: return -1;
+  }
+
+  // Leave room for the step to grow under eh_auresample_adjust().
+  rs->hista=(int)ceil(EH_AURESAMPLE_BLOCK*rs->step*1.05)+rs->tapc+4;
+  if (!(rs->histv=calloc(sizeof(float)*rs->chanc,rs->hista))) return -1;
+
+  // Start with enough silence that the first output is centered on the first input.
+  rs->histc=(rs->tapc-1)>>1;
+  rs->pos=0.0;
+
+  return 0;
+}
+
+/* How much input needed?
+ */
+
+int eh_auresample_want(const struct eh_auresample *rs,int dstframec) {
+  if (dstframec<1) return 0;
+  if (dstframec>EH_AURESAMPLE_BLOCK) dstframec=EH_AURESAMPLE_BLOCK;
+  int need=(int)(rs->pos+rs->step*(dstframec-1))+rs->tapc;
+  if (need<=rs->histc) return 0;
+  return need-rs->histc;
+}
+
+/* Import.
+ */
+
+int eh_auresample_import(struct eh_auresample *rs,const void *src,int framec,int srcfmt) {
+  if (framec>rs->hista-rs->histc) framec=rs->hista-rs->histc;
+  if (framec<1) return 0;
+  float *l=rs->histv+rs->histc;
+  float *r=l+rs->hista;
+  int i;
+  #define IMPORT(type,scale) { \
+    const type *s=src; \
+    if (rs->chanc==1) { \
+      for (i=0;i<framec;i++) l[i]=s[i]*(scale); \
+    } else { \
+      for (i=0;i<framec;i++,s+=2) { l[i]=s[0]*(scale); r[i]=s[1]*(scale); } \
+    } \
+  } break;
+  switch (srcfmt) {
+    case EH_AUDIO_FORMAT_S16N: IMPORT(int16_t,1.0f/32768.0f)
+    case EH_AUDIO_FORMAT_S32N: IMPORT(int32_t,1.0f/2147483648.0f)
+    case EH_AUDIO_FORMAT_F32N: IMPORT(float,1.0f)
+    case EH_AUDIO_FORMAT_S32N_LO16: IMPORT(int32_t,1.0f/32768.0f)
+    case EH_AUDIO_FORMAT_S8: IMPORT(int8_t,1.0f/128.0f)
+    default: return 0;
+  }
+  #undef IMPORT
+  rs->histc+=framec;
+  return framec;
+}
+
+/* Pad.
+ */
+
+void eh_auresample_pad(struct eh_auresample *rs,int framec) {
+  if (framec>rs->hista-rs->histc) framec=rs->hista-rs->histc;
+  if (framec<1) return;
+  int plane=0; for (;plane<rs->chanc;plane++) {
+    float *v=rs->histv+plane*rs->hista;
+    float last=rs->histc?v[rs->histc-1]:0.0f;
+    float *dst=v+rs->histc;
+    int i=framec; while (i-->0) *dst++=last;
+  }
+  rs->histc+=framec;
+}
+
+/* Write one output frame.
+ * Inlined into each quality's loop, where the compiler hoists the switch out.
+ * S32 scales by the largest float below 2^31: 2147483647.0f rounds up to 2^31, and full scale would overflow.
+ */
+
+#define EH_AURESAMPLE_S32_SCALE 2147483520.0f
+
+static inline void eh_auresample_store(void *dst,int p,float l,float r,int dstfmt,int dstchanc) {
+  if (l<-1.0f) l=-1.0f; else if (l>1.0f) l=1.0f;
+  if (r<-1.0f) r=-1.0f; else if (r>1.0f) r=1.0f;
+  if (dstchanc==1) {
+    float m=(l+r)*0.5f;
+    switch (dstfmt) {
+      case EH_AUDIO_FORMAT_S16N: ((int16_t*)dst)[p]=m*32767.0f; break;
+      case EH_AUDIO_FORMAT_S32N: ((int32_t*)dst)[p]=m*EH_AURESAMPLE_S32_SCALE; break;
+      case EH_AUDIO_FORMAT_F32N: ((float*)dst)[p]=m; break;
+      case EH_AUDIO_FORMAT_S32N_LO16: ((int32_t*)dst)[p]=m*32767.0f; break;
+      case EH_AUDIO_FORMAT_S8: ((int8_t*)dst)[p]=m*127.0f; break;
+    }
+  } else {
+    p<<=1;
+    switch (dstfmt) {
+      case EH_AUDIO_FORMAT_S16N: ((int16_t*)dst)[p]=l*32767.0f; ((int16_t*)dst)[p+1]=r*32767.0f; break;
+      case EH_AUDIO_FORMAT_S32N: ((int32_t*)dst)[p]=l*EH_AURESAMPLE_S32_SCALE; ((int32_t*)dst)[p+1]=r*EH_AURESAMPLE_S32_SCALE; break;
+      case EH_AUDIO_FORMAT_F32N: ((float*)dst)[p]=l; ((float*)dst)[p+1]=r; break;
+      case EH_AUDIO_FORMAT_S32N_LO16: ((int32_t*)dst)[p]=l*32767.0f; ((int32_t*)dst)[p+1]=r*32767.0f; break;
+      case EH_AUDIO_FORMAT_S8: ((int8_t*)dst)[p]=l*127.0f; ((int8_t*)dst)[p+1]=r*127.0f; break;
+    }
+  }
+}
+
+/* Export, one loop per quality tier.
+ */
+
+static void eh_auresample_export_nearest(struct eh_auresample *rs,void *dst,int dstframec,int dstfmt,int dstchanc) {
+  const float *l=rs->histv,*r=(rs->chanc==2)?(l+rs->hista):l;
+  int i=0; for (;i<dstframec;i++,rs->pos+=rs->step) {
+    int ip=(int)rs->pos;
+    eh_auresample_store(dst,i,l[ip],r[ip],dstfmt,dstchanc);
+  }
+}
+
+static void eh_auresample_export_linear(struct eh_auresample *rs,void *dst,int dstframec,int dstfmt,int dstchanc) {
+  const float *l=rs->histv,*r=(rs->chanc==2)?(l+rs->hista):l;
+  int i=0; for (;i<dstframec;i++,rs->pos+=rs->step) {
+    int ip=(int)rs->pos;
+    float f=rs->pos-ip;
+    float lv=l[ip]+(l[ip+1]-l[ip])*f;
+    float rv=r[ip]+(r[ip+1]-r[ip])*f;
+    eh_auresample_store(dst,i,lv,rv,dstfmt,dstchanc);
+  }
+}
+
+static void eh_auresample_export_cubic(struct eh_auresample *rs,void *dst,int dstframec,int dstfmt,int dstchanc) {
+  const float *l=rs->histv,*r=(rs->chanc==2)?(l+rs->hista):l;
+  int i=0; for (;i<dstframec;i++,rs->pos+=rs->step) {
+    int ip=(int)rs->pos;
+    float t=rs->pos-ip,t2=t*t,t3=t2*t;
+    float wv[4]={
+      0.5f*(-t+2.0f*t2-t3),
+      0.5f*(2.0f-5.0f*t2+3.0f*t3),
+      0.5f*(t+4.0f*t2-3.0f*t3),
+      0.5f*(t3-t2),
+    };
+    float lv=eh_auresample_dot(wv,l+ip,4);
+    float rv=(r==l)?lv:eh_auresample_dot(wv,r+ip,4);
+    eh_auresample_store(dst,i,lv,rv,dstfmt,dstchanc);
+  }
+}
+
+static void eh_auresample_export_sinc(struct eh_auresample *rs,void *dst,int dstframec,int dstfmt,int dstchanc) {
+  const float *l=rs->histv,*r=(rs->chanc==2)?(l+rs->hista):l;
+  int i=0; for (;i<dstframec;i++,rs->pos+=rs->step) {
+    int ip=(int)rs->pos;
+    int phase=(int)((rs->pos-ip)*rs->phasec+0.5);
+    const float *coef=rs->coefv+phase*rs->tapc;
+    float lv=eh_auresample_dot(coef,l+ip,rs->tapc);
+    float rv=(r==l)?lv:eh_auresample_dot(coef,r+ip,rs->tapc);
+    eh_auresample_store(dst,i,lv,rv,dstfmt,dstchanc);
+  }
+}
+
+/* Export.
+ */
+
+void eh_auresample_export(struct eh_auresample *rs,void *dst,int dstframec,int dstfmt,int dstchanc) {
+  if (dstframec>EH_AURESAMPLE_BLOCK) dstframec=EH_AURESAMPLE_BLOCK;
+  if (dstframec<1) return;
+  switch (rs->quality) {
+    case EH_AURESAMPLE_NEAREST: eh_auresample_export_nearest(rs,dst,dstframec,dstfmt,dstchanc); break;
+    case EH_AURESAMPLE_LINEAR: eh_auresample_export_linear(rs,dst,dstframec,dstfmt,dstchanc); break;
+    case EH_AURESAMPLE_CUBIC: eh_auresample_export_cubic(rs,dst,dstframec,dstfmt,dstchanc); break;
+    case EH_AURESAMPLE_SINC: eh_auresample_export_sinc(rs,dst,dstframec,dstfmt,dstchanc); break;
+  }
+
+  // Drop whatever history is entirely behind the read head.
+  int dropc=(int)rs->pos;
+  if (dropc>rs->histc) dropc=rs->histc;
+  if (dropc>0) {
+    int keepc=rs->histc-dropc;
+    int plane=0; for (;plane<rs->chanc;plane++) {
+      float *v=rs->histv+plane*rs->hista;
+      memmove(v,v+dropc,sizeof(float)*keepc);
+    }
+    rs->histc=keepc;
+    rs->pos-=dropc;
+  }
+}
+
+/* Adjust ratio.
+ */
+ 
+void eh_auresample_adjust(struct eh_auresample *rs,double adjust) {
+  if (adjust<0.95) adjust=0.95;
+  else if (adjust>1.05) adjust=1.05;
+  rs->step=rs->nominal_step*adjust;
+}
+
+/* Quality names.
+ */
+
+int eh_auresample_quality_eval(const char *src,int srcc) {
+  if (!src) return 0;
+  if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if ((srcc==7)&&!memcmp(src,"nearest",7)) return EH_AURESAMPLE_NEAREST;
+  if ((srcc==6)&&!memcmp(src,"linear",6)) return EH_AURESAMPLE_LINEAR;
+  if ((srcc==5)&&!memcmp(src,"cubic",5)) return EH_AURESAMPLE_CUBIC;
+  if ((srcc==4)&&!memcmp(src,"sinc",4)) return EH_AURESAMPLE_SINC;
+  return 0;
+}
+
+const char *eh_auresample_quality_repr(int quality) {
+  switch (quality) {
+    case EH_AURESAMPLE_NEAREST: return "nearest";
+    case EH_AURESAMPLE_LINEAR: return "linear";
+    case EH_AURESAMPLE_CUBIC: return "cubic";
+    case EH_AURESAMPLE_SINC: return "sinc";
+  }
+  return "";
+}
+
+/* Benchmark.
+ */
+
+static inline uint64_t eh_auresample_cycles() {
+  #if defined(__x86_64__)||defined(__i386__)
+    return __builtin_ia32_rdtsc();
+  #else
+    return 0; // No portable cycle counter. We'll report time only.
+  #endif
+}
+
+void eh_auresample_benchmark() {
+  static const struct eh_auresample_conv { int srcrate,dstrate; } convv[]={
+    {44100,48000},
+    {48000,44100},
+    {32000,48000},
+    {48000,32000},
+    {32000,44100},
+    {44100,32000},
+  };
+  static const int qualityv[]={
+    EH_AURESAMPLE_NEAREST,
+    EH_AURESAMPLE_LINEAR,
+    EH_AURESAMPLE_CUBIC,
+    EH_AURESAMPLE_SINC,
+  };
+  const int seconds=10;
+  #define SRCFRAMEC 4096
+  int16_t src[SRCFRAMEC*2];
+  int16_t dst[EH_AURESAMPLE_BLOCK*2];
+  volatile int sink=0;
+
+  // Something vaguely musical: A sine with a bit of noise on top.
+  uint32_t noise=0x12345678;
+  int i=0; for (;i<SRCFRAMEC;i++) {
+    noise=noise*1103515245+12345;
+    float v=sinf(i*0.0627f)*0.5f+((int)(noise>>16)-0x8000)/262144.0f;
+    src[i*2]=src[i*2+1]=v*32767.0f;
+  }
+
+  fprintf(stderr,"Audio resampler benchmark, stereo S16N, %d s of output per case:\n",seconds);
+  const struct eh_auresample_conv *conv=convv;
+  int convi=sizeof(convv)/sizeof(convv[0]);
+  for (;convi-->0;conv++) {
+    const int *quality=qualityv;
+    int qualityi=sizeof(qualityv)/sizeof(int);
+    for (;qualityi-->0;quality++) {
+      struct eh_auresample rs;
+      if (eh_auresample_init(&rs,*quality,conv->srcrate,conv->dstrate,2)<0) {
+        fprintf(stderr,"  %-7s %6d => %6d: init failed\n",eh_auresample_quality_repr(*quality),conv->srcrate,conv->dstrate);
+        continue;
+      }
+      int dstframec=conv->dstrate*seconds;
+      int totalc=dstframec;
+      int srcp=0;
+      int64_t starttime=eh_now_cpu_us();
+      uint64_t startcycles=eh_auresample_cycles();
+      while (dstframec>0) {
+        int updc=dstframec;
+        if (updc>EH_AURESAMPLE_BLOCK) updc=EH_AURESAMPLE_BLOCK;
+        int wantc;
+        while ((wantc=eh_auresample_want(&rs,updc))>0) {
+          if (wantc>SRCFRAMEC-srcp) wantc=SRCFRAMEC-srcp;
+          int err=eh_auresample_import(&rs,src+srcp*2,wantc,EH_AUDIO_FORMAT_S16N);
+          if (err<1) break;
+          if ((srcp+=err)>=SRCFRAMEC) srcp=0;
+        }
+        eh_auresample_export(&rs,dst,updc,EH_AUDIO_FORMAT_S16N,2);
+        sink+=dst[0];
+        dstframec-=updc;
+      }
+      uint64_t cycles=eh_auresample_cycles()-startcycles;
+      int64_t elapsed=eh_now_cpu_us()-starttime;
+      if (cycles) {
+        fprintf(stderr,"  %-7s %6d => %6d: %8.2f cycles/frame, %8.2f ns/frame, taps=%d\n",
+          eh_auresample_quality_repr(*quality),conv->srcrate,conv->dstrate,
+          (double)cycles/totalc,(elapsed*1000.0)/totalc,rs.tapc
+        );
+      } else {
+        fprintf(stderr,"  %-7s %6d => %6d: %8.2f ns/frame, taps=%d\n",
+          eh_auresample_quality_repr(*quality),conv->srcrate,conv->dstrate,
+          (elapsed*1000.0)/totalc,rs.tapc
+        );
+      }
+      eh_auresample_cleanup(&rs);
+    }
+  }
+  #undef SRCFRAMEC
+}
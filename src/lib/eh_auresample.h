@@ -0,0 +1,83 @@
+/* eh_auresample.h
+ * Band-limited rate conversion for eh_aucvt.
+ * Input is imported from the client's format into a planar float history,
+ * and output is written straight into the driver's format in the same pass that interpolates.
+ * Four quality tiers, selectable via "--audio-resampler":
+ *   nearest: What we used to do. Cheap and aliases horribly.
+ *   linear: 2 taps.
+ *   cubic: 4-tap Catmull-Rom.
+ *   sinc: Polyphase windowed sinc, 32 taps or more when downsampling. The default.
+ */
+
+#ifndef EH_AURESAMPLE_H
+#define EH_AURESAMPLE_H
+
+#include <stdint.h>
+
+#define EH_AURESAMPLE_NEAREST 1
+#define EH_AURESAMPLE_LINEAR  2
+#define EH_AURESAMPLE_CUBIC   3
+#define EH_AURESAMPLE_SINC    4
+
+#define EH_AURESAMPLE_DEFAULT EH_AURESAMPLE_SINC
+
+/* We output in blocks no longer than this, in frames.
+ * The history buffer is sized to cover one block.
+ */
+#define EH_AURESAMPLE_BLOCK 256
+
+struct eh_auresample {
+  int quality;
+  int srcrate,dstrate;
+  int chanc; // Source channel count, 1 or 2. We keep that many planes in (histv).
+  int tapc; // Input frames per output frame. Multiple of 4 for sinc.
+  int phasec; // Sinc only. (coefv) has (phasec+1) rows of (tapc).
+  float *coefv;
+  float *histv; // (chanc) planes of (hista) floats each.
+  int histc,hista; // frames
+  double pos; // Position of the first tap in (histv), in frames.
+  double step; // Input frames per output frame.
+  double nominal_step; // (step) before any eh_auresample_adjust().
+};
+
+void eh_auresample_cleanup(struct eh_auresample *rs);
+
+/* (chanc) is the source channel count, must be 1 or 2.
+ * Output channel count and format are provided at export, they don't affect our state.
+ */
+int eh_auresample_init(struct eh_auresample *rs,int quality,int srcrate,int dstrate,int chanc);
+
+/* How many more input frames do we need before we can export (dstframec)?
+ * (dstframec) is clamped to EH_AURESAMPLE_BLOCK.
+ */
+int eh_auresample_want(const struct eh_auresample *rs,int dstframec);
+
+/* Append (framec) frames of input to our history, converting from (srcfmt).
+ * Returns the count consumed, which may be less if the history fills.
+ */
+int eh_auresample_import(struct eh_auresample *rs,const void *src,int framec,int srcfmt);
+
+/* Append (framec) frames repeating the most recent input, in case of underrun.
+ */
+void eh_auresample_pad(struct eh_auresample *rs,int framec);
+
+/* Produce (dstframec) frames (no more than EH_AURESAMPLE_BLOCK) in the given format.
+ * Caller must import or pad first, until eh_auresample_want() returns zero.
+ */
+void eh_auresample_export(struct eh_auresample *rs,void *dst,int dstframec,int dstfmt,int dstchanc);
+
+/* Adjust the conversion ratio by a small factor, for dynamic rate control.
+ * 1.0 is nominal. >1 consumes input faster.
+ * The sinc table was built for the nominal ratio; adjustments of a percent or so are fine.
+ */
+void eh_auresample_adjust(struct eh_auresample *rs,double adjust);
+
+int eh_auresample_quality_eval(const char *src,int srcc);
+const char *eh_auresample_quality_repr(int quality);
+
+/* Run each quality tier against a few common rate conversions and log cost per output frame.
+ * Backs "--audio-benchmark".
+ */
+void eh_auresample_benchmark();
+
+#endif
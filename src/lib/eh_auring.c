@@ -0,0 +1,239 @@
+#include "eh_internal.h"
+#include "eh_auring.h"
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+
+/* Cleanup.
+ */
+
+void eh_auring_cleanup(struct eh_auring *ring) {
+  if (ring->v) free(ring->v);
+  ring->v=0;
+  ring->slotc=0;
+  atomic_store(&ring->head,0);
+  atomic_store(&ring->tail,0);
+}
+
+/* Init.
+ */
+
+int eh_auring_init(struct eh_auring *ring,int capacity,int samplesize,int align) {
+  if ((capacity<1)||(samplesize<1)||(align<1)) return -1;
+  if (capacity%align) capacity+=align-capacity%align;
+  if (capacity>INT_MAX/samplesize-align) return -1;
+  ring->slotc=capacity+align;
+  ring->samplesize=samplesize;
+  ring->align=align;
+  if (!(ring->v=calloc(ring->slotc,samplesize))) {
+    ring->slotc=0;
+    return -1;
+  }
+  atomic_store(&ring->head,0);
+  atomic_store(&ring->tail,0);
+  return 0;
+}
+
+/* Fill and space.
+ */
+
+int eh_auring_get_fill(const struct eh_auring *ring) {
+  if (!ring->slotc) return 0;
+  int head=atomic_load_explicit(&((struct eh_auring*)ring)->head,memory_order_acquire);
+  int tail=atomic_load_explicit(&((struct eh_auring*)ring)->tail,memory_order_acquire);
+  int fill=head-tail;
+  if (fill<0) fill+=ring->slotc;
+  return fill;
+}
+
+int eh_auring_get_space(const struct eh_auring *ring) {
+  if (!ring->slotc) return 0;
+  return ring->slotc-ring->align-eh_auring_get_fill(ring);
+}
+
+int eh_auring_get_capacity(const struct eh_auring *ring) {
+  if (!ring->slotc) return 0;
+  return ring->slotc-ring->align;
+}
+
+/* Write.
+ */
+
+int eh_auring_write(struct eh_auring *ring,const void *src,int samplec) {
+  if (!ring->slotc) return 0;
+  samplec-=samplec%ring->align;
+  int head=atomic_load_explicit(&ring->head,memory_order_relaxed);
+  int tail=atomic_load_explicit(&ring->tail,memory_order_acquire);
+  int space=tail-head-ring->align;
+  if (space<0) space+=ring->slotc;
+  if (samplec>space) samplec=space;
+  if (samplec<1) return 0;
+  int headc=ring->slotc-head;
+  if (headc>samplec) headc=samplec;
+  memcpy(ring->v+head*ring->samplesize,src,headc*ring->samplesize);
+  if (headc<samplec) {
+    memcpy(ring->v,(char*)src+headc*ring->samplesize,(samplec-headc)*ring->samplesize);
+  }
+  if ((head+=samplec)>=ring->slotc) head-=ring->slotc;
+  atomic_store_explicit(&ring->head,head,memory_order_release);
+  return samplec;
+}
+
+/* Peek.
+ */
+
+int eh_auring_peek(const struct eh_auring *ring,const void **dstpp) {
+  if (!ring->slotc) return 0;
+  int head=atomic_load_explicit(&((struct eh_auring*)ring)->head,memory_order_acquire);
+  int tail=atomic_load_explicit(&((struct eh_auring*)ring)->tail,memory_order_relaxed);
+  int c=(head>=tail)?(head-tail):(ring->slotc-tail);
+  *dstpp=ring->v+tail*ring->samplesize;
+  return c;
+}
+
+/* Consume.
+ */
+
+void eh_auring_consume(struct eh_auring *ring,int samplec) {
+  if (samplec<1) return;
+  int fill=eh_auring_get_fill(ring);
+  if (samplec>fill) samplec=fill;
+  samplec-=samplec%ring->align;
+  int tail=atomic_load_explicit(&ring->tail,memory_order_relaxed);
+  if ((tail+=samplec)>=ring->slotc) tail-=ring->slotc;
+  atomic_store_explicit(&ring->tail,tail,memory_order_release);
+}
+
+/* Read.
+ */
+
+int eh_auring_read(struct eh_auring *ring,void *dst,int samplec) {
+  int dstc=0;
+  samplec-=samplec%ring->align;
+  while (dstc<samplec) {
+    const void *src=0;
+    int cpc=eh_auring_peek(ring,&src);
+    if (cpc<1) break;
+    if (cpc>samplec-dstc) cpc=samplec-dstc;
+    memcpy((char*)dst+dstc*ring->samplesize,src,cpc*ring->samplesize);
+    eh_auring_consume(ring,cpc);
+    dstc+=cpc;
+  }
+  return dstc;
+}
+
+/* Stress test.
+ * Samples are a running counter, so the consumer can verify every one.
+ * Each side takes random-sized bites and pauses every so often, one side more than the other.
+ */
+
+struct eh_auring_stress {
+  struct eh_auring ring;
+  int total; // samples
+  int producer_pause_us,consumer_pause_us;
+  int fullc,emptyc;
+  int errorc;
+  int first_error_at;
+};
+
+static void eh_auring_stress_pause(int us,uint32_t *seed) {
+  *seed^=*seed<<13; *seed^=*seed>>17; *seed^=*seed<<5;
+  if ((*seed&15)||(us<1)) return;
+  struct timespec ts={0,us*1000};
+  nanosleep(&ts,0);
+}
+
+static void *eh_auring_stress_producer(void *arg) {
+  struct eh_auring_stress *ctx=arg;
+  int32_t chunk[256];
+  int32_t seq=0;
+  uint32_t seed=0x1234567;
+  while (seq<ctx->total) {
+    seed^=seed<<13; seed^=seed>>17; seed^=seed<<5;
+    int c=((seed%128)+1)*2;
+    if (c>ctx->total-seq) c=ctx->total-seq;
+    int i=0; for (;i<c;i++) chunk[i]=seq+i;
+    int p=0;
+    while (p<c) {
+      int err=eh_auring_write(&ctx->ring,chunk+p,c-p);
+      if (err<1) {
+        ctx->fullc++;
+        sched_yield();
+        continue;
+      }
+      p+=err;
+    }
+    seq+=c;
+    eh_auring_stress_pause(ctx->producer_pause_us,&seed);
+  }
+  return 0;
+}
+
+static void *eh_auring_stress_consumer(void *arg) {
+  struct eh_auring_stress *ctx=arg;
+  int32_t expect=0;
+  uint32_t seed=0x7654321;
+  while (expect<ctx->total) {
+    const void *src=0;
+    int c=eh_auring_peek(&ctx->ring,&src);
+    if (c<1) {
+      ctx->emptyc++;
+      sched_yield();
+      continue;
+    }
+    seed^=seed<<13; seed^=seed>>17; seed^=seed<<5;
+    int limit=((seed%160)+1)*2;
+    if (c>limit) c=limit;
+    const int32_t *v=src;
+    int i=0; for (;i<c;i++,expect++) {
+      if (v[i]!=expect) {
+        if (!ctx->errorc++) ctx->first_error_at=expect;
+        expect=v[i];
+      }
+    }
+    eh_auring_consume(&ctx->ring,c);
+    eh_auring_stress_pause(ctx->consumer_pause_us,&seed);
+  }
+  return 0;
+}
+
+static int eh_auring_stress_1(const char *desc,int producer_pause_us,int consumer_pause_us) {
+  struct eh_auring_stress ctx={
+    .total=20000000,
+    .producer_pause_us=producer_pause_us,
+    .consumer_pause_us=consumer_pause_us,
+  };
+  if (eh_auring_init(&ctx.ring,4096,sizeof(int32_t),2)<0) return -1;
+  int64_t starttime=eh_now_real_us();
+  pthread_t producer,consumer;
+  if (pthread_create(&consumer,0,eh_auring_stress_consumer,&ctx)) {
+    eh_auring_cleanup(&ctx.ring);
+    return -1;
+  }
+  if (pthread_create(&producer,0,eh_auring_stress_producer,&ctx)) {
+    // Consumer will never finish. Just leave it; we're about to exit anyway.
+    return -1;
+  }
+  pthread_join(producer,0);
+  pthread_join(consumer,0);
+  int64_t elapsed=eh_now_real_us()-starttime;
+  fprintf(stderr,
+    "  %-16s %d samples in %.3f s (%.1f M/s), %d full, %d empty, %d errors\n",
+    desc,ctx.total,elapsed/1000000.0,(elapsed>0)?(double)ctx.total/elapsed:0.0,
+    ctx.fullc,ctx.emptyc,ctx.errorc
+  );
+  if (ctx.errorc) {
+    fprintf(stderr,"  !!! First discontinuity at sample %d !!!\n",ctx.first_error_at);
+  }
+  eh_auring_cleanup(&ctx.ring);
+  return ctx.errorc?-1:0;
+}
+
+int eh_auring_stress() {
+  fprintf(stderr,"Audio ring stress, producer and consumer threads at mismatched rates:\n");
+  int err=0;
+  if (eh_auring_stress_1("producer slower",200,20)<0) err=-1;
+  if (eh_auring_stress_1("consumer slower",20,200)<0) err=-1;
+  if (eh_auring_stress_1("unthrottled",0,0)<0) err=-1;
+  return err;
+}
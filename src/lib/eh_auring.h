@@ -0,0 +1,60 @@
+/* eh_auring.h
+ * Wait-free single-producer single-consumer ring buffer for PCM.
+ * The client's update thread produces via eh_audio_write(), and the driver's I/O thread consumes.
+ * No locks: Each side owns one index and only reads the other's.
+ * Indices live on separate cache lines so the two threads don't fight over one.
+ * Everything is in samples, and all transfers are in whole multiples of (align), typically the channel count.
+ */
+
+#ifndef EH_AURING_H
+#define EH_AURING_H
+
+#include <stdatomic.h>
+
+#define EH_AURING_CACHE_LINE 64
+
+struct eh_auring {
+  char *v;
+  int slotc; // Total samples allocated. One (align) is always left empty, to distinguish full from empty.
+  int samplesize;
+  int align;
+  _Alignas(EH_AURING_CACHE_LINE) atomic_int head; // Next sample to write. Producer owns.
+  _Alignas(EH_AURING_CACHE_LINE) atomic_int tail; // Next sample to read. Consumer owns.
+  _Alignas(EH_AURING_CACHE_LINE) char pad;
+};
+
+void eh_auring_cleanup(struct eh_auring *ring);
+
+/* (capacity) in samples will be rounded up to a multiple of (align).
+ */
+int eh_auring_init(struct eh_auring *ring,int capacity,int samplesize,int align);
+
+/* Samples currently readable, or writeable.
+ * Safe from either thread, but it's a snapshot: It may change as soon as we return.
+ */
+int eh_auring_get_fill(const struct eh_auring *ring);
+int eh_auring_get_space(const struct eh_auring *ring);
+int eh_auring_get_capacity(const struct eh_auring *ring);
+
+/* Producer only.
+ * Copy in as much as fits, in at most two memcpy.
+ * Returns sample count consumed, possibly less than (samplec), possibly zero.
+ */
+int eh_auring_write(struct eh_auring *ring,const void *src,int samplec);
+
+/* Consumer only.
+ * eh_auring_peek() reports the contiguous readable span at the read head, up to the end of the buffer.
+ * Do whatever you like with it, then eh_auring_consume() some or all of it.
+ * eh_auring_read() is the same thing with memcpy, up to two spans.
+ */
+int eh_auring_peek(const struct eh_auring *ring,const void **dstpp);
+void eh_auring_consume(struct eh_auring *ring,int samplec);
+int eh_auring_read(struct eh_auring *ring,void *dst,int samplec);
+
+/* Run a producer and consumer on separate threads at mismatched rates for a few seconds,
+ * verify that every sample arrives exactly once in order, and log the result.
+ * Returns <0 if anything went wrong. Backs "--audio-benchmark".
+ */
+int eh_auring_stress();
+
+#endif
@@ -1,9 +1,33 @@
 #include "eh_internal.h"
+#include "render/eh_screencap.h"
+#include "opt/fs/fs.h"
+#include "opt/serial/serial.h"
+
+/* Init.
+ */
+
+int eh_auto_collect_metadata_init(struct eh_auto_collect_metadata *acm,int frame_limit,int interval,const char *output) {
+  memset(acm,0,sizeof(struct eh_auto_collect_metadata));
+  acm->frame_limit=(frame_limit>0)?frame_limit:EH_ACM_DEFAULT_FRAMES;
+  acm->interval=(interval>0)?interval:EH_ACM_DEFAULT_INTERVAL;
+  acm->next_capture=acm->interval;
+  if (output&&output[0]) {
+    if (dir_mkdirp(output)<0) {
+      fprintf(stderr,"%s: Failed to create directory.\n",output);
+      return -2;
+    }
+    acm->output=output;
+  }
+  acm->start_ns=eh_now_mono_ns();
+  return 0;
+}
 
 /* Update.
  */
- 
-int eh_auto_collect_metadata_update(struct eh_auto_collect_metadata *acm) {
+
+int eh_auto_collect_metadata_update(struct eh_auto_collect_metadata *acm,int framec) {
+  if (acm->framec>=acm->frame_limit) return 0;
+  acm->framec+=framec;
   switch ((acm->stage++)&3) {
     case 0: {
         inmgr_artificial_event(1,INMGR_BTN_SOUTH,1);
@@ -18,22 +42,135 @@ int eh_auto_collect_metadata_update(struct eh_auto_collect_metadata *acm) {
         inmgr_artificial_event(1,INMGR_BTN_AUX1,0);
       } break;
   }
-  return 0;
+  return 1;
+}
+
+/* Hash framebuffer, FNV-1a.
+ */
+
+static uint32_t eh_acm_hash(const uint8_t *v,int c) {
+  uint32_t h=0x811c9dc5;
+  for (;c-->0;v++) {
+    h^=*v;
+    h*=0x01000193;
+  }
+  return h;
 }
 
 /* Analyze framebuffer.
  */
- 
-int eh_auto_collect_metadata_fb(const void *fb) {
-  /*
+
+int eh_auto_collect_metadata_fb(struct eh_auto_collect_metadata *acm,const void *fb,const uint8_t *ctab) {
+  if (!fb||!acm->frame_limit) return 0;
+  if (acm->framec<acm->next_capture) return 0;
+  if (acm->capturec>=EH_ACM_CAPTURE_LIMIT) return 0;
+  struct eh_screencap_format format={
     .w=eh.delegate.video_width,
     .h=eh.delegate.video_height,
     .format=eh.delegate.video_format,
     .rmask=eh.delegate.rmask,
     .gmask=eh.delegate.gmask,
     .bmask=eh.delegate.bmask,
-    .ctab=eh.render->ctab,
-  */
-  //...ugh actually this is crazy, it's too much effort.
-  return 0;
+    .ctab=ctab,
+  };
+  int stride=eh_screencap_calculate_stride(&format);
+  if ((stride<1)||(format.h<1)) return 0;
+  int len=stride*format.h;
+
+  // Uniform framebuffers are loading screens or fades. Don't advance (next_capture), try again next pass.
+  int unit=stride/format.w;
+  if (unit<1) unit=1;
+  if ((len<=unit)||!memcmp(fb,(const uint8_t*)fb+unit,len-unit)) return 0;
+
+  // Same for anything we've already captured, eg a title screen that hasn't budged.
+  uint32_t hash=eh_acm_hash(fb,len);
+  int i=acm->capturec;
+  while (i-->0) if (acm->hashv[i]==hash) return 0;
+
+  if (acm->output) {
+    char path[1024];
+    int pathc=snprintf(path,sizeof(path),"%s/scap-%06d.png",acm->output,acm->framec);
+    if ((pathc<1)||(pathc>=sizeof(path))) return -1;
+    void *png=0;
+    int pngc=eh_screencap_from_fb(&png,fb,&format);
+    if (pngc<0) {
+      fprintf(stderr,"%s: Failed to encode screencap.\n",eh.exename);
+      return -2;
+    }
+    int err=file_write(path,png,pngc);
+    free(png);
+    if (err<0) {
+      fprintf(stderr,"%s: Failed to write %d-byte file.\n",path,pngc);
+      return -2;
+    }
+  }
+  acm->capturev[acm->capturec]=acm->framec;
+  acm->hashv[acm->capturec]=hash;
+  acm->capturec++;
+  acm->next_capture=acm->framec+acm->interval;
+  return 1;
+}
+
+/* Player count.
+ */
+
+int eh_auto_collect_metadata_get_player_count(const struct eh_auto_collect_metadata *acm) {
+  int playerc=0;
+  int i=32; while (i-->1) {
+    if (acm->pollmask&(1u<<i)) {
+      playerc=i;
+      break;
+    }
+  }
+  if ((eh.delegate.playerc>0)&&(playerc>eh.delegate.playerc)) playerc=eh.delegate.playerc;
+  return playerc;
+}
+
+/* Report.
+ */
+
+static int eh_acm_encode(struct sr_encoder *dst,const struct eh_auto_collect_metadata *acm) {
+  int jsonctx=sr_encode_json_object_start(dst,0,0);
+  if (jsonctx<0) return -1;
+  if (sr_encode_json_string(dst,"rom",3,eh.rompath?eh.rompath:"",-1)<0) return -1;
+  if (sr_encode_json_string(dst,"emulator",8,eh.delegate.name?eh.delegate.name:"",-1)<0) return -1;
+  if (sr_encode_json_int(dst,"frames",6,acm->framec)<0) return -1;
+  if (sr_encode_json_int(dst,"players",7,eh_auto_collect_metadata_get_player_count(acm))<0) return -1;
+  int arrayctx=sr_encode_json_array_start(dst,"screencaps",10);
+  if (arrayctx<0) return -1;
+  if (acm->output) {
+    int i=0; for (;i<acm->capturec;i++) {
+      char name[32];
+      int namec=snprintf(name,sizeof(name),"scap-%06d.png",acm->capturev[i]);
+      if (sr_encode_json_string(dst,0,0,name,namec)<0) return -1;
+    }
+  }
+  if (sr_encode_json_array_end(dst,arrayctx)<0) return -1;
+  if (sr_encode_json_int(dst,"elapsedMs",9,(int)((eh_now_mono_ns()-acm->start_ns)/1000000))<0) return -1;
+  return sr_encode_json_object_end(dst,jsonctx);
+}
+
+int eh_auto_collect_metadata_finish(struct eh_auto_collect_metadata *acm) {
+  if (!acm->frame_limit) return 0;
+  struct sr_encoder encoder={0};
+  if (eh_acm_encode(&encoder,acm)<0) {
+    sr_encoder_cleanup(&encoder);
+    fprintf(stderr,"%s: Failed to encode metadata report.\n",eh.exename);
+    return -2;
+  }
+  int err=0;
+  if (acm->output) {
+    char path[1024];
+    int pathc=snprintf(path,sizeof(path),"%s/report.json",acm->output);
+    if ((pathc<1)||(pathc>=sizeof(path))) err=-1;
+    else if (file_write(path,encoder.v,encoder.c)<0) {
+      fprintf(stderr,"%s: Failed to write %d-byte file.\n",path,encoder.c);
+      err=-2;
+    }
+  } else {
+    fprintf(stdout,"%.*s\n",encoder.c,encoder.v);
+    fflush(stdout);
+  }
+  sr_encoder_cleanup(&encoder);
+  return err;
 }
@@ -1,11 +1,70 @@
+/* eh_auto_collect_metadata.h
+ * Run a game headless for a fixed count of frames and note what we can about it.
+ * Romassist launches a pool of these to backfill screencaps and player counts.
+ *
+ * We mash South and Aux1 on player one, that gets past most title screens.
+ * Screencaps are taken every (interval) frames, but blank frames and repeats are skipped, we retry on the next pass.
+ * Player count is the highest player the game asked eh_input_get() about, capped to what the delegate declares.
+ * Plenty of emulators read every port regardless of the game, so treat it as an upper bound.
+ *
+ * With an output directory, we write "scap-FRAME.png" for each screencap, and at exit "report.json":
+ *   {
+ *     "rom":PATH,
+ *     "emulator":NAME,
+ *     "frames":INT,
+ *     "players":INT,
+ *     "screencaps":[BASENAME...],
+ *     "elapsedMs":INT,
+ *   }
+ * Without one, the report goes to stdout and we don't encode screencaps.
+ */
+
 #ifndef EH_AUTO_COLLECT_METADATA_H
 #define EH_AUTO_COLLECT_METADATA_H
 
+#include <stdint.h>
+
+#define EH_ACM_DEFAULT_FRAMES 3600
+#define EH_ACM_DEFAULT_INTERVAL 600
+#define EH_ACM_FRAMES_PER_PASS 20
+#define EH_ACM_CAPTURE_LIMIT 16
+
 struct eh_auto_collect_metadata {
   int stage;
+  int framec; // Frames run so far.
+  int frame_limit;
+  int interval;
+  int next_capture; // Frame count at which we want the next screencap.
+  const char *output; // Directory. WEAK, from config.
+  uint32_t pollmask; // Player ids passed to eh_input_get().
+  int capturev[EH_ACM_CAPTURE_LIMIT]; // Frame counts, they're also the file names.
+  uint32_t hashv[EH_ACM_CAPTURE_LIMIT];
+  int capturec;
+  int64_t start_ns;
 };
 
-int eh_auto_collect_metadata_update(struct eh_auto_collect_metadata *acm);
-int eh_auto_collect_metadata_fb(const void *fb);
+/* Call after the game is loaded.
+ * (output) may be null. If not, we create the directory.
+ */
+int eh_auto_collect_metadata_init(struct eh_auto_collect_metadata *acm,int frame_limit,int interval,const char *output);
+
+/* Call before each pass of (framec) frames, in place of the clock.
+ * Returns zero when we're done.
+ */
+int eh_auto_collect_metadata_update(struct eh_auto_collect_metadata *acm,int framec);
+
+/* Renderer calls with each committed framebuffer, and its color table for indexed formats.
+ */
+int eh_auto_collect_metadata_fb(struct eh_auto_collect_metadata *acm,const void *fb,const uint8_t *ctab);
+
+static inline void eh_auto_collect_metadata_poll(struct eh_auto_collect_metadata *acm,uint8_t plrid) {
+  if (plrid<32) acm->pollmask|=1u<<plrid;
+}
+
+int eh_auto_collect_metadata_get_player_count(const struct eh_auto_collect_metadata *acm);
+
+/* Write report.json, or dump it to stdout. Noop if we never started.
+ */
+int eh_auto_collect_metadata_finish(struct eh_auto_collect_metadata *acm);
 
 #endif
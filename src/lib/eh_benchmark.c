@@ -0,0 +1,253 @@
+#include "eh_internal.h"
+#include "eh_benchmark.h"
+#include "opt/serial/serial.h"
+#include "opt/fs/fs.h"
+#include <sys/resource.h>
+#if USE_evdev
+  #include "opt/evdev/evdev.h"
+  #include <linux/input.h>
+#endif
+
+/* Cleanup.
+ */
+
+void eh_benchmark_cleanup(struct eh_benchmark *bm) {
+  if (bm->update_ns) free(bm->update_ns);
+  if (bm->commit_ns) free(bm->commit_ns);
+  if (bm->aucvt_ns) free(bm->aucvt_ns);
+  memset(bm,0,sizeof(struct eh_benchmark));
+}
+
+/* Init.
+ */
+
+int eh_benchmark_init(struct eh_benchmark *bm,int framec) {
+  eh_benchmark_cleanup(bm);
+  if (framec<1) return 0;
+  if (
+    !(bm->update_ns=malloc(sizeof(int32_t)*framec))||
+    !(bm->commit_ns=malloc(sizeof(int32_t)*framec))||
+    !(bm->aucvt_ns=malloc(sizeof(int32_t)*framec))
+  ) {
+    eh_benchmark_cleanup(bm);
+    return -1;
+  }
+  bm->framec=framec;
+  bm->start_ns=eh_now_mono_ns();
+  return 0;
+}
+
+/* End of frame.
+ */
+
+static int32_t eh_benchmark_clamp(int64_t ns) {
+  if (ns>INT_MAX) return INT_MAX;
+  return ns;
+}
+
+int eh_benchmark_frame(struct eh_benchmark *bm) {
+  if (!bm->framec) return 1;
+  if (bm->framep>=bm->framec) return 0;
+  bm->update_ns[bm->framep]=eh_benchmark_clamp(bm->update_acc);
+  bm->commit_ns[bm->framep]=eh_benchmark_clamp(bm->commit_acc);
+  bm->aucvt_ns[bm->framep]=eh_benchmark_clamp(bm->aucvt_acc);
+  bm->update_acc=bm->commit_acc=bm->aucvt_acc=0;
+  if (++(bm->framep)<bm->framec) return 1;
+  bm->end_ns=eh_now_mono_ns();
+  return 0;
+}
+
+/* Encode one set of samples. Sorts (v) in place.
+ */
+
+static int eh_benchmark_cmp(const void *a,const void *b) {
+  int32_t A=*(const int32_t*)a,B=*(const int32_t*)b;
+  return (A<B)?-1:(A>B)?1:0;
+}
+
+static int eh_benchmark_encode_stats(struct sr_encoder *dst,const char *k,int32_t *v,int c) {
+  int jsonctx=sr_encode_json_object_start(dst,k,-1);
+  if (jsonctx<0) return -1;
+  if (c>0) {
+    int64_t total=0;
+    int i=c; while (i-->0) total+=v[i];
+    qsort(v,c,sizeof(int32_t),eh_benchmark_cmp);
+    int p99=(c*99)/100;
+    if (p99>=c) p99=c-1;
+    if (sr_encode_json_double(dst,"p50Us",5,v[c>>1]/1000.0)<0) return -1;
+    if (sr_encode_json_double(dst,"p99Us",5,v[p99]/1000.0)<0) return -1;
+    if (sr_encode_json_double(dst,"maxUs",5,v[c-1]/1000.0)<0) return -1;
+    if (sr_encode_json_double(dst,"totalMs",7,total/1000000.0)<0) return -1;
+  }
+  return sr_encode_json_object_end(dst,jsonctx);
+}
+
+/* Report.
+ */
+
+static int eh_benchmark_encode(struct sr_encoder *dst,struct eh_benchmark *bm) {
+  int64_t end_ns=bm->end_ns?bm->end_ns:eh_now_mono_ns();
+  double elapsed=(end_ns-bm->start_ns)/1000000000.0;
+  struct rusage usage={0};
+  getrusage(RUSAGE_SELF,&usage);
+  int jsonctx=sr_encode_json_object_start(dst,0,0);
+  if (jsonctx<0) return -1;
+  if (sr_encode_json_string(dst,"benchmark",9,"frames",6)<0) return -1;
+  if (sr_encode_json_string(dst,"emulator",8,eh.delegate.name?eh.delegate.name:"",-1)<0) return -1;
+  if (sr_encode_json_string(dst,"rom",3,eh.rompath?eh.rompath:"",-1)<0) return -1;
+  if (sr_encode_json_int(dst,"frames",6,bm->framep)<0) return -1;
+  if (sr_encode_json_double(dst,"elapsedS",8,elapsed)<0) return -1;
+  if (sr_encode_json_double(dst,"fps",3,(elapsed>0.0)?(bm->framep/elapsed):0.0)<0) return -1;
+  if (eh_benchmark_encode_stats(dst,"update",bm->update_ns,bm->framep)<0) return -1;
+  if (eh_benchmark_encode_stats(dst,"commit",bm->commit_ns,bm->framep)<0) return -1;
+  if (eh_benchmark_encode_stats(dst,"aucvt",bm->aucvt_ns,bm->framep)<0) return -1;
+  if (sr_encode_json_int(dst,"peakRssKb",9,usage.ru_maxrss)<0) return -1;
+  return sr_encode_json_object_end(dst,jsonctx);
+}
+
+void eh_benchmark_report(struct eh_benchmark *bm) {
+  if (!bm->framec) return;
+  struct sr_encoder encoder={0};
+  if (eh_benchmark_encode(&encoder,bm)>=0) {
+    fprintf(stdout,"%.*s\n",encoder.c,encoder.v);
+    fflush(stdout);
+  } else {
+    fprintf(stderr,"%s: Failed to encode benchmark report.\n",eh.exename);
+  }
+  sr_encoder_cleanup(&encoder);
+}
+
+/* Input benchmark: Add a button to the caps list, or widen the one that's there.
+ */
+#if USE_evdev
+
+static int eh_benchmark_input_cap(struct inmgr_benchmark_button **v,int *c,int *a,int type,int code,int value) {
+  int btnid=(type<<16)|code;
+  struct inmgr_benchmark_button *button=*v;
+  int i=*c;
+  for (;i-->0;button++) {
+    if (button->btnid!=btnid) continue;
+    if (type!=EV_ABS) return 0;
+    if (value<button->lo) button->lo=value;
+    else if (value>button->hi) button->hi=value;
+    return 0;
+  }
+  if (*c>=*a) {
+    int na=(*a)+32;
+    void *nv=realloc(*v,sizeof(struct inmgr_benchmark_button)*na);
+    if (!nv) return -1;
+    *v=nv;
+    *a=na;
+  }
+  button=(*v)+(*c)++;
+  button->btnid=btnid;
+  button->hidusage=evdev_guess_hid_usage(type,code);
+  if (type==EV_KEY) {
+    button->lo=0;
+    button->hi=2;
+  } else {
+    button->lo=button->hi=value;
+  }
+  return 0;
+}
+
+/* Input benchmark: Make up a gamepad session.
+ * About one event in eight is a button or hat, the rest are analogue sticks and triggers wandering around.
+ */
+ 
+static int eh_benchmark_input_synthesize(struct input_event **dstpp) {
+  static const int axisv[]={ABS_X,ABS_Y,ABS_RX,ABS_RY,ABS_Z,ABS_RZ};
+  const int eventc=200000;
+  struct input_event *event=calloc(eventc,sizeof(struct input_event));
+  if (!event) return -1;
+  *dstpp=event;
+  int axisvalue[6]={0},hatvalue[2]={0},keystate=0;
+  int i=0;
+  // Swing each axis across its full range first, as if calibrating. We take the caps from what we see.
+  for (;i<6;i++) {
+    event->type=EV_ABS; event->code=axisv[i]; event->value=(i<4)?-32768:0; event++;
+    event->type=EV_ABS; event->code=axisv[i]; event->value=(i<4)?32767:255; event++;
+    event->type=EV_ABS; event->code=axisv[i]; event->value=0; event++;
+  }
+  uint32_t noise=0x12345678;
+  for (i=18;i<eventc;i++,event++) {
+    noise=noise*1103515245+12345;
+    int r=noise>>16;
+    if (r&7) {
+      int axisp=(r>>3)%6;
+      event->type=EV_ABS;
+      event->code=axisv[axisp];
+      if (axisp<4) {
+        int v=axisvalue[axisp]+((r>>6)&0x3ff)-0x200;
+        if (v<-32768) v=-32768; else if (v>32767) v=32767;
+        event->value=axisvalue[axisp]=v;
+      } else {
+        event->value=axisvalue[axisp]=(r>>6)&0xff;
+      }
+    } else if (r&8) {
+      int hatp=(r>>4)&1;
+      event->type=EV_ABS;
+      event->code=ABS_HAT0X+hatp;
+      event->value=hatvalue[hatp]=(hatvalue[hatp]?0:((r&32)?1:-1));
+    } else {
+      int bit=(r>>4)%12;
+      event->type=EV_KEY;
+      event->code=BTN_SOUTH+bit;
+      event->value=((keystate^=1<<bit)&(1<<bit))?1:0;
+    }
+  }
+  return eventc;
+}
+
+#endif
+
+/* Input benchmark.
+ */
+ 
+int eh_benchmark_input(const char *path) {
+  #if USE_evdev
+    struct input_event *src=0;
+    int srcc=0;
+    if (path&&path[0]) {
+      if ((srcc=file_read(&src,path))<0) {
+        fprintf(stderr,"%s: Failed to read file.\n",path);
+        return -2;
+      }
+      srcc/=sizeof(struct input_event);
+    } else {
+      if ((srcc=eh_benchmark_input_synthesize(&src))<0) return -1;
+    }
+    struct inmgr_benchmark_button *buttonv=0;
+    int buttonc=0,buttona=0,eventc=0,err=0,i;
+    int *eventv=malloc(sizeof(int)*2*(srcc?srcc:1));
+    if (!eventv) err=-1;
+    const struct input_event *event=src;
+    for (i=srcc;(err>=0)&&(i-->0);event++) {
+      if ((event->type!=EV_KEY)&&(event->type!=EV_ABS)) continue;
+      if (eh_benchmark_input_cap(&buttonv,&buttonc,&buttona,event->type,event->code,event->value)<0) { err=-1; break; }
+      eventv[eventc*2]=(event->type<<16)|event->code;
+      eventv[eventc*2+1]=event->value;
+      eventc++;
+    }
+    // Axes that only ever reported one value would look like buttons to inmgr. Spread them a little.
+    struct inmgr_benchmark_button *button=buttonv;
+    for (i=buttonc;i-->0;button++) {
+      if (button->hi-button->lo<2) { button->lo--; button->hi++; }
+    }
+    if (err>=0) {
+      if (!eventc) {
+        fprintf(stderr,"%s: No key or axis events.\n",(path&&path[0])?path:"synthetic");
+        err=-2;
+      } else {
+        err=inmgr_benchmark(buttonv,buttonc,eventv,eventc,(path&&path[0])?path:"synthetic gamepad");
+      }
+    }
+    if (src) free(src);
+    if (eventv) free(eventv);
+    if (buttonv) free(buttonv);
+    return err;
+  #else
+    fprintf(stderr,"%s: --input-benchmark requires evdev.\n",eh.exename);
+    return -2;
+  #endif
+}
@@ -0,0 +1,55 @@
+/* eh_benchmark.h
+ * --benchmark=FRAMES: Run that many frames headless and unthrottled, then print one line of JSON to stdout:
+ *   {"benchmark":"frames","emulator":STRING,"rom":STRING,"frames":INT,"elapsedS":FLOAT,"fps":FLOAT,
+ *    "update":STATS,"commit":STATS,"aucvt":STATS,"peakRssKb":INT}
+ *   STATS: {"p50Us":FLOAT,"p99Us":FLOAT,"maxUs":FLOAT,"totalMs":FLOAT}
+ * "update" is delegate.update, "commit" is framebuffer conversion (eh_render_commit), "aucvt" is eh_aucvt_output.
+ * Input is the movie from --replay if given, otherwise a scripted sequence that's the same every run.
+ * Logging still goes to stderr, so stdout is just the report.
+ */
+
+#ifndef EH_BENCHMARK_H
+#define EH_BENCHMARK_H
+
+#include "eh_clock.h"
+
+struct eh_benchmark {
+  int framec; // Target. Zero if we're not benchmarking.
+  int framep;
+  int32_t *update_ns; // One per frame, each list (framec) long.
+  int32_t *commit_ns;
+  int32_t *aucvt_ns;
+  int64_t update_acc,commit_acc,aucvt_acc; // Current frame.
+  int64_t start_ns,end_ns;
+};
+
+void eh_benchmark_cleanup(struct eh_benchmark *bm);
+int eh_benchmark_init(struct eh_benchmark *bm,int framec);
+
+/* Call at the end of each main loop pass.
+ * Returns zero when we've collected enough frames.
+ */
+int eh_benchmark_frame(struct eh_benchmark *bm);
+
+/* Print the JSON report to stdout.
+ */
+void eh_benchmark_report(struct eh_benchmark *bm);
+
+/* --input-benchmark[=PATH]: Replay evdev events through inmgr, comparing its mapping lookups. Report to stderr.
+ * PATH is a raw dump of one device, eg `cat /dev/input/event3 > gamepad.bin`, mash some buttons, then ^C.
+ * We take its capabilities from the events, so buttons you didn't touch don't exist.
+ * Without PATH, a made-up gamepad with noisy sticks.
+ */
+int eh_benchmark_input(const char *path);
+
+/* Wrap measured operations in these: t=eh_benchmark_begin(bm); ...; eh_benchmark_end(&bm->XXX_acc,t);
+ * They cost nothing when not benchmarking.
+ */
+static inline int64_t eh_benchmark_begin(const struct eh_benchmark *bm) {
+  return bm->framec?eh_now_mono_ns():0;
+}
+static inline void eh_benchmark_end(int64_t *acc,int64_t t0) {
+  if (t0) *acc+=eh_now_mono_ns()-t0;
+}
+
+#endif
@@ -1,13 +1,21 @@
 #include "eh_clock.h"
+#include "eh_aucvt.h"
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
 #include <stdio.h>
+#include <string.h>
+#include <errno.h>
 
 /* If our expected time disagrees with real time by more than this, panic and reset.
  */
 #define EH_MAX_DELAY 1000000ll
 
+/* Precise pacing sleeps until this long before the deadline, then spins.
+ * Comfortably more than the kernel's default timer slack (50 us).
+ */
+#define EH_CLOCK_SPIN_NS 250000ll
+
 /* Current time.
  */
  
@@ -23,10 +31,17 @@ int64_t eh_now_cpu_us() {
   return (int64_t)tv.tv_sec*1000000ll+tv.tv_nsec/1000;
 }
 
+int64_t eh_now_mono_ns() {
+  struct timespec tv={0};
+  clock_gettime(CLOCK_MONOTONIC,&tv);
+  return (int64_t)tv.tv_sec*1000000000ll+tv.tv_nsec;
+}
+
 /* Init.
  */
  
-void eh_clock_init(struct eh_clock *clock,double rate) {
+void eh_clock_init(struct eh_clock *clock,double rate,int pacing,int display_rate) {
+  memset(clock,0,sizeof(struct eh_clock));
 
   /* Permit 1..240 Hz, and default to 60 if unset or negative.
    */
@@ -34,19 +49,34 @@ void eh_clock_init(struct eh_clock *clock,double rate) {
   else if (rate>240.0) clock->rate=240.0;
   else clock->rate=rate;
   clock->frame_time=1000000.0/clock->rate;
+  clock->frame_time_ns=1000000000.0/clock->rate;
+  
+  switch (pacing) {
+    case EH_CLOCK_PACING_USLEEP:
+    case EH_CLOCK_PACING_PRECISE:
+    case EH_CLOCK_PACING_VSYNC:
+      clock->pacing=pacing;
+      break;
+    default: clock->pacing=EH_CLOCK_PACING_DEFAULT;
+  }
+  
+  if ((clock->pacing==EH_CLOCK_PACING_VSYNC)&&(display_rate>0)) {
+    clock->present_period_ns=1000000000ll/display_rate;
+  } else {
+    clock->present_period_ns=clock->frame_time_ns;
+  }
   
   clock->start_time_real=eh_now_real_us();
   clock->start_time_cpu=eh_now_cpu_us();
   // Cheat start time backward so we don't delay the first frame:
   clock->recent_time_real=clock->start_time_real-clock->frame_time;
-  clock->framec=0;
-  clock->faultc=0;
+  clock->deadline_ns=eh_now_mono_ns()-clock->frame_time_ns;
 }
 
-/* Tick.
+/* Tick, usleep mode.
  */
-
-int eh_clock_tick(struct eh_clock *clock) {
+ 
+static void eh_clock_tick_usleep(struct eh_clock *clock) {
   clock->recent_time_real+=clock->frame_time;
   int64_t now=eh_now_real_us();
   while (1) {
@@ -65,27 +95,163 @@ int eh_clock_tick(struct eh_clock *clock) {
     usleep(delay+1);
     now=eh_now_real_us();
   }
+}
+
+/* Sleep until an absolute monotonic time, less the spin margin, then spin.
+ */
+ 
+static void eh_clock_wait_until(int64_t deadline) {
+  int64_t wake=deadline-EH_CLOCK_SPIN_NS;
+  if (wake>eh_now_mono_ns()) {
+    struct timespec ts={
+      .tv_sec=wake/1000000000ll,
+      .tv_nsec=wake%1000000000ll,
+    };
+    while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,0)==EINTR) ;
+  }
+  while (eh_now_mono_ns()<deadline) ;
+}
+
+/* Tick, precise mode.
+ * Same policy as usleep: Hold to a fixed schedule, catch up if behind, reset if way off.
+ */
+ 
+static void eh_clock_tick_precise(struct eh_clock *clock) {
+  clock->deadline_ns+=clock->frame_time_ns;
+  int64_t now=eh_now_mono_ns();
+  int64_t delay=clock->deadline_ns-now;
+  if ((delay<-EH_MAX_DELAY*1000ll)||(delay>EH_MAX_DELAY*1000ll)) {
+    clock->deadline_ns=now;
+    clock->faultc++;
+    return;
+  }
+  if (delay<=0) return;
+  eh_clock_wait_until(clock->deadline_ns);
+}
+
+/* Tick, vsync mode.
+ * The video driver's swap already blocked until vblank, so ordinarily we just proceed.
+ * But some compositors quietly ignore swap interval.
+ * So hold to at least 3/4 of the refresh period, so we can't run away if vsync isn't really happening.
+ */
+ 
+static void eh_clock_tick_vsync(struct eh_clock *clock) {
+  if (!clock->last_tick_ns) return;
+  int64_t floor=clock->last_tick_ns+(clock->present_period_ns*3)/4;
+  if (eh_now_mono_ns()<floor) eh_clock_wait_until(floor);
+}
+
+/* Record one interval.
+ */
+ 
+static void eh_clock_record(struct eh_clock *clock) {
+  int64_t now=eh_now_mono_ns();
+  if (clock->last_tick_ns) {
+    int64_t interval=now-clock->last_tick_ns;
+    int64_t p=interval/EH_CLOCK_HISTOGRAM_BUCKET_NS;
+    if (p<0) p=0;
+    else if (p>=EH_CLOCK_HISTOGRAM_SIZE) p=EH_CLOCK_HISTOGRAM_SIZE-1;
+    clock->histogram[p]++;
+    clock->intervalc++;
+    if (interval>clock->frame_time_max) clock->frame_time_max=interval;
+    int64_t period=clock->present_period_ns;
+    if (interval*2>=period*3) {
+      clock->duplicatec+=(interval+period/2)/period-1;
+    } else if (interval*2<period) {
+      clock->tearc++;
+    }
+  } else {
+    clock->start_time_mono=now;
+  }
+  clock->last_tick_ns=now;
+}
+
+/* Tick.
+ */
+
+int eh_clock_tick(struct eh_clock *clock) {
+  switch (clock->pacing) {
+    case EH_CLOCK_PACING_USLEEP: eh_clock_tick_usleep(clock); break;
+    case EH_CLOCK_PACING_VSYNC: eh_clock_tick_vsync(clock); break;
+    default: eh_clock_tick_precise(clock); break;
+  }
+  eh_clock_record(clock);
   clock->framec++;
   return 1;
 }
 
+/* Percentile from histogram, in ns.
+ */
+ 
+static int64_t eh_clock_percentile(const struct eh_clock *clock,int pct) {
+  if (clock->intervalc<1) return 0;
+  int threshold=(int)(((int64_t)clock->intervalc*pct+99)/100);
+  if (threshold<1) threshold=1;
+  int sum=0,i=0;
+  for (;i<EH_CLOCK_HISTOGRAM_SIZE;i++) {
+    sum+=clock->histogram[i];
+    if (sum>=threshold) {
+      int64_t v=(i+1)*EH_CLOCK_HISTOGRAM_BUCKET_NS;
+      if (v>clock->frame_time_max) v=clock->frame_time_max;
+      return v;
+    }
+  }
+  return clock->frame_time_max;
+}
+
 /* Report.
  */
 
 const char *eh_clock_report(struct eh_clock *clock) {
   if (clock->framec<1) return "";
   
-  double elapsed_real=(clock->recent_time_real-clock->start_time_real)/1000000.0;
+  // Measured between actual tick returns, so it reflects what we really delivered, not what we scheduled.
+  double elapsed_real=(clock->last_tick_ns-clock->start_time_mono)/1000000000.0;
   double elapsed_cpu=(eh_now_cpu_us()-clock->start_time_cpu)/1000000.0;
-  double avgrate=clock->framec/elapsed_real;
-  double cpuusage=elapsed_cpu/elapsed_real;
+  double avgrate=(elapsed_real>0.0)?(clock->intervalc/elapsed_real):0.0;
+  double cpuusage=(elapsed_real>0.0)?(elapsed_cpu/elapsed_real):0.0;
   
   int c=snprintf(clock->report_storage,sizeof(clock->report_storage),
-    "%d frames in %.0f s, %d faults, video rate %.03f Hz, CPU usage %.03f",
-    clock->framec,elapsed_real,clock->faultc,avgrate,cpuusage
+    "%d frames in %.0f s, %d faults, video rate %.03f Hz (%s), "
+    "frame time p50 %.2f p99 %.2f max %.2f ms, %d duplicate, %d torn, CPU usage %.03f",
+    clock->framec,elapsed_real,clock->faultc,avgrate,eh_clock_pacing_repr(clock->pacing),
+    eh_clock_percentile(clock,50)/1000000.0,
+    eh_clock_percentile(clock,99)/1000000.0,
+    clock->frame_time_max/1000000.0,
+    clock->duplicatec,clock->tearc,cpuusage
   );
   if ((c<1)||(c>=sizeof(clock->report_storage))) {
     clock->report_storage[0]=0;
+    return clock->report_storage;
+  }
+  
+  if (clock->aucvt) {
+    char audio[256];
+    if (eh_aucvt_report(audio,sizeof(audio),clock->aucvt)>0) {
+      int addc=snprintf(clock->report_storage+c,sizeof(clock->report_storage)-c,", %s",audio);
+      if ((addc<1)||(c+addc>=sizeof(clock->report_storage))) clock->report_storage[c]=0;
+    }
   }
   return clock->report_storage;
 }
+
+/* Pacing names.
+ */
+ 
+int eh_clock_pacing_eval(const char *src,int srcc) {
+  if (!src) return 0;
+  if (srcc<0) { srcc=0; while (src[srcc]) srcc++; }
+  if ((srcc==6)&&!memcmp(src,"usleep",6)) return EH_CLOCK_PACING_USLEEP;
+  if ((srcc==7)&&!memcmp(src,"precise",7)) return EH_CLOCK_PACING_PRECISE;
+  if ((srcc==5)&&!memcmp(src,"vsync",5)) return EH_CLOCK_PACING_VSYNC;
+  return 0;
+}
+
+const char *eh_clock_pacing_repr(int pacing) {
+  switch (pacing) {
+    case EH_CLOCK_PACING_USLEEP: return "usleep";
+    case EH_CLOCK_PACING_PRECISE: return "precise";
+    case EH_CLOCK_PACING_VSYNC: return "vsync";
+  }
+  return "?";
+}
@@ -3,23 +3,63 @@
 
 #include <stdint.h>
 
+struct eh_aucvt;
+
+/* Pacing modes.
+ *   usleep: What we used to do. Sleep until the deadline, with the scheduler's usual slop.
+ *   precise: clock_nanosleep to an absolute deadline just shy of the target, then spin the rest. Default.
+ *   vsync: Don't delay at all; the video driver blocks at swap until vertical blank.
+ */
+#define EH_CLOCK_PACING_USLEEP  1
+#define EH_CLOCK_PACING_PRECISE 2
+#define EH_CLOCK_PACING_VSYNC   3
+
+#define EH_CLOCK_PACING_DEFAULT EH_CLOCK_PACING_PRECISE
+
+/* Frame-time histogram resolution and range.
+ * Anything longer than the last bucket lands in the last bucket; (frame_time_max) is exact.
+ */
+#define EH_CLOCK_HISTOGRAM_BUCKET_NS 50000ll
+#define EH_CLOCK_HISTOGRAM_SIZE 2000
+
 struct eh_clock {
   double rate; // hz
+  int pacing; // EH_CLOCK_PACING_*
   int64_t frame_time; // us
+  int64_t frame_time_ns;
   int64_t start_time_real;
   int64_t start_time_cpu;
   int64_t recent_time_real;
+  int64_t deadline_ns; // precise only, monotonic
   int framec;
   int faultc;
-  char report_storage[128];
+
+  /* Frame-to-frame interval stats, measured at each tick's return.
+   * (present_period_ns) is the display's refresh period if known, otherwise our frame time.
+   * An interval spanning more than 1.5 periods means the display showed some frame twice: "duplicate".
+   * Less than half a period means two frames went out in one refresh, one of them torn or never seen: "tear".
+   */
+  int64_t present_period_ns;
+  int64_t start_time_mono; // First tick.
+  int64_t last_tick_ns;
+  int64_t frame_time_max;
+  int histogram[EH_CLOCK_HISTOGRAM_SIZE];
+  int intervalc;
+  int duplicatec;
+  int tearc;
+
+  const struct eh_aucvt *aucvt; // Optional, owner sets after init, to include audio stats in the report.
+  char report_storage[512];
 };
 
 int64_t eh_now_real_us();
 int64_t eh_now_cpu_us();
+int64_t eh_now_mono_ns();
 
 /* (rate) should come straight off the delegate.
+ * (display_rate) is the video driver's refresh rate if known, or zero.
  */
-void eh_clock_init(struct eh_clock *clock,double rate);
+void eh_clock_init(struct eh_clock *clock,double rate,int pacing,int display_rate);
 
 /* Delay if needed, and return count of frames to execute, usually 1.
  */
@@ -31,4 +71,7 @@ int eh_clock_tick(struct eh_clock *clock);
  */
 const char *eh_clock_report(struct eh_clock *clock);
 
+int eh_clock_pacing_eval(const char *src,int srcc);
+const char *eh_clock_pacing_repr(int pacing);
+
 #endif
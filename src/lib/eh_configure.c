@@ -13,17 +13,43 @@ static void eh_print_help(const char *topic,int topicc) {
     "  --help                   Print this message.\n"
     "  --video=LIST             Video drivers, in order of preference.\n"
     "  --audio=LIST             Audio drivers, in order of preference.\n"
-    "  --input=LIST             Input drivers -- we will instantiate all.\n"
+    "  --input=LIST             Input drivers -- we will instantiate all. 'none' for none.\n"
     "  --fullscreen=0|1\n"
     "  --video-device=PATH      Default /dev/dri/card0, only DRM uses.\n"
+    "  --video-flip-queue=0     1..3 frames queued for scanout, zero for default (2). Only DRM uses.\n"
     "  --pixel-refresh=1.0      Lower for motion blur.\n"
     "  --audio-rate=HZ\n"
     "  --audio-chanc=1|2\n"
     "  --audio-device=STRING\n"
+    "  --audio-resampler=sinc   (nearest,linear,cubic,sinc) Quality of rate conversion, if needed.\n"
+    "  --audio-rate-control=1   Adjust resampling slightly to keep audio in sync. 0 to add/drop video frames instead.\n"
+    "  --audio-period=0         Frames per transfer to the audio device. Zero for the driver's default. alsa, pulseasync (minreq).\n"
+    "  --audio-periods=0        Transfers per device buffer. With --audio-period, sets the buffer size. alsa, pulseasync (tlength).\n"
+    "  --audio-mmap=0           Fill the device's buffer in place instead of copying. alsa only.\n"
+    "  --audio-rtprio=0         Run the audio thread SCHED_FIFO at this priority (1..99). Needs permission. alsa only.\n"
+    "  --audio-benchmark        Measure each resampler and stress the audio ring, then quit.\n"
+    "  --input-benchmark[=PATH] Replay raw evdev events (or a made-up gamepad) through input mapping, then quit.\n"
+    "  --screencap-level=6      (0..9) zlib compression for screencaps. They encode in the background either way.\n"
+    "  --screencap-shm=1        Share raw screencaps with a local Romassist, and let it do the encoding.\n"
+    "  --runahead=0             Run-ahead frames to hide the game's input lag. Costs CPU. Not every emulator supports it.\n"
+    "  --pacing=precise         (usleep,precise,vsync) How to hold the video rate. vsync needs glx or drm.\n"
     "  --glsl-version=INT\n"
     "  --screen=any             (left,right,top,bottom) Try to land window on the given monitor.\n"
     "  --crop=x,y,w,h\n"
     "  --romassist=HOST:PORT\n"
+    "  --stream=0               Stream the framebuffer to Romassist's web viewers at up to so many frames per second.\n"
+    "  --record[=PATH]          Record input. Without PATH, it's saved by Romassist as a blob of the game.\n"
+    "  --replay=PATH            Play back a recorded movie, then quit.\n"
+    "  --replay-loop            Reset and replay forever, eg for attract mode.\n"
+    "  --unthrottled            Run as fast as possible. With --replay and --video=dummy --audio=dummy, a benchmark.\n"
+    "  --benchmark=FRAMES       Run headless and unthrottled, then print JSON timings to stdout. Scripted input unless --replay.\n"
+    "  --auto-collect-metadata[=3600] Run headless for so many frames, taking screencaps and guessing the player count.\n"
+    "  --acm-interval=600       Frames between metadata screencaps.\n"
+    "  --acm-output=DIR         Write metadata screencaps and report.json here. Otherwise report to stdout.\n"
+    "  --input-thread=0         Service input devices on their own thread as events arrive, rather than polling each frame. evdev only.\n"
+    "  --latency-probe=FRAMES   Press a virtual gamepad button every so many frames, to measure input latency. Needs /dev/uinput.\n"
+    "  --rom-mmap=1             Map the ROM file instead of reading it. Either way, it loads while drivers initialize.\n"
+    "  --standby                Connect to Romassist and wait for it to provide the ROM. Romassist uses this for warm spares.\n"
     "\n"
   );
 }
@@ -119,6 +145,32 @@ static int eh_config_set_crop(const char *src,int srcc) {
   return 0;
 }
 
+/* --audio-resampler=nearest|linear|cubic|sinc
+ */
+ 
+static int eh_config_set_resampler(const char *src,int srcc) {
+  int quality=eh_auresample_quality_eval(src,srcc);
+  if (!quality) {
+    fprintf(stderr,"%s: Expected 'nearest', 'linear', 'cubic', or 'sinc' for audio-resampler, found '%.*s'\n",eh.exename,srcc,src);
+    return -2;
+  }
+  eh.audio_resampler=quality;
+  return 0;
+}
+
+/* --pacing=usleep|precise|vsync
+ */
+ 
+static int eh_config_set_pacing(const char *src,int srcc) {
+  int pacing=eh_clock_pacing_eval(src,srcc);
+  if (!pacing) {
+    fprintf(stderr,"%s: Expected 'usleep', 'precise', or 'vsync' for pacing, found '%.*s'\n",eh.exename,srcc,src);
+    return -2;
+  }
+  eh.pacing=pacing;
+  return 0;
+}
+
 /* --romassist=HOST:PORT
  */
  
@@ -168,14 +220,111 @@ static int eh_argv_kv(const char *k,int kc,const char *v,int vc) {
   if ((kc==5)&&!memcmp(k,"input",5)) return eh_config_set_string(&eh.input_drivers,v,vc);
   if ((kc==10)&&!memcmp(k,"fullscreen",10)) { eh.fullscreen=vc?vn:1; return 0; }
   if ((kc==12)&&!memcmp(k,"video-device",12)) return eh_config_set_string(&eh.video_device,v,vc);
+  if ((kc==16)&&!memcmp(k,"video-flip-queue",16)) { eh.video_flip_queue=vn; return 0; }
   if ((kc==13)&&!memcmp(k,"pixel-refresh",13)) return eh_config_set_float(&eh.pixel_refresh,v,vc,0.0f,1.0f);
   if ((kc==10)&&!memcmp(k,"audio-rate",10)) { eh.audio_rate=vn; return 0; }
   if ((kc==11)&&!memcmp(k,"audio-chanc",11)) { eh.audio_chanc=vn; return 0; }
   if ((kc==12)&&!memcmp(k,"audio-device",12)) return eh_config_set_string(&eh.audio_device,v,vc);
+  if ((kc==15)&&!memcmp(k,"audio-resampler",15)) return eh_config_set_resampler(v,vc);
+  if ((kc==18)&&!memcmp(k,"audio-rate-control",18)) { eh.audio_rate_control=vc?vn:1; return 0; }
+  if ((kc==12)&&!memcmp(k,"audio-period",12)) { eh.audio_period=vn; return 0; }
+  if ((kc==13)&&!memcmp(k,"audio-periods",13)) { eh.audio_periods=vn; return 0; }
+  if ((kc==10)&&!memcmp(k,"audio-mmap",10)) { eh.audio_mmap=vc?vn:1; return 0; }
+  if ((kc==12)&&!memcmp(k,"audio-rtprio",12)) {
+    if ((vn<0)||(vn>99)) {
+      fprintf(stderr,"%s: audio-rtprio must be in 0..99, found %d\n",eh.exename,vn);
+      return -2;
+    }
+    eh.audio_rtprio=vn;
+    return 0;
+  }
+  if ((kc==15)&&!memcmp(k,"audio-benchmark",15)) {
+    eh_auresample_benchmark();
+    if (eh_auring_stress()<0) fprintf(stderr,"!!! Audio ring stress test FAILED !!!\n");
+    eh.terminate=1;
+    return 0;
+  }
+  if ((kc==15)&&!memcmp(k,"input-benchmark",15)) {
+    char path[1024];
+    if (vc>=sizeof(path)) return -1;
+    memcpy(path,v,vc);
+    path[vc]=0;
+    if (eh_benchmark_input(path)<0) fprintf(stderr,"!!! Input benchmark FAILED !!!\n");
+    eh.terminate=1;
+    return 0;
+  }
+  if ((kc==13)&&!memcmp(k,"screencap-shm",13)) { eh.screencap_shm=vc?vn:1; return 0; }
+  if ((kc==8)&&!memcmp(k,"rom-mmap",8)) { eh.rom_mmap=vc?vn:1; return 0; }
+  if ((kc==15)&&!memcmp(k,"screencap-level",15)) {
+    if ((vn<0)||(vn>9)) {
+      fprintf(stderr,"%s: screencap-level must be in 0..9, found %d\n",eh.exename,vn);
+      return -2;
+    }
+    eh.screencap_level=vn;
+    return 0;
+  }
+  if ((kc==8)&&!memcmp(k,"runahead",8)) {
+    if ((vn<0)||(vn>EH_RUNAHEAD_LIMIT)) {
+      fprintf(stderr,"%s: runahead must be in 0..%d, found %d\n",eh.exename,EH_RUNAHEAD_LIMIT,vn);
+      return -2;
+    }
+    eh.runahead_framec=vn;
+    return 0;
+  }
+  if ((kc==6)&&!memcmp(k,"pacing",6)) return eh_config_set_pacing(v,vc);
+  if ((kc==6)&&!memcmp(k,"stream",6)) {
+    if ((vn<0)||(vn>60)) {
+      fprintf(stderr,"%s: stream must be in 0..60, found %d\n",eh.exename,vn);
+      return -2;
+    }
+    eh.stream_rate=vn;
+    return 0;
+  }
+  if ((kc==6)&&!memcmp(k,"record",6)) {
+    eh.record=1;
+    return eh_config_set_string(&eh.record_path,v,vc);
+  }
+  if ((kc==6)&&!memcmp(k,"replay",6)) return eh_config_set_string(&eh.replay_path,v,vc);
+  if ((kc==11)&&!memcmp(k,"replay-loop",11)) { eh.replay_loop=vc?vn:1; return 0; }
+  if ((kc==11)&&!memcmp(k,"unthrottled",11)) { eh.unthrottled=vc?vn:1; return 0; }
+  if ((kc==9)&&!memcmp(k,"benchmark",9)) {
+    if (vn<1) {
+      fprintf(stderr,"%s: benchmark must be a positive frame count, found '%.*s'\n",eh.exename,vc,v);
+      return -2;
+    }
+    eh.benchmark_framec=vn;
+    return 0;
+  }
   if ((kc==12)&&!memcmp(k,"glsl-version",12)) { eh.glsl_version=vn; return 0; }
   if ((kc==6)&&!memcmp(k,"screen",6)) { eh.prefer_screen=eh_config_screen_eval(v,vc); return 0; }
   if ((kc==4)&&!memcmp(k,"crop",4)) return eh_config_set_crop(v,vc);
-  if ((kc==21)&&!memcmp(k,"auto-collect-metadata",21)) { eh.auto_collect_metadata=1; return 0; }
+  if ((kc==21)&&!memcmp(k,"auto-collect-metadata",21)) {
+    if (vc&&(vn<1)) {
+      fprintf(stderr,"%s: auto-collect-metadata must be a positive frame count, found '%.*s'\n",eh.exename,vc,v);
+      return -2;
+    }
+    eh.auto_collect_metadata=vc?vn:EH_ACM_DEFAULT_FRAMES;
+    return 0;
+  }
+  if ((kc==12)&&!memcmp(k,"acm-interval",12)) {
+    if (vn<1) {
+      fprintf(stderr,"%s: acm-interval must be a positive frame count, found '%.*s'\n",eh.exename,vc,v);
+      return -2;
+    }
+    eh.acm_interval=vn;
+    return 0;
+  }
+  if ((kc==10)&&!memcmp(k,"acm-output",10)) return eh_config_set_string(&eh.acm_output,v,vc);
+  if ((kc==12)&&!memcmp(k,"input-thread",12)) { eh.input_thread=vc?vn:1; return 0; }
+  if ((kc==13)&&!memcmp(k,"latency-probe",13)) {
+    if (vn<2) {
+      fprintf(stderr,"%s: latency-probe must be a frame count of at least 2, found '%.*s'\n",eh.exename,vc,v);
+      return -2;
+    }
+    eh.latency_probe=vn;
+    return 0;
+  }
+  if ((kc==7)&&!memcmp(k,"standby",7)) { eh.standby=vc?vn:1; return 0; }
   if ((kc==17)&&!memcmp(k,"allow-quit-button",17)) { eh.allow_quit_button=vn; return 0; }
   
   /* "--romassist" splits into two fields.
@@ -234,24 +383,38 @@ static int eh_config_encode(struct sr_encoder *dst) {
   if (sr_encode_fmt(dst,"screen=%s\n",eh_config_screen_repr(eh.prefer_screen))<0) return -1;
   if (sr_encode_fmt(dst,"glsl-version=%d\n",eh.glsl_version)<0) return -1;
   if (sr_encode_fmt(dst,"video-device=%s\n",eh.video_device?eh.video_device:"")<0) return -1;
+  if (sr_encode_fmt(dst,"video-flip-queue=%d\n",eh.video_flip_queue)<0) return -1;
   if (sr_encode_fmt(dst,"pixel-refresh=%f\n",eh.pixel_refresh)<0) return -1;
   
   if (sr_encode_fmt(dst,"audio=%s\n",eh.audio_drivers?eh.audio_drivers:"")<0) return -1;
   if (sr_encode_fmt(dst,"audio-rate=%d\n",eh.audio_rate)<0) return -1;
   if (sr_encode_fmt(dst,"audio-chanc=%d\n",eh.audio_chanc)<0) return -1;
   if (sr_encode_fmt(dst,"audio-device=%s\n",eh.audio_device?eh.audio_device:"")<0) return -1;
+  if (sr_encode_fmt(dst,"audio-resampler=%s\n",eh_auresample_quality_repr(eh.audio_resampler))<0) return -1;
+  if (sr_encode_fmt(dst,"audio-rate-control=%d\n",eh.audio_rate_control)<0) return -1;
+  if (sr_encode_fmt(dst,"audio-period=%d\n",eh.audio_period)<0) return -1;
+  if (sr_encode_fmt(dst,"audio-periods=%d\n",eh.audio_periods)<0) return -1;
+  if (sr_encode_fmt(dst,"audio-mmap=%d\n",eh.audio_mmap)<0) return -1;
+  if (sr_encode_fmt(dst,"audio-rtprio=%d\n",eh.audio_rtprio)<0) return -1;
+  if (sr_encode_fmt(dst,"pacing=%s\n",eh_clock_pacing_repr(eh.pacing))<0) return -1;
+  if (sr_encode_fmt(dst,"screencap-level=%d\n",eh.screencap_level)<0) return -1;
+  if (sr_encode_fmt(dst,"screencap-shm=%d\n",eh.screencap_shm)<0) return -1;
+  if (sr_encode_fmt(dst,"rom-mmap=%d\n",eh.rom_mmap)<0) return -1;
   
   if (sr_encode_fmt(dst,"input=%s\n",eh.input_drivers?eh.input_drivers:"")<0) return -1;
   
   if (sr_encode_fmt(dst,"romassist=%s:%d\n",eh.romassist_host?eh.romassist_host:"",eh.romassist_port)<0) return -1;
+  if (sr_encode_fmt(dst,"stream=%d\n",eh.stream_rate)<0) return -1;
   
   return 0;
 }
 
 /* Save live configuration to file.
+ * Not in headless modes: We've replaced the drivers with dummies and "none", and the real game shouldn't inherit that.
  */
  
 int eh_config_save() {
+  if (eh.benchmark_framec||eh.auto_collect_metadata) return 0;
   char path[1024];
   if (eh_config_get_path(path,sizeof(path))<0) return -1;
   struct sr_encoder encoder={0};
@@ -327,6 +490,12 @@ static void eh_configure_start() {
   eh.fbcrop.h=eh.delegate.video_height;
   eh.pixel_refresh=1.0f;
   eh.allow_quit_button=1;
+  eh.audio_resampler=EH_AURESAMPLE_DEFAULT;
+  eh.audio_rate_control=1;
+  eh.pacing=EH_CLOCK_PACING_DEFAULT;
+  eh.screencap_level=6;
+  eh.screencap_shm=1;
+  eh.rom_mmap=1;
 }
 
 /* Finish configuration.
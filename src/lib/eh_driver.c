@@ -14,6 +14,7 @@ extern const struct eh_video_type eh_video_type_mswm;
 extern const struct eh_video_type eh_video_type_dummy;
 
 extern const struct eh_audio_type eh_audio_type_pulse;
+extern const struct eh_audio_type eh_audio_type_pulseasync;
 extern const struct eh_audio_type eh_audio_type_alsa;
 extern const struct eh_audio_type eh_audio_type_macaudio;
 extern const struct eh_audio_type eh_audio_type_msaudio;
@@ -42,6 +43,7 @@ static const struct eh_video_type *eh_video_typev[]={
 static const struct eh_audio_type *eh_audio_typev[]={
 #if USE_pulse
   &eh_audio_type_pulse,
+  &eh_audio_type_pulseasync,
 #endif
 #if USE_alsa
   &eh_audio_type_alsa,
@@ -42,14 +42,17 @@ struct eh_video_setup {
   int iconw,iconh;
   int screen; // EH_SCREEN_(LEFT|RIGHT|TOP|BOTTOM), window placement hint
   const char *device; // only drm uses. Default "/dev/dri/card0"
+  int vsync; // Ask the driver to block at end() until vertical blank. Check (driver->vsync) after init.
+  int flipdepth; // Frames allowed to queue for scanout. Zero for default. Only drm uses.
 };
  
 struct eh_video_driver {
   const struct eh_video_type *type;
   struct eh_video_delegate delegate;
   int w,h; // Full output size.
-  int rate; // hz
+  int rate; // hz, zero if unknown
   int fullscreen;
+  int vsync; // Driver sets nonzero if end() is synchronized to the display.
 };
 
 struct eh_video_type {
@@ -58,6 +61,7 @@ struct eh_video_type {
   int objlen;
   int appointment_only;
   int provides_keyboard;
+  int no_gl; // No OpenGL context. Framebuffer clients still get converted, but nothing is drawn.
   // Required:
   void (*del)(struct eh_video_driver *driver);
   int (*init)(struct eh_video_driver *driver,const struct eh_video_setup *setup);
@@ -93,6 +97,10 @@ struct eh_audio_setup {
   int format;
   int buffersize;
   const char *device;
+  int periodsize; // Frames per transfer, zero for the driver's default.
+  int periodc; // Transfers per buffer, zero for default.
+  int mmap;
+  int rtprio; // SCHED_FIFO priority for the I/O thread, zero for normal scheduling.
 };
 
 struct eh_audio_driver {
@@ -145,6 +153,8 @@ struct eh_input_delegate {
   void (*cb_connect)(int devid,void *userdata);
   void (*cb_disconnect)(int devid,void *userdata);
   void (*cb_button)(int devid,int btnid,int value,void *userdata);
+  // Drivers that know when the event happened may call this instead. (time_ns) on eh_now_mono_ns()'s clock.
+  void (*cb_button_timed)(int devid,int btnid,int value,int64_t time_ns,void *userdata);
 };
 
 struct eh_input_driver {
@@ -169,6 +179,9 @@ struct eh_input_type {
     void *userdata
   );
   int (*has_device)(struct eh_input_driver *driver,int devid);
+  // Optional, for --input-thread. Service your devices on a thread of your own from now on, and noop update().
+  // Hold eh_input_lock() while calling the delegate, and release it after each batch so the states publish. Stop and join the thread at del.
+  int (*start_thread)(struct eh_input_driver *driver);
 };
 
 void eh_input_driver_del(struct eh_input_driver *driver);
@@ -192,4 +205,12 @@ const struct eh_input_type *eh_input_type_by_name(const char *name,int namec);
 
 int eh_input_devid_next();
 
+/* With --input-thread, anyone touching inmgr must hold this: Input threads while they call their delegate,
+ * the main thread while polling and flushing deferred callbacks, and clients that remap or enumerate devices.
+ * Never hold it across anything slow. It's recursive, and unlocking publishes player states for eh_input_get().
+ * Noop when no input thread is running.
+ */
+void eh_input_lock();
+void eh_input_unlock();
+
 #endif
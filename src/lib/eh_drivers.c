@@ -1,15 +1,27 @@
 #include "eh_internal.h"
 #include "opt/serial/serial.h"
+#include "render/eh_screencap.h"
+#include "render/eh_stream.h"
 #include <unistd.h>
+#include <pthread.h>
+
+static pthread_mutex_t eh_input_mutex; // Recursive. Initialized at eh_drivers_start_input_threads().
 
 /* Quit.
  */
  
 void eh_drivers_quit() {
+  // Input threads go first, before anything they might touch.
+  if (eh.input_threaded) {
+    while (eh.inputc>0) eh_input_driver_del(eh.inputv[--(eh.inputc)]);
+    eh.input_threaded=0;
+    inmgr_defer(0);
+  }
   if (eh.audio) {
     eh.audio->type->play(eh.audio,0);
     eh_audio_lock();
   }
+  eh_screencap_quit();
   eh_render_del(eh.render);
   eh_audio_driver_del(eh.audio);
   eh_video_driver_del(eh.video);
@@ -20,6 +32,7 @@ void eh_drivers_quit() {
   eh_aucvt_cleanup(&eh.aucvt);
   inmgr_quit();
   fakews_del(eh.fakews);
+  eh_stream_del(eh.stream);
 }
 
 /* Choose and init video driver.
@@ -47,6 +60,8 @@ static int eh_drivers_init_video_type(const struct eh_video_type *type) {
     .iconh=eh.delegate.iconh,
     .screen=eh.prefer_screen,
     .device=eh.video_device,
+    .vsync=(eh.pacing==EH_CLOCK_PACING_VSYNC),
+    .flipdepth=eh.video_flip_queue,
   };
   if (!(eh.video=eh_video_driver_new(type,&delegate,&setup))) {
     fprintf(stderr,"%s: Failed to instantiate video driver '%s'.\n",eh.exename,type->name);
@@ -112,6 +127,10 @@ struct eh_audio_driver *eh_audio_reinit(const struct eh_audio_type *type,const s
   };
   struct eh_audio_setup adjsetup=*setup;
   adjsetup.buffersize=1024;
+  if (!adjsetup.periodsize) adjsetup.periodsize=eh.audio_period;
+  if (!adjsetup.periodc) adjsetup.periodc=eh.audio_periods;
+  if (!adjsetup.mmap) adjsetup.mmap=eh.audio_mmap;
+  if (!adjsetup.rtprio) adjsetup.rtprio=eh.audio_rtprio;
   if (!(eh.audio=eh_audio_driver_new(type,&delegate,&adjsetup))) {
     fprintf(stderr,
       "%s: !!! Failed to reinitialize audio !!! driver=%s device=%s rate=%d chanc=%d format=%d\n",
@@ -141,6 +160,11 @@ static int eh_drivers_init_audio_type(const struct eh_audio_type *type) {
     .rate=eh.audio_rate,
     .chanc=eh.audio_chanc,
     .buffersize=2048,
+    .device=eh.audio_device,
+    .periodsize=eh.audio_period,
+    .periodc=eh.audio_periods,
+    .mmap=eh.audio_mmap,
+    .rtprio=eh.audio_rtprio,
   };
   if (!setup.rate&&!(setup.rate=eh.delegate.audio_rate)) setup.rate=44100;
   if (!setup.chanc&&!(setup.chanc=eh.delegate.audio_chanc)) setup.chanc=1;
@@ -180,7 +204,9 @@ static int eh_drivers_init_audio() {
     int srcfmt=eh.delegate.audio_format;
     if ((err=eh_aucvt_init(&eh.aucvt,
       eh.audio->rate,eh.audio->chanc,eh.audio->format,
-      srcrate,srcchanc,srcfmt
+      srcrate,srcchanc,srcfmt,
+      eh.audio_resampler,
+      eh.audio_rate_control
     ))<0) {
       if (err!=-2) fprintf(stderr,
         "%s: Failed to initialize audio resampler. in=(%d,%d,%d) out=(%d,%d,%d)\n",
@@ -218,6 +244,7 @@ static int eh_drivers_init_input_type(const struct eh_input_type *type) {
     .cb_connect=eh_cb_connect,
     .cb_disconnect=eh_cb_disconnect,
     .cb_button=eh_cb_button,
+    .cb_button_timed=eh_cb_button_timed,
   };
   struct eh_input_driver *driver=eh_input_driver_new(type,&delegate);
   if (!driver) {
@@ -241,7 +268,9 @@ static int eh_drivers_init_input() {
 
   // Instantiate drivers.
   int err=0;
-  if (eh.input_drivers) {
+  if (eh.input_drivers&&!strcmp(eh.input_drivers,"none")) {
+    // Headless modes, and anyone who asks. Notably, evdev would grab devices away from the foreground game.
+  } else if (eh.input_drivers) {
     sr_string_split(eh.input_drivers,-1,',',eh_drivers_init_input_name,0);
   } else {
     int p=0; for (;;p++) {
@@ -282,7 +311,8 @@ int eh_drivers_init() {
   ) return err;
   
   if (eh.romassist_port) {
-    if (!(eh.fakews=fakews_new(
+    // Standby mode connects earlier.
+    if (!eh.fakews&&!(eh.fakews=fakews_new(
       eh.romassist_host,-1,
       eh.romassist_port,
       eh.delegate.use_menu_role?"/ws/menu":"/ws/game",8,
@@ -291,6 +321,13 @@ int eh_drivers_init() {
       eh_cb_ws_message,
       0
     ))) return -1;
+    // Standby connected before video existed, so GL games couldn't size the ring then.
+    if (!eh.shmring&&fakews_is_connected(eh.fakews)) eh_screencap_shm_connect();
+    if ((eh.stream_rate>0)&&eh.delegate.video_width) {
+      if (!(eh.stream=eh_stream_new(eh.romassist_host,eh.romassist_port,eh.stream_rate))) {
+        fprintf(stderr,"%s: Failed to initialize framebuffer streaming. Proceeding without.\n",eh.exename);
+      }
+    }
   }
   
   return 0;
@@ -319,6 +356,7 @@ int eh_audio_get_format() {
 
 void eh_audio_write(const void *v,int framec) {
   if (eh.delegate.generate_pcm) return;
+  if (eh.runahead.hidden) return; // Speculative frame, it never happened.
   int samplec=framec*eh.delegate.audio_chanc;
   int samplesize;
   switch (eh.delegate.audio_format) {
@@ -339,6 +377,7 @@ void eh_audio_write(const void *v,int framec) {
       break;
     default: return;
   }
+  // No lock: aucvt's ring is single-producer single-consumer, and we are the only producer.
   int64_t busylooptime=0;
   while (samplec>0) {
     int err=eh_aucvt_input(&eh.aucvt,v,samplec);
@@ -361,7 +400,7 @@ void eh_audio_write(const void *v,int framec) {
 
 int eh_audio_guess_framec() {
   if (eh.delegate.generate_pcm) return 0;
-  return (eh.aucvt.bufa-eh.aucvt.bufc)/eh.delegate.audio_chanc;
+  return eh_auring_get_space(&eh.aucvt.ring)/eh.delegate.audio_chanc;
 }
 
 int eh_audio_lock() {
@@ -378,6 +417,17 @@ void eh_audio_unlock() {
  */
  
 uint16_t eh_input_get(uint8_t plrid) {
+  if (eh.auto_collect_metadata) eh_auto_collect_metadata_poll(&eh.acm,plrid);
+  if (eh.movie.mode==EH_MOVIE_MODE_REPLAY) return eh_movie_get(&eh.movie,plrid);
+  eh_latency_input(&eh.latency,plrid);
+  return eh_input_get_published(plrid);
+}
+
+uint16_t eh_input_get_published(int plrid) {
+  if (eh.input_threaded) {
+    if ((plrid<0)||(plrid>INMGR_PLAYER_LIMIT)) return 0;
+    return __atomic_load_n(eh.input_statev+plrid,__ATOMIC_RELAXED);
+  }
   return inmgr_get_player(plrid);
 }
 
@@ -434,3 +484,50 @@ const char *eh_get_audio_device() {
 }
 
 // The public video API is at lib/render/eh_render_obj.c
+
+/* Input thread and its lock.
+ */
+ 
+static void eh_input_publish() {
+  int i=0;
+  for (;i<=INMGR_PLAYER_LIMIT;i++) __atomic_store_n(eh.input_statev+i,inmgr_get_player(i),__ATOMIC_RELAXED);
+}
+ 
+int eh_drivers_start_input_threads() {
+  // Recursive, because deferred callbacks run under the lock and may call back into things that take it.
+  pthread_mutexattr_t attr;
+  pthread_mutexattr_init(&attr);
+  pthread_mutexattr_settype(&attr,PTHREAD_MUTEX_RECURSIVE);
+  pthread_mutex_init(&eh_input_mutex,&attr);
+  pthread_mutexattr_destroy(&attr);
+  eh.input_threaded=1;
+  inmgr_defer(1);
+  eh_input_publish();
+  int i=0,startc=0;
+  for (;i<eh.inputc;i++) {
+    struct eh_input_driver *driver=eh.inputv[i];
+    if (!driver->type->start_thread) continue;
+    if (driver->type->start_thread(driver)<0) {
+      fprintf(stderr,"%s: Failed to start input thread for '%s'.\n",eh.exename,driver->type->name);
+      return -2;
+    }
+    startc++;
+  }
+  if (!startc) {
+    fprintf(stderr,"%s:WARNING: --input-thread requested but no input driver supports it.\n",eh.exename);
+    inmgr_defer(0);
+    eh.input_threaded=0;
+  }
+  return 0;
+}
+ 
+void eh_input_lock() {
+  if (!eh.input_threaded) return;
+  pthread_mutex_lock(&eh_input_mutex);
+}
+
+void eh_input_unlock() {
+  if (!eh.input_threaded) return;
+  eh_input_publish();
+  pthread_mutex_unlock(&eh_input_mutex);
+}
@@ -1,5 +1,6 @@
 #include "eh_internal.h"
 #include "opt/serial/serial.h"
+#include "render/eh_screencap.h"
 
 /* Window closed.
  */
@@ -47,7 +48,9 @@ void eh_cb_pcm(int16_t *v,int c,void *dummy) {
   if (eh.delegate.generate_pcm) {
     eh.delegate.generate_pcm(v,c);
   } else {
+    int64_t bmt=eh_benchmark_begin(&eh.benchmark);
     eh_aucvt_output(v,c,&eh.aucvt);
+    eh_benchmark_end(&eh.benchmark.aucvt_acc,bmt);
   }
 }
 
@@ -96,6 +99,10 @@ void eh_cb_button(int devid,int btnid,int value,void *dummy) {
   inmgr_event(devid,btnid,value);
 }
 
+void eh_cb_button_timed(int devid,int btnid,int value,int64_t time_ns,void *dummy) {
+  inmgr_event_timed(devid,btnid,value,time_ns);
+}
+
 /* Toggle fullscreen.
  * This is bigger than it sounds: The setting should stick across launches.
  */
@@ -134,7 +141,7 @@ void eh_cb_PAUSE() {
 }
 
 void eh_cb_SCREENCAP() {
-  fprintf(stderr,"%s\n",__func__);//TODO
+  eh.screencap_requested=1;
 }
 
 void eh_cb_SAVESTATE() {
@@ -154,7 +161,7 @@ void eh_cb_RESET() {
 }
 
 void eh_cb_DEBUG() {
-  fprintf(stderr,"%s\n",__func__);//TODO
+  eh.perf.overlay=eh.perf.overlay?0:1;
 }
 
 void eh_cb_STEP() {
@@ -173,9 +180,14 @@ void eh_cb_AUTOMAPPED() {
  */
  
 void eh_cb_ws_connect(void *userdata) {
+  eh_standby_hello();
+  eh_screencap_shm_connect();
+  eh_first_frame_send();
+  eh_trace_flush(&eh.trace);
 }
 
 void eh_cb_ws_disconnect(void *userdata) {
+  eh_screencap_shm_disconnect();
 }
 
 void eh_cb_ws_message(int opcode,const void *v,int c,void *userdata) {
@@ -183,7 +195,7 @@ void eh_cb_ws_message(int opcode,const void *v,int c,void *userdata) {
   //if (opcode==1) fprintf(stderr,"v: %.*s\n",c,(char*)v);
   // We don't respond to any binary packets.
   if (opcode!=1) return;
-  // And so nice, every packet we do respond to, only contains "id".
+  // And so nice, almost every packet we do respond to, only contains "id".
   struct sr_decoder decoder={.v=v,.c=c};
   if (sr_decode_json_object_start(&decoder)>=0) {
     const char *k;
@@ -199,6 +211,10 @@ void eh_cb_ws_message(int opcode,const void *v,int c,void *userdata) {
           if ((idc==6)&&!memcmp(id,"resume",6)) { eh_cb_PAUSE(); return; } // our PAUSE is a toggle. oh well, close enough
           if ((idc==4)&&!memcmp(id,"step",4)) { eh_cb_STEP(); return; }
           if ((idc==12)&&!memcmp(id,"httpresponse",12)) { if (eh.delegate.http_response) eh.delegate.http_response(v,c); return; }
+          if ((idc==5)&&!memcmp(id,"input",5)) { eh_remote_input_receive(&eh.remote_input,v,c); return; }
+          if ((idc==11)&&!memcmp(id,"requestPerf",11)) { eh_perf_send(&eh.perf); return; }
+          if ((idc==4)&&!memcmp(id,"wake",4)) { eh_standby_wake(v,c); return; }
+          if ((idc==9)&&!memcmp(id,"shmringOk",9)) { eh_screencap_shm_ack(); return; }
         
           if (eh.delegate.websocket_incoming) eh.delegate.websocket_incoming(id,idc,v,c);
           return;
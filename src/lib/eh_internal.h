@@ -6,6 +6,14 @@
 #include "eh_clock.h"
 #include "eh_aucvt.h"
 #include "eh_auto_collect_metadata.h"
+#include "eh_runahead.h"
+#include "eh_remote_input.h"
+#include "eh_movie.h"
+#include "eh_benchmark.h"
+#include "eh_perf.h"
+#include "eh_trace.h"
+#include "eh_latency.h"
+#include "eh_romload.h"
 #include "inmgr/inmgr.h"
 #include "render/eh_render.h"
 #include "opt/fakews/fakews.h"
@@ -27,17 +35,36 @@ extern struct eh {
   char *input_drivers;
   int fullscreen;
   char *video_device;
+  int video_flip_queue; // Frames allowed to queue for scanout, zero for the driver's default.
   float pixel_refresh;
   int audio_rate;
   int audio_chanc;
   char *audio_device;
+  int audio_resampler; // EH_AURESAMPLE_*
+  int audio_rate_control; // Nudge resample ratio to keep aucvt centered, instead of adding and dropping frames.
+  int audio_period; // Frames per driver transfer, zero for the driver's default.
+  int audio_periods; // Transfers per driver buffer, zero for default.
+  int audio_mmap; // Ask the driver to transfer by mmap, if it can.
+  int audio_rtprio; // Nonzero to ask for SCHED_FIFO at this priority on the driver's I/O thread.
+  int pacing; // EH_CLOCK_PACING_*
+  int runahead_framec; // From config. (runahead.framec) is the truth.
   int glsl_version;
   int prefer_screen;
   char *romassist_host;
   int romassist_port;
   struct { int x,y,w,h; } fbcrop; // True dimensions of video output. delegate->width,height are only input from client.
-  int auto_collect_metadata; // A special experimental mode. XXX Started but not implemented.
+  int auto_collect_metadata; // Frame count, nonzero to run headless and collect metadata. See eh_auto_collect_metadata.h.
+  int acm_interval;
+  char *acm_output;
+  int standby; // Wait for Romassist to wake us before initializing drivers. See eh_standby.c.
   int allow_quit_button;
+  int stream_rate; // Live framebuffer streaming to Romassist, frames per second. Zero to disable.
+  int record; // Record input. To (record_path) if set, otherwise send to Romassist at exit.
+  char *record_path;
+  char *replay_path;
+  int replay_loop;
+  int unthrottled; // Run frames as fast as we can, ignoring the clock.
+  int benchmark_framec; // Nonzero for --benchmark: Implies headless and unthrottled.
   
   struct eh_auto_collect_metadata acm;
   
@@ -49,13 +76,33 @@ extern struct eh {
   int devid_keyboard; // nonzero if video driver provides a keyboard
   struct eh_render *render;
   int inmgr_dirty;
+  int input_thread; // --input-thread, requested.
+  int input_threaded; // An input thread is running, see eh_input_lock().
+  int input_statev[1+INMGR_PLAYER_LIMIT]; // Published at eh_input_unlock(), read atomically by eh_input_get_published().
   struct eh_aucvt aucvt;
+  struct eh_runahead runahead;
   struct fakews *fakews;
+  struct eh_stream *stream; // Null unless streaming.
+  struct eh_remote_input remote_input;
+  struct eh_movie movie;
+  struct eh_benchmark benchmark;
+  struct eh_perf perf;
+  struct eh_trace trace;
+  struct eh_latency latency;
+  int latency_probe; // --latency-probe, frames between presses.
+  struct eh_romload romload;
+  int rom_mmap; // Map the ROM file for load_serial instead of reading it.
   
   int screencap_requested;
+  int screencap_level; // zlib, 0..9
+  int screencap_shm; // Hand screencaps to Romassist via shared memory, when it's on the same host.
+  struct shmring *shmring;
+  int shmring_ready; // Romassist opened (shmring), so it can take "shmScreencap" instead of PNG.
   int hard_pause;
   int hard_pause_stepc;
   int fastfwd;
+  int64_t first_frame_time; // Real time, us.
+  int first_frame_sent;
   
 } eh;
 
@@ -65,8 +112,15 @@ int eh_config_save();
 
 void eh_drivers_quit();
 int eh_drivers_init();
+int eh_drivers_start_input_threads();
+uint16_t eh_input_get_published(int plrid); // eh_input_get() without the side effects (metadata, movie, latency).
 
 int eh_render_init();
+
+int eh_standby_wait();
+void eh_standby_wake(const void *v,int c);
+void eh_standby_hello();
+void eh_first_frame_send();
 void eh_commit_framebuffer(const void *fb);
 
 void eh_cb_close(void *dummy);
@@ -78,6 +132,7 @@ void eh_cb_pcm(int16_t *v,int c,void *dummy);
 void eh_cb_connect(int devid,void *dummy);
 void eh_cb_disconnect(int devid,void *dummy);
 void eh_cb_button(int devid,int btnid,int value,void *dummy);
+void eh_cb_button_timed(int devid,int btnid,int value,int64_t time_ns,void *dummy);
 //int eh_cb_digested_event(void *userdata,const struct eh_inmgr_event *event);
 void eh_cb_inmgr_config_dirty(void *userdata);
 void eh_cb_ws_connect(void *userdata);
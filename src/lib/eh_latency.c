@@ -0,0 +1,125 @@
+#include "eh_internal.h"
+#include "opt/serial/serial.h"
+#if USE_evdev
+  #include "opt/evdev/evdev.h"
+  #include <linux/input.h>
+  #include <unistd.h>
+#endif
+
+/* Cleanup.
+ */
+
+void eh_latency_cleanup(struct eh_latency *latency) {
+  #if USE_evdev
+    if (latency->probe_interval) close(latency->probe_fd);
+  #endif
+  latency->probe_interval=0;
+}
+
+/* Probe.
+ */
+
+int eh_latency_probe_init(struct eh_latency *latency,int interval) {
+  #if USE_evdev
+    if (interval<2) interval=2;
+    if ((latency->probe_fd=evdev_uinput_open("Emuhost Latency Probe"))<0) {
+      fprintf(stderr,"%s:WARNING: Failed to create uinput device for latency probe: %m\n",eh.exename);
+      return 0;
+    }
+    latency->probe_interval=interval;
+    latency->probe_framec=0;
+    fprintf(stderr,"%s: Latency probe pressing SOUTH every %d frames.\n",eh.exename,interval);
+  #else
+    fprintf(stderr,"%s:WARNING: Latency probe requires evdev.\n",eh.exename);
+  #endif
+  return 0;
+}
+
+static void eh_latency_probe_update(struct eh_latency *latency) {
+  #if USE_evdev
+    if (!latency->probe_interval) return;
+    if (!latency->probe_framec) evdev_uinput_button(latency->probe_fd,BTN_SOUTH,1);
+    else if (latency->probe_framec==latency->probe_interval>>1) evdev_uinput_button(latency->probe_fd,BTN_SOUTH,0);
+    if (++(latency->probe_framec)>=latency->probe_interval) latency->probe_framec=0;
+  #endif
+}
+
+/* Record one sample.
+ */
+
+static void eh_latency_add(int *v,int *c,int64_t ns) {
+  int p=(int)(ns/1000000);
+  if (p<0) p=0;
+  else if (p>=EH_LATENCY_BUCKET_COUNT) p=EH_LATENCY_BUCKET_COUNT-1;
+  v[p]++;
+  (*c)++;
+}
+
+/* Input read.
+ */
+
+void eh_latency_input(struct eh_latency *latency,int plrid) {
+  int64_t press=inmgr_take_press_time(plrid);
+  if (!press||(press==latency->last_press_ns)) return;
+  latency->last_press_ns=press;
+  eh_latency_add(latency->inputv,&latency->inputc,eh_now_mono_ns()-press);
+  if (!latency->present_press_ns||(press<latency->present_press_ns)) latency->present_press_ns=press;
+}
+
+/* Frame complete.
+ */
+
+void eh_latency_frame(struct eh_latency *latency) {
+  if (latency->present_press_ns) {
+    eh_latency_add(latency->presentv,&latency->presentc,eh_now_mono_ns()-latency->present_press_ns);
+    latency->present_press_ns=0;
+  }
+  eh_latency_probe_update(latency);
+}
+
+/* Report.
+ */
+
+static int eh_latency_percentile(const int *v,int c,int pct) {
+  if (c<1) return 0;
+  int target=(c*pct+99)/100,p=0;
+  for (;p<EH_LATENCY_BUCKET_COUNT;p++) {
+    if ((target-=v[p])<=0) return p;
+  }
+  return EH_LATENCY_BUCKET_COUNT-1;
+}
+
+int eh_latency_report(char *dst,int dsta,const struct eh_latency *latency) {
+  if (!latency->inputc) return 0;
+  return snprintf(dst,dsta,
+    "Input latency, %d presses: read p50 %d ms, p99 %d ms. Presented p50 %d ms, p99 %d ms.",
+    latency->inputc,
+    eh_latency_percentile(latency->inputv,latency->inputc,50),
+    eh_latency_percentile(latency->inputv,latency->inputc,99),
+    eh_latency_percentile(latency->presentv,latency->presentc,50),
+    eh_latency_percentile(latency->presentv,latency->presentc,99)
+  );
+}
+
+/* Encode.
+ */
+
+static int eh_latency_encode_histogram(struct sr_encoder *dst,const char *k,int kc,const int *v) {
+  int c=EH_LATENCY_BUCKET_COUNT;
+  while (c&&!v[c-1]) c--;
+  int arrayctx=sr_encode_json_array_start(dst,k,kc);
+  if (arrayctx<0) return -1;
+  int i=0;
+  for (;i<c;i++) {
+    if (sr_encode_json_int(dst,0,0,v[i])<0) return -1;
+  }
+  return sr_encode_json_array_end(dst,arrayctx);
+}
+
+int eh_latency_encode_json(struct sr_encoder *dst,const struct eh_latency *latency) {
+  int jsonctx=sr_encode_json_object_start(dst,"latency",7);
+  if (jsonctx<0) return -1;
+  if (eh_latency_encode_histogram(dst,"inputMs",7,latency->inputv)<0) return -1;
+  if (eh_latency_encode_histogram(dst,"presentMs",9,latency->presentv)<0) return -1;
+  return sr_encode_json_object_end(dst,jsonctx);
+}
@@ -0,0 +1,57 @@
+/* eh_latency.h
+ * Input latency: From the driver's timestamp on a button press, to the game reading it (eh_input_get),
+ * and to the end of the frame it went into, ie just after the video driver's swap.
+ * Only timestamped input counts, currently that means evdev. Keyboard via the window manager doesn't.
+ * Two histograms of 1 ms buckets, the last one catching everything longer.
+ *
+ * Reported at exit, and included in the "perf" message to Romassist as:
+ *   "latency":{"inputMs":[count...],"presentMs":[count...]}
+ *
+ * --latency-probe=FRAMES creates a virtual gamepad via uinput and presses SOUTH every so many frames.
+ * So you can measure without a human or special hardware, but you do need write access to /dev/uinput.
+ * Probe presses always land just after a frame, so they see about the worst case of our polling.
+ */
+
+#ifndef EH_LATENCY_H
+#define EH_LATENCY_H
+
+#include <stdint.h>
+
+#define EH_LATENCY_BUCKET_COUNT 100
+
+struct sr_encoder;
+
+struct eh_latency {
+  int64_t last_press_ns; // Most recent press taken, so player zero and the real player don't count twice.
+  int64_t present_press_ns; // Earliest press read since the last frame, zero if none.
+  int inputv[EH_LATENCY_BUCKET_COUNT];
+  int presentv[EH_LATENCY_BUCKET_COUNT];
+  int inputc,presentc;
+  int probe_interval; // Frames, zero if not probing.
+  int probe_fd;
+  int probe_framec;
+};
+
+void eh_latency_cleanup(struct eh_latency *latency);
+
+/* Create the virtual device. Failure is logged and not fatal.
+ */
+int eh_latency_probe_init(struct eh_latency *latency,int interval);
+
+/* Call in eh_input_get(), so we know when each press was read.
+ */
+void eh_latency_input(struct eh_latency *latency,int plrid);
+
+/* Call after each rendered frame.
+ */
+void eh_latency_frame(struct eh_latency *latency);
+
+/* Single line with medians and 99th percentiles. Zero if nothing measured.
+ */
+int eh_latency_report(char *dst,int dsta,const struct eh_latency *latency);
+
+/* Add "latency" to an object in progress.
+ */
+int eh_latency_encode_json(struct sr_encoder *dst,const struct eh_latency *latency);
+
+#endif
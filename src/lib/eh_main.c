@@ -1,5 +1,7 @@
 #include "eh_internal.h"
 #include "opt/fs/fs.h"
+#include "render/eh_screencap.h"
+#include "render/eh_stream.h"
 #include <signal.h>
 #include <unistd.h>
 
@@ -25,6 +27,30 @@ static void eh_rcvsig(int sigid) {
  
 static void eh_cleanup() {
   fprintf(stderr,"%s: Normal exit. %s\n",eh.exename,eh_clock_report(&eh.clock));
+  char report[256];
+  if (eh_runahead_report(report,sizeof(report),&eh.runahead)>0) {
+    fprintf(stderr,"%s: %s\n",eh.exename,report);
+  }
+  eh_runahead_cleanup(&eh.runahead);
+  eh_movie_finish(&eh.movie,eh.record_path);
+  if (eh_movie_report(report,sizeof(report),&eh.movie)>0) {
+    fprintf(stderr,"%s: %s\n",eh.exename,report);
+  }
+  eh_movie_cleanup(&eh.movie);
+  eh_benchmark_report(&eh.benchmark);
+  eh_benchmark_cleanup(&eh.benchmark);
+  eh_auto_collect_metadata_finish(&eh.acm);
+  if (eh_stream_report(report,sizeof(report),eh.stream)>0) {
+    fprintf(stderr,"%s: %s\n",eh.exename,report);
+  }
+  if (eh_remote_input_report(report,sizeof(report),&eh.remote_input)>0) {
+    fprintf(stderr,"%s: %s\n",eh.exename,report);
+  }
+  eh_remote_input_cleanup(&eh.remote_input);
+  if (eh_latency_report(report,sizeof(report),&eh.latency)>0) {
+    fprintf(stderr,"%s: %s\n",eh.exename,report);
+  }
+  eh_latency_cleanup(&eh.latency);
   eh_drivers_quit();
 }
 
@@ -37,14 +63,16 @@ static int eh_startup_vm() {
   if (eh.rompath) {
     if (eh.delegate.load_file) return eh.delegate.load_file(eh.rompath);
     if (eh.delegate.load_serial) {
-      void *serial=0;
-      int serialc=file_read(&serial,eh.rompath);
+      // eh_romload_begin() was called before driver init.
+      const void *serial=0;
+      int serialc=eh_romload_finish(&serial,&eh.romload);
       if (serialc<0) {
         fprintf(stderr,"%s: Failed to read file.\n",eh.rompath);
         return -2;
       }
+      eh_trace_mark(&eh.trace,"read");
       int err=eh.delegate.load_serial(serial,serialc,eh.rompath);
-      free(serial);
+      eh_romload_cleanup(&eh.romload);
       return err;
     }
     fprintf(stderr,"%s: Emuhost delegate does not implement load_file or load_serial.\n",eh.exename);
@@ -68,18 +96,25 @@ static int eh_update() {
   // Regulate timing. This may block.
   int framec;
   if (eh.auto_collect_metadata) {
-    framec=20;
-    eh_auto_collect_metadata_update(&eh.acm);
+    framec=EH_ACM_FRAMES_PER_PASS;
+    if (!eh_auto_collect_metadata_update(&eh.acm,framec)) {
+      eh.terminate=1;
+      return 0;
+    }
+  } else if (eh.unthrottled) {
+    framec=1;
   } else {
     framec=eh_clock_tick(&eh.clock);
   }
+  eh_perf_begin_frame(&eh.perf);
   
-  // Timing adjustment per audio conversion.
+  // Timing adjustment per audio conversion, only if aucvt isn't doing rate control.
   // It is perfectly normal to overrun and underrun regularly.
   // Longer aucvt buffer makes it less frequent.
-  if (eh.aucvt.badframec) {
-    //fprintf(stderr,"%s:%d: badframec=%d. Running one extra update frame.\n",__FILE__,__LINE__,eh.aucvt.badframec);
-    eh.aucvt.badframec=0;
+  if (eh.aucvt.drc||eh.unthrottled) {
+    // aucvt keeps itself centered, or we're not keeping time at all. Never add or drop frames.
+  } else if (__atomic_exchange_n(&eh.aucvt.badframec,0,__ATOMIC_RELAXED)) {
+    // Audio thread counts these, so take and clear in one step.
     framec++;
   } else if (eh.aucvt.overframec) {
     //fprintf(stderr,"%s:%d: overframec=%d. Eliminating one frame.\n",__FILE__,__LINE__,eh.aucvt.overframec);
@@ -88,33 +123,54 @@ static int eh_update() {
   }
 
   // Update all drivers.
+  // With an input thread, we hold its lock only while touching inmgr: Polling, keyboard via the window manager, and deferred callbacks.
+  int err=0;
+  int64_t t0=eh_now_mono_ns();
+  eh_input_lock();
   int i=eh.inputc;
   struct eh_input_driver **input=eh.inputv+i-1;
   for (;i-->0;input--) {
     if ((*input)->type->update(*input)<0) {
       fprintf(stderr,"%s: Error polling input (%s).\n",eh.exename,(*input)->type->name);
-      return -2;
+      err=-2;
+      break;
     }
   }
-  if (eh.video->type->update) {
-    if (eh.video->type->update(eh.video)<0) {
-      fprintf(stderr,"%s: Error updating window manager (%s).\n",eh.exename,eh.video->type->name);
-      return -2;
+  if (!err) {
+    inmgr_flush_deferred();
+    eh_perf_add(&eh.perf,EH_PERF_INPUT,t0);
+    if (eh.video->type->update) {
+      t0=eh_now_mono_ns();
+      if (eh.video->type->update(eh.video)<0) {
+        fprintf(stderr,"%s: Error updating window manager (%s).\n",eh.exename,eh.video->type->name);
+        err=-2;
+      } else {
+        eh_perf_add(&eh.perf,EH_PERF_VIDEO,t0);
+      }
     }
   }
+  eh_input_unlock();
+  if (err<0) return err;
   if (eh.audio->type->update) {
     eh.audio->type->update(eh.audio);
   }
+  t0=eh_now_mono_ns();
   if (fakews_update(eh.fakews,0)<0) {
     fprintf(stderr,"%s: Error updating network.\n",eh.exename);
     return -2;
   }
+  eh_perf_add(&eh.perf,EH_PERF_FAKEWS,t0);
+  eh_screencap_update();
+  eh_stream_update(eh.stream);
+  eh_input_lock();
+  eh_remote_input_update(&eh.remote_input);
   if (eh.inmgr_dirty) {
     if (inmgr_save()<0) {
       fprintf(stderr,"%s: Failed to save input config.\n",eh.exename);
     }
     eh.inmgr_dirty=0;
   }
+  eh_input_unlock();
   
   // If we're hard-paused, stop here.
   if (eh.hard_pause) {
@@ -129,26 +185,66 @@ static int eh_update() {
   
   // Update the client.
   if (framec>0) {
+    if (eh.movie.mode==EH_MOVIE_MODE_RECORD) eh_movie_update(&eh.movie,framec);
     eh_render_before(eh.render);
-    while (framec-->0) {
+    if (eh.runahead.framec&&!eh.fastfwd) {
+      int err=eh_runahead_update(&eh.runahead,framec);
+      if (err<0) {
+        if (err!=-2) fprintf(stderr,"%s: Unspecified error updating VM.\n",eh.exename);
+        return -2;
+      }
+    } else while (framec-->0) {
+      if ((eh.movie.mode==EH_MOVIE_MODE_REPLAY)&&!eh_movie_update(&eh.movie,1)) {
+        eh.terminate=1;
+        break;
+      }
+      int64_t bmt=eh_benchmark_begin(&eh.benchmark);
+      t0=eh_now_mono_ns();
       int err=eh.delegate.update(framec);
+      eh_perf_add(&eh.perf,EH_PERF_UPDATE,t0);
+      eh_benchmark_end(&eh.benchmark.update_acc,bmt);
       if (err<0) {
         if (err!=-2) fprintf(stderr,"%s: Unspecified error updating VM.\n",eh.exename);
         return -2;
       }
+      eh_trace_mark(&eh.trace,"firstUpdate");
     }
     eh_render_after(eh.render);
+    eh_latency_frame(&eh.latency);
+    if (!eh.first_frame_time) {
+      eh.first_frame_time=eh_now_real_us();
+      eh_first_frame_send();
+      eh_trace_mark(&eh.trace,"firstFrame");
+    }
+    if (!eh_benchmark_frame(&eh.benchmark)) eh.terminate=1;
   }
   
   return 0;
 }
 
+/* Tell Romassist when our first frame went out, so it can measure launch time.
+ * Called at the first frame and at connection, whichever is later does it.
+ * We report how long ago, not when, to keep the numbers small.
+ */
+ 
+void eh_first_frame_send() {
+  if (!eh.first_frame_time||eh.first_frame_sent) return;
+  if (!fakews_is_connected(eh.fakews)) return;
+  char msg[64];
+  int msgc=snprintf(msg,sizeof(msg),"{\"id\":\"firstFrame\",\"agoMs\":%d}",(int)((eh_now_real_us()-eh.first_frame_time)/1000));
+  if ((msgc<1)||(msgc>=sizeof(msg))) return;
+  if (fakews_send(eh.fakews,1,msg,msgc)<0) return;
+  eh.first_frame_sent=1;
+}
+
 /* Main.
  */
  
 int eh_main(int argc,char **argv,const struct eh_delegate *delegate) {
   int err;
   eh.delegate=*delegate;
+  eh_trace_init(&eh.trace);
+  eh_trace_mark(&eh.trace,"start");
   fprintf(stderr,"%s: Starting up...\n",(argc>=1)?argv[0]:"emuhost");
   
   signal(SIGINT,eh_rcvsig);
@@ -157,10 +253,18 @@ int eh_main(int argc,char **argv,const struct eh_delegate *delegate) {
     if (err!=-2) fprintf(stderr,"%s: Unspecified error from eh_configure.\n",eh.exename);
     return 1;
   }
+  eh_trace_mark(&eh.trace,"configure");
   if (eh.terminate) {
     // eh_configure() may set (terminate), eg when it processed --help
     return 0;
   }
+  if (eh.standby) {
+    if ((err=eh_standby_wait())<0) {
+      if (err!=-2) fprintf(stderr,"%s: Unspecified error in standby.\n",eh.exename);
+      return 1;
+    }
+    if (eh.terminate) return 0;
+  }
   if (!eh.rompath&&!eh.delegate.load_none) {
     fprintf(stderr,"%s: Expected ROM path.\n",eh.exename);
     return 1;
@@ -169,19 +273,86 @@ int eh_main(int argc,char **argv,const struct eh_delegate *delegate) {
     return 1;
   }
   
+  // Benchmark and metadata collection are headless and unthrottled, and Romassist stays out of it.
+  if (eh.benchmark_framec||eh.auto_collect_metadata) {
+    if (eh_config_set_string(&eh.video_drivers,"dummy",5)<0) return 1;
+    if (eh_config_set_string(&eh.audio_drivers,"dummy",5)<0) return 1;
+    if (eh_config_set_string(&eh.input_drivers,"none",4)<0) return 1;
+    eh.romassist_port=0;
+    eh.unthrottled=1;
+  }
+  
+  // Start reading the ROM now, so it overlaps driver init.
+  if (eh.rompath&&!eh.delegate.load_file&&eh.delegate.load_serial) {
+    if (eh_romload_begin(&eh.romload,eh.rompath,eh.rom_mmap)<0) return 1;
+  }
+  
   if ((err=eh_drivers_init())<0) {
     if (err!=-2) fprintf(stderr,"%s: Unspecified error from eh_drivers_init.\n",eh.exename);
+    eh_romload_cleanup(&eh.romload);
     return 1;
   }
+  eh_trace_mark(&eh.trace,"drivers");
   
   if ((err=eh_startup_vm())<0) {
     if (err!=2) fprintf(stderr,"%s: Unspecified error starting vm.\n",eh.exename);
     return 1;
   }
+  eh_trace_mark(&eh.trace,"load");
+  
+  // Replay runs one frame at a time against recorded input; there's no human latency to hide.
+  // Benchmark is a replay too, of a scripted sequence unless they gave us a movie.
+  if (eh.replay_path) {
+    if ((err=eh_movie_replay(&eh.movie,eh.replay_path,eh.replay_loop))<0) {
+      if (err!=-2) fprintf(stderr,"%s: Unspecified error starting replay.\n",eh.replay_path);
+      return 1;
+    }
+    eh_runahead_init(&eh.runahead,0);
+  } else if (eh.benchmark_framec) {
+    if (eh_movie_script(&eh.movie,eh.benchmark_framec)<0) return 1;
+    eh_runahead_init(&eh.runahead,0);
+  } else if (eh.auto_collect_metadata) {
+    if ((err=eh_auto_collect_metadata_init(&eh.acm,eh.auto_collect_metadata,eh.acm_interval,eh.acm_output))<0) {
+      if (err!=-2) fprintf(stderr,"%s: Unspecified error starting metadata collection.\n",eh.exename);
+      return 1;
+    }
+    eh_runahead_init(&eh.runahead,0);
+  } else {
+    if (eh.record) {
+      if (!eh.record_path&&!eh.romassist_port) {
+        fprintf(stderr,"%s: --record without a path requires --romassist.\n",eh.exename);
+        return 1;
+      }
+      eh_movie_record(&eh.movie);
+    }
+    eh_runahead_init(&eh.runahead,eh.runahead_framec);
+    if (eh.latency_probe) eh_latency_probe_init(&eh.latency,eh.latency_probe);
+  }
   
   eh.audio->type->play(eh.audio,1);
   
-  eh_clock_init(&eh.clock,eh.delegate.video_rate);
+  int pacing=eh.pacing;
+  if ((pacing==EH_CLOCK_PACING_VSYNC)&&!eh.video->vsync) {
+    fprintf(stderr,"%s: Video driver '%s' can't sync to vblank. Using precise pacing instead.\n",eh.exename,eh.video->type->name);
+    pacing=EH_CLOCK_PACING_PRECISE;
+  } else if ((pacing==EH_CLOCK_PACING_VSYNC)&&(eh.video->rate>0)&&(eh.delegate.video_rate>0)) {
+    // Locking to a display that's way off the game's rate would run the game at the wrong speed.
+    // Small differences, eg 59.94 vs 60.1, are what vsync mode is for: Audio rate control takes up the slack.
+    double ratio=eh.video->rate/eh.delegate.video_rate;
+    if ((ratio<0.98)||(ratio>1.02)) {
+      fprintf(stderr,
+        "%s: Display refresh %d Hz too far from game rate %.3f Hz for vsync pacing. Using precise pacing instead.\n",
+        eh.exename,eh.video->rate,eh.delegate.video_rate
+      );
+      pacing=EH_CLOCK_PACING_PRECISE;
+    }
+  }
+  eh_clock_init(&eh.clock,eh.delegate.video_rate,pacing,eh.video->rate);
+  if (!eh.delegate.generate_pcm) eh.clock.aucvt=&eh.aucvt;
+  
+  if (eh_benchmark_init(&eh.benchmark,eh.benchmark_framec)<0) return 1;
+  
+  if (eh.input_thread&&(eh_drivers_start_input_threads()<0)) return 1;
   
   fprintf(stderr,"%s: Running...\n",eh.exename);
   while (1) {
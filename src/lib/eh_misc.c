@@ -24,6 +24,13 @@ int eh_get_romassist_directory(char *dst,int dsta) {
   return inmgr_compose_path(dst,dsta,"romassist",9,0,0);
 }
 
+/* Termination.
+ */
+ 
+void eh_request_termination() {
+  eh.terminate=1;
+}
+
 /* Encode HTTP request.
  */
  
@@ -0,0 +1,323 @@
+#include "eh_internal.h"
+#include "eh_movie.h"
+#include "opt/fs/fs.h"
+
+#define EH_MOVIE_HEADER_SIZE 0x11
+#define EH_MOVIE_RUN_LIMIT 0x0fffffff
+
+/* Cleanup.
+ */
+
+void eh_movie_cleanup(struct eh_movie *movie) {
+  sr_encoder_cleanup(&movie->encoder);
+  if (movie->src) free(movie->src);
+  memset(movie,0,sizeof(struct eh_movie));
+}
+
+/* Basename of the ROM, for the header.
+ */
+
+static int eh_movie_rom_name(const char **dst) {
+  if (!eh.rompath) { *dst=""; return 0; }
+  const char *src=eh.rompath;
+  int srcp=0,srcc=0;
+  for (;src[srcc];srcc++) if (src[srcc]=='/') srcp=srcc+1;
+  *dst=src+srcp;
+  srcc-=srcp;
+  if (srcc>0xff) srcc=0xff;
+  return srcc;
+}
+
+/* Begin recording.
+ */
+
+int eh_movie_record(struct eh_movie *movie) {
+  eh_movie_cleanup(movie);
+  movie->mode=EH_MOVIE_MODE_RECORD;
+  movie->playerc=inmgr_get_player_count();
+  movie->statec=1+movie->playerc;
+  movie->start_real=eh_now_real_us();
+  movie->start_cpu=eh_now_cpu_us();
+  fprintf(stderr,"%s: Recording input for %d player%s.\n",eh.exename,movie->playerc,(movie->playerc==1)?"":"s");
+  return 0;
+}
+
+/* Begin replay.
+ */
+
+int eh_movie_replay(struct eh_movie *movie,const char *path,int loop) {
+  eh_movie_cleanup(movie);
+  if ((movie->srcc=file_read(&movie->src,path))<0) {
+    movie->srcc=0;
+    fprintf(stderr,"%s: Failed to read movie.\n",path);
+    return -2;
+  }
+  const uint8_t *src=movie->src;
+  if ((movie->srcc<EH_MOVIE_HEADER_SIZE)||memcmp(src,"EHMV",4)) {
+    fprintf(stderr,"%s: Not an emuhost movie.\n",path);
+    return -2;
+  }
+  if (src[4]!=1) {
+    fprintf(stderr,"%s: Unsupported movie version %d.\n",path,src[4]);
+    return -2;
+  }
+  movie->playerc=src[5];
+  if (movie->playerc>INMGR_PLAYER_LIMIT) {
+    fprintf(stderr,"%s: Invalid player count %d.\n",path,movie->playerc);
+    return -2;
+  }
+  movie->statec=1+movie->playerc;
+  movie->total_framec=(src[8]<<24)|(src[9]<<16)|(src[10]<<8)|src[11];
+  int namec=src[16];
+  if (EH_MOVIE_HEADER_SIZE+namec>movie->srcc) {
+    fprintf(stderr,"%s: Movie header overruns file.\n",path);
+    return -2;
+  }
+  const char *name;
+  int expectc=eh_movie_rom_name(&name);
+  if ((namec!=expectc)||memcmp(src+EH_MOVIE_HEADER_SIZE,name,namec)) {
+    fprintf(stderr,
+      "%s:WARNING: Movie was recorded for '%.*s', playing against '%.*s'.\n",
+      path,namec,(char*)src+EH_MOVIE_HEADER_SIZE,expectc,name
+    );
+  }
+  if (movie->playerc!=inmgr_get_player_count()) {
+    fprintf(stderr,
+      "%s:WARNING: Movie has %d players but the game declared %d.\n",
+      path,movie->playerc,inmgr_get_player_count()
+    );
+  }
+  if (loop&&!eh.delegate.reset) {
+    fprintf(stderr,"%s: Can't loop replay, this emulator doesn't implement reset.\n",eh.exename);
+    loop=0;
+  }
+  movie->loop=loop;
+  movie->srcp=movie->runp=EH_MOVIE_HEADER_SIZE+namec;
+  movie->mode=EH_MOVIE_MODE_REPLAY;
+  movie->start_real=eh_now_real_us();
+  movie->start_cpu=eh_now_cpu_us();
+  fprintf(stderr,"%s: Replaying %d frames.\n",path,movie->total_framec);
+  return 0;
+}
+
+/* Recording: Emit the current run.
+ */
+
+static int eh_movie_flush_run(struct eh_movie *movie) {
+  if (movie->runc<1) return 0;
+  if (sr_encode_vlq(&movie->encoder,movie->runc)<0) return -1;
+  int i=0;
+  for (;i<movie->statec;i++) {
+    if (sr_encode_intbe(&movie->encoder,movie->statev[i],2)<0) return -1;
+  }
+  movie->runc=0;
+  return 0;
+}
+
+/* Begin scripted replay.
+ * We generate the whole thing upfront, in the same format as a file.
+ */
+
+int eh_movie_script(struct eh_movie *movie,int framec) {
+  eh_movie_cleanup(movie);
+  movie->playerc=inmgr_get_player_count();
+  movie->statec=1+movie->playerc;
+  uint32_t seed=0x12345678;
+  int framep=0;
+  while (framep<framec) {
+    seed^=seed<<13; seed^=seed>>17; seed^=seed<<5;
+    int runc=4+seed%27;
+    if (runc>framec-framep) runc=framec-framep;
+    memset(movie->statev,0,sizeof(movie->statev));
+    int playerid=1;
+    for (;playerid<=movie->playerc;playerid++) {
+      seed^=seed<<13; seed^=seed>>17; seed^=seed<<5;
+      uint16_t state=INMGR_BTN_CD|(seed&(INMGR_BTN_DPAD|INMGR_BTN_SOUTH|INMGR_BTN_WEST));
+      if ((state&INMGR_BTN_HORZ)==INMGR_BTN_HORZ) state&=~INMGR_BTN_HORZ;
+      if ((state&INMGR_BTN_VERT)==INMGR_BTN_VERT) state&=~INMGR_BTN_VERT;
+      if (framep%300<runc) state|=INMGR_BTN_AUX1;
+      movie->statev[playerid]=state;
+      movie->statev[0]|=state;
+    }
+    movie->runc=runc;
+    if (eh_movie_flush_run(movie)<0) return -1;
+    framep+=runc;
+  }
+  movie->src=movie->encoder.v; // handoff
+  movie->srcc=movie->encoder.c;
+  memset(&movie->encoder,0,sizeof(struct sr_encoder));
+  movie->mode=EH_MOVIE_MODE_REPLAY;
+  movie->total_framec=framec;
+  movie->start_real=eh_now_real_us();
+  movie->start_cpu=eh_now_cpu_us();
+  return 0;
+}
+
+/* Recording: Add (framec) frames of the current input state.
+ */
+
+static int eh_movie_update_record(struct eh_movie *movie,int framec) {
+  uint16_t statev[1+INMGR_PLAYER_LIMIT];
+  int i=0;
+  for (;i<movie->statec;i++) statev[i]=eh_input_get_published(i);
+  if ((movie->runc>0)&&!memcmp(statev,movie->statev,sizeof(uint16_t)*movie->statec)&&(movie->runc<=EH_MOVIE_RUN_LIMIT-framec)) {
+    movie->runc+=framec;
+  } else {
+    if (eh_movie_flush_run(movie)<0) {
+      fprintf(stderr,"%s: Out of memory recording input. Stopping.\n",eh.exename);
+      movie->mode=EH_MOVIE_MODE_NONE;
+      return 1;
+    }
+    memcpy(movie->statev,statev,sizeof(uint16_t)*movie->statec);
+    movie->runc=framec;
+  }
+  movie->framec+=framec;
+  return 1;
+}
+
+/* Replay: Advance one frame.
+ */
+
+static int eh_movie_update_replay(struct eh_movie *movie) {
+  if (movie->runc<1) {
+    if (movie->srcp>=movie->srcc) {
+      if (!movie->loop) {
+        movie->end_real=eh_now_real_us();
+        movie->end_cpu=eh_now_cpu_us();
+        return 0;
+      }
+      if (eh.delegate.reset()<0) {
+        fprintf(stderr,"%s: Reset failed, ending replay.\n",eh.exename);
+        return 0;
+      }
+      movie->srcp=movie->runp;
+      movie->loopc++;
+    }
+    int runc=0;
+    int err=sr_vlq_decode(&runc,(char*)movie->src+movie->srcp,movie->srcc-movie->srcp);
+    if ((err<1)||(runc<1)||(movie->srcp>movie->srcc-err-movie->statec*2)) {
+      fprintf(stderr,"%s: Malformed movie around %d/%d. Ending replay.\n",eh.exename,movie->srcp,movie->srcc);
+      movie->srcp=movie->srcc;
+      movie->loop=0;
+      return 0;
+    }
+    movie->srcp+=err;
+    const uint8_t *src=(uint8_t*)movie->src+movie->srcp;
+    int i=0;
+    for (;i<movie->statec;i++,src+=2) movie->statev[i]=(src[0]<<8)|src[1];
+    movie->srcp+=movie->statec*2;
+    movie->runc=runc;
+  }
+  movie->runc--;
+  movie->framec++;
+  return 1;
+}
+
+/* Update.
+ */
+
+int eh_movie_update(struct eh_movie *movie,int framec) {
+  switch (movie->mode) {
+    case EH_MOVIE_MODE_RECORD: return eh_movie_update_record(movie,framec);
+    case EH_MOVIE_MODE_REPLAY: return eh_movie_update_replay(movie);
+  }
+  return 1;
+}
+
+/* Replay state.
+ */
+
+uint16_t eh_movie_get(const struct eh_movie *movie,int playerid) {
+  if ((playerid<0)||(playerid>=movie->statec)) return 0;
+  return movie->statev[playerid];
+}
+
+/* Send to Romassist, and wait for the network to take it.
+ * We're shutting down, so it's OK to block a little.
+ */
+
+static int eh_movie_send(const void *v,int c) {
+  if (!eh.fakews||!fakews_is_connected(eh.fakews)) {
+    fprintf(stderr,"%s: Not connected to Romassist, discarding %d-byte movie.\n",eh.exename,c);
+    return -2;
+  }
+  if (fakews_send(eh.fakews,2,v,c)<0) {
+    fprintf(stderr,"%s: Failed to send %d-byte movie to Romassist.\n",eh.exename,c);
+    return -2;
+  }
+  int64_t deadline=eh_now_real_us()+2000000;
+  while (fakews_get_pending(eh.fakews)>0) {
+    if (eh_now_real_us()>deadline) {
+      fprintf(stderr,"%s: Timed out sending movie to Romassist.\n",eh.exename);
+      return -2;
+    }
+    if (fakews_update(eh.fakews,10)<0) return -2;
+  }
+  fprintf(stderr,"%s: Sent %d-byte movie to Romassist.\n",eh.exename,c);
+  return 0;
+}
+
+/* Finish recording.
+ */
+
+int eh_movie_finish(struct eh_movie *movie,const char *path) {
+  if (movie->mode!=EH_MOVIE_MODE_RECORD) return 0;
+  movie->end_real=eh_now_real_us();
+  movie->end_cpu=eh_now_cpu_us();
+  if (eh_movie_flush_run(movie)<0) return -1;
+  struct sr_encoder encoder={0};
+  const char *name;
+  int namec=eh_movie_rom_name(&name);
+  int ratemhz=(int)(eh.delegate.video_rate*1000.0);
+  if (
+    (sr_encode_raw(&encoder,"EHMV\1",5)<0)||
+    (sr_encode_u8(&encoder,movie->playerc)<0)||
+    (sr_encode_intbe(&encoder,0,2)<0)||
+    (sr_encode_intbe(&encoder,movie->framec,4)<0)||
+    (sr_encode_intbe(&encoder,ratemhz,4)<0)||
+    (sr_encode_u8(&encoder,namec)<0)||
+    (sr_encode_raw(&encoder,name,namec)<0)||
+    (sr_encode_raw(&encoder,movie->encoder.v,movie->encoder.c)<0)
+  ) {
+    sr_encoder_cleanup(&encoder);
+    return -1;
+  }
+  int err;
+  if (path) {
+    if ((err=file_write(path,encoder.v,encoder.c))<0) {
+      fprintf(stderr,"%s: Failed to write %d-byte movie.\n",path,encoder.c);
+      err=-2;
+    } else {
+      fprintf(stderr,"%s: Saved movie, %d frames in %d bytes.\n",path,movie->framec,encoder.c);
+    }
+  } else {
+    err=eh_movie_send(encoder.v,encoder.c);
+  }
+  sr_encoder_cleanup(&encoder);
+  return err;
+}
+
+/* Report.
+ */
+
+int eh_movie_report(char *dst,int dsta,const struct eh_movie *movie) {
+  if (!dst||(dsta<1)) return -1;
+  dst[0]=0;
+  if ((movie->mode!=EH_MOVIE_MODE_REPLAY)||(movie->framec<1)) return 0;
+  int64_t end_real=movie->end_real?movie->end_real:eh_now_real_us();
+  int64_t end_cpu=movie->end_cpu?movie->end_cpu:eh_now_cpu_us();
+  double elapsed=(end_real-movie->start_real)/1000000.0;
+  if (elapsed<=0.0) return 0;
+  double fps=movie->framec/elapsed;
+  double speed=(eh.delegate.video_rate>0.0)?(fps/eh.delegate.video_rate):0.0;
+  int dstc=snprintf(dst,dsta,
+    "Replayed %d frames (%d loops) in %.3f s: %.1f fps, %.1fx real time, %.3f ms CPU per frame",
+    movie->framec,movie->loopc,elapsed,fps,speed,
+    (end_cpu-movie->start_cpu)/(1000.0*movie->framec)
+  );
+  if ((dstc<1)||(dstc>=dsta)) {
+    dst[0]=0;
+    return 0;
+  }
+  return dstc;
+}
@@ -0,0 +1,82 @@
+/* eh_movie.h
+ * Record every frame's player states, and play them back.
+ * Replay is deterministic only if the game is: It must start from power-on and read input only via eh_input_get().
+ * Replaying with --unthrottled and the dummy drivers, it's also a throughput benchmark.
+ *
+ * File format, all integers big-endian:
+ *   0000   4 "EHMV"
+ *   0004   1 Version, 1.
+ *   0005   1 Player count, not including the aggregate.
+ *   0006   2 Reserved, zero.
+ *   0008   4 Frame count.
+ *   000c   4 Game's video rate, millihertz.
+ *   0010   1 ROM name length.
+ *   0011 ... ROM name, basename only. Replay warns on mismatch, but proceeds.
+ *   .... ... Runs:
+ *     VLQ Frame count, >0.
+ *     (2*(1+playercount)) States, player zero (the aggregate) first.
+ *
+ * A movie recorded with no path is sent to Romassist on exit and saved as a blob of the running game.
+ */
+
+#ifndef EH_MOVIE_H
+#define EH_MOVIE_H
+
+#include <stdint.h>
+#include "inmgr/inmgr.h"
+#include "opt/serial/serial.h"
+
+#define EH_MOVIE_MODE_NONE   0
+#define EH_MOVIE_MODE_RECORD 1
+#define EH_MOVIE_MODE_REPLAY 2
+
+struct eh_movie {
+  int mode;
+  int playerc;
+  int statec; // 1+playerc
+  uint16_t statev[1+INMGR_PLAYER_LIMIT]; // Recording: current run. Replay: current frame.
+  int runc; // Frames remaining (replay) or accumulated (record) in the current run.
+  int framec; // Total frames recorded or replayed.
+  int loop;
+
+  struct sr_encoder encoder; // Recording: runs only, we add the header at finish.
+  void *src; // Replay.
+  int srcc,srcp,runp;
+  int total_framec;
+
+  int64_t start_real,start_cpu;
+  int64_t end_real,end_cpu;
+  int loopc;
+};
+
+void eh_movie_cleanup(struct eh_movie *movie);
+
+/* Call after the game is loaded, so its player count is known.
+ * (path) for replay is required. For recording, it's optional; if null we'll send to Romassist instead.
+ */
+int eh_movie_record(struct eh_movie *movie);
+int eh_movie_replay(struct eh_movie *movie,const char *path,int loop);
+
+/* Replay a made-up sequence of (framec) frames, the same every time, for benchmarking.
+ * Every declared player wanders the dpad and mashes buttons, and Aux1 gets tapped every few seconds.
+ */
+int eh_movie_script(struct eh_movie *movie,int framec);
+
+/* Recording: Call with (framec) about to run under the current input state.
+ * Replay: Call before each frame, it advances the state that eh_input_get() reports.
+ * Returns >0 normally, or 0 at the end of a replay if not looping.
+ */
+int eh_movie_update(struct eh_movie *movie,int framec);
+
+/* Input state to report while replaying.
+ */
+uint16_t eh_movie_get(const struct eh_movie *movie,int playerid);
+
+/* Encode the finished recording and write it to (path), or send to Romassist if null.
+ * Noop if not recording.
+ */
+int eh_movie_finish(struct eh_movie *movie,const char *path);
+
+int eh_movie_report(char *dst,int dsta,const struct eh_movie *movie);
+
+#endif
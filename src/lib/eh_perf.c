@@ -0,0 +1,83 @@
+#include "eh_internal.h"
+#include "eh_perf.h"
+#include "opt/serial/serial.h"
+
+static const char *eh_perf_stage_names[EH_PERF_STAGE_COUNT]={
+  "input","video","fakews","update","fbcvt","upload","swap",
+};
+
+/* Begin frame.
+ */
+
+void eh_perf_begin_frame(struct eh_perf *perf) {
+  int64_t now=eh_now_mono_ns();
+  int64_t prev=perf->framec?perf->ringv[perf->ringp].start_ns:now;
+  if (perf->framec<INT_MAX) perf->framec++;
+  if (++(perf->ringp)>=EH_PERF_RING_SIZE) perf->ringp=0;
+  struct eh_perf_frame *frame=perf->ringv+perf->ringp;
+  memset(frame,0,sizeof(struct eh_perf_frame));
+  frame->start_ns=now;
+  frame->interval_ns=now-prev;
+}
+
+/* Completed frames.
+ */
+
+int eh_perf_get_frame_count(const struct eh_perf *perf) {
+  if (perf->framec>=EH_PERF_RING_SIZE) return EH_PERF_RING_SIZE-1;
+  if (perf->framec<1) return 0;
+  return perf->framec-1;
+}
+
+const struct eh_perf_frame *eh_perf_get_frame(const struct eh_perf *perf,int p) {
+  int c=eh_perf_get_frame_count(perf);
+  if ((p<0)||(p>=c)) return 0;
+  p=perf->ringp-c+p;
+  if (p<0) p+=EH_PERF_RING_SIZE;
+  return perf->ringv+p;
+}
+
+/* Encode.
+ */
+
+int eh_perf_encode_json(struct sr_encoder *dst,const struct eh_perf *perf) {
+  int jsonctx=sr_encode_json_object_start(dst,0,0);
+  if (jsonctx<0) return -1;
+  if (sr_encode_json_string(dst,"id",2,"perf",4)<0) return -1;
+  if (sr_encode_json_int(dst,"frameUs",7,(int)eh.clock.frame_time)<0) return -1;
+  int arrayctx=sr_encode_json_array_start(dst,"stages",6);
+  if (arrayctx<0) return -1;
+  int i=0;
+  for (;i<EH_PERF_STAGE_COUNT;i++) {
+    if (sr_encode_json_string(dst,0,0,eh_perf_stage_names[i],-1)<0) return -1;
+  }
+  if (sr_encode_json_array_end(dst,arrayctx)<0) return -1;
+  if ((arrayctx=sr_encode_json_array_start(dst,"frames",6))<0) return -1;
+  int framec=eh_perf_get_frame_count(perf);
+  for (i=0;i<framec;i++) {
+    const struct eh_perf_frame *frame=eh_perf_get_frame(perf,i);
+    int framectx=sr_encode_json_array_start(dst,0,0);
+    if (framectx<0) return -1;
+    if (sr_encode_json_int(dst,0,0,(int)(frame->interval_ns/1000))<0) return -1;
+    int stage=0;
+    for (;stage<EH_PERF_STAGE_COUNT;stage++) {
+      if (sr_encode_json_int(dst,0,0,(int)(frame->stagev[stage]/1000))<0) return -1;
+    }
+    if (sr_encode_json_array_end(dst,framectx)<0) return -1;
+  }
+  if (sr_encode_json_array_end(dst,arrayctx)<0) return -1;
+  if (eh_latency_encode_json(dst,&eh.latency)<0) return -1;
+  return sr_encode_json_object_end(dst,jsonctx);
+}
+
+/* Send.
+ */
+
+void eh_perf_send(const struct eh_perf *perf) {
+  if (!eh.fakews) return;
+  struct sr_encoder encoder={0};
+  if (eh_perf_encode_json(&encoder,perf)>=0) {
+    fakews_send(eh.fakews,1,encoder.v,encoder.c);
+  }
+  sr_encoder_cleanup(&encoder);
+}
@@ -0,0 +1,72 @@
+/* eh_perf.h
+ * Per-frame timing of each subsystem, kept for the last few seconds.
+ * Always on; it's a handful of clock reads per frame.
+ *
+ * EH_BTN_DEBUG toggles an overlay: One column per frame, newest on the right, stacked in stage order from the bottom:
+ *   input yellow, video cyan, fakews magenta, update green, fbcvt orange, upload blue, swap red.
+ * Gray behind them is the whole frame interval, so the gap is mostly time spent waiting on the clock.
+ * White line is the frame budget, and the graph's top is twice that.
+ *
+ * Romassist can ask for the ring: {"id":"requestPerf"} => {"id":"perf",
+ *   "frameUs":BUDGET,
+ *   "stages":["input","video","fakews","update","fbcvt","upload","swap"],
+ *   "frames":[[intervalUs,stageUs...],...] oldest first
+ *   "latency":{...} see eh_latency.h
+ * }
+ * "update" includes run-ahead's speculative frames. Its save and load aren't counted anywhere, they show up as waiting.
+ */
+
+#ifndef EH_PERF_H
+#define EH_PERF_H
+
+#include "eh_clock.h"
+
+#define EH_PERF_INPUT  0 /* Input drivers' update. */
+#define EH_PERF_VIDEO  1 /* Video driver's update, ie window manager events. */
+#define EH_PERF_FAKEWS 2 /* Romassist connection. */
+#define EH_PERF_UPDATE 3 /* delegate.update, every call this frame. */
+#define EH_PERF_FBCVT  4 /* Software framebuffer conversion. */
+#define EH_PERF_UPLOAD 5 /* Texture upload and draw. */
+#define EH_PERF_SWAP   6 /* Video driver's end, usually a buffer swap. */
+#define EH_PERF_STAGE_COUNT 7
+
+#define EH_PERF_RING_SIZE 256
+
+struct sr_encoder;
+
+struct eh_perf_frame {
+  int64_t start_ns;
+  int64_t interval_ns; // From the previous frame's start.
+  int64_t stagev[EH_PERF_STAGE_COUNT];
+};
+
+struct eh_perf {
+  struct eh_perf_frame ringv[EH_PERF_RING_SIZE];
+  int ringp; // Frame in progress.
+  int framec; // Total frames begun, saturating.
+  int overlay;
+};
+
+/* Call at the start of each main loop pass, after the clock lets us go.
+ */
+void eh_perf_begin_frame(struct eh_perf *perf);
+
+/* Add time since (t0) to one stage of the current frame:
+ *   int64_t t0=eh_now_mono_ns(); ...; eh_perf_add(perf,EH_PERF_XXX,t0);
+ */
+static inline void eh_perf_add(struct eh_perf *perf,int stage,int64_t t0) {
+  perf->ringv[perf->ringp].stagev[stage]+=eh_now_mono_ns()-t0;
+}
+
+/* Completed frames in order, oldest first. Returns the count, up to EH_PERF_RING_SIZE-1.
+ */
+int eh_perf_get_frame_count(const struct eh_perf *perf);
+const struct eh_perf_frame *eh_perf_get_frame(const struct eh_perf *perf,int p);
+
+int eh_perf_encode_json(struct sr_encoder *dst,const struct eh_perf *perf);
+
+/* Encode and send to Romassist, in response to "requestPerf".
+ */
+void eh_perf_send(const struct eh_perf *perf);
+
+#endif
@@ -0,0 +1,136 @@
+#include "eh_internal.h"
+#include "eh_remote_input.h"
+#include "opt/serial/serial.h"
+
+/* Cleanup.
+ */
+ 
+void eh_remote_input_cleanup(struct eh_remote_input *ri) {
+  int playerid=1;
+  for (;playerid<=INMGR_PLAYER_LIMIT;playerid++) {
+    if (ri->devidv[playerid]>0) inmgr_disconnect(ri->devidv[playerid]);
+  }
+  memset(ri,0,sizeof(struct eh_remote_input));
+}
+
+/* Receive.
+ */
+ 
+static int eh_remote_input_receive_states(struct eh_remote_input *ri,struct sr_decoder *decoder) {
+  int jsonctx=sr_decode_json_array_start(decoder);
+  if (jsonctx<0) return -1;
+  while (sr_decode_json_next(0,decoder)>0) {
+    int playerid=0,state=0;
+    if (sr_decode_json_int(&playerid,decoder)<0) return -1;
+    if (sr_decode_json_next(0,decoder)<=0) return -1;
+    if (sr_decode_json_int(&state,decoder)<0) return -1;
+    if ((playerid<1)||(playerid>INMGR_PLAYER_LIMIT)) continue;
+    ri->statev[playerid]=state&~INMGR_BTN_CD;
+  }
+  return sr_decode_json_end(decoder,jsonctx);
+}
+ 
+void eh_remote_input_receive(struct eh_remote_input *ri,const void *v,int c) {
+  struct sr_decoder decoder={.v=v,.c=c};
+  if (sr_decode_json_object_start(&decoder)<0) return;
+  const char *k;
+  int kc;
+  while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+    if ((kc==3)&&!memcmp(k,"seq",3)) {
+      if (sr_decode_json_int(&ri->seq,&decoder)<0) return;
+    } else if ((kc==1)&&(k[0]=='t')) {
+      if (sr_decode_json_double(&ri->t,&decoder)<0) return;
+    } else if ((kc==6)&&!memcmp(k,"states",6)) {
+      if (eh_remote_input_receive_states(ri,&decoder)<0) return;
+    } else {
+      if (sr_decode_json_skip(&decoder)<0) return;
+    }
+  }
+  int64_t now=eh_now_real_us();
+  if (!ri->dirty) ri->rcvtime=now;
+  ri->last_rcv_time=now;
+  ri->dirty=1;
+  ri->packetc++;
+}
+
+/* Apply one player's state to its virtual device, creating it if needed.
+ */
+ 
+static void eh_remote_input_apply(struct eh_remote_input *ri,int playerid) {
+  uint16_t state=ri->statev[playerid];
+  uint16_t changed=state^ri->appliedv[playerid];
+  if (!changed) return;
+  if (ri->devidv[playerid]<0) return;
+  if (!ri->devidv[playerid]) {
+    int devid=eh_input_devid_next();
+    if (devid<1) return;
+    inmgr_connect_virtual(devid,playerid,"Remote",6);
+    if (!inmgr_get_device_id(0,0,0,devid)) { // eg (playerid) out of range for this game. Don't retry.
+      ri->devidv[playerid]=-1;
+      return;
+    }
+    ri->devidv[playerid]=devid;
+  }
+  uint16_t mask=1;
+  for (;mask<INMGR_BTN_CD;mask<<=1) {
+    if (changed&mask) inmgr_event(ri->devidv[playerid],mask,(state&mask)?1:0);
+  }
+  ri->appliedv[playerid]=state;
+}
+
+/* Update.
+ */
+ 
+void eh_remote_input_update(struct eh_remote_input *ri) {
+  int64_t now=eh_now_real_us();
+  int playerid;
+  
+  // Sender went quiet with buttons held? Let go.
+  if (!ri->dirty&&ri->last_rcv_time&&(now-ri->last_rcv_time>EH_REMOTE_INPUT_TIMEOUT_US)) {
+    ri->last_rcv_time=0;
+    int held=0;
+    for (playerid=1;playerid<=INMGR_PLAYER_LIMIT;playerid++) {
+      if (ri->statev[playerid]) held=1;
+      ri->statev[playerid]=0;
+      eh_remote_input_apply(ri,playerid);
+    }
+    if (held) ri->timeoutc++;
+    return;
+  }
+  
+  if (!ri->dirty) return;
+  ri->dirty=0;
+  for (playerid=1;playerid<=INMGR_PLAYER_LIMIT;playerid++) eh_remote_input_apply(ri,playerid);
+  
+  int64_t local_us=now-ri->rcvtime;
+  ri->applyc++;
+  ri->local_us_total+=local_us;
+  if (local_us>ri->local_us_max) ri->local_us_max=local_us;
+  
+  char msg[256];
+  int msgc=snprintf(msg,sizeof(msg),
+    "{\"id\":\"inputApplied\",\"seq\":%d,\"t\":%.3f,\"frame\":%d,\"localUs\":%d}",
+    ri->seq,ri->t,eh.clock.framec,(int)local_us
+  );
+  if ((msgc>0)&&(msgc<sizeof(msg))) fakews_send(eh.fakews,1,msg,msgc);
+}
+
+/* Report.
+ */
+ 
+int eh_remote_input_report(char *dst,int dsta,const struct eh_remote_input *ri) {
+  if (!dst||(dsta<1)) return -1;
+  dst[0]=0;
+  if (ri->applyc<1) return 0;
+  int dstc=snprintf(dst,dsta,
+    "Remote input: %d packets, %d applied, receive-to-apply %.3f ms avg %.3f ms max, %d timeouts",
+    ri->packetc,ri->applyc,
+    ri->local_us_total/(ri->applyc*1000.0),ri->local_us_max/1000.0,
+    ri->timeoutc
+  );
+  if ((dstc<1)||(dstc>=dsta)) {
+    dst[0]=0;
+    return 0;
+  }
+  return dstc;
+}
@@ -0,0 +1,53 @@
+/* eh_remote_input.h
+ * Button state from Romassist's web UI, merged into player state as one virtual inmgr device per player.
+ *
+ * Incoming, via the GAME fakews: {"id":"input","seq":INT,"t":SENDER_MS,"states":[PLAYERID,STATE,...]}
+ * The web app batches: It sends full states only when something changed, at most once per display frame,
+ * and repeats while anything is held, so we can release everything if the sender goes quiet.
+ *
+ * We apply at the start of the next frame, and acknowledge the latest batch applied that frame:
+ *   {"id":"inputApplied","seq":INT,"t":SENDER_MS,"frame":INT,"localUs":INT}
+ * (t) is the sender's own timestamp echoed back, so it can measure send-to-apply-to-ack on one clock.
+ * (localUs) is how long the batch sat with us, from receipt to the frame that used it.
+ */
+
+#ifndef EH_REMOTE_INPUT_H
+#define EH_REMOTE_INPUT_H
+
+#include <stdint.h>
+#include "inmgr/inmgr.h"
+
+#define EH_REMOTE_INPUT_TIMEOUT_US 3000000
+
+struct eh_remote_input {
+  int devidv[1+INMGR_PLAYER_LIMIT]; // Zero until that player's first packet, <0 if the game doesn't have that player.
+  uint16_t statev[1+INMGR_PLAYER_LIMIT]; // Received, not necessarily applied yet.
+  uint16_t appliedv[1+INMGR_PLAYER_LIMIT];
+  int dirty; // Something received since the last update.
+  int seq;
+  double t;
+  int64_t rcvtime; // First packet since the last update.
+  int64_t last_rcv_time;
+
+  // Stats.
+  int packetc;
+  int applyc;
+  int64_t local_us_total,local_us_max;
+  int timeoutc;
+};
+
+void eh_remote_input_cleanup(struct eh_remote_input *ri);
+
+/* Digest one "input" packet. Changes take effect at the next update.
+ */
+void eh_remote_input_receive(struct eh_remote_input *ri,const void *v,int c);
+
+/* Call once per frame, before the client updates.
+ */
+void eh_remote_input_update(struct eh_remote_input *ri);
+
+/* Empty if we never got anything.
+ */
+int eh_remote_input_report(char *dst,int dsta,const struct eh_remote_input *ri);
+
+#endif
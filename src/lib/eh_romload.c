@@ -0,0 +1,127 @@
+#include "eh_internal.h"
+#include "eh_romload.h"
+#include "opt/fs/fs.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#if !USE_mswin
+  #include <sys/mman.h>
+#endif
+
+/* Cleanup.
+ */
+ 
+static void eh_romload_drop_content(struct eh_romload *romload) {
+  if (romload->mapped) {
+    #if !USE_mswin
+      munmap(romload->v,romload->c);
+    #endif
+  } else if (romload->v) {
+    free(romload->v);
+  }
+  romload->v=0;
+  romload->c=0;
+  romload->mapped=0;
+}
+ 
+void eh_romload_cleanup(struct eh_romload *romload) {
+  if (romload->running) {
+    pthread_join(romload->thread,0);
+    romload->running=0;
+  }
+  eh_romload_drop_content(romload);
+  if (romload->path) free(romload->path);
+  memset(romload,0,sizeof(struct eh_romload));
+}
+
+/* Map the file read-only and fault it all in.
+ * Zero-length files can't be mapped; those fail here and go to file_read.
+ */
+ 
+static int eh_romload_mmap(struct eh_romload *romload) {
+  #if USE_mswin
+    return -1;
+  #else
+    int fd=open(romload->path,O_RDONLY);
+    if (fd<0) return -1;
+    struct stat st={0};
+    if ((fstat(fd,&st)<0)||!S_ISREG(st.st_mode)||(st.st_size<1)||(st.st_size>INT_MAX)) {
+      close(fd);
+      return -1;
+    }
+    int flags=MAP_PRIVATE;
+    #ifdef MAP_POPULATE
+      flags|=MAP_POPULATE;
+    #endif
+    void *v=mmap(0,st.st_size,PROT_READ,flags,fd,0);
+    close(fd);
+    if (v==MAP_FAILED) return -1;
+    #ifndef MAP_POPULATE
+      madvise(v,st.st_size,MADV_WILLNEED);
+    #endif
+    romload->v=v;
+    romload->c=st.st_size;
+    romload->mapped=1;
+    return 0;
+  #endif
+}
+
+/* Load, on either thread.
+ */
+ 
+static void eh_romload_load(struct eh_romload *romload) {
+  romload->start_us=eh_now_real_us();
+  if (!romload->use_mmap||(eh_romload_mmap(romload)<0)) {
+    void *v=0;
+    int c=file_read(&v,romload->path);
+    if (c>=0) {
+      romload->v=v;
+      romload->c=c;
+    } else {
+      romload->c=-1;
+    }
+  }
+  romload->end_us=eh_now_real_us();
+}
+
+static void *eh_romload_main(void *arg) {
+  eh_romload_load(arg);
+  return 0;
+}
+
+/* Begin.
+ */
+ 
+int eh_romload_begin(struct eh_romload *romload,const char *path,int use_mmap) {
+  if (!path) return -1;
+  eh_romload_cleanup(romload);
+  if (!(romload->path=strdup(path))) return -1;
+  romload->use_mmap=use_mmap;
+  if (pthread_create(&romload->thread,0,eh_romload_main,romload)) {
+    eh_romload_load(romload);
+  } else {
+    romload->running=1;
+  }
+  return 0;
+}
+
+/* Finish.
+ */
+ 
+int eh_romload_finish(void *dstpp,struct eh_romload *romload) {
+  if (!romload->path) return -1;
+  int64_t waitstart=eh_now_real_us();
+  if (romload->running) {
+    pthread_join(romload->thread,0);
+    romload->running=0;
+  }
+  int64_t waited=eh_now_real_us()-waitstart;
+  if (romload->c<0) return -1;
+  fprintf(stderr,
+    "%s: Read %d bytes (%s) in %d us, waited %d us after drivers.\n",
+    romload->path,romload->c,romload->mapped?"mmap":"read",
+    (int)(romload->end_us-romload->start_us),(int)waited
+  );
+  *(void**)dstpp=romload->v;
+  return romload->c;
+}
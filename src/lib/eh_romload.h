@@ -0,0 +1,37 @@
+/* eh_romload.h
+ * Read the ROM file for load_serial on a background thread, while the drivers initialize.
+ * We mmap it read-only and prefault it, so on a cold SD card the reading overlaps with window and audio setup.
+ * Falls back to file_read if mapping fails or --rom-mmap=0.
+ * Trace milestone "read" lands when the main thread collects it, and we log the read time vs the time we waited.
+ */
+
+#ifndef EH_ROMLOAD_H
+#define EH_ROMLOAD_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+struct eh_romload {
+  char *path; // STRONG
+  int use_mmap;
+  pthread_t thread;
+  int running;
+  void *v;
+  int c;
+  int mapped; // If nonzero, (v) is mapped, otherwise it's from the heap.
+  int64_t start_us,end_us; // Real time on the loader thread.
+};
+
+void eh_romload_cleanup(struct eh_romload *romload);
+
+/* Start reading (path) in the background.
+ * If we can't start a thread, we read it synchronously instead.
+ */
+int eh_romload_begin(struct eh_romload *romload,const char *path,int use_mmap);
+
+/* Block until it's loaded, then put the content in (*dstpp).
+ * It stays valid until cleanup.
+ */
+int eh_romload_finish(void *dstpp,struct eh_romload *romload);
+
+#endif
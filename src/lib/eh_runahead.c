@@ -0,0 +1,141 @@
+#include "eh_internal.h"
+#include "eh_runahead.h"
+#include <time.h>
+
+/* Thread CPU time.
+ * We care about what the main loop spends, not the audio thread.
+ */
+
+static int64_t eh_runahead_now() {
+  struct timespec tv={0};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID,&tv);
+  return (int64_t)tv.tv_sec*1000000000ll+tv.tv_nsec;
+}
+
+/* Cleanup.
+ */
+
+void eh_runahead_cleanup(struct eh_runahead *runahead) {
+  if (runahead->state) free(runahead->state);
+  memset(runahead,0,sizeof(struct eh_runahead));
+}
+
+/* Init.
+ */
+
+int eh_runahead_init(struct eh_runahead *runahead,int framec) {
+  eh_runahead_cleanup(runahead);
+  if (framec<1) return 0;
+  if (framec>EH_RUNAHEAD_LIMIT) framec=EH_RUNAHEAD_LIMIT;
+  if (!eh.delegate.save_state||!eh.delegate.load_state) {
+    fprintf(stderr,"%s: Run-ahead requested but this emulator doesn't support save and load state. Disabling.\n",eh.exename);
+    return 0;
+  }
+  runahead->framec=framec;
+  fprintf(stderr,"%s: Run-ahead %d frame%s.\n",eh.exename,framec,(framec==1)?"":"s");
+  return 0;
+}
+
+/* Save state, growing the buffer if needed.
+ */
+
+static int eh_runahead_save(struct eh_runahead *runahead) {
+  while (1) {
+    int err=eh.delegate.save_state(runahead->state,runahead->statea);
+    if (err<0) return -1;
+    if (err<=runahead->statea) {
+      runahead->statec=err;
+      return 0;
+    }
+    if (err>INT_MAX-1024) return -1;
+    int na=(err+1024)&~1023;
+    void *nv=realloc(runahead->state,na);
+    if (!nv) return -1;
+    runahead->state=nv;
+    runahead->statea=na;
+  }
+}
+
+/* Give up on run-ahead, after a failure to save or load.
+ */
+
+static void eh_runahead_fail(struct eh_runahead *runahead,const char *what) {
+  fprintf(stderr,"%s: Failed to %s state for run-ahead. Disabling.\n",eh.exename,what);
+  runahead->failc++;
+  runahead->framec=0;
+  runahead->hidden=0;
+}
+
+/* Update.
+ */
+
+int eh_runahead_update(struct eh_runahead *runahead,int framec) {
+  int err;
+  int64_t t0=eh_runahead_now();
+  int64_t perft=eh_now_mono_ns();
+
+  // Real frames. None of these gets displayed, so they're all partial.
+  while (framec-->0) {
+    if ((err=eh.delegate.update(1))<0) return err;
+  }
+  eh_perf_add(&eh.perf,EH_PERF_UPDATE,perft);
+  if (!runahead->framec) return 0; // eg disabled mid-flight
+  int64_t t1=eh_runahead_now();
+
+  if (eh_runahead_save(runahead)<0) {
+    eh_runahead_fail(runahead,"save");
+    return 0;
+  }
+  int64_t t2=eh_runahead_now();
+
+  // Speculative frames with the current input, rendering only the last.
+  runahead->hidden=1;
+  perft=eh_now_mono_ns();
+  int i=runahead->framec;
+  while (i-->0) {
+    if ((err=eh.delegate.update(i))<0) {
+      runahead->hidden=0;
+      return err;
+    }
+  }
+  runahead->hidden=0;
+  eh_perf_add(&eh.perf,EH_PERF_UPDATE,perft);
+
+  // Present now, while the client's framebuffer still holds the speculative frame.
+  eh_render_after(eh.render);
+  int64_t t3=eh_runahead_now();
+
+  if (eh.delegate.load_state(runahead->state,runahead->statec)<0) {
+    eh_runahead_fail(runahead,"load");
+    return 0;
+  }
+  int64_t t4=eh_runahead_now();
+
+  runahead->real_ns+=t1-t0;
+  runahead->save_ns+=t2-t1;
+  runahead->load_ns+=t4-t3;
+  runahead->extra_ns+=t4-t1;
+  runahead->updatec++;
+  return 0;
+}
+
+/* Report.
+ */
+
+int eh_runahead_report(char *dst,int dsta,const struct eh_runahead *runahead) {
+  if (!dst||(dsta<1)) return -1;
+  dst[0]=0;
+  if (runahead->updatec<1) return 0;
+  double n=runahead->updatec*1000000.0;
+  int dstc=snprintf(dst,dsta,
+    "Run-ahead %d: +%.3f ms CPU per frame (real frames %.3f ms, save %.3f ms, load %.3f ms), %d failures",
+    runahead->framec,
+    runahead->extra_ns/n,runahead->real_ns/n,runahead->save_ns/n,runahead->load_ns/n,
+    runahead->failc
+  );
+  if ((dstc<1)||(dstc>=dsta)) {
+    dst[0]=0;
+    return 0;
+  }
+  return dstc;
+}
@@ -0,0 +1,47 @@
+/* eh_runahead.h
+ * Run-ahead latency reduction.
+ * Each displayed frame: Run the real frame(s) without rendering, save state,
+ * run (framec) more with the same input, present the last of those, then restore.
+ * The player sees the game's response to their input (framec) frames sooner than the game itself would show it.
+ * Requires delegate.save_state and delegate.load_state. Costs roughly (framec+1) times the emulation CPU.
+ */
+
+#ifndef EH_RUNAHEAD_H
+#define EH_RUNAHEAD_H
+
+#include <stdint.h>
+
+#define EH_RUNAHEAD_LIMIT 6
+
+struct eh_runahead {
+  int framec; // Zero if disabled.
+  int hidden; // Nonzero while running speculative frames. Their audio is dropped.
+  void *state;
+  int statec,statea;
+
+  // Stats, thread CPU time, cumulative.
+  int64_t real_ns; // Real frames, what we'd spend anyway.
+  int64_t extra_ns; // Save, speculative frames, and restore: The cost of run-ahead.
+  int64_t save_ns,load_ns;
+  int updatec; // Displayed frames.
+  int failc;
+};
+
+void eh_runahead_cleanup(struct eh_runahead *runahead);
+
+/* Disables run-ahead with a warning, if the delegate doesn't support it.
+ * (framec) zero is fine and just means disabled.
+ */
+int eh_runahead_init(struct eh_runahead *runahead,int framec);
+
+/* Run the client for one displayed frame, including (framec) real frames and our speculative ones.
+ * Also commits video; caller doesn't need to eh_render_after(), but it's harmless.
+ */
+int eh_runahead_update(struct eh_runahead *runahead,int framec);
+
+/* Summarize cost per displayed frame, for the exit log.
+ * Empty if disabled.
+ */
+int eh_runahead_report(char *dst,int dsta,const struct eh_runahead *runahead);
+
+#endif
@@ -0,0 +1,83 @@
+/* eh_standby.c
+ * --standby: Start the process, read config, connect to Romassist, then wait to be told what to do.
+ * Romassist keeps one of these around as a warm spare, and wakes it instead of launching a new process.
+ *
+ * We connect at "/ws/spare" and introduce ourselves: {"id":"spare","pid":INT}
+ * Romassist wakes us with: {"id":"wake","rom":PATH,"trace":INT} (both optional, "rom" is absent for the menu)
+ * After that, the connection is our normal game or menu connection, Romassist changes its role.
+ *
+ * Video and audio don't initialize until we wake.
+ * We'd like to, but the process we're replacing probably still holds the display.
+ */
+
+#include "eh_internal.h"
+#include "opt/serial/serial.h"
+#include <unistd.h>
+
+/* Introduce ourselves, at each connection while still in standby.
+ */
+
+void eh_standby_hello() {
+  if (!eh.standby) return;
+  char msg[64];
+  int msgc=snprintf(msg,sizeof(msg),"{\"id\":\"spare\",\"pid\":%d}",(int)getpid());
+  if ((msgc>0)&&(msgc<sizeof(msg))) fakews_send(eh.fakews,1,msg,msgc);
+}
+
+/* Wait.
+ */
+
+int eh_standby_wait() {
+  if (!eh.romassist_port) {
+    fprintf(stderr,"%s: --standby requires --romassist.\n",eh.exename);
+    return -2;
+  }
+  if (!(eh.fakews=fakews_new(
+    eh.romassist_host,-1,
+    eh.romassist_port,
+    "/ws/spare",9,
+    eh_cb_ws_connect,
+    eh_cb_ws_disconnect,
+    eh_cb_ws_message,
+    0
+  ))) return -1;
+  fprintf(stderr,"%s: Standing by.\n",eh.exename);
+  while (eh.standby) {
+    if (eh.sigc) {
+      eh.terminate=1;
+      return 0;
+    }
+    if (fakews_update(eh.fakews,100)<0) {
+      fprintf(stderr,"%s: Error updating network.\n",eh.exename);
+      return -2;
+    }
+  }
+  fprintf(stderr,"%s: Woke up, %s.\n",eh.exename,eh.rompath?eh.rompath:"no ROM");
+  return 0;
+}
+
+/* {"id":"wake"}
+ */
+
+void eh_standby_wake(const void *v,int c) {
+  if (!eh.standby) return;
+  struct sr_decoder decoder={.v=v,.c=c};
+  if (sr_decode_json_object_start(&decoder)<0) return;
+  const char *k;
+  int kc,traceid=0;
+  while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+    if ((kc==5)&&!memcmp(k,"trace",5)) {
+      if (sr_decode_json_int(&traceid,&decoder)<0) return;
+    } else if ((kc==3)&&!memcmp(k,"rom",3)) {
+      char path[1024];
+      int pathc=sr_decode_json_string(path,sizeof(path),&decoder);
+      if ((pathc<0)||(pathc>sizeof(path))) return;
+      if (eh_config_set_string(&eh.rompath,path,pathc)<0) return;
+    } else {
+      if (sr_decode_json_skip(&decoder)<0) return;
+    }
+  }
+  eh.standby=0;
+  eh_trace_reset(&eh.trace,traceid);
+  eh_trace_mark(&eh.trace,"wake");
+}
@@ -0,0 +1,54 @@
+#include "eh_internal.h"
+
+/* Init.
+ */
+
+void eh_trace_init(struct eh_trace *trace) {
+  const char *src=getenv("RA_TRACE");
+  int id=0;
+  if (src) for (;(*src>='0')&&(*src<='9');src++) {
+    if (id>=INT_MAX/10) break;
+    id=id*10+(*src)-'0';
+  }
+  eh_trace_reset(trace,id);
+}
+
+void eh_trace_reset(struct eh_trace *trace,int id) {
+  trace->id=id;
+  trace->stagec=0;
+  trace->sentc=0;
+}
+
+/* Mark.
+ */
+
+void eh_trace_mark(struct eh_trace *trace,const char *name) {
+  if (!trace->id) return;
+  if (trace->stagec>=EH_TRACE_LIMIT) return;
+  int i=trace->stagec;
+  while (i-->0) if (trace->stagev[i].name==name) return;
+  struct eh_trace_stage *stage=trace->stagev+trace->stagec++;
+  stage->name=name;
+  stage->time=eh_now_real_us();
+  eh_trace_flush(trace);
+}
+
+/* Flush.
+ */
+
+void eh_trace_flush(struct eh_trace *trace) {
+  if (!trace->id) return;
+  if (!fakews_is_connected(eh.fakews)) return;
+  int64_t now=eh_now_real_us();
+  while (trace->sentc<trace->stagec) {
+    const struct eh_trace_stage *stage=trace->stagev+trace->sentc;
+    char msg[128];
+    int msgc=snprintf(msg,sizeof(msg),
+      "{\"id\":\"trace\",\"trace\":%d,\"stage\":\"%s\",\"agoMs\":%d}",
+      trace->id,stage->name,(int)((now-stage->time)/1000)
+    );
+    if ((msgc<1)||(msgc>=sizeof(msg))) return;
+    if (fakews_send(eh.fakews,1,msg,msgc)<0) return;
+    trace->sentc++;
+  }
+}
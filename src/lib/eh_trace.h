@@ -0,0 +1,45 @@
+/* eh_trace.h
+ * Startup milestones, reported to Romassist so it can time launches end to end.
+ * Romassist puts a trace ID in our environment (RA_TRACE), or in the "wake" message for standby processes.
+ * Without one we don't record anything.
+ *
+ * Each milestone goes out as: {"id":"trace","trace":ID,"stage":NAME,"agoMs":INT}
+ * Times are relative to the moment of sending, since our clock and Romassist's aren't necessarily comparable.
+ * Milestones before the connection is up are held and sent at connect.
+ */
+
+#ifndef EH_TRACE_H
+#define EH_TRACE_H
+
+#include <stdint.h>
+
+#define EH_TRACE_LIMIT 16
+
+struct eh_trace {
+  int id;
+  struct eh_trace_stage {
+    const char *name; // WEAK, must be a literal.
+    int64_t time; // Real, us.
+  } stagev[EH_TRACE_LIMIT];
+  int stagec;
+  int sentc;
+};
+
+/* Pick up the ID from the environment. Zero for none, which is fine.
+ */
+void eh_trace_init(struct eh_trace *trace);
+
+/* Drop anything recorded and start over with a new ID, eg waking from standby.
+ */
+void eh_trace_reset(struct eh_trace *trace,int id);
+
+/* Record a milestone, and send it if we can.
+ * Each name once only; repeats are ignored.
+ */
+void eh_trace_mark(struct eh_trace *trace,const char *name);
+
+/* Send anything not sent yet. Call at connect.
+ */
+void eh_trace_flush(struct eh_trace *trace);
+
+#endif
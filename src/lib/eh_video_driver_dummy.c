@@ -42,6 +42,7 @@ const struct eh_video_type eh_video_type_dummy={
   .desc="Fake video driver that discards output.",
   .objlen=sizeof(struct eh_video_driver_dummy),
   .appointment_only=1,
+  .no_gl=1,
   .del=_dummy_del,
   .init=_dummy_init,
   .begin=_dummy_begin,
@@ -181,6 +181,15 @@ struct eh_delegate {
   /* Anything from the fake websocket connection that we don't recognize, we'll dump it here as a last resort.
    */
   void (*websocket_incoming)(const char *id,int idc,const char *src,int srcc);
+  
+  /* Optional. Capture or restore the complete machine state, in memory.
+   * Required for run-ahead ("--runahead=N"), which calls both once per displayed frame, so keep them cheap.
+   * save_state returns the length of the state. If that exceeds (dsta), we'll grow the buffer and call again.
+   * load_state receives exactly what save_state produced, in the same session.
+   * Return <0 for errors, as usual.
+   */
+  int (*save_state)(void *dst,int dsta);
+  int (*load_state)(const void *src,int srcc);
 };
 
 /* Call from your main, typically the only thing your main should do.
@@ -276,6 +285,11 @@ int eh_get_scratch_directory(char **dstpp);
  */
 int eh_get_romassist_directory(char *dst,int dsta);
 
+/* Ask emuhost to end the run cleanly, as if the window were closed.
+ * Safe during configure: eh_main returns zero without starting any drivers.
+ */
+void eh_request_termination();
+
 /* Null if we are not configured to connect to a Romassist server.
  * (mind that that configuration can be influenced at the command line, so never assume that fakews is in play).
  * Existence of a fakews does not necessarily mean it's connected.
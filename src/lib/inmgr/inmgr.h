@@ -6,6 +6,8 @@
 #ifndef INMGR_H
 #define INMGR_H
 
+#include <stdint.h>
+
 // 1, 2, 4, and 8 are limits we've seen. 16 is ridiculous, so that's good for a limit.
 // This does not include the aggregate player zero.
 #define INMGR_PLAYER_LIMIT 16
@@ -147,15 +149,30 @@ int inmgr_set_signal(int btnid,void (*cb)());
  * inmgr_get_button() can return those bits and also Extended buttons.
  */
 int inmgr_get_player(int playerid);
+int inmgr_get_player_count();
 int inmgr_get_button(int playerid,int btnid);
 
 /* One-shot events from the sources (ie you).
  * (devid) must be unique and positive.
  */
 void inmgr_event(int devid,int btnid,int value);
+
+/* Same as inmgr_event(), when the driver knows when it happened.
+ * Each player remembers (time_ns) of its earliest twostate press, until you take it.
+ * Releasing everything also drops it, so presses nobody reads don't linger.
+ * Emuhost uses this to measure input latency. We don't care what clock it is, only nonzero.
+ */
+void inmgr_event_timed(int devid,int btnid,int value,int64_t time_ns);
+int64_t inmgr_take_press_time(int playerid);
 void inmgr_disconnect(int devid);
 void inmgr_connect_keyboard(int devid);
 
+/* Device whose source buttons are already player buttons, eg remote input over the network.
+ * Bound to (playerid) and mapped identity, for every button in the global mask. Never saved to config.
+ * Send events with the 16-bit btnid, as usual through inmgr_event().
+ */
+void inmgr_connect_virtual(int devid,int playerid,const char *name,int namec);
+
 /* Most connections, you should "begin", then "more" for each source button, and finally "end.
  * The device does not fully participate until you "end" it.
  * Keyboards that report their buttons as HID page 7 can just call inmgr_connect_keyboard() instead of all this.
@@ -184,6 +201,14 @@ void inmgr_device_enable(int devid,int enable);
 int inmgr_listen(void (*cb)(int devid,int btnid,int value,int state,void *userdata),void *userdata);
 void inmgr_unlisten(int listenerid);
 
+/* When events arrive on a different thread than the one that owns your callbacks, say so here.
+ * While deferring, signals and listener callbacks are queued until you flush, on the owner thread.
+ * Player states change immediately either way.
+ * You must serialize access to inmgr yourself; we don't lock.
+ */
+void inmgr_defer(int defer);
+void inmgr_flush_deferred();
+
 /* Bypass mapping and write some state change directly to our outputs.
  * If (btnid) is a signal and (value) nonzero, we fire its callback.
  */
@@ -204,6 +229,20 @@ int inmgr_playerid_for_devid(int devid);
  */
 int inmgr_remap_button(int devid,int srcbtnid,int dstbtnid);
 
+/* Connect one device with these buttons, replay (eventv) through it, and print timings to stderr.
+ * Compares our usual table lookup against the plain binary search, and checks that they agree.
+ * (eventv) is (btnid,value) pairs, (eventc) counts pairs.
+ * Must be called while uninitialized; we init and quit around it, so your config file's templates apply.
+ */
+struct inmgr_benchmark_button {
+  int btnid,hidusage,lo,hi;
+};
+int inmgr_benchmark(
+  const struct inmgr_benchmark_button *buttonv,int buttonc,
+  const int *eventv,int eventc,
+  const char *desc
+);
+
 //TODO Should we expose the gritty details of the config file?
 
 #endif
@@ -0,0 +1,78 @@
+#include "inmgr_internal.h"
+#include <time.h>
+
+#define INMGR_BENCHMARK_DEVID 1
+#define INMGR_BENCHMARK_NS 500000000ll
+
+static int64_t inmgr_benchmark_now() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec*1000000000ll+ts.tv_nsec;
+}
+
+/* Connect a fresh device, replay once to check the outcome, then repeat until we have enough time.
+ * Returns the final player state of that first pass, and fills (*nsper) with the average per event.
+ */
+ 
+static int inmgr_benchmark_run(
+  double *nsper,
+  const struct inmgr_benchmark_button *buttonv,int buttonc,
+  const int *eventv,int eventc
+) {
+  inmgr_disconnect(INMGR_BENCHMARK_DEVID);
+  inmgr_connect_begin(INMGR_BENCHMARK_DEVID,0,0,0,"Input Benchmark",-1);
+  for (;buttonc-->0;buttonv++) inmgr_connect_more(INMGR_BENCHMARK_DEVID,buttonv->btnid,buttonv->hidusage,buttonv->lo,buttonv->hi,0);
+  inmgr_connect_end(INMGR_BENCHMARK_DEVID);
+  
+  const int *event=eventv;
+  int i=eventc;
+  for (;i-->0;event+=2) inmgr_event(INMGR_BENCHMARK_DEVID,event[0],event[1]);
+  int state=inmgr_get_player(0);
+  
+  int64_t passc=0,elapsed=0,start=inmgr_benchmark_now();
+  while (elapsed<INMGR_BENCHMARK_NS) {
+    for (event=eventv,i=eventc;i-->0;event+=2) inmgr_event(INMGR_BENCHMARK_DEVID,event[0],event[1]);
+    passc++;
+    elapsed=inmgr_benchmark_now()-start;
+  }
+  *nsper=(double)elapsed/(double)(passc*eventc);
+  return state;
+}
+
+/* Benchmark, main entry point.
+ */
+ 
+int inmgr_benchmark(
+  const struct inmgr_benchmark_button *buttonv,int buttonc,
+  const int *eventv,int eventc,
+  const char *desc
+) {
+  if (eventc<1) return -1;
+  if (inmgr_init()<0) return -1;
+  double tablens=0.0,searchns=0.0;
+  int tablestate=inmgr_benchmark_run(&tablens,buttonv,buttonc,eventv,eventc);
+  struct inmgr_device *device=inmgr_device_by_devid(INMGR_BENCHMARK_DEVID);
+  int pagec=device?device->pagec:0;
+  int mappedc=0;
+  if (device) {
+    const struct inmgr_button *button=device->buttonv;
+    int i=device->buttonc;
+    for (;i-->0;button++) if (button->dstbtnid) mappedc++;
+  }
+  inmgr.lookup_search=1;
+  int searchstate=inmgr_benchmark_run(&searchns,buttonv,buttonc,eventv,eventc);
+  inmgr.lookup_search=0;
+  inmgr_quit();
+  
+  fprintf(stderr,
+    "Input mapping benchmark, %s: %d events, %d buttons (%d mapped, %d table pages).\n",
+    desc?desc:"",eventc,buttonc,mappedc,pagec
+  );
+  fprintf(stderr,"  table:  %8.2f ns/event\n",tablens);
+  fprintf(stderr,"  search: %8.2f ns/event\n",searchns);
+  if (tablestate!=searchstate) {
+    fprintf(stderr,"!!! Final states disagree: table 0x%04x, search 0x%04x !!!\n",tablestate,searchstate);
+    return -1;
+  }
+  return 0;
+}
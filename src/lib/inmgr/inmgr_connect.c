@@ -406,22 +406,19 @@ void inmgr_disconnect(int devid) {
   inmgr_broadcast(devid,0,0,0);
 }
 
-/* Connect keyboard, one-shot.
+/* Insert a zeroed device, or null if invalid or it already exists.
  */
  
-void inmgr_connect_keyboard(int devid) {
-
-  /* Create the new device, or fail if it already exists or invalid devid.
-   */
-  if (devid<1) return;
+static struct inmgr_device *inmgr_device_insert(int devid) {
+  if (devid<1) return 0;
   int devp=inmgr_devicev_search(devid);
-  if (devp>=0) return;
+  if (devp>=0) return 0;
   devp=-devp-1;
   if (inmgr.devicec>=inmgr.devicea) {
     int na=inmgr.devicea+16;
-    if (na>INT_MAX/sizeof(struct inmgr_device)) return;
+    if (na>INT_MAX/sizeof(struct inmgr_device)) return 0;
     void *nv=realloc(inmgr.devicev,sizeof(struct inmgr_device)*na);
-    if (!nv) return;
+    if (!nv) return 0;
     inmgr.devicev=nv;
     inmgr.devicea=na;
   }
@@ -429,6 +426,18 @@ void inmgr_connect_keyboard(int devid) {
   memmove(device+1,device,sizeof(struct inmgr_device)*(inmgr.devicec-devp));
   inmgr.devicec++;
   memset(device,0,sizeof(struct inmgr_device));
+  return device;
+}
+
+/* Connect keyboard, one-shot.
+ */
+ 
+void inmgr_connect_keyboard(int devid) {
+
+  /* Create the new device, or fail if it already exists or invalid devid.
+   */
+  struct inmgr_device *device=inmgr_device_insert(devid);
+  if (!device) return;
   
   /* Initialize a few header things.
    * Keyboards are mapped and ready instantly, since they can only map to player one.
@@ -458,6 +467,34 @@ void inmgr_connect_keyboard(int devid) {
   inmgr_broadcast(devid,0,1,device->state);
 }
 
+/* Connect virtual device, one-shot.
+ */
+ 
+void inmgr_connect_virtual(int devid,int playerid,const char *name,int namec) {
+  if ((playerid<1)||(playerid>inmgr.playerc)) return;
+  struct inmgr_device *device=inmgr_device_insert(devid);
+  if (!device) return;
+  
+  /* Like keyboards, virtual devices are ready instantly.
+   * We skip templates entirely, so they never land in the config file.
+   */
+  device->devid=devid;
+  device->enable=1;
+  device->ready=1;
+  device->playerid=playerid;
+  inmgr_device_set_name(device,name,namec);
+  device->state=INMGR_BTN_CD;
+  inmgr.playerv[playerid].state|=INMGR_BTN_CD;
+  inmgr.playerv[0].state|=INMGR_BTN_CD;
+  
+  int btnid=1;
+  for (;btnid<INMGR_BTN_CD;btnid<<=1) {
+    if (inmgr.btnmask&btnid) inmgr_buttonv_append_key(device,btnid,btnid);
+  }
+  
+  inmgr_broadcast(devid,0,1,device->state);
+}
+
 /* Begin connection of new device.
  */
 
@@ -465,22 +502,8 @@ void inmgr_connect_begin(int devid,int vid,int pid,int version,const char *name,
 
   /* Validate devid and create the new device instance.
    */
-  if (devid<1) return;
-  int devp=inmgr_devicev_search(devid);
-  if (devp>=0) return;
-  devp=-devp-1;
-  if (inmgr.devicec>=inmgr.devicea) {
-    int na=inmgr.devicea+16;
-    if (na>INT_MAX/sizeof(struct inmgr_device)) return;
-    void *nv=realloc(inmgr.devicev,sizeof(struct inmgr_device)*na);
-    if (!nv) return;
-    inmgr.devicev=nv;
-    inmgr.devicea=na;
-  }
-  struct inmgr_device *device=inmgr.devicev+devp;
-  memmove(device+1,device,sizeof(struct inmgr_device)*(inmgr.devicec-devp));
-  inmgr.devicec++;
-  memset(device,0,sizeof(struct inmgr_device));
+  struct inmgr_device *device=inmgr_device_insert(devid);
+  if (!device) return;
   
   /* Initialize.
    */
@@ -505,6 +528,7 @@ void inmgr_connect_more(int devid,int btnid,int hidusage,int lo,int hi,int value
   if (!device||device->ready) return;
   int btnp=inmgr_device_buttonv_search(device,btnid);
   if (btnp>=0) return; // Duplicate. Keep the first one.
+  device->compiled=0;
   btnp=-btnp-1;
   if (device->buttonc>=device->buttona) {
     int na=device->buttona+16;
@@ -532,6 +556,7 @@ void inmgr_connect_end(int devid) {
   struct inmgr_device *device=inmgr_device_by_devid(devid);
   if (!device||device->ready) return;
   device->ready=1;
+  device->compiled=0;
   struct inmgr_tm *tm=inmgr_tm_for_device(device);
   if (tm) {
     inmgr_device_apply_applicable_template(device,tm);
@@ -576,6 +601,7 @@ int inmgr_remap_button(int devid,int srcbtnid,int dstbtnid) {
     button->srcbtnid=srcbtnid;
   }
   inmgr_button_remap(button,dstbtnid,0,0);
+  device->compiled=0;
   
   if (device->tmid) {
     struct inmgr_tm *tm=inmgr.tmv;
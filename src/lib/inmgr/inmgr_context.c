@@ -16,6 +16,7 @@ void inmgr_quit() {
   }
   if (inmgr.signalv) free(inmgr.signalv);
   if (inmgr.listenerv) free(inmgr.listenerv);
+  if (inmgr.deferredv) free(inmgr.deferredv);
   memset(&inmgr,0,sizeof(struct inmgr));
 }
 
@@ -127,6 +128,9 @@ int inmgr_set_extbtn(int btnid,int lo,int hi) {
     extbtn->lo=lo;
     extbtn->hi=hi;
   }
+  struct inmgr_device *device=inmgr.devicev;
+  int i=inmgr.devicec;
+  for (;i-->0;device++) device->compiled=0;
   return 0;
 }
 
@@ -148,6 +152,10 @@ int inmgr_signalv_search(int btnid) {
 void inmgr_signal(int btnid) {
   int p=inmgr_signalv_search(btnid);
   if (p<0) return;
+  if (inmgr.defer) {
+    inmgr_deferred_add(0,btnid,1,0);
+    return;
+  }
   inmgr.signalv[p].cb();
 }
 
@@ -188,6 +196,10 @@ int inmgr_get_player(int playerid) {
   return inmgr.playerv[playerid].state;
 }
 
+int inmgr_get_player_count() {
+  return inmgr.playerc;
+}
+
 int inmgr_get_button(int playerid,int btnid) {
   if ((playerid<0)||(playerid>inmgr.playerc)) return 0;
   int extbtnp=inmgr_extbtnv_search(btnid);
@@ -259,6 +271,10 @@ void inmgr_unlisten(int listenerid) {
 }
 
 void inmgr_broadcast(int devid,int btnid,int value,int state) {
+  if (inmgr.defer) {
+    if (inmgr.listenerc) inmgr_deferred_add(devid,btnid,value,state);
+    return;
+  }
   // Important to run backward: Listeners are allowed to remove themselves during the callback.
   int i=inmgr.listenerc;
   struct inmgr_listener *listener=inmgr.listenerv+i-1;
@@ -266,3 +282,46 @@ void inmgr_broadcast(int devid,int btnid,int value,int state) {
     listener->cb(devid,btnid,value,state,listener->userdata);
   }
 }
+
+/* Deferred signals and broadcasts.
+ */
+ 
+void inmgr_deferred_add(int devid,int btnid,int value,int state) {
+  if (inmgr.deferredc>=inmgr.deferreda) {
+    int na=inmgr.deferreda+32;
+    if (na>INT_MAX/sizeof(struct inmgr_deferred)) return;
+    void *nv=realloc(inmgr.deferredv,sizeof(struct inmgr_deferred)*na);
+    if (!nv) return;
+    inmgr.deferredv=nv;
+    inmgr.deferreda=na;
+  }
+  struct inmgr_deferred *deferred=inmgr.deferredv+inmgr.deferredc++;
+  deferred->devid=devid;
+  deferred->btnid=btnid;
+  deferred->value=value;
+  deferred->state=state;
+}
+
+void inmgr_defer(int defer) {
+  if (defer) {
+    inmgr.defer=1;
+  } else {
+    inmgr_flush_deferred();
+    inmgr.defer=0;
+  }
+}
+
+void inmgr_flush_deferred() {
+  if (!inmgr.deferredc) return;
+  int defer=inmgr.defer;
+  inmgr.defer=0;
+  // Callbacks can cause more events, eg signals that connect things. Those go straight through.
+  int i=0;
+  for (;i<inmgr.deferredc;i++) {
+    const struct inmgr_deferred *deferred=inmgr.deferredv+i;
+    if (deferred->devid) inmgr_broadcast(deferred->devid,deferred->btnid,deferred->value,deferred->state);
+    else inmgr_signal(deferred->btnid);
+  }
+  inmgr.deferredc=0;
+  inmgr.defer=defer;
+}
@@ -6,6 +6,7 @@
 void inmgr_device_cleanup(struct inmgr_device *device) {
   if (device->name) free(device->name);
   if (device->buttonv) free(device->buttonv);
+  while (device->pagec-->0) free(device->pagev[device->pagec].v);
 }
 
 /* Search device list.
@@ -50,6 +51,81 @@ struct inmgr_button *inmgr_button_by_srcbtnid(const struct inmgr_device *device,
   return device->buttonv+p;
 }
 
+/* Compile.
+ * Anything that changes (buttonv), or its mappings, or the global extbtn list, must zero (compiled) after.
+ * We rebuild lazily, at the next event.
+ */
+ 
+static void inmgr_button_compile(struct inmgr_button *button) {
+  button->extbtnp=-1;
+  switch (button->mode) {
+    case INMGR_BUTTON_MODE_TWOSTATE: {
+        if (button->dstbtnid&0xffff0000) button->extbtnp=inmgr_extbtnv_search(button->dstbtnid);
+      } break;
+    case INMGR_BUTTON_MODE_THREEWAY: {
+        if (button->srclo<=button->srchi) {
+          button->twlo=button->srclo;
+          button->twhi=button->srchi;
+          button->btnidlo=(button->dstbtnid&(INMGR_BTN_LEFT|INMGR_BTN_UP));
+          button->btnidhi=(button->dstbtnid&(INMGR_BTN_RIGHT|INMGR_BTN_DOWN));
+        } else {
+          button->twlo=button->srchi;
+          button->twhi=button->srclo;
+          button->btnidhi=(button->dstbtnid&(INMGR_BTN_LEFT|INMGR_BTN_UP));
+          button->btnidlo=(button->dstbtnid&(INMGR_BTN_RIGHT|INMGR_BTN_DOWN));
+        }
+      } break;
+    case INMGR_BUTTON_MODE_LINEAR: {
+        button->extbtnp=inmgr_extbtnv_search(button->dstbtnid);
+      } break;
+  }
+}
+ 
+void inmgr_device_compile(struct inmgr_device *device) {
+  while (device->pagec>0) free(device->pagev[--(device->pagec)].v);
+  device->compiled=1;
+  struct inmgr_button *button=device->buttonv;
+  int i=device->buttonc;
+  for (;i-->0;button++) inmgr_button_compile(button);
+  if (device->buttonc>=0xffff) return;
+  // (buttonv) is sorted by srcbtnid, so each type is one contiguous run.
+  int p=0;
+  while (p<device->buttonc) {
+    int type=device->buttonv[p].srcbtnid>>16;
+    int q=p+1;
+    while ((q<device->buttonc)&&((device->buttonv[q].srcbtnid>>16)==type)) q++;
+    int lo=device->buttonv[p].srcbtnid&0xffff;
+    int c=(device->buttonv[q-1].srcbtnid&0xffff)-lo+1;
+    if ((type>=0)&&(c<=INMGR_PAGE_SIZE_LIMIT)&&(device->pagec<INMGR_PAGE_LIMIT)) {
+      uint16_t *v=calloc(c,sizeof(uint16_t));
+      if (v) {
+        struct inmgr_page *page=device->pagev+device->pagec++;
+        page->type=type;
+        page->lo=lo;
+        page->c=c;
+        page->v=v;
+        for (i=p;i<q;i++) v[(device->buttonv[i].srcbtnid&0xffff)-lo]=i+1;
+      }
+    }
+    p=q;
+  }
+}
+
+struct inmgr_button *inmgr_button_lookup(struct inmgr_device *device,int srcbtnid) {
+  if (!device->compiled) inmgr_device_compile(device);
+  if (inmgr.lookup_search) return inmgr_button_by_srcbtnid(device,srcbtnid);
+  int type=srcbtnid>>16;
+  const struct inmgr_page *page=device->pagev;
+  int i=device->pagec;
+  for (;i-->0;page++) {
+    if (page->type!=type) continue;
+    int code=(srcbtnid&0xffff)-page->lo;
+    if ((code<0)||(code>=page->c)||!page->v[code]) return 0;
+    return device->buttonv+page->v[code]-1;
+  }
+  return inmgr_button_by_srcbtnid(device,srcbtnid);
+}
+
 /* Public device list inspection.
  */
 
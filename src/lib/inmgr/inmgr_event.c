@@ -24,24 +24,39 @@ static void inmgr_device_select_playerid(struct inmgr_device *device) {
   }
 }
 
+/* Record press time against a player, and drop it when they let go of everything.
+ * Atomic, since inmgr_take_press_time() may be on a different thread than the events.
+ */
+ 
+static void inmgr_player_pressed(struct inmgr_player *player) {
+  int64_t none=0;
+  __atomic_compare_exchange_n(&player->press_time_ns,&none,inmgr.event_time_ns,0,__ATOMIC_RELAXED,__ATOMIC_RELAXED);
+}
+
+static void inmgr_player_released(struct inmgr_player *player) {
+  if (!player->state) __atomic_store_n(&player->press_time_ns,0,__ATOMIC_RELAXED);
+}
+
 /* Update and cascade device's state.
  */
  
+static void inmgr_device_update_extbtn(struct inmgr_device *device,int extbtnp,int value) {
+  if (value==device->extbtnv[extbtnp]) return;
+  device->extbtnv[extbtnp]=value;
+  if (device->enable) {
+    if (!device->playerid) {
+      if (!value) return;
+      inmgr_device_select_playerid(device);
+    }
+    inmgr.playerv[device->playerid].extbtnv[extbtnp]=value;
+    inmgr.playerv[0].extbtnv[extbtnp]=value;
+  }
+}
+ 
 static void inmgr_device_update_state(struct inmgr_device *device,int btnid,int value) {
   if (btnid&0xffff0000) { // extbtn
     int extbtnp=inmgr_extbtnv_search(btnid);
-    if (extbtnp>=0) {
-      if (value==device->extbtnv[extbtnp]) return;
-      device->extbtnv[extbtnp]=value;
-      if (device->enable) {
-        if (!device->playerid) {
-          if (!value) return;
-          inmgr_device_select_playerid(device);
-        }
-        inmgr.playerv[device->playerid].extbtnv[extbtnp]=value;
-        inmgr.playerv[0].extbtnv[extbtnp]=value;
-      }
-    }
+    if (extbtnp>=0) inmgr_device_update_extbtn(device,extbtnp,value);
       
   } else if (value) { // twostate true
     if (device->state&btnid) return;
@@ -50,6 +65,8 @@ static void inmgr_device_update_state(struct inmgr_device *device,int btnid,int
       if (!device->playerid) inmgr_device_select_playerid(device);
       inmgr.playerv[device->playerid].state|=btnid;
       inmgr.playerv[0].state|=btnid;
+      inmgr_player_pressed(inmgr.playerv+device->playerid);
+      inmgr_player_pressed(inmgr.playerv);
     }
     
   } else { // twostate false
@@ -58,6 +75,8 @@ static void inmgr_device_update_state(struct inmgr_device *device,int btnid,int
     if (device->enable&&device->playerid) {
       inmgr.playerv[device->playerid].state&=~btnid;
       inmgr.playerv[0].state&=~btnid;
+      inmgr_player_released(inmgr.playerv+device->playerid);
+      inmgr_player_released(inmgr.playerv);
     }
   }
 }
@@ -81,20 +100,13 @@ static void inmgr_button_update(struct inmgr_device *device,struct inmgr_button
         int dstvalue=((srcvalue>=button->srclo)&&(srcvalue<=button->srchi))?1:0;
         if (dstvalue==button->dstvalue) return;
         button->dstvalue=dstvalue;
-        inmgr_device_update_state(device,button->dstbtnid,dstvalue);
+        if (button->extbtnp>=0) inmgr_device_update_extbtn(device,button->extbtnp,dstvalue);
+        else inmgr_device_update_state(device,button->dstbtnid,dstvalue);
       } break;
       
     case INMGR_BUTTON_MODE_THREEWAY: {
-        int dstvalue,btnidlo,btnidhi;
-        if (button->srclo<=button->srchi) {
-          dstvalue=(srcvalue<=button->srclo)?-1:(srcvalue>=button->srchi)?1:0;
-          btnidlo=(button->dstbtnid&(INMGR_BTN_LEFT|INMGR_BTN_UP));
-          btnidhi=(button->dstbtnid&(INMGR_BTN_RIGHT|INMGR_BTN_DOWN));
-        } else {
-          dstvalue=(srcvalue<=button->srchi)?-1:(srcvalue>=button->srclo)?1:0;
-          btnidhi=(button->dstbtnid&(INMGR_BTN_LEFT|INMGR_BTN_UP));
-          btnidlo=(button->dstbtnid&(INMGR_BTN_RIGHT|INMGR_BTN_DOWN));
-        }
+        int dstvalue=(srcvalue<=button->twlo)?-1:(srcvalue>=button->twhi)?1:0;
+        int btnidlo=button->btnidlo,btnidhi=button->btnidhi;
         if (dstvalue==button->dstvalue) return;
         button->dstvalue=dstvalue;
         switch (dstvalue) {
@@ -134,11 +146,10 @@ static void inmgr_button_update(struct inmgr_device *device,struct inmgr_button
       
     case INMGR_BUTTON_MODE_LINEAR: {
         // LINEAR is only allowed for extbtn, because we need two ranges.
-        int extbtnp=inmgr_extbtnv_search(button->dstbtnid);
-        if (extbtnp<0) break;
-        const struct inmgr_extbtn *extbtn=inmgr.extbtnv+extbtnp;
+        if (button->extbtnp<0) break;
+        const struct inmgr_extbtn *extbtn=inmgr.extbtnv+button->extbtnp;
         int dstvalue=((srcvalue-button->srclo)*(extbtn->hi-extbtn->lo))/(button->srchi-button->srclo);
-        inmgr_device_update_state(device,button->dstbtnid,dstvalue);
+        inmgr_device_update_extbtn(device,button->extbtnp,dstvalue);
       } break;
   }
 }
@@ -155,9 +166,18 @@ void inmgr_event(int devid,int btnid,int value) {
   
   // If this is a mapped button, apply it.
   int state=0;
-  struct inmgr_device *device=inmgr_device_by_devid(devid);
+  struct inmgr_device *device;
+  if (
+    !inmgr.lookup_search&&
+    (inmgr.devicep_recent<inmgr.devicec)&&
+    (inmgr.devicev[inmgr.devicep_recent].devid==devid)
+  ) {
+    device=inmgr.devicev+inmgr.devicep_recent;
+  } else if ((device=inmgr_device_by_devid(devid))) {
+    inmgr.devicep_recent=device-inmgr.devicev;
+  }
   if (device) {
-    struct inmgr_button *button=inmgr_button_by_srcbtnid(device,btnid);
+    struct inmgr_button *button=inmgr_button_lookup(device,btnid);
     if (button) {
       inmgr_button_update(device,button,value);
     }
@@ -168,6 +188,17 @@ void inmgr_event(int devid,int btnid,int value) {
   inmgr_broadcast(devid,btnid,value,state);
 }
 
+void inmgr_event_timed(int devid,int btnid,int value,int64_t time_ns) {
+  inmgr.event_time_ns=time_ns;
+  inmgr_event(devid,btnid,value);
+  inmgr.event_time_ns=0;
+}
+
+int64_t inmgr_take_press_time(int playerid) {
+  if ((playerid<0)||(playerid>inmgr.playerc)) return 0;
+  return __atomic_exchange_n(&inmgr.playerv[playerid].press_time_ns,0,__ATOMIC_RELAXED);
+}
+
 /* Premapped event from client.
  */
  
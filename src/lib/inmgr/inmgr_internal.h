@@ -11,6 +11,12 @@
 
 #define INMGR_EXTBTN_LIMIT 16
 
+/* Devices' source buttons are indexed by the high 16 bits of srcbtnid (evdev type, HID page), one dense page per.
+ * Types whose codes span more than INMGR_PAGE_SIZE_LIMIT, or beyond INMGR_PAGE_LIMIT of them, fall back to binary search.
+ */
+#define INMGR_PAGE_LIMIT 4
+#define INMGR_PAGE_SIZE_LIMIT 1024
+
 /* The various modes are only applicable for specific dstbtnid.
  */
 #define INMGR_BUTTON_MODE_NOOP 0
@@ -39,8 +45,10 @@ extern struct inmgr {
   struct inmgr_player {
     int state; // 16 bits.
     int extbtnv[INMGR_EXTBTN_LIMIT];
+    int64_t press_time_ns; // Source time of the earliest press not yet taken, zero if none.
   } playerv[1+INMGR_PLAYER_LIMIT];
   int playerc; // Not counting player zero.
+  int64_t event_time_ns; // Source time of the event in progress, if the driver supplied one.
   
   // Live devices.
   struct inmgr_device {
@@ -63,8 +71,17 @@ extern struct inmgr {
       int dstvalue;
       int dstbtnid;
       int hidusage,lo,hi; // Addl details retained for live remapping or inspection.
+      // Precomputed by inmgr_device_compile():
+      int extbtnp; // LINEAR, or TWOSTATE to an extbtn. -1 if not applicable.
+      int twlo,twhi,btnidlo,btnidhi; // THREEWAY, thresholds in ascending order.
     } *buttonv;
     int buttonc,buttona;
+    int compiled; // Zero if (pagev) and the precomputed button fields need rebuilt.
+    struct inmgr_page {
+      int type,lo,c;
+      uint16_t *v; // Index in (buttonv) plus one, or zero if unmapped.
+    } pagev[INMGR_PAGE_LIMIT];
+    int pagec;
   } *devicev;
   int devicec,devicea;
   
@@ -75,6 +92,16 @@ extern struct inmgr {
   } *listenerv;
   int listenerc,listenera;
   int listenerid_next;
+  int devicep_recent; // Cache for inmgr_event(), validate before using.
+  int lookup_search; // Nonzero to bypass (pagev) and the device cache, for benchmarking.
+  
+  // inmgr_defer(), signals and broadcasts wait here for inmgr_flush_deferred().
+  int defer;
+  struct inmgr_deferred {
+    int devid; // Zero for signals.
+    int btnid,value,state;
+  } *deferredv;
+  int deferredc,deferreda;
   
   // Templates, matching the config file.
   struct inmgr_tm {
@@ -101,6 +128,7 @@ int inmgr_extbtnv_search(int btnid);
 int inmgr_signalv_search(int btnid);
 void inmgr_broadcast(int devid,int btnid,int value,int state);
 void inmgr_signal(int btnid);
+void inmgr_deferred_add(int devid,int btnid,int value,int state);
 
 // inmgr_device.c
 void inmgr_device_cleanup(struct inmgr_device *device);
@@ -108,6 +136,8 @@ int inmgr_devicev_search(int devid);
 struct inmgr_device *inmgr_device_by_devid(int devid);
 int inmgr_device_buttonv_search(const struct inmgr_device *device,int srcbtnid);
 struct inmgr_button *inmgr_button_by_srcbtnid(const struct inmgr_device *device,int srcbtnid);
+void inmgr_device_compile(struct inmgr_device *device);
+struct inmgr_button *inmgr_button_lookup(struct inmgr_device *device,int srcbtnid); // Fast, for events. Compiles if needed.
 int inmgr_device_set_name(struct inmgr_device *device,const char *src,int srcc);
 
 // inmgr_connect.c
@@ -92,14 +92,26 @@ static inline void eh_render_upload_texture(struct eh_render *render,const void
  
 void eh_render_commit(struct eh_render *render) {
   if (!render->srcfb) return;
+  if (render->headless) {
+    // Convert anyway, so headless runs cost about what real ones do.
+    if (render->fbrgb) {
+      int64_t t0=eh_now_mono_ns();
+      render->fbcvt(render->fbrgb,render->srcfb,render);
+      eh_perf_add(&eh.perf,EH_PERF_FBCVT,t0);
+    }
+    return;
+  }
   if (!render->texid) return;
   
   eh_require_output_bounds(render);
   glViewport(0,0,eh.video->w,eh.video->h);
   
+  int64_t t0=eh_now_mono_ns();
   glBindTexture(GL_TEXTURE_2D,render->texid);
   if (render->fbrgb) {
     render->fbcvt(render->fbrgb,render->srcfb,render);
+    eh_perf_add(&eh.perf,EH_PERF_FBCVT,t0);
+    t0=eh_now_mono_ns();
     eh_render_upload_texture(render,render->fbrgb);
   } else {
     eh_render_upload_texture(render,render->srcfb);
@@ -135,4 +147,5 @@ void eh_render_commit(struct eh_render *render) {
   glVertexAttribPointer(0,2,GL_FLOAT,0,sizeof(positionv[0]),positionv);
   glVertexAttribPointer(1,2,GL_UNSIGNED_BYTE,0,sizeof(texcoordv[0]),texcoordv);
   glDrawArrays(GL_TRIANGLE_STRIP,0,4);
+  eh_perf_add(&eh.perf,EH_PERF_UPLOAD,t0);
 }
@@ -52,7 +52,12 @@ struct eh_render {
   GLfloat pixelRefresh;
   
   int gx_in_progress;
-  int auto_collect_metadata_clock;
+  int headless; // Video driver has no GL context.
+  
+  // Performance overlay, initialized at first use.
+  GLuint overlay_programid;
+  void *overlay_vtxv;
+  int overlay_failed;
 };
 
 /* Main entry point for framebuffer conversion and delivery.
@@ -70,4 +75,14 @@ void eh_fbcvt_rgb16swap(uint8_t *dst,const uint8_t *src,struct eh_render *render
 
 void *eh_render_chr16(uint16_t mask); // => uint8_t(*)(uint16_t), channel reader from 16 bits
 
+/* Shader helpers, attach to or link an existing program.
+ */
+int eh_render_compile(GLuint programid,const char *src,int srcc,int type);
+int eh_render_link(GLuint programid);
+
+/* Draw the frame timing graph on top of whatever's in the framebuffer, see eh_perf.h.
+ */
+void eh_render_overlay(struct eh_render *render,const struct eh_perf *perf);
+void eh_render_overlay_cleanup(struct eh_render *render);
+
 #endif
@@ -1,11 +1,13 @@
 #include "eh_render_internal.h"
 #include "eh_screencap.h"
+#include "eh_stream.h"
 
 /* Delete.
  */
 
 void eh_render_del(struct eh_render *render) {
   if (!render) return;
+  eh_render_overlay_cleanup(render);
   if (render->texid) glDeleteTextures(1,&render->texid);
   if (render->fbrgb) free(render->fbrgb);
   if (render->cropbuf) free(render->cropbuf);
@@ -48,16 +50,18 @@ static int eh_render_init_conversion(struct eh_render *render) {
   if (!eh.delegate.video_width) return 0;
   
   // Allocate the texture.
-  glGenTextures(1,&render->texid);
-  if (!render->texid) {
+  if (!render->headless) {
     glGenTextures(1,&render->texid);
-    if (!render->texid) return -1;
+    if (!render->texid) {
+      glGenTextures(1,&render->texid);
+      if (!render->texid) return -1;
+    }
+    glBindTexture(GL_TEXTURE_2D,render->texid);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
   }
-  glBindTexture(GL_TEXTURE_2D,render->texid);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
   
   // If it's an indexed format, initialize the color table to grayscale. Just in case they forget to.
   uint8_t *dst=render->ctab;
@@ -164,7 +168,7 @@ static const char eh_fshader[]=
 /* Compile shader.
  */
  
-static int eh_render_compile(struct eh_render *render,const char *src,int srcc,int type) {
+int eh_render_compile(GLuint programid,const char *src,int srcc,int type) {
 
   char version[256];
   int versionc;
@@ -181,7 +185,7 @@ static int eh_render_compile(struct eh_render *render,const char *src,int srcc,i
   GLint status=0;
   glGetShaderiv(id,GL_COMPILE_STATUS,&status);
   if (status) {
-    glAttachShader(render->programid,id);
+    glAttachShader(programid,id);
     glDeleteShader(id);
     return 0;
   }
@@ -209,22 +213,22 @@ static int eh_render_compile(struct eh_render *render,const char *src,int srcc,i
 /* Link shader.
  */
  
-static int eh_render_link(struct eh_render *render) {
+int eh_render_link(GLuint programid) {
 
-  glLinkProgram(render->programid);
+  glLinkProgram(programid);
   GLint status=0;
-  glGetProgramiv(render->programid,GL_LINK_STATUS,&status);
+  glGetProgramiv(programid,GL_LINK_STATUS,&status);
   if (status) return 0;
 
   /* Link failed. */
   int err=-1;
   GLint loga=0;
-  glGetProgramiv(render->programid,GL_INFO_LOG_LENGTH,&loga);
+  glGetProgramiv(programid,GL_INFO_LOG_LENGTH,&loga);
   if ((loga>0)&&(loga<INT_MAX)) {
     char *log=malloc(loga);
     if (log) {
       GLint logc=0;
-      glGetProgramInfoLog(render->programid,loga,&logc,log);
+      glGetProgramInfoLog(programid,loga,&logc,log);
       while (logc&&((unsigned char)log[logc-1]<=0x20)) logc--;
       if ((logc>0)&&(logc<=loga)) {
         fprintf(stderr,"Error linking shader:\n%.*s\n",logc,log);
@@ -242,13 +246,13 @@ static int eh_render_link(struct eh_render *render) {
 static int eh_render_init_shader(struct eh_render *render) {
 
   if (!(render->programid=glCreateProgram())) return -1;
-  if (eh_render_compile(render,eh_vshader,sizeof(eh_vshader),GL_VERTEX_SHADER)<0) return -1;
-  if (eh_render_compile(render,eh_fshader,sizeof(eh_fshader),GL_FRAGMENT_SHADER)<0) return -1;
+  if (eh_render_compile(render->programid,eh_vshader,sizeof(eh_vshader),GL_VERTEX_SHADER)<0) return -1;
+  if (eh_render_compile(render->programid,eh_fshader,sizeof(eh_fshader),GL_FRAGMENT_SHADER)<0) return -1;
   
   glBindAttribLocation(render->programid,0,"aposition");
   glBindAttribLocation(render->programid,1,"atexcoord");
   
-  if (eh_render_link(render)<0) return -1;
+  if (eh_render_link(render->programid)<0) return -1;
   
   glUseProgram(render->programid);
   render->loc_pixelRefresh=glGetUniformLocation(render->programid,"pixelRefresh");
@@ -265,13 +269,14 @@ struct eh_render *eh_render_new() {
   
   render->dstr_dirty=1;
   render->pixelRefresh=1.0f;
+  render->headless=eh.video->type->no_gl;
   
   if (eh_render_init_conversion(render)<0) {
     eh_render_del(render);
     return 0;
   }
   
-  if (eh_render_init_shader(render)<0) {
+  if (!render->headless&&(eh_render_init_shader(render)<0)) {
     eh_render_del(render);
     return 0;
   }
@@ -290,17 +295,32 @@ void eh_render_before(struct eh_render *render) {
   render->srcfb=0;
 }
 
+/* Finish the video driver's frame, with the overlay if enabled.
+ */
+ 
+static void eh_render_end(struct eh_render *render) {
+  if (eh.perf.overlay) eh_render_overlay(render,&eh.perf);
+  int64_t t0=eh_now_mono_ns();
+  eh.video->type->end(eh.video);
+  eh_perf_add(&eh.perf,EH_PERF_SWAP,t0);
+}
+
 void eh_render_after(struct eh_render *render) {
   if (render->gx_in_progress) {
     render->gx_in_progress=0;
-    eh.video->type->end(eh.video);
+    eh_render_end(render);
   }
   if (render->srcfb) {
     eh.video->type->begin(eh.video);
+    int64_t bmt=eh_benchmark_begin(&eh.benchmark);
     eh_render_commit(render);
-    eh.video->type->end(eh.video);
+    eh_benchmark_end(&eh.benchmark.commit_acc,bmt);
+    eh_render_end(render);
+    if (eh.stream) eh_stream_frame(eh.stream,render);
     if (eh.auto_collect_metadata) { // TODO Do we need to support GX clients too? Not sure we use that at all.
-      eh_auto_collect_metadata_fb(render->srcfb);
+      if (eh_auto_collect_metadata_fb(&eh.acm,render->srcfb,render->ctab)==-1) {
+        fprintf(stderr,"%s: Failed to collect screencap.\n",eh.exename);
+      }
     }
     render->srcfb=0;
   }
@@ -336,7 +356,7 @@ void eh_video_end() {
     eh.screencap_requested=0;
     eh_screencap_send_from_opengl();
   }
-  eh.video->type->end(eh.video);
+  eh_render_end(eh.render);
 }
 
 void eh_video_get_size(int *w,int *h) {
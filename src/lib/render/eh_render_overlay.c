@@ -0,0 +1,185 @@
+#include "eh_render_internal.h"
+
+/* Frame timing graph, see eh_perf.h.
+ * Flat-shaded triangles in normalized device coordinates, with their own little shader.
+ */
+
+#define EH_OVERLAY_COLUMN_COUNT (EH_PERF_RING_SIZE-1)
+#define EH_OVERLAY_QUADS_PER_COLUMN (1+EH_PERF_STAGE_COUNT)
+#define EH_OVERLAY_VERTEX_LIMIT ((EH_OVERLAY_COLUMN_COUNT*EH_OVERLAY_QUADS_PER_COLUMN+1)*6)
+
+// Graph occupies the bottom of the screen, and its top is two frame budgets.
+#define EH_OVERLAY_BOTTOM -1.0f
+#define EH_OVERLAY_TOP    -0.4f
+
+struct eh_overlay_vertex {
+  GLfloat x,y;
+  GLubyte r,g,b,a;
+};
+
+static const GLubyte eh_overlay_stage_colors[EH_PERF_STAGE_COUNT][3]={
+  {0xff,0xff,0x00}, // input
+  {0x00,0xff,0xff}, // video
+  {0xff,0x00,0xff}, // fakews
+  {0x00,0xff,0x00}, // update
+  {0xff,0x80,0x00}, // fbcvt
+  {0x40,0x60,0xff}, // upload
+  {0xff,0x00,0x00}, // swap
+};
+
+static const char eh_overlay_vshader[]=
+  "attribute vec2 aposition;\n"
+  "attribute vec4 acolor;\n"
+  "varying vec4 vcolor;\n"
+  "void main() {\n"
+  "  gl_Position=vec4(aposition,0.0,1.0);\n"
+  "  vcolor=acolor;\n"
+  "}\n"
+"";
+
+static const char eh_overlay_fshader[]=
+  "varying vec4 vcolor;\n"
+  "void main() {\n"
+  "  gl_FragColor=vcolor;\n"
+  "}\n"
+"";
+
+/* Cleanup.
+ */
+
+void eh_render_overlay_cleanup(struct eh_render *render) {
+  if (render->overlay_programid) glDeleteProgram(render->overlay_programid);
+  if (render->overlay_vtxv) free(render->overlay_vtxv);
+  render->overlay_programid=0;
+  render->overlay_vtxv=0;
+}
+
+/* Init, lazily on the first draw.
+ */
+
+static int eh_render_overlay_init(struct eh_render *render) {
+  if (!(render->overlay_vtxv=malloc(sizeof(struct eh_overlay_vertex)*EH_OVERLAY_VERTEX_LIMIT))) return -1;
+  if (!(render->overlay_programid=glCreateProgram())) return -1;
+  if (eh_render_compile(render->overlay_programid,eh_overlay_vshader,sizeof(eh_overlay_vshader),GL_VERTEX_SHADER)<0) return -1;
+  if (eh_render_compile(render->overlay_programid,eh_overlay_fshader,sizeof(eh_overlay_fshader),GL_FRAGMENT_SHADER)<0) return -1;
+  glBindAttribLocation(render->overlay_programid,0,"aposition");
+  glBindAttribLocation(render->overlay_programid,1,"acolor");
+  if (eh_render_link(render->overlay_programid)<0) return -1;
+  return 0;
+}
+
+/* Add one quad.
+ */
+
+static struct eh_overlay_vertex *eh_overlay_quad(
+  struct eh_overlay_vertex *v,
+  GLfloat l,GLfloat b,GLfloat r,GLfloat t,
+  GLubyte cr,GLubyte cg,GLubyte cb,GLubyte ca
+) {
+  v[0]=(struct eh_overlay_vertex){l,b,cr,cg,cb,ca};
+  v[1]=(struct eh_overlay_vertex){r,b,cr,cg,cb,ca};
+  v[2]=(struct eh_overlay_vertex){l,t,cr,cg,cb,ca};
+  v[3]=v[2];
+  v[4]=v[1];
+  v[5]=(struct eh_overlay_vertex){r,t,cr,cg,cb,ca};
+  return v+6;
+}
+
+/* Save and restore a vertex attribute's array, around our draw.
+ */
+
+struct eh_overlay_attrib {
+  GLint enabled,size,type,normalized,stride,buffer;
+  void *pointer;
+};
+
+static void eh_overlay_attrib_save(struct eh_overlay_attrib *attrib,GLuint index) {
+  glGetVertexAttribiv(index,GL_VERTEX_ATTRIB_ARRAY_ENABLED,&attrib->enabled);
+  glGetVertexAttribiv(index,GL_VERTEX_ATTRIB_ARRAY_SIZE,&attrib->size);
+  glGetVertexAttribiv(index,GL_VERTEX_ATTRIB_ARRAY_TYPE,&attrib->type);
+  glGetVertexAttribiv(index,GL_VERTEX_ATTRIB_ARRAY_NORMALIZED,&attrib->normalized);
+  glGetVertexAttribiv(index,GL_VERTEX_ATTRIB_ARRAY_STRIDE,&attrib->stride);
+  glGetVertexAttribiv(index,GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING,&attrib->buffer);
+  glGetVertexAttribPointerv(index,GL_VERTEX_ATTRIB_ARRAY_POINTER,&attrib->pointer);
+}
+
+static void eh_overlay_attrib_restore(const struct eh_overlay_attrib *attrib,GLuint index) {
+  glBindBuffer(GL_ARRAY_BUFFER,attrib->buffer);
+  glVertexAttribPointer(index,attrib->size,attrib->type,attrib->normalized,attrib->stride,attrib->pointer);
+  if (!attrib->enabled) glDisableVertexAttribArray(index);
+}
+
+/* Draw.
+ */
+
+void eh_render_overlay(struct eh_render *render,const struct eh_perf *perf) {
+  if (render->headless||render->overlay_failed) return;
+  if (!render->overlay_programid) {
+    if (eh_render_overlay_init(render)<0) {
+      fprintf(stderr,"%s: Failed to initialize performance overlay.\n",eh.exename);
+      eh_render_overlay_cleanup(render);
+      render->overlay_failed=1;
+      return;
+    }
+  }
+
+  double budget_ns=eh.clock.frame_time_ns;
+  if (budget_ns<=0.0) budget_ns=1000000000.0/60.0;
+  GLfloat yscale=(EH_OVERLAY_TOP-EH_OVERLAY_BOTTOM)/(budget_ns*2.0);
+  GLfloat colw=2.0f/EH_OVERLAY_COLUMN_COUNT;
+  struct eh_overlay_vertex *v=render->overlay_vtxv;
+  int framec=eh_perf_get_frame_count(perf);
+  GLfloat x=1.0f-framec*colw;
+  int i=0;
+  for (;i<framec;i++,x+=colw) {
+    const struct eh_perf_frame *frame=eh_perf_get_frame(perf,i);
+    GLfloat t=EH_OVERLAY_BOTTOM+frame->interval_ns*yscale;
+    if (t>EH_OVERLAY_TOP) t=EH_OVERLAY_TOP;
+    v=eh_overlay_quad(v,x,EH_OVERLAY_BOTTOM,x+colw,t,0x60,0x60,0x60,0xa0);
+    GLfloat b=EH_OVERLAY_BOTTOM;
+    int stage=0;
+    for (;stage<EH_PERF_STAGE_COUNT;stage++) {
+      if (b>=EH_OVERLAY_TOP) break;
+      t=b+frame->stagev[stage]*yscale;
+      if (t>EH_OVERLAY_TOP) t=EH_OVERLAY_TOP;
+      const GLubyte *color=eh_overlay_stage_colors[stage];
+      v=eh_overlay_quad(v,x,b,x+colw,t,color[0],color[1],color[2],0xe0);
+      b=t;
+    }
+  }
+  GLfloat budgety=(EH_OVERLAY_BOTTOM+EH_OVERLAY_TOP)*0.5f;
+  GLfloat lineh=(eh.video->h>0)?(2.0f/eh.video->h):0.005f;
+  v=eh_overlay_quad(v,-1.0f,budgety,1.0f,budgety+lineh,0xff,0xff,0xff,0xff);
+  int vtxc=v-(struct eh_overlay_vertex*)render->overlay_vtxv;
+
+  // GX clients draw after us with whatever state we leave, so put back everything we touch.
+  GLint program=0,viewport[4]={0},blendsrc=GL_ONE,blenddst=GL_ZERO,buffer=0;
+  GLboolean blend=glIsEnabled(GL_BLEND);
+  glGetIntegerv(GL_CURRENT_PROGRAM,&program);
+  glGetIntegerv(GL_VIEWPORT,viewport);
+  glGetIntegerv(GL_BLEND_SRC_ALPHA,&blendsrc);
+  glGetIntegerv(GL_BLEND_DST_ALPHA,&blenddst);
+  glGetIntegerv(GL_ARRAY_BUFFER_BINDING,&buffer);
+  struct eh_overlay_attrib attribv[2];
+  eh_overlay_attrib_save(attribv+0,0);
+  eh_overlay_attrib_save(attribv+1,1);
+
+  glViewport(0,0,eh.video->w,eh.video->h);
+  glBindBuffer(GL_ARRAY_BUFFER,0);
+  glUseProgram(render->overlay_programid);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(0,2,GL_FLOAT,0,sizeof(struct eh_overlay_vertex),&((struct eh_overlay_vertex*)render->overlay_vtxv)->x);
+  glVertexAttribPointer(1,4,GL_UNSIGNED_BYTE,1,sizeof(struct eh_overlay_vertex),&((struct eh_overlay_vertex*)render->overlay_vtxv)->r);
+  glDrawArrays(GL_TRIANGLES,0,vtxc);
+
+  eh_overlay_attrib_restore(attribv+0,0);
+  eh_overlay_attrib_restore(attribv+1,1);
+  glBindBuffer(GL_ARRAY_BUFFER,buffer);
+  glBlendFunc(blendsrc,blenddst);
+  if (!blend) glDisable(GL_BLEND);
+  glUseProgram(program);
+  glViewport(viewport[0],viewport[1],viewport[2],viewport[3]);
+}
@@ -1,6 +1,306 @@
 #include "eh_render_internal.h"
 #include "eh_screencap.h"
 #include "opt/png/png.h"
+#include <pthread.h>
+#if USE_shmring
+  #include "opt/shmring/shmring.h"
+#endif
+
+static struct png_image *eh_screencap_snapshot_fb(const void *fb,const struct eh_screencap_format *format);
+static struct png_image *eh_screencap_snapshot_opengl(int w,int h);
+static int eh_screencap_format_is_pngable(uint8_t *depth,uint8_t *colortype,const struct eh_screencap_format *format);
+
+/* Background encoder.
+ * The main thread copies the frame into (pixels), which we reuse across screencaps.
+ * Worker encodes it, and the main thread sends the result at its next eh_screencap_update().
+ * Only one screencap in flight at a time. Requests that arrive while busy wait for the next frame.
+ */
+ 
+#define EH_SCREENCAP_IDLE     0 /* Main owns everything. */
+#define EH_SCREENCAP_PENDING  1 /* Snapshot ready, worker owns (image). */
+#define EH_SCREENCAP_ENCODING 2
+#define EH_SCREENCAP_DONE     3 /* Main owns (serial). */
+ 
+static struct eh_screencap_worker {
+  pthread_t thread;
+  pthread_mutex_t mtx;
+  pthread_cond_t cond;
+  int running;
+  int quit;
+  int state;
+  void *pixels;
+  int pixelsa;
+  struct png_image *image;
+  void *serial;
+  int serialc;
+  int64_t snapshot_us;
+  int64_t encode_us;
+} eh_screencap_worker={
+  .mtx=PTHREAD_MUTEX_INITIALIZER,
+  .cond=PTHREAD_COND_INITIALIZER,
+};
+
+static void *eh_screencap_worker_main(void *dummy) {
+  struct eh_screencap_worker *worker=&eh_screencap_worker;
+  pthread_mutex_lock(&worker->mtx);
+  while (1) {
+    while (!worker->quit&&(worker->state!=EH_SCREENCAP_PENDING)) {
+      pthread_cond_wait(&worker->cond,&worker->mtx);
+    }
+    if (worker->quit) break;
+    worker->state=EH_SCREENCAP_ENCODING;
+    struct png_image *image=worker->image;
+    worker->image=0;
+    pthread_mutex_unlock(&worker->mtx);
+    
+    int64_t starttime=eh_now_real_us();
+    void *serial=0;
+    int serialc=png_encode_level(&serial,image,eh.screencap_level);
+    int64_t elapsed=eh_now_real_us()-starttime;
+    png_image_del(image);
+    
+    pthread_mutex_lock(&worker->mtx);
+    if (serialc>=0) {
+      worker->serial=serial;
+      worker->serialc=serialc;
+      worker->encode_us=elapsed;
+      worker->state=EH_SCREENCAP_DONE;
+    } else {
+      fprintf(stderr,"%s: Failed to encode screencap.\n",eh.exename);
+      if (serial) free(serial);
+      worker->state=EH_SCREENCAP_IDLE;
+    }
+  }
+  pthread_mutex_unlock(&worker->mtx);
+  return 0;
+}
+
+/* Hand a fresh snapshot to the worker, starting it if needed.
+ * Caller must have confirmed the worker is idle.
+ */
+ 
+static int eh_screencap_submit(struct png_image *image,int64_t snapshot_us) {
+  struct eh_screencap_worker *worker=&eh_screencap_worker;
+  if (!worker->running) {
+    worker->quit=0;
+    if (pthread_create(&worker->thread,0,eh_screencap_worker_main,0)) {
+      png_image_del(image);
+      return -1;
+    }
+    worker->running=1;
+  }
+  pthread_mutex_lock(&worker->mtx);
+  worker->image=image;
+  worker->snapshot_us=snapshot_us;
+  worker->state=EH_SCREENCAP_PENDING;
+  pthread_cond_signal(&worker->cond);
+  pthread_mutex_unlock(&worker->mtx);
+  return 0;
+}
+
+/* Nonzero if the worker can accept a new snapshot.
+ * If not, we re-raise the request so the next frame tries again.
+ */
+ 
+static int eh_screencap_ready_for_snapshot() {
+  struct eh_screencap_worker *worker=&eh_screencap_worker;
+  pthread_mutex_lock(&worker->mtx);
+  int idle=(worker->state==EH_SCREENCAP_IDLE);
+  pthread_mutex_unlock(&worker->mtx);
+  if (!idle) eh.screencap_requested=1;
+  return idle;
+}
+
+/* Grow the reusable snapshot buffer.
+ * Only while idle, the worker might be reading it otherwise.
+ */
+ 
+static int eh_screencap_require_pixels(int len) {
+  struct eh_screencap_worker *worker=&eh_screencap_worker;
+  if (len<1) return -1;
+  if (len<=worker->pixelsa) return 0;
+  void *nv=malloc(len);
+  if (!nv) return -1;
+  if (worker->pixels) free(worker->pixels);
+  worker->pixels=nv;
+  worker->pixelsa=len;
+  return 0;
+}
+
+/* Main-loop update and shutdown.
+ */
+ 
+void eh_screencap_update() {
+  struct eh_screencap_worker *worker=&eh_screencap_worker;
+  if (!worker->running) return;
+  pthread_mutex_lock(&worker->mtx);
+  if (worker->state!=EH_SCREENCAP_DONE) {
+    pthread_mutex_unlock(&worker->mtx);
+    return;
+  }
+  void *serial=worker->serial;
+  int serialc=worker->serialc;
+  worker->serial=0;
+  worker->serialc=0;
+  worker->state=EH_SCREENCAP_IDLE;
+  pthread_mutex_unlock(&worker->mtx);
+  fprintf(stderr,
+    "%s: Screencap %d bytes. Snapshot %d us on main thread, encode %d us in background at level %d.\n",
+    eh.exename,serialc,(int)worker->snapshot_us,(int)worker->encode_us,eh.screencap_level
+  );
+  if (fakews_is_connected(eh.fakews)) {
+    fakews_send(eh.fakews,2,serial,serialc);
+  }
+  free(serial);
+}
+
+void eh_screencap_quit() {
+  struct eh_screencap_worker *worker=&eh_screencap_worker;
+  if (worker->running) {
+    pthread_mutex_lock(&worker->mtx);
+    worker->quit=1;
+    pthread_cond_signal(&worker->cond);
+    pthread_mutex_unlock(&worker->mtx);
+    pthread_join(worker->thread,0);
+    worker->running=0;
+  }
+  if (worker->image) png_image_del(worker->image);
+  worker->image=0;
+  if (worker->serial) free(worker->serial);
+  worker->serial=0;
+  if (worker->pixels) free(worker->pixels);
+  worker->pixels=0;
+  worker->pixelsa=0;
+  worker->state=EH_SCREENCAP_IDLE;
+  #if USE_shmring
+    shmring_del(eh.shmring);
+  #endif
+  eh.shmring=0;
+  eh.shmring_ready=0;
+}
+
+/* Shared-memory handoff.
+ * If Romassist is on this host and opened our ring, we copy the frame in and tell it which one.
+ * Romassist does the encoding, and our worker thread stays idle.
+ * Anything that doesn't fit or doesn't convert easily falls back to PNG.
+ */
+ 
+void eh_screencap_shm_connect() {
+  #if USE_shmring
+    eh.shmring_ready=0;
+    if (!eh.screencap_shm) return;
+    if (!fakews_is_connected(eh.fakews)) return;
+    int slotsize;
+    if (eh.delegate.video_width) {
+      slotsize=eh.delegate.video_width*eh.delegate.video_height*4;
+    } else if (eh.video) {
+      slotsize=eh.video->w*eh.video->h*3;
+    } else {
+      return; // Standby connects before video exists. We'll get another chance after driver init.
+    }
+    // A new peer means a new ring: The last one unlinked the name when it opened it.
+    shmring_del(eh.shmring);
+    if (!(eh.shmring=shmring_new(slotsize))) {
+      fprintf(stderr,"%s: Failed to create shared framebuffer. Screencaps will go out as PNG.\n",eh.exename);
+      return;
+    }
+    char msg[128];
+    int msgc=snprintf(msg,sizeof(msg),"{\"id\":\"shmring\",\"name\":\"%s\"}",shmring_get_name(eh.shmring));
+    if ((msgc>0)&&(msgc<sizeof(msg))) fakews_send(eh.fakews,1,msg,msgc);
+  #endif
+}
+
+void eh_screencap_shm_ack() {
+  if (eh.shmring) eh.shmring_ready=1;
+}
+
+void eh_screencap_shm_disconnect() {
+  eh.shmring_ready=0;
+}
+
+#if USE_shmring
+
+static int eh_screencap_shm_send(int64_t starttime) {
+  int frameid=shmring_commit(eh.shmring);
+  if (frameid<0) return -1;
+  char msg[64];
+  int msgc=snprintf(msg,sizeof(msg),"{\"id\":\"shmScreencap\",\"frame\":%d}",frameid);
+  if ((msgc<1)||(msgc>=sizeof(msg))) return -1;
+  if (fakews_send(eh.fakews,1,msg,msgc)<0) return -1;
+  fprintf(stderr,"%s: Screencap %d via shared memory, %d us on main thread.\n",eh.exename,frameid,(int)(eh_now_real_us()-starttime));
+  return 0;
+}
+
+static int eh_screencap_shm_fb(const void *fb,const struct eh_screencap_format *format) {
+  if (!eh.shmring_ready) return -1;
+  int64_t starttime=eh_now_real_us();
+  struct shmring_frame *frame=0;
+  uint8_t *dst=shmring_begin(&frame,eh.shmring);
+  if (!dst) return -1;
+  int dsta=shmring_get_slot_size(eh.shmring);
+  memset(frame,0,sizeof(struct shmring_frame));
+  frame->w=format->w;
+  frame->h=format->h;
+  
+  if (eh_screencap_format_is_pngable(&frame->depth,&frame->colortype,format)) {
+    frame->stride=eh_screencap_calculate_stride(format);
+    if ((frame->len=frame->stride*format->h)>dsta) return -1;
+    memcpy(dst,fb,frame->len);
+    if (frame->colortype==3) {
+      if (format->ctab) {
+        frame->ctabc=1<<frame->depth;
+        memcpy(frame->ctab,format->ctab,frame->ctabc*3);
+      } else {
+        frame->colortype=0;
+      }
+    }
+    
+  } else if (format->format==EH_VIDEO_FORMAT_RGB32) {
+    // Copy verbatim and let Romassist unpack it. Masks must be whole bytes, same as eh_screencap_from_rgb32.
+    uint32_t tmp;
+    #define shift(ch) if (!format->ch##mask) return -1; tmp=format->ch##mask; while (!(tmp&1)) { tmp>>=1; frame->ch##shift++; } if (tmp!=0xff) return -1;
+    shift(r)
+    shift(g)
+    shift(b)
+    #undef shift
+    frame->rgb32=1;
+    frame->stride=format->w<<2;
+    if ((frame->len=frame->stride*format->h)>dsta) return -1;
+    memcpy(dst,fb,frame->len);
+    
+  } else if (eh.render->fbcvt&&(eh.render->fb_gl_format==GL_RGB)&&(eh.render->fb_gl_type==GL_UNSIGNED_BYTE)) {
+    frame->depth=8;
+    frame->colortype=2;
+    frame->stride=format->w*3;
+    if ((frame->len=frame->stride*format->h)>dsta) return -1;
+    eh.render->fbcvt(dst,fb,eh.render);
+    
+  } else {
+    return -1;
+  }
+  return eh_screencap_shm_send(starttime);
+}
+
+static int eh_screencap_shm_opengl(int w,int h) {
+  if (!eh.shmring_ready) return -1;
+  if ((w<1)||(h<1)) return -1;
+  int64_t starttime=eh_now_real_us();
+  struct shmring_frame *frame=0;
+  uint8_t *dst=shmring_begin(&frame,eh.shmring);
+  if (!dst) return -1;
+  memset(frame,0,sizeof(struct shmring_frame));
+  frame->w=w;
+  frame->h=h;
+  frame->depth=8;
+  frame->colortype=2;
+  frame->stride=w*3;
+  if ((frame->len=frame->stride*h)>shmring_get_slot_size(eh.shmring)) return -1;
+  glPixelStorei(GL_PACK_ALIGNMENT,1);
+  glReadPixels(0,0,w,h,GL_RGB,GL_UNSIGNED_BYTE,dst);
+  return eh_screencap_shm_send(starttime);
+}
+
+#endif
 
 /* High-level conveniences using global state.
  */
@@ -17,28 +317,33 @@ int eh_screencap_send_from_fb(const void *fb) {
     .bmask=eh.delegate.bmask,
     .ctab=eh.render->ctab,
   };
-  void *serial=0;
-  int serialc=eh_screencap_from_fb(&serial,fb,&format);
-  if (serialc<0) return serialc;
-  int err=fakews_send(eh.fakews,2,serial,serialc);
-  free(serial);
-  return err;
+  #if USE_shmring
+    if (eh_screencap_shm_fb(fb,&format)>=0) return 0;
+  #endif
+  if (!eh_screencap_ready_for_snapshot()) return 0;
+  int64_t starttime=eh_now_real_us();
+  struct png_image *image=eh_screencap_snapshot_fb(fb,&format);
+  if (!image) return -1;
+  return eh_screencap_submit(image,eh_now_real_us()-starttime);
 }
 
 int eh_screencap_send_from_opengl() {
   if (!fakews_is_connected(eh.fakews)) return -1;
-  void *serial=0;
-  int serialc=eh_screencap_from_opengl(&serial,eh.video->w,eh.video->h);
-  if (serialc<0) return serialc;
-  int err=fakews_send(eh.fakews,2,serial,serialc);
-  free(serial);
-  return err;
+  #if USE_shmring
+    if (eh_screencap_shm_opengl(eh.video->w,eh.video->h)>=0) return 0;
+  #endif
+  if (!eh_screencap_ready_for_snapshot()) return 0;
+  int64_t starttime=eh_now_real_us();
+  struct png_image *image=eh_screencap_snapshot_opengl(eh.video->w,eh.video->h);
+  if (!image) return -1;
+  return eh_screencap_submit(image,eh_now_real_us()-starttime);
 }
 
+
 /* Stride from format.
  */
  
-static int eh_screencap_calculate_stride(const struct eh_screencap_format *format) {
+int eh_screencap_calculate_stride(const struct eh_screencap_format *format) {
   switch (format->format) {
     case EH_VIDEO_FORMAT_I1:
       return (format->w+7)>>3;
@@ -101,14 +406,13 @@ static int eh_screencap_add_ctab_if_needed(struct png_image *image,const struct
 /* From RGB32.
  */
  
-static int eh_screencap_from_rgb32(struct png_image *image,const uint32_t *fb,const struct eh_screencap_format *format) {
+static int eh_screencap_from_rgb32(uint8_t *dst,const uint32_t *fb,const struct eh_screencap_format *format) {
   uint32_t tmp;
   #define shift(ch) int ch##shift=0; if (!format->ch##mask) return -1; tmp=format->ch##mask; while (!(tmp&1)) { tmp>>=1; ch##shift++; } if (tmp!=0xff) return -1;
   shift(r)
   shift(g)
   shift(b)
   #undef shift
-  uint8_t *dst=image->pixels;
   int i=format->w*format->h;
   for (;i-->0;dst+=3,fb++) {
     dst[0]=(*fb)>>rshift;
@@ -160,7 +464,7 @@ static struct png_image *eh_screencap_convert_pngable(const void *fb,const struc
   if (format->format==EH_VIDEO_FORMAT_RGB32) {
     struct png_image *image=png_image_new(format->w,format->h,8,2);
     if (!image) return 0;
-    eh_screencap_from_rgb32(image,fb,format);
+    eh_screencap_from_rgb32(image->pixels,fb,format);
     return image;
   }
   
@@ -171,6 +475,66 @@ static struct png_image *eh_screencap_convert_pngable(const void *fb,const struc
   return 0;
 }
 
+/* Copy framebuffer into the worker's snapshot buffer, converting if necessary, and wrap in a PNG image.
+ * Same logic as eh_screencap_convert_pngable(), but we never borrow the client's framebuffer.
+ */
+ 
+static struct png_image *eh_screencap_snapshot_fb(const void *fb,const struct eh_screencap_format *format) {
+  struct eh_screencap_worker *worker=&eh_screencap_worker;
+  uint8_t depth=0,colortype=0;
+  int stride;
+  if (eh_screencap_format_is_pngable(&depth,&colortype,format)) {
+    stride=eh_screencap_calculate_stride(format);
+    if (eh_screencap_require_pixels(stride*format->h)<0) return 0;
+    memcpy(worker->pixels,fb,stride*format->h);
+  } else {
+    depth=8;
+    colortype=2;
+    stride=format->w*3;
+    if (eh_screencap_require_pixels(stride*format->h)<0) return 0;
+    if (eh.render->fbcvt&&(eh.render->fb_gl_format==GL_RGB)&&(eh.render->fb_gl_type==GL_UNSIGNED_BYTE)) {
+      eh.render->fbcvt(worker->pixels,fb,eh.render);
+    } else if (format->format==EH_VIDEO_FORMAT_RGB32) {
+      if (eh_screencap_from_rgb32(worker->pixels,fb,format)<0) return 0;
+    } else {
+      fprintf(stderr,"%s:%d:%s: No easy framebuffer=>PNG conversion. Implement generic conversion. format=%d\n",__FILE__,__LINE__,__func__,format->format);
+      return 0;
+    }
+  }
+  struct png_image *image=png_image_new(0,0,0,0);
+  if (!image) return 0;
+  image->depth=depth;
+  image->colortype=colortype;
+  image->w=format->w;
+  image->h=format->h;
+  image->stride=stride;
+  image->pixels=worker->pixels;
+  image->ownpixels=0;
+  if (eh_screencap_add_ctab_if_needed(image,format)<0) {
+    png_image_del(image);
+    return 0;
+  }
+  return image;
+}
+
+static struct png_image *eh_screencap_snapshot_opengl(int w,int h) {
+  struct eh_screencap_worker *worker=&eh_screencap_worker;
+  if ((w<1)||(h<1)) return 0;
+  if (eh_screencap_require_pixels(w*3*h)<0) return 0;
+  glPixelStorei(GL_PACK_ALIGNMENT,1);
+  glReadPixels(0,0,w,h,GL_RGB,GL_UNSIGNED_BYTE,worker->pixels);
+  struct png_image *image=png_image_new(0,0,0,0);
+  if (!image) return 0;
+  image->depth=8;
+  image->colortype=2;
+  image->w=w;
+  image->h=h;
+  image->stride=w*3;
+  image->pixels=worker->pixels;
+  image->ownpixels=0;
+  return image;
+}
+
 /* Generate PNG from framebuffer, outer layer.
  */
 
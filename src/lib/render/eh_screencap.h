@@ -4,13 +4,30 @@
 #ifndef EH_SCREENCAP_H
 #define EH_SCREENCAP_H
 
-/* Generate a PNG file from this framebuffer or the current OpenGL output,
- * and queue it for delivery out the WebSocket.
+/* Snapshot this framebuffer or the current OpenGL output,
+ * and queue it for encoding on a background thread and then delivery out the WebSocket.
  * If the global WebSocket is closed, we quickly noop and report failure.
+ * If the previous screencap is still encoding, we re-raise (eh.screencap_requested) and try again next frame.
  */
 int eh_screencap_send_from_fb(const void *fb);
 int eh_screencap_send_from_opengl();
 
+/* Call each frame from the main loop, to send finished screencaps.
+ */
+void eh_screencap_update();
+
+/* Stop the encoder thread and drop anything in flight.
+ */
+void eh_screencap_quit();
+
+/* Shared-memory handoff to Romassist, when --screencap-shm and it's on the same host.
+ * On connect we create a ring and announce it, and "shmringOk" from Romassist enables it.
+ * Connect is also safe to call again after driver init; it's a noop unless connected.
+ */
+void eh_screencap_shm_connect();
+void eh_screencap_shm_ack();
+void eh_screencap_shm_disconnect();
+
 /* Generate a PNG file from a framebuffer, no globals.
  * (format) should come straight off the client delegate, except (ctab), from the renderer.
  */
@@ -22,6 +39,10 @@ struct eh_screencap_format {
 };
 int eh_screencap_from_fb(void *dstpp,const void *fb,const struct eh_screencap_format *format);
 
+/* Bytes per row of a framebuffer in this format, zero if unknown.
+ */
+int eh_screencap_calculate_stride(const struct eh_screencap_format *format);
+
 /* Generate a PNG file from the OpenGL context.
  * These will always be RGB.
  */
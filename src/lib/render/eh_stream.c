@@ -0,0 +1,445 @@
+#include "eh_render_internal.h"
+#include "eh_stream.h"
+#include "opt/fakews/fakews.h"
+#include "opt/serial/serial.h"
+
+#define EH_STREAM_TILESIZE 16
+#define EH_STREAM_HEADER_SIZE 17
+#define EH_STREAM_PACKET_LIMIT 0xffff
+#define EH_STREAM_TILE_LIMIT (3+1+16*3+128+EH_STREAM_TILESIZE*EH_STREAM_TILESIZE*3) /* Worst case for one encoded tile. */
+#define EH_STREAM_BACKLOG_LIMIT 0x40000 /* Skip frames while the socket has so much unsent. */
+#define EH_STREAM_KEYFRAME_INTERVAL_US 5000000
+#define EH_STREAM_STATS_INTERVAL_US 2000000
+
+#define EH_STREAM_FLAG_KEYFRAME 0x01
+#define EH_STREAM_FLAG_END      0x02
+#define EH_STREAM_FLAG_INDEXED  0x04
+#define EH_STREAM_FLAG_PALETTE  0x08
+
+#define EH_STREAM_ENC_FILL 0
+#define EH_STREAM_ENC_RAW  1
+#define EH_STREAM_ENC_PAL  2
+
+struct eh_stream {
+  struct fakews *fakews;
+  int64_t interval_us;
+  int64_t next_frame_time;
+  int64_t next_keyframe_time;
+  int keyframe_requested;
+
+  int w,h; // Cropped output size.
+  int indexed; // Pixels are 1 byte if indexed, otherwise 3.
+  int pixelsize;
+  uint8_t *cur,*prev; // (w*h*pixelsize), tightly packed.
+  uint8_t ctab[768]; // Palette last sent.
+  uint32_t seq;
+
+  uint8_t pkt[EH_STREAM_PACKET_LIMIT];
+  int pktc;
+  int pkttilec;
+  int pktflags;
+  int sendfail;
+
+  // Cumulative stats.
+  int framec,keyframec,dropc;
+  int encodec; // Frames examined, including unchanged ones we didn't send.
+  int64_t bytec,tilec;
+  int64_t encode_us,encode_us_max;
+  int64_t start_time;
+
+  // Stats since the last streamStats report.
+  int64_t next_stats_time;
+  int64_t window_start;
+  int window_framec,window_encodec;
+  int64_t window_bytec;
+  int64_t window_encode_us,window_encode_us_max;
+};
+
+/* Connection callbacks.
+ */
+
+static void eh_stream_cb_connect(void *userdata) {
+  struct eh_stream *stream=userdata;
+  stream->keyframe_requested=1;
+}
+
+static void eh_stream_cb_disconnect(void *userdata) {
+}
+
+static void eh_stream_cb_message(int opcode,const void *v,int c,void *userdata) {
+  struct eh_stream *stream=userdata;
+  if (opcode!=1) return;
+  struct sr_decoder decoder={.v=v,.c=c};
+  if (sr_decode_json_object_start(&decoder)<0) return;
+  const char *k;
+  int kc;
+  while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+    if ((kc==2)&&!memcmp(k,"id",2)) {
+      char id[32];
+      int idc=sr_decode_json_string(id,sizeof(id),&decoder);
+      if ((idc==14)&&!memcmp(id,"streamKeyframe",14)) stream->keyframe_requested=1;
+      return;
+    }
+    if (sr_decode_json_skip(&decoder)<0) return;
+  }
+}
+
+/* Delete.
+ */
+
+void eh_stream_del(struct eh_stream *stream) {
+  if (!stream) return;
+  fakews_del(stream->fakews);
+  if (stream->cur) free(stream->cur);
+  if (stream->prev) free(stream->prev);
+  free(stream);
+}
+
+/* New.
+ */
+
+struct eh_stream *eh_stream_new(const char *host,int port,int rate) {
+  if (rate<1) return 0;
+  if ((eh.fbcrop.w<1)||(eh.fbcrop.h<1)) return 0;
+  if ((eh.fbcrop.w>0xffff)||(eh.fbcrop.h>0xffff)) return 0;
+  struct eh_stream *stream=calloc(1,sizeof(struct eh_stream));
+  if (!stream) return 0;
+
+  stream->interval_us=1000000/rate;
+  stream->w=eh.fbcrop.w;
+  stream->h=eh.fbcrop.h;
+  switch (eh.delegate.video_format) {
+    case EH_VIDEO_FORMAT_I1:
+    case EH_VIDEO_FORMAT_I2:
+    case EH_VIDEO_FORMAT_I4:
+    case EH_VIDEO_FORMAT_I8: stream->indexed=1; stream->pixelsize=1; break;
+    default: stream->pixelsize=3;
+  }
+  int size=stream->w*stream->h*stream->pixelsize;
+  if (
+    !(stream->cur=malloc(size))||
+    !(stream->prev=malloc(size))||
+    !(stream->fakews=fakews_new(
+      host,-1,port,"/ws/stream",10,
+      eh_stream_cb_connect,eh_stream_cb_disconnect,eh_stream_cb_message,stream
+    ))
+  ) {
+    eh_stream_del(stream);
+    return 0;
+  }
+  stream->keyframe_requested=1;
+  stream->start_time=eh_now_real_us();
+  return stream;
+}
+
+/* Periodic stats, sent to Romassist for the viewers.
+ */
+
+static void eh_stream_send_stats(struct eh_stream *stream,int64_t now) {
+  int64_t elapsed=now-stream->window_start;
+  if (elapsed<1) return;
+  char msg[256];
+  int msgc=snprintf(msg,sizeof(msg),
+    "{\"id\":\"streamStats\",\"fps\":%.2f,\"kbps\":%.1f,\"encodeUs\":%d,\"encodeMaxUs\":%d,\"w\":%d,\"h\":%d,\"dropc\":%d}",
+    (stream->window_framec*1000000.0)/elapsed,
+    (stream->window_bytec*8000.0)/elapsed,
+    stream->window_encodec?(int)(stream->window_encode_us/stream->window_encodec):0,
+    (int)stream->window_encode_us_max,
+    stream->w,stream->h,stream->dropc
+  );
+  if ((msgc>0)&&(msgc<sizeof(msg))) fakews_send(stream->fakews,1,msg,msgc);
+  stream->window_start=now;
+  stream->window_framec=0;
+  stream->window_encodec=0;
+  stream->window_bytec=0;
+  stream->window_encode_us=0;
+  stream->window_encode_us_max=0;
+}
+
+/* Update.
+ */
+
+void eh_stream_update(struct eh_stream *stream) {
+  if (!stream) return;
+  fakews_update(stream->fakews,0);
+  if (!fakews_is_connected(stream->fakews)) return;
+  int64_t now=eh_now_real_us();
+  if (!stream->window_start) {
+    stream->window_start=now;
+    stream->next_stats_time=now+EH_STREAM_STATS_INTERVAL_US;
+  } else if (now>=stream->next_stats_time) {
+    stream->next_stats_time=now+EH_STREAM_STATS_INTERVAL_US;
+    eh_stream_send_stats(stream,now);
+  }
+}
+
+/* Copy the client's framebuffer into (stream->cur), cropped.
+ */
+
+static void eh_stream_capture_indexed(struct eh_stream *stream,const uint8_t *src) {
+  int bits;
+  switch (eh.delegate.video_format) {
+    case EH_VIDEO_FORMAT_I1: bits=1; break;
+    case EH_VIDEO_FORMAT_I2: bits=2; break;
+    case EH_VIDEO_FORMAT_I4: bits=4; break;
+    default: bits=8;
+  }
+  int srcstride=(eh.delegate.video_width*bits+7)>>3;
+  src+=eh.fbcrop.y*srcstride;
+  uint8_t *dst=stream->cur;
+  int yi=stream->h;
+  if (bits==8) {
+    src+=eh.fbcrop.x;
+    for (;yi-->0;dst+=stream->w,src+=srcstride) memcpy(dst,src,stream->w);
+    return;
+  }
+  int mask=(1<<bits)-1;
+  for (;yi-->0;src+=srcstride) {
+    int x=eh.fbcrop.x,xi=stream->w;
+    for (;xi-->0;x++,dst++) {
+      int bitp=x*bits;
+      *dst=(src[bitp>>3]>>(8-bits-(bitp&7)))&mask;
+    }
+  }
+}
+
+static void eh_stream_capture_rgb(struct eh_stream *stream,struct eh_render *render) {
+  const uint8_t *src;
+  int srcpixelsize=3;
+  if (render->fbrgb) src=render->fbrgb;
+  else if (render->fb_gl_format==GL_RGBA) { src=render->srcfb; srcpixelsize=4; }
+  else src=render->srcfb;
+  int srcstride=eh.delegate.video_width*srcpixelsize;
+  src+=eh.fbcrop.y*srcstride+eh.fbcrop.x*srcpixelsize;
+  uint8_t *dst=stream->cur;
+  int dststride=stream->w*3;
+  int yi=stream->h;
+  if (srcpixelsize==3) {
+    for (;yi-->0;dst+=dststride,src+=srcstride) memcpy(dst,src,dststride);
+    return;
+  }
+  for (;yi-->0;src+=srcstride) {
+    const uint8_t *srcp=src;
+    int xi=stream->w;
+    for (;xi-->0;dst+=3,srcp+=4) {
+      dst[0]=srcp[0];
+      dst[1]=srcp[1];
+      dst[2]=srcp[2];
+    }
+  }
+}
+
+/* Packet assembly.
+ */
+
+static void eh_stream_packet_begin(struct eh_stream *stream,int flags) {
+  uint8_t *dst=stream->pkt;
+  memcpy(dst,"EHFS",4);
+  dst[4]=1;
+  dst[5]=0; // flags, at flush
+  dst[6]=stream->w>>8;
+  dst[7]=stream->w;
+  dst[8]=stream->h>>8;
+  dst[9]=stream->h;
+  dst[10]=stream->seq>>24;
+  dst[11]=stream->seq>>16;
+  dst[12]=stream->seq>>8;
+  dst[13]=stream->seq;
+  dst[14]=EH_STREAM_TILESIZE;
+  stream->pktc=EH_STREAM_HEADER_SIZE;
+  stream->pkttilec=0;
+  stream->pktflags=flags;
+  if (flags&EH_STREAM_FLAG_PALETTE) {
+    memcpy(stream->pkt+stream->pktc,stream->ctab,768);
+    stream->pktc+=768;
+  }
+}
+
+static void eh_stream_packet_flush(struct eh_stream *stream,int end) {
+  if (end) stream->pktflags|=EH_STREAM_FLAG_END;
+  stream->pkt[5]=stream->pktflags;
+  stream->pkt[15]=stream->pkttilec>>8;
+  stream->pkt[16]=stream->pkttilec;
+  if (fakews_send(stream->fakews,2,stream->pkt,stream->pktc)<0) stream->sendfail=1;
+  stream->bytec+=3+stream->pktc;
+  stream->window_bytec+=3+stream->pktc;
+  // Continuation packets never repeat the palette.
+  eh_stream_packet_begin(stream,stream->pktflags&(EH_STREAM_FLAG_KEYFRAME|EH_STREAM_FLAG_INDEXED));
+}
+
+/* Encode one tile at the end of the packet.
+ * Caller ensures there's room for the worst case.
+ */
+
+static void eh_stream_encode_tile(struct eh_stream *stream,int tileid,int x,int y,int w,int h) {
+  int ps=stream->pixelsize;
+  int stride=stream->w*ps;
+  const uint8_t *src=stream->cur+y*stride+x*ps;
+  uint8_t *dst=stream->pkt+stream->pktc;
+  dst[0]=tileid>>8;
+  dst[1]=tileid;
+
+  // Gather up to 16 distinct colors. Usually there are very few.
+  uint8_t colorv[16*3];
+  int colorc=0;
+  const uint8_t *row=src;
+  int yi=h;
+  for (;yi-->0;row+=stride) {
+    const uint8_t *p=row;
+    int xi=w;
+    for (;xi-->0;p+=ps) {
+      int i=0; for (;i<colorc;i++) if (!memcmp(colorv+i*ps,p,ps)) break;
+      if (i<colorc) continue;
+      if (colorc>=16) { colorc=17; goto _raw_; }
+      memcpy(colorv+colorc*ps,p,ps);
+      colorc++;
+    }
+  }
+
+  if (colorc==1) {
+    dst[2]=EH_STREAM_ENC_FILL;
+    memcpy(dst+3,colorv,ps);
+    stream->pktc+=3+ps;
+    return;
+  }
+
+  // Tile-local palette only if it's actually smaller. (It usually is for RGB, rarely for tiny indexed tiles).
+  int palsize=1+colorc*ps+((w*h+1)>>1);
+  if (palsize<w*h*ps) {
+    dst[2]=EH_STREAM_ENC_PAL;
+    dst[3]=colorc;
+    memcpy(dst+4,colorv,colorc*ps);
+    uint8_t *bits=dst+4+colorc*ps;
+    int bitp=0;
+    for (row=src,yi=h;yi-->0;row+=stride) {
+      const uint8_t *p=row;
+      int xi=w;
+      for (;xi-->0;p+=ps,bitp++) {
+        int i=0; for (;i<colorc;i++) if (!memcmp(colorv+i*ps,p,ps)) break;
+        if (bitp&1) bits[bitp>>1]|=i;
+        else bits[bitp>>1]=i<<4;
+      }
+    }
+    stream->pktc+=3+palsize;
+    return;
+  }
+
+ _raw_:;
+  dst[2]=EH_STREAM_ENC_RAW;
+  uint8_t *dstp=dst+3;
+  int rowsize=w*ps;
+  for (row=src,yi=h;yi-->0;row+=stride,dstp+=rowsize) memcpy(dstp,row,rowsize);
+  stream->pktc+=3+h*rowsize;
+}
+
+static int eh_stream_tile_changed(const struct eh_stream *stream,int x,int y,int w,int h) {
+  int stride=stream->w*stream->pixelsize;
+  int offset=y*stride+x*stream->pixelsize;
+  const uint8_t *a=stream->cur+offset;
+  const uint8_t *b=stream->prev+offset;
+  int rowsize=w*stream->pixelsize;
+  for (;h-->0;a+=stride,b+=stride) {
+    if (memcmp(a,b,rowsize)) return 1;
+  }
+  return 0;
+}
+
+/* Frame.
+ */
+
+void eh_stream_frame(struct eh_stream *stream,struct eh_render *render) {
+  if (!stream||!render||!render->srcfb) return;
+  if (!fakews_is_connected(stream->fakews)) return;
+  int64_t now=eh_now_real_us();
+  if (now<stream->next_frame_time) return;
+  if (fakews_get_pending(stream->fakews)>EH_STREAM_BACKLOG_LIMIT) {
+    stream->dropc++;
+    return;
+  }
+  stream->next_frame_time+=stream->interval_us;
+  if (stream->next_frame_time<now) stream->next_frame_time=now+stream->interval_us;
+
+  int keyframe=stream->keyframe_requested||stream->sendfail||(now>=stream->next_keyframe_time);
+  if (stream->indexed) {
+    eh_stream_capture_indexed(stream,render->srcfb);
+    if (memcmp(stream->ctab,render->ctab,768)) {
+      memcpy(stream->ctab,render->ctab,768);
+      keyframe=1;
+    }
+  } else {
+    eh_stream_capture_rgb(stream,render);
+  }
+
+  int flags=0;
+  if (keyframe) {
+    flags|=EH_STREAM_FLAG_KEYFRAME;
+    if (stream->indexed) flags|=EH_STREAM_FLAG_PALETTE;
+    stream->keyframe_requested=0;
+    stream->sendfail=0;
+    stream->next_keyframe_time=now+EH_STREAM_KEYFRAME_INTERVAL_US;
+    stream->keyframec++;
+  }
+  if (stream->indexed) flags|=EH_STREAM_FLAG_INDEXED;
+  eh_stream_packet_begin(stream,flags);
+
+  int tilec=0,tileid=0,y=0;
+  for (;y<stream->h;y+=EH_STREAM_TILESIZE) {
+    int th=stream->h-y;
+    if (th>EH_STREAM_TILESIZE) th=EH_STREAM_TILESIZE;
+    int x=0;
+    for (;x<stream->w;x+=EH_STREAM_TILESIZE,tileid++) {
+      int tw=stream->w-x;
+      if (tw>EH_STREAM_TILESIZE) tw=EH_STREAM_TILESIZE;
+      if (!keyframe&&!eh_stream_tile_changed(stream,x,y,tw,th)) continue;
+      if (stream->pktc>EH_STREAM_PACKET_LIMIT-EH_STREAM_TILE_LIMIT) eh_stream_packet_flush(stream,0);
+      eh_stream_encode_tile(stream,tileid,x,y,tw,th);
+      stream->pkttilec++;
+      tilec++;
+    }
+  }
+
+  // Nothing changed, don't send anything. The viewer keeps showing what it has.
+  if (tilec) {
+    eh_stream_packet_flush(stream,1);
+    stream->seq++;
+    stream->framec++;
+    stream->window_framec++;
+    stream->tilec+=tilec;
+    uint8_t *tmp=stream->prev;
+    stream->prev=stream->cur;
+    stream->cur=tmp;
+  }
+
+  int64_t elapsed=eh_now_real_us()-now;
+  stream->encodec++;
+  stream->window_encodec++;
+  stream->encode_us+=elapsed;
+  if (elapsed>stream->encode_us_max) stream->encode_us_max=elapsed;
+  if (elapsed>stream->window_encode_us_max) stream->window_encode_us_max=elapsed;
+  stream->window_encode_us+=elapsed;
+}
+
+/* Report.
+ */
+
+int eh_stream_report(char *dst,int dsta,const struct eh_stream *stream) {
+  if (!dst||(dsta<1)) return -1;
+  dst[0]=0;
+  if (!stream||(stream->framec<1)) return 0;
+  double elapsed=(eh_now_real_us()-stream->start_time)/1000000.0;
+  if (elapsed<=0.0) elapsed=1.0;
+  int dstc=snprintf(dst,dsta,
+    "Stream: %d frames (%d key), %.1f KB/frame, %.1f KB/s, %.1f tiles/frame, encode %.0f us avg %d us max, %d dropped for backlog",
+    stream->framec,stream->keyframec,
+    stream->bytec/(1024.0*stream->framec),
+    stream->bytec/(1024.0*elapsed),
+    (double)stream->tilec/stream->framec,
+    (double)stream->encode_us/stream->encodec,(int)stream->encode_us_max,
+    stream->dropc
+  );
+  if ((dstc<1)||(dstc>=dsta)) {
+    dst[0]=0;
+    return 0;
+  }
+  return dstc;
+}
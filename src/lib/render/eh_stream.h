@@ -0,0 +1,59 @@
+/* eh_stream.h
+ * Live framebuffer streaming to Romassist, for watching a station from the web app.
+ * We open a second fakews connection "/ws/stream", so big frame data never delays the game's control channel.
+ *
+ * Only framebuffer clients. Frames are cut into 16x16 tiles, and we send only the tiles that changed since the last sent frame,
+ * plus a keyframe with every tile every few seconds or on request.
+ * Indexed formats send 8-bit indices and the palette. RGB sends 24-bit pixels.
+ * Either way, a tile with one color is sent as one pixel, and a tile with <=16 colors gets a tile-local 4-bit palette.
+ *
+ * Binary packet, all integers big-endian:
+ *   0000   4 "EHFS"
+ *   0004   1 Version, 1.
+ *   0005   1 Flags:
+ *              01 Keyframe: Every tile is included, across however many packets.
+ *              02 End of frame: Present after this packet.
+ *              04 Indexed: Pixels are 1 byte indexing the palette. Otherwise 3 bytes RGB.
+ *              08 Palette: 768 bytes RGB follow the header.
+ *   0006   2 Width.
+ *   0008   2 Height.
+ *   000a   4 Frame sequence.
+ *   000e   1 Tile size, 16.
+ *   000f   2 Tile count in this packet.
+ *   0011 ... Palette if flagged, then tiles:
+ *     2 Tile index, LRTB.
+ *     1 Encoding:
+ *         0 Fill: One pixel.
+ *         1 Raw: Every pixel LRTB. Tiles on the right and bottom edges may be short.
+ *         2 Palette: u8 color count, that many pixels, then 4-bit indices LRTB big-endianly, padded to a byte at the end.
+ *
+ * JSON out, every few seconds: {"id":"streamStats",fps,kbps,encodeUs,encodeMaxUs,w,h,dropc}
+ * JSON in: {"id":"streamKeyframe"} to request a keyframe, eg when a new viewer connects.
+ */
+
+#ifndef EH_STREAM_H
+#define EH_STREAM_H
+
+struct eh_stream;
+struct eh_render;
+
+void eh_stream_del(struct eh_stream *stream);
+
+/* (rate) in frames per second, we'll send no more often than that.
+ */
+struct eh_stream *eh_stream_new(const char *host,int port,int rate);
+
+/* Call every frame from the main loop, to pump the connection.
+ */
+void eh_stream_update(struct eh_stream *stream);
+
+/* Call after the frame is committed, while (render) still has its converted framebuffer.
+ * Noop if not due yet, or if the network hasn't caught up with the last one.
+ */
+void eh_stream_frame(struct eh_stream *stream,struct eh_render *render);
+
+/* Cumulative bandwidth and encode cost, for the exit log.
+ */
+int eh_stream_report(char *dst,int dsta,const struct eh_stream *stream);
+
+#endif
@@ -25,6 +25,7 @@ extern struct mn {
   struct db_service dbs;
   int upgrade_in_progress;
   int upgrade_status;
+  int benchmark_failed; // --synth-benchmark; we exit nonzero.
 } mn;
 
 /* Convenience: Returns (mn.data_path) prepended to (basename) with the appropriate separator.
@@ -32,6 +33,10 @@ extern struct mn {
  */
 const char *mn_data_path(const char *basename);
 
+/* Replace (mn.cheapsynth) and start printing our sound effects.
+ */
+int mn_init_cheapsynth(int rate,int chanc);
+
 extern const struct gui_widget_type mn_widget_type_home;
 extern const struct gui_widget_type mn_widget_type_menubar;
 extern const struct gui_widget_type mn_widget_type_carousel;
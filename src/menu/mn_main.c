@@ -83,6 +83,29 @@ static void mn_generate_pcm(void *v,int c) {
   cheapsynth_updatei(v,c,mn.cheapsynth);
 }
 
+/* Create the synthesizer and intern everything up front.
+ * Printing happens in the background, and it's usually just a read from the cache.
+ * Sounds played before they're ready render in real time, so no need to wait.
+ */
+ 
+int mn_init_cheapsynth(int rate,int chanc) {
+  cheapsynth_del(mn.cheapsynth);
+  if (!(mn.cheapsynth=cheapsynth_new(rate,chanc))) return -1;
+  cheapsynth_set_async(mn.cheapsynth,1);
+  char path[1024];
+  int pathc=eh_get_romassist_directory(path,sizeof(path));
+  if ((pathc>0)&&(pathc<sizeof(path)-11)) {
+    memcpy(path+pathc,"/cheapsynth",12);
+    cheapsynth_set_cache_directory(mn.cheapsynth,path);
+  }
+  cheapsynth_sound_intern(mn.cheapsynth,&mn_sound_ACTIVATE);
+  cheapsynth_sound_intern(mn.cheapsynth,&mn_sound_MINOR_OK);
+  cheapsynth_sound_intern(mn.cheapsynth,&mn_sound_MOTION);
+  cheapsynth_sound_intern(mn.cheapsynth,&mn_sound_CANCEL);
+  cheapsynth_sound_intern(mn.cheapsynth,&mn_sound_REJECT);
+  return 0;
+}
+
 void mn_cb_sound_effect(int sfxid,void *userdata) {
   struct cheapsynth_sound *sound=0;
   switch (sfxid) {
@@ -165,7 +188,7 @@ static int mn_load_none() {
   if (!home) return -1;
   
   if (eh_audio_get_format()!=EH_AUDIO_FORMAT_S16N) return -1;
-  if (!(mn.cheapsynth=cheapsynth_new(eh_audio_get_rate(),eh_audio_get_chanc()))) return -1;
+  if (mn_init_cheapsynth(eh_audio_get_rate(),eh_audio_get_chanc())<0) return -1;
 
   return 0;
 }
@@ -259,6 +282,13 @@ static int mn_configure(const char *k,int kc,const char *v,int vc,int vn) {
     mn.kiosk=1;
     return 1;
   }
+  if ((kc==15)&&!memcmp(k,"synth-benchmark",15)) {
+    // Runs at configure time, before any drivers exist. eh_main returns as soon as configure finishes.
+    if ((vn<1)||(vn>200000)) vn=48000;
+    if (cheapsynth_benchmark(vn)<0) mn.benchmark_failed=1;
+    eh_request_termination();
+    return 1;
+  }
   return 0;
 }
 
@@ -289,5 +319,7 @@ int main(int argc,char **argv) {
   };
   mn.exename=(argc>=0)?argv[0]:0;
   if (!mn.exename||!mn.exename[0]) mn.exename=delegate.name;
-  return eh_main(argc,argv,&delegate);
+  int status=eh_main(argc,argv,&delegate);
+  if (mn.benchmark_failed) return 1;
+  return status;
 }
@@ -70,8 +70,7 @@ static void audio_replace_driver(struct gui_widget *widget) {
   };
   struct eh_audio_driver *driver=eh_audio_reinit(type,&setup);
   if (!driver) return;
-  cheapsynth_del(mn.cheapsynth);
-  mn.cheapsynth=cheapsynth_new(driver->rate,driver->chanc);
+  mn_init_cheapsynth(driver->rate,driver->chanc);
   if (driver->type->play) driver->type->play(driver,1);
 }
 
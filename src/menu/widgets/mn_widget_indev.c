@@ -44,8 +44,10 @@ struct mn_widget_indev {
  */
  
 static void _indev_del(struct gui_widget *widget) {
+  eh_input_lock();
   inmgr_unlisten(WIDGET->listenerid);
   inmgr_device_enable(WIDGET->devid,1);
+  eh_input_unlock();
   gui_texture_del(WIDGET->nametex);
   gui_texture_del(WIDGET->gridtex);
   if (WIDGET->cellv) free(WIDGET->cellv);
@@ -274,7 +276,10 @@ static void indev_cb_map(struct gui_widget *pickone,int p,void *userdata) {
       int dstbtnid=indev_optionv[p].btnid;
       if (dstbtnid!=cell->dstbtnid) { // NB zero is perfectly valid for dstbtnid, but it's also the fallback
         MN_SOUND(ACTIVATE)
-        if (inmgr_remap_button(WIDGET->devid,cell->btnid,dstbtnid)>=0) {
+        eh_input_lock();
+        int err=inmgr_remap_button(WIDGET->devid,cell->btnid,dstbtnid);
+        eh_input_unlock();
+        if (err>=0) {
           eh_inmgr_dirty();
           cell->dstbtnid=dstbtnid;
           indev_redraw_gridtex_cell(widget,WIDGET->selx,WIDGET->sely);
@@ -450,11 +455,7 @@ static int indev_build_caps(struct gui_widget *widget) {
 /* Public setup.
  */
  
-int mn_widget_indev_setup(struct gui_widget *widget,int devid) {
-  if (!widget||(widget->type!=&mn_widget_type_indev)) return -1;
-  if (WIDGET->devid) return -1;
-  WIDGET->devid=devid;
-  
+static int indev_setup_locked(struct gui_widget *widget) {
   if ((WIDGET->listenerid=inmgr_listen(indev_cb_event,widget))<1) return -1;
   inmgr_device_enable(WIDGET->devid,0);
   
@@ -473,3 +474,16 @@ int mn_widget_indev_setup(struct gui_widget *widget,int devid) {
   
   return 0;
 }
+
+int mn_widget_indev_setup(struct gui_widget *widget,int devid) {
+  if (!widget||(widget->type!=&mn_widget_type_indev)) return -1;
+  if (WIDGET->devid) return -1;
+  WIDGET->devid=devid;
+  
+  // Input thread, if there is one, must hold off while we read the device and its mapping.
+  eh_input_lock();
+  int err=indev_setup_locked(widget);
+  eh_input_unlock();
+  return err;
+}
+
@@ -1,5 +1,6 @@
 #include "../mn_internal.h"
 #include "lib/emuhost.h"
+#include "lib/eh_driver.h"
 #include "lib/inmgr/inmgr.h"
 
 #define INPUT_ALARM_TIME 100
@@ -41,7 +42,9 @@ static void _input_del(struct gui_widget *widget) {
     while (WIDGET->rowc-->0) input_row_cleanup(WIDGET->rowv+WIDGET->rowc);
     free(WIDGET->rowv);
   }
+  eh_input_lock();
   inmgr_unlisten(WIDGET->listenerid);
+  eh_input_unlock();
 }
 
 /* Add row.
@@ -145,12 +148,17 @@ static int _input_init(struct gui_widget *widget) {
   if (!(WIDGET->instructions=gui_texture_from_text(widget->gui,0,"(A+B) to select",-1,0xc0c0c0))) return -1;
   if (!input_add_row(widget,"Done",4,-1)) return -1;
   
-  if ((WIDGET->listenerid=inmgr_listen(input_cb_event,widget))<0) return -1;
+  eh_input_lock();
+  if ((WIDGET->listenerid=inmgr_listen(input_cb_event,widget))<0) {
+    eh_input_unlock();
+    return -1;
+  }
   int i=0; for (;;i++) { // Simulate connection for all existing devices.
     int devid=inmgr_devid_by_index(i);
     if (devid<=0) break;
     input_cb_event(devid,0,0,0,widget);
   }
+  eh_input_unlock();
 
   return 0;
 }
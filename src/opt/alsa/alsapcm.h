@@ -37,10 +37,18 @@ struct alsapcm_delegate {
 struct alsapcm_setup {
   int rate; // hz
   int chanc; // usually 1 or 2
-  const char *device; // basename or absolute path of device file eg "pcmC0D0p", null to try all.
+  const char *device; // basename or absolute path of device file eg "pcmC0D0p", null to try all. "null" for no hardware.
   int buffersize; // Hardware buffer size in frames. Usually best to leave it zero, let us decide.
+  int periodsize; // Frames per transfer. Zero for half the buffer. With (periodc), overrides (buffersize).
+  int periodc; // Periods per buffer, zero to let the device decide.
+  int mmap; // Nonzero to map the hardware buffer and fill it in place, instead of write(). Falls back to write() if refused.
+  int rtprio; // Nonzero to run the I/O thread SCHED_FIFO at this priority. Failure is logged and not fatal.
 };
 
+/* The "null" device has no file and no hardware, it consumes samples at the nominal rate with a clock.
+ * It honors all the setup params, and both transfer modes, so you can test buffering without a sound card.
+ */
+
 /* Iterate possible PCM devices in a given directory.
  * We only report devices that support interleaved output of native s16.
  * Stop iteration by returning nonzero; we return the same.
@@ -94,6 +102,16 @@ int alsapcm_get_rate(const struct alsapcm *alsapcm);
 int alsapcm_get_chanc(const struct alsapcm *alsapcm);
 const char *alsapcm_get_device(const struct alsapcm *alsapcm);
 int alsapcm_get_running(const struct alsapcm *alsapcm);
+int alsapcm_get_buffer_size(const struct alsapcm *alsapcm); // frames
+int alsapcm_get_period_size(const struct alsapcm *alsapcm); // frames
+int alsapcm_get_mmap(const struct alsapcm *alsapcm);
+
+/* Underruns since creation, and frames queued ahead of the hardware as of the last transfer.
+ * Latency is measured on the I/O thread after each transfer, (avg) and (max) are since creation.
+ * Any output may be null.
+ */
+int alsapcm_get_xrun_count(const struct alsapcm *alsapcm);
+void alsapcm_get_latency(int *last,int *avg,int *max,const struct alsapcm *alsapcm);
 
 /* A new context is stopped until you explicitly set_running(1).
  */
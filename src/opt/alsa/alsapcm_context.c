@@ -91,6 +91,14 @@ static void *alsapcm_iothd(void *arg) {
   while (1) {
     pthread_testcancel();
     
+    if (alsapcm->mmap) {
+      if (alsapcm_mmap_update(alsapcm)<0) {
+        alsapcm->ioerror=-1;
+        return 0;
+      }
+      continue;
+    }
+    
     if (pthread_mutex_lock(&alsapcm->iomtx)) {
       usleep(1000);
       continue;
@@ -113,10 +121,13 @@ static void *alsapcm_iothd(void *arg) {
       pthread_testcancel();
       int pvcancel;
       pthread_setcancelstate(PTHREAD_CANCEL_DISABLE,&pvcancel);
-      int err=write(alsapcm->fd,src+srcp,srcc-srcp);
+      int err;
+      if (alsapcm->null) err=alsapcm_null_write(alsapcm,src+srcp,srcc-srcp);
+      else err=write(alsapcm->fd,src+srcp,srcc-srcp);
       pthread_setcancelstate(pvcancel,0);
       if (err<0) {
         if (errno==EPIPE) {
+          __atomic_add_fetch(&alsapcm->xrunc,1,__ATOMIC_RELAXED);
           if (
             (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_DROP)<0)||
             (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_DRAIN)<0)||
@@ -136,6 +147,7 @@ static void *alsapcm_iothd(void *arg) {
         srcp+=err;
       }
     }
+    alsapcm_latency_sample(alsapcm);
   }
 }
 
@@ -150,6 +162,18 @@ void alsapcm_del(struct alsapcm *alsapcm) {
     pthread_join(alsapcm->iothd,0);
   }
   
+  if (alsapcm->latency_samplec) {
+    fprintf(stderr,
+      "alsapcm: %d underruns. Output latency avg %d ms, max %d ms. Buffer %d frames, period %d, %s.\n",
+      alsapcm->xrunc,
+      (int)((alsapcm->latency_sum*1000)/(alsapcm->latency_samplec*alsapcm->rate)),
+      (alsapcm->latency_max*1000)/alsapcm->rate,
+      alsapcm->hwbufframec,alsapcm->periodframec,
+      alsapcm->mmap?"mmap":"write"
+    );
+  }
+  
+  alsapcm_mmap_cleanup(alsapcm);
   if (alsapcm->fd>=0) close(alsapcm->fd);
   if (alsapcm->device) free(alsapcm->device);
   if (alsapcm->buf) free(alsapcm->buf);
@@ -168,6 +192,11 @@ static int alsapcm_select_device_path(
   if (alsapcm->device) return 0;
   
   // If caller supplied a device path or basename, that trumps all.
+  if (setup&&setup->device&&!strcmp(setup->device,"null")) {
+    alsapcm->null=1;
+    if (!(alsapcm->device=strdup("null"))) return -1;
+    return 0;
+  }
   if (setup&&setup->device&&setup->device[0]) {
     if (setup->device[0]=='/') {
       if (!(alsapcm->device=strdup(setup->device))) return -1;
@@ -206,6 +235,7 @@ static int alsapcm_select_device_path(
  */
  
 static int alsapcm_open_device(struct alsapcm *alsapcm) {
+  if (alsapcm->null) return 0;
   if (alsapcm->fd>=0) return 0;
   if (!alsapcm->device) return -1;
   
@@ -226,6 +256,70 @@ static int alsapcm_open_device(struct alsapcm *alsapcm) {
   return 0;
 }
 
+/* Init: Refine hw params against the broadest set of criteria, anything we can technically handle.
+ * (we impose a hard requirement for s16 interleaved; that's about it).
+ * Access is mmap or read/write according to (alsapcm->mmap).
+ */
+ 
+static int alsapcm_refine_hw_params(struct alsapcm *alsapcm,struct snd_pcm_hw_params *hwparams) {
+  alsapcm_hw_params_none(hwparams);
+  hwparams->flags=SNDRV_PCM_HW_PARAMS_NORESAMPLE;
+  alsapcm_hw_params_set_mask(hwparams,SNDRV_PCM_HW_PARAM_ACCESS,alsapcm->mmap?SNDRV_PCM_ACCESS_MMAP_INTERLEAVED:SNDRV_PCM_ACCESS_RW_INTERLEAVED,1);
+  alsapcm_hw_params_set_mask(hwparams,SNDRV_PCM_HW_PARAM_FORMAT,SNDRV_PCM_FORMAT_S16,1);
+  alsapcm_hw_params_set_mask(hwparams,SNDRV_PCM_HW_PARAM_SUBFORMAT,SNDRV_PCM_SUBFORMAT_STD,1);
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_SAMPLE_BITS,16,16);
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_FRAME_BITS,0,UINT_MAX);
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_CHANNELS,ALSAPCM_CHANC_MIN,ALSAPCM_CHANC_MAX);
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_RATE,ALSAPCM_RATE_MIN,ALSAPCM_RATE_MAX);
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_PERIOD_TIME,0,UINT_MAX); // us between interrupts
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_PERIOD_SIZE,0,UINT_MAX); // frames between interrupts
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_PERIOD_BYTES,0,UINT_MAX); // bytes between interrupts
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_PERIODS,0,UINT_MAX); // interrupts per buffer
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_BUFFER_TIME,0,UINT_MAX); // us
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_BUFFER_SIZE,ALSAPCM_BUF_MIN,ALSAPCM_BUF_MAX); // frames
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_BUFFER_BYTES,0,UINT_MAX);
+  alsapcm_hw_params_set_interval(hwparams,SNDRV_PCM_HW_PARAM_TICK_TIME,0,UINT_MAX); // us
+  if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_HW_REFINE,hwparams)<0) {
+    return alsapcm_error(alsapcm,"SNDRV_PCM_IOCTL_HW_REFINE",0);
+  }
+  return 0;
+}
+
+/* Init: Choose a single value for a refined param, then refine again so the rest stay consistent with it.
+ */
+ 
+static int alsapcm_hw_params_settle(struct alsapcm *alsapcm,struct snd_pcm_hw_params *hwparams,int k,int v) {
+  alsapcm_hw_params_set_nearest_interval(hwparams,k,v);
+  if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_HW_REFINE,hwparams)<0) {
+    return alsapcm_error(alsapcm,"SNDRV_PCM_IOCTL_HW_REFINE",0);
+  }
+  return 0;
+}
+
+/* Init: Transfer size and buffer, after the device settles its params. Same for real and null devices.
+ * Transfers are half the buffer by default, which has served us well in write() mode.
+ * Asking for a period size, or using mmap, we transfer one device period at a time instead.
+ */
+ 
+static int alsapcm_configure_transfer(
+  struct alsapcm *alsapcm,
+  const struct alsapcm_setup *setup,
+  int devperiod
+) {
+  if ((setup&&(setup->periodsize>0))||alsapcm->mmap) {
+    alsapcm->periodframec=devperiod;
+  } else {
+    alsapcm->periodframec=alsapcm->hwbufframec>>1;
+  }
+  if ((alsapcm->periodframec<1)||(alsapcm->periodframec>alsapcm->hwbufframec)) {
+    alsapcm->periodframec=alsapcm->hwbufframec>>1;
+  }
+  alsapcm->bufa=alsapcm->periodframec*alsapcm->chanc;
+  if (alsapcm->buf) free(alsapcm->buf);
+  if (!(alsapcm->buf=malloc(alsapcm->bufa<<1))) return -1;
+  return 0;
+}
+
 /* Init: With device open, send the handshake ioctls to configure it.
  */
  
@@ -233,37 +327,45 @@ static int alsapcm_configure_device(
   struct alsapcm *alsapcm,
   const struct alsapcm_setup *setup
 ) {
+  alsapcm->mmap=(setup&&setup->mmap)?1:0;
+  
+  if (alsapcm->null) {
+    if (alsapcm_null_configure(alsapcm,setup)<0) return -1;
+    int devperiod=0;
+    if (setup&&(setup->periodsize>0)) devperiod=setup->periodsize;
+    else if (setup&&(setup->periodc>0)) devperiod=alsapcm->hwbufframec/setup->periodc;
+    else devperiod=alsapcm->hwbufframec>>1;
+    if (alsapcm_configure_transfer(alsapcm,setup,devperiod)<0) return -1;
+    if (alsapcm_mmap_init(alsapcm)<0) return -1;
+    return 0;
+  }
 
-  /* Refine hw params against the broadest set of criteria, anything we can technically handle.
-   * (we impose a hard requirement for s16 interleaved; that's about it).
-   */
   struct snd_pcm_hw_params hwparams;
-  alsapcm_hw_params_none(&hwparams);
-  hwparams.flags=SNDRV_PCM_HW_PARAMS_NORESAMPLE;
-  alsapcm_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_ACCESS,SNDRV_PCM_ACCESS_RW_INTERLEAVED,1);
-  alsapcm_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_FORMAT,SNDRV_PCM_FORMAT_S16,1);
-  alsapcm_hw_params_set_mask(&hwparams,SNDRV_PCM_HW_PARAM_SUBFORMAT,SNDRV_PCM_SUBFORMAT_STD,1);
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_SAMPLE_BITS,16,16);
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_FRAME_BITS,0,UINT_MAX);
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_CHANNELS,ALSAPCM_CHANC_MIN,ALSAPCM_CHANC_MAX);
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_RATE,ALSAPCM_RATE_MIN,ALSAPCM_RATE_MAX);
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_PERIOD_TIME,0,UINT_MAX); // us between interrupts
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_PERIOD_SIZE,0,UINT_MAX); // frames between interrupts
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_PERIOD_BYTES,0,UINT_MAX); // bytes between interrupts
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_PERIODS,0,UINT_MAX); // interrupts per buffer
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_BUFFER_TIME,0,UINT_MAX); // us
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_BUFFER_SIZE,ALSAPCM_BUF_MIN,ALSAPCM_BUF_MAX); // frames
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_BUFFER_BYTES,0,UINT_MAX);
-  alsapcm_hw_params_set_interval(&hwparams,SNDRV_PCM_HW_PARAM_TICK_TIME,0,UINT_MAX); // us
-              
-  if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_HW_REFINE,&hwparams)<0) {
-    return alsapcm_error(alsapcm,"SNDRV_PCM_IOCTL_HW_REFINE",0);
+  if (alsapcm_refine_hw_params(alsapcm,&hwparams)<0) {
+    if (!alsapcm->mmap) return -1;
+    alsapcm_error(alsapcm,"","mmap access refused, falling back to write().");
+    alsapcm->mmap=0;
+    if (alsapcm_refine_hw_params(alsapcm,&hwparams)<0) return -1;
   }
 
   if (setup) {
     if (setup->rate>0) alsapcm_hw_params_set_nearest_interval(&hwparams,SNDRV_PCM_HW_PARAM_RATE,setup->rate);
     if (setup->chanc>0) alsapcm_hw_params_set_nearest_interval(&hwparams,SNDRV_PCM_HW_PARAM_CHANNELS,setup->chanc);
-    if (setup->buffersize>0) alsapcm_hw_params_set_nearest_interval(&hwparams,SNDRV_PCM_HW_PARAM_BUFFER_SIZE,setup->buffersize);
+    if ((setup->periodsize>0)||(setup->periodc>0)) {
+      // Period constraints depend on rate and channels, so refine those first, and after each period param.
+      if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_HW_REFINE,&hwparams)<0) {
+        return alsapcm_error(alsapcm,"SNDRV_PCM_IOCTL_HW_REFINE",0);
+      }
+      if (setup->periodsize>0) {
+        if (alsapcm_hw_params_settle(alsapcm,&hwparams,SNDRV_PCM_HW_PARAM_PERIOD_SIZE,setup->periodsize)<0) return -1;
+      }
+      if (setup->periodc>0) {
+        if (alsapcm_hw_params_settle(alsapcm,&hwparams,SNDRV_PCM_HW_PARAM_PERIODS,setup->periodc)<0) return -1;
+      }
+    }
+    if ((setup->buffersize>0)&&((setup->periodsize<1)||(setup->periodc<1))) {
+      alsapcm_hw_params_set_nearest_interval(&hwparams,SNDRV_PCM_HW_PARAM_BUFFER_SIZE,setup->buffersize);
+    }
   }
 
   if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_HW_PARAMS,&hwparams)<0) {
@@ -279,6 +381,8 @@ static int alsapcm_configure_device(
   alsapcm->rate=hwparams.rate_num/hwparams.rate_den;
   if (alsapcm_hw_params_assert_exact_interval(&alsapcm->chanc,&hwparams,SNDRV_PCM_HW_PARAM_CHANNELS)<0) return -1;
   if (alsapcm_hw_params_assert_exact_interval(&alsapcm->hwbufframec,&hwparams,SNDRV_PCM_HW_PARAM_BUFFER_SIZE)<0) return -1;
+  int devperiod=0;
+  alsapcm_hw_params_assert_exact_interval(&devperiod,&hwparams,SNDRV_PCM_HW_PARAM_PERIOD_SIZE);
   
   // Validate.
   if ((alsapcm->rate<ALSAPCM_RATE_MIN)||(alsapcm->rate>ALSAPCM_RATE_MAX)) {
@@ -291,12 +395,10 @@ static int alsapcm_configure_device(
     return alsapcm_error(alsapcm,"","Rejecting buffer size %d, limit %d..%d",alsapcm->hwbufframec,ALSAPCM_BUF_MIN,ALSAPCM_BUF_MAX);
   }
   
-  alsapcm->bufa=(alsapcm->hwbufframec*alsapcm->chanc)>>1;
-  if (alsapcm->buf) free(alsapcm->buf);
-  if (!(alsapcm->buf=malloc(alsapcm->bufa<<1))) return -1;
+  if (alsapcm_configure_transfer(alsapcm,setup,devperiod)<0) return -1;
   
   /* Now set some driver software parameters.
-   * The main thing is we want avail_min to be half of the hardware buffer size.
+   * The main thing is we want avail_min to be one transfer, by default half of the hardware buffer size.
    * We will send half-hardware-buffers at a time, and this arrangement should click nicely, let us sleep as much as possible.
    * (in limited experimentation so far, I have found this to be so, and it makes a big impact on overall performance).
    * I've heard that swparams can be used to automatically recover from xrun, but haven't seen that work yet. Not trying here.
@@ -304,7 +406,7 @@ static int alsapcm_configure_device(
   struct snd_pcm_sw_params swparams={
     .tstamp_mode=SNDRV_PCM_TSTAMP_NONE,
     .sleep_min=0,
-    .avail_min=alsapcm->hwbufframec>>1,
+    .avail_min=alsapcm->periodframec,
     .xfer_align=1,
     .start_threshold=0,
     .stop_threshold=alsapcm->hwbufframec,
@@ -318,6 +420,14 @@ static int alsapcm_configure_device(
   if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_SW_PARAMS,&swparams)<0) {
     return alsapcm_error(alsapcm,"SNDRV_PCM_IOCTL_SW_PARAMS",0);
   }
+  // The driver reports its real boundary, where the pointers wrap. We need it for mmap.
+  alsapcm->boundary=swparams.boundary;
+  if (alsapcm->boundary<=alsapcm->hwbufframec) {
+    alsapcm->boundary=alsapcm->hwbufframec;
+    while (alsapcm->boundary<=LONG_MAX/2/alsapcm->hwbufframec) alsapcm->boundary<<=1;
+  }
+  
+  if (alsapcm_mmap_init(alsapcm)<0) return -1;
   
   /* And finally, reset the driver and confirm that it enters PREPARED state.
    */
@@ -351,13 +461,22 @@ static int alsapcm_init_alsa(
 /* Prepare mutex and thread.
  */
  
-static int alsapcm_init_thread(struct alsapcm *alsapcm) {
+static int alsapcm_init_thread(struct alsapcm *alsapcm,const struct alsapcm_setup *setup) {
   pthread_mutexattr_t mattr;
   pthread_mutexattr_init(&mattr);
   pthread_mutexattr_settype(&mattr,PTHREAD_MUTEX_RECURSIVE);
   if (pthread_mutex_init(&alsapcm->iomtx,&mattr)) return -1;
   pthread_mutexattr_destroy(&mattr);
   if (pthread_create(&alsapcm->iothd,0,alsapcm_iothd,alsapcm)) return -1;
+  if (setup&&(setup->rtprio>0)) {
+    struct sched_param param={.sched_priority=setup->rtprio};
+    int err=pthread_setschedparam(alsapcm->iothd,SCHED_FIFO,&param);
+    if (err) {
+      fprintf(stderr,"alsapcm: Failed to set SCHED_FIFO priority %d for I/O thread: %s\n",setup->rtprio,strerror(err));
+    } else {
+      alsapcm->rtprio=setup->rtprio;
+    }
+  }
   return 0;
 }
 
@@ -380,7 +499,7 @@ struct alsapcm *alsapcm_new(
     return 0;
   }
   
-  if (alsapcm_init_thread(alsapcm)<0) {
+  if (alsapcm_init_thread(alsapcm,setup)<0) {
     alsapcm_del(alsapcm);
     return 0;
   }
@@ -411,6 +530,36 @@ int alsapcm_get_running(const struct alsapcm *alsapcm) {
   return alsapcm->running;
 }
 
+int alsapcm_get_buffer_size(const struct alsapcm *alsapcm) {
+  if (!alsapcm) return 0;
+  return alsapcm->hwbufframec;
+}
+
+int alsapcm_get_period_size(const struct alsapcm *alsapcm) {
+  if (!alsapcm) return 0;
+  return alsapcm->periodframec;
+}
+
+int alsapcm_get_mmap(const struct alsapcm *alsapcm) {
+  if (!alsapcm) return 0;
+  return alsapcm->mmap;
+}
+
+int alsapcm_get_xrun_count(const struct alsapcm *alsapcm) {
+  if (!alsapcm) return 0;
+  return __atomic_load_n(&alsapcm->xrunc,__ATOMIC_RELAXED);
+}
+
+void alsapcm_get_latency(int *last,int *avg,int *max,const struct alsapcm *alsapcm) {
+  if (!alsapcm) return;
+  if (last) *last=__atomic_load_n(&alsapcm->latency_last,__ATOMIC_RELAXED);
+  if (avg) {
+    int64_t samplec=__atomic_load_n(&alsapcm->latency_samplec,__ATOMIC_RELAXED);
+    *avg=samplec?(int)(__atomic_load_n(&alsapcm->latency_sum,__ATOMIC_RELAXED)/samplec):0;
+  }
+  if (max) *max=__atomic_load_n(&alsapcm->latency_max,__ATOMIC_RELAXED);
+}
+
 void alsapcm_set_running(struct alsapcm *alsapcm,int run) {
   if (!alsapcm) return;
   alsapcm->running=run?1:0;
@@ -28,6 +28,10 @@ static int _alsa_init(struct eh_audio_driver *driver,const struct eh_audio_setup
     .chanc=config->chanc,
     .device=config->device,
     .buffersize=config->buffersize,
+    .periodsize=config->periodsize,
+    .periodc=config->periodc,
+    .mmap=config->mmap,
+    .rtprio=config->rtprio,
   };
   
   if (!(DRIVER->alsapcm=alsapcm_new(&delegate,&setup))) return -1;
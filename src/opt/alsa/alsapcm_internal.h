@@ -32,6 +32,7 @@ struct alsapcm {
   int chanc;
   int running;
   int hwbufframec;
+  int periodframec; // Frames per transfer, not necessarily the device's period.
   char *device;
   int protocol_version;
   pthread_t iothd;
@@ -39,6 +40,18 @@ struct alsapcm {
   int ioerror;
   int16_t *buf;
   int bufa; // samples
+  int mmap; // Transferring via (data) rather than write().
+  int null; // No device file, see alsapcm_mmap.c.
+  int rtprio;
+  void *data; // Hardware buffer for mmap mode or the null device, (hwbufframec) frames.
+  int datalen; // bytes
+  struct snd_pcm_sync_ptr syncptr; // Last known pointers and state, also for the null device.
+  snd_pcm_uframes_t boundary;
+  int64_t null_start_ns,null_writtenc; // Null device, (null_start_ns) zero if stopped.
+  // Statistics, written by the I/O thread only. Public accessors read from other threads, so __atomic everywhere:
+  int xrunc;
+  int latency_last,latency_max; // frames
+  int64_t latency_sum,latency_samplec;
 };
 
 // Log if enabled, and always returns -1. Null (fmt) to use errno.
@@ -52,6 +65,18 @@ int alsapcm_hw_params_assert_exact_interval(int *v,const struct snd_pcm_hw_param
 void alsapcm_hw_params_set_mask(struct snd_pcm_hw_params *params,int k,int bit,int v);
 void alsapcm_hw_params_set_interval(struct snd_pcm_hw_params *params,int k,int lo,int hi);
 
+/* alsapcm_mmap.c: Pointer tracking for mmap mode and the null device.
+ * alsapcm_mmap_update() is one pass of the I/O thread in mmap mode.
+ * alsapcm_null_write() stands in for write() on the null device.
+ * alsapcm_latency_sample() is for any mode, call after each transfer.
+ */
+int alsapcm_mmap_init(struct alsapcm *alsapcm);
+void alsapcm_mmap_cleanup(struct alsapcm *alsapcm);
+int alsapcm_mmap_update(struct alsapcm *alsapcm);
+int alsapcm_null_configure(struct alsapcm *alsapcm,const struct alsapcm_setup *setup);
+int alsapcm_null_write(struct alsapcm *alsapcm,const void *src,int srcc);
+void alsapcm_latency_sample(struct alsapcm *alsapcm);
+
 // Having already refined the given param, choose a single value for it as close as possible to (v).
 void alsapcm_hw_params_set_nearest_interval(struct snd_pcm_hw_params *params,int k,unsigned int v);
 
@@ -0,0 +1,261 @@
+/* alsapcm_mmap.c
+ * mmap transfers: We map the device's buffer and let the client write straight into it, one period at a time.
+ * Pointers go back and forth via SNDRV_PCM_IOCTL_SYNC_PTR. That's what libasound falls back to when it can't
+ * map the status and control pages, and it's one ioctl per period either way.
+ *
+ * Also the "null" device, which keeps the same pointers against a clock instead of hardware.
+ */
+
+#include "alsapcm_internal.h"
+#include <sys/mman.h>
+#include <time.h>
+
+static int64_t alsapcm_now_ns() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return ts.tv_sec*1000000000ll+ts.tv_nsec;
+}
+
+/* Map the buffer, or allocate one for the null device.
+ */
+
+int alsapcm_mmap_init(struct alsapcm *alsapcm) {
+  alsapcm->datalen=alsapcm->hwbufframec*alsapcm->chanc*sizeof(int16_t);
+  if (alsapcm->null) {
+    if (!(alsapcm->data=calloc(1,alsapcm->datalen))) return -1;
+    return 0;
+  }
+  if (!alsapcm->mmap) return 0;
+  void *data=mmap(0,alsapcm->datalen,PROT_READ|PROT_WRITE,MAP_SHARED,alsapcm->fd,SNDRV_PCM_MMAP_OFFSET_DATA);
+  if (data==MAP_FAILED) return alsapcm_error(alsapcm,"mmap",0);
+  alsapcm->data=data;
+  return 0;
+}
+
+void alsapcm_mmap_cleanup(struct alsapcm *alsapcm) {
+  if (!alsapcm->data) return;
+  if (alsapcm->null) free(alsapcm->data);
+  else munmap(alsapcm->data,alsapcm->datalen);
+  alsapcm->data=0;
+}
+
+/* Null device: Configure, and advance the hardware pointer by the clock.
+ * Underrun when it catches up to us, same as a real device with (stop_threshold) at the buffer size.
+ */
+
+int alsapcm_null_configure(struct alsapcm *alsapcm,const struct alsapcm_setup *setup) {
+  alsapcm->rate=44100;
+  alsapcm->chanc=1;
+  alsapcm->hwbufframec=2048;
+  if (setup) {
+    if (setup->rate>0) alsapcm->rate=setup->rate;
+    if (setup->chanc>0) alsapcm->chanc=setup->chanc;
+    if ((setup->periodsize>0)&&(setup->periodc>0)) alsapcm->hwbufframec=setup->periodsize*setup->periodc;
+    else if (setup->buffersize>0) alsapcm->hwbufframec=setup->buffersize;
+  }
+  if (alsapcm->rate<ALSAPCM_RATE_MIN) alsapcm->rate=ALSAPCM_RATE_MIN;
+  else if (alsapcm->rate>ALSAPCM_RATE_MAX) alsapcm->rate=ALSAPCM_RATE_MAX;
+  if (alsapcm->chanc<ALSAPCM_CHANC_MIN) alsapcm->chanc=ALSAPCM_CHANC_MIN;
+  else if (alsapcm->chanc>ALSAPCM_CHANC_MAX) alsapcm->chanc=ALSAPCM_CHANC_MAX;
+  if (alsapcm->hwbufframec<ALSAPCM_BUF_MIN) alsapcm->hwbufframec=ALSAPCM_BUF_MIN;
+  else if (alsapcm->hwbufframec>ALSAPCM_BUF_MAX) alsapcm->hwbufframec=ALSAPCM_BUF_MAX;
+  alsapcm->boundary=alsapcm->hwbufframec;
+  while (alsapcm->boundary<=LONG_MAX/2/alsapcm->hwbufframec) alsapcm->boundary<<=1;
+  alsapcm->syncptr.s.status.state=SNDRV_PCM_STATE_PREPARED;
+  fprintf(stderr,"alsapcm: Using null device, no hardware.\n");
+  return 0;
+}
+
+static void alsapcm_null_sync(struct alsapcm *alsapcm) {
+  struct snd_pcm_mmap_status *status=&alsapcm->syncptr.s.status;
+  int64_t playedc=0;
+  if (alsapcm->null_start_ns) {
+    playedc=((alsapcm_now_ns()-alsapcm->null_start_ns)*alsapcm->rate)/1000000000ll;
+    if (playedc>=alsapcm->null_writtenc) {
+      status->state=SNDRV_PCM_STATE_XRUN;
+      playedc=alsapcm->null_writtenc;
+    }
+  }
+  status->hw_ptr=playedc%alsapcm->boundary;
+  alsapcm->syncptr.c.control.appl_ptr=alsapcm->null_writtenc%alsapcm->boundary;
+}
+
+/* Refresh (syncptr) from the driver, and optionally send our (appl_ptr) first.
+ * An underrun during sync is not an error, we report it via (syncptr.s.status.state).
+ */
+
+static int alsapcm_sync(struct alsapcm *alsapcm,int commit) {
+  if (alsapcm->null) {
+    alsapcm_null_sync(alsapcm);
+    return 0;
+  }
+  alsapcm->syncptr.flags=SNDRV_PCM_SYNC_PTR_HWSYNC|SNDRV_PCM_SYNC_PTR_AVAIL_MIN;
+  if (!commit) alsapcm->syncptr.flags|=SNDRV_PCM_SYNC_PTR_APPL;
+  if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_SYNC_PTR,&alsapcm->syncptr)<0) {
+    if (errno==EPIPE) {
+      alsapcm->syncptr.s.status.state=SNDRV_PCM_STATE_XRUN;
+      return 0;
+    }
+    return alsapcm_error(alsapcm,"SNDRV_PCM_IOCTL_SYNC_PTR",0);
+  }
+  return 0;
+}
+
+/* Frames we can write, as of the last sync.
+ */
+
+static int alsapcm_avail(const struct alsapcm *alsapcm) {
+  int64_t avail=(int64_t)alsapcm->syncptr.s.status.hw_ptr+alsapcm->hwbufframec-(int64_t)alsapcm->syncptr.c.control.appl_ptr;
+  if (avail<0) avail+=alsapcm->boundary;
+  else if (avail>=(int64_t)alsapcm->boundary) avail-=alsapcm->boundary;
+  return (int)avail;
+}
+
+/* Advance (appl_ptr) past some frames we've filled in.
+ */
+
+static int alsapcm_commit(struct alsapcm *alsapcm,int framec) {
+  if (alsapcm->null) {
+    alsapcm->null_writtenc+=framec;
+    alsapcm_null_sync(alsapcm);
+    return 0;
+  }
+  snd_pcm_uframes_t appl=alsapcm->syncptr.c.control.appl_ptr+framec;
+  if (appl>=alsapcm->boundary) appl-=alsapcm->boundary;
+  alsapcm->syncptr.c.control.appl_ptr=appl;
+  return alsapcm_sync(alsapcm,1);
+}
+
+/* Start playback. We don't let the driver do it automatically in mmap mode, it doesn't see our writes.
+ */
+
+static int alsapcm_start(struct alsapcm *alsapcm) {
+  if (alsapcm->null) {
+    alsapcm->null_start_ns=alsapcm_now_ns();
+    alsapcm->syncptr.s.status.state=SNDRV_PCM_STATE_RUNNING;
+    return 0;
+  }
+  if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_START)<0) return alsapcm_error(alsapcm,"SNDRV_PCM_IOCTL_START",0);
+  return 0;
+}
+
+/* Recover from underrun. Pointers reset and playback is stopped; we'll start again when the buffer fills.
+ */
+
+static int alsapcm_recover(struct alsapcm *alsapcm) {
+  __atomic_add_fetch(&alsapcm->xrunc,1,__ATOMIC_RELAXED);
+  if (alsapcm->null) {
+    alsapcm->null_start_ns=0;
+    alsapcm->null_writtenc=0;
+    alsapcm->syncptr.s.status.state=SNDRV_PCM_STATE_PREPARED;
+    alsapcm_null_sync(alsapcm);
+  } else {
+    if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_PREPARE)<0) {
+      return alsapcm_error(alsapcm,"io","Failed to recover from underrun: %m");
+    }
+    if (alsapcm_sync(alsapcm,0)<0) return -1;
+  }
+  alsapcm_error(alsapcm,"io","Recovered from underrun");
+  return 0;
+}
+
+/* Sleep until at least (framec) can be written, or thereabouts.
+ */
+
+static int alsapcm_wait(struct alsapcm *alsapcm,int framec) {
+  if (alsapcm->null) {
+    int avail=alsapcm_avail(alsapcm);
+    if (avail>=framec) return 0;
+    int64_t ns=((int64_t)(framec-avail)*1000000000ll)/alsapcm->rate;
+    struct timespec ts={.tv_sec=ns/1000000000ll,.tv_nsec=ns%1000000000ll};
+    nanosleep(&ts,0);
+    return 0;
+  }
+  // The driver signals POLLOUT when (avail_min) frames are free, and we set that to our period.
+  struct pollfd pollfd={.fd=alsapcm->fd,.events=POLLOUT};
+  if (poll(&pollfd,1,1000)<0) {
+    if (errno==EINTR) return 0;
+    return alsapcm_error(alsapcm,"poll",0);
+  }
+  return 0;
+}
+
+/* One pass of the I/O thread in mmap mode.
+ */
+
+int alsapcm_mmap_update(struct alsapcm *alsapcm) {
+  if (alsapcm_sync(alsapcm,0)<0) return -1;
+  if (alsapcm->syncptr.s.status.state==SNDRV_PCM_STATE_XRUN) {
+    if (alsapcm_recover(alsapcm)<0) return -1;
+  }
+
+  int avail=alsapcm_avail(alsapcm);
+  if (avail<alsapcm->periodframec) {
+    if (alsapcm->syncptr.s.status.state==SNDRV_PCM_STATE_PREPARED) return alsapcm_start(alsapcm);
+    return alsapcm_wait(alsapcm,alsapcm->periodframec);
+  }
+
+  // Fill one period in place. If it straddles the end of the buffer, take what's contiguous and the next pass gets the rest.
+  int offset=alsapcm->syncptr.c.control.appl_ptr%alsapcm->hwbufframec;
+  int framec=alsapcm->periodframec;
+  if (framec>alsapcm->hwbufframec-offset) framec=alsapcm->hwbufframec-offset;
+  int16_t *dst=(int16_t*)alsapcm->data+offset*alsapcm->chanc;
+  int samplec=framec*alsapcm->chanc;
+  if (pthread_mutex_lock(&alsapcm->iomtx)) {
+    usleep(1000);
+    return 0;
+  }
+  if (alsapcm->running) {
+    alsapcm->delegate.pcm_out(dst,samplec,alsapcm->delegate.userdata);
+  } else {
+    memset(dst,0,samplec<<1);
+  }
+  pthread_mutex_unlock(&alsapcm->iomtx);
+
+  if (alsapcm_commit(alsapcm,framec)<0) return -1;
+  alsapcm_latency_sample(alsapcm);
+  return 0;
+}
+
+/* Null device in write() mode: Copy what fits, start on the first write, and block when full.
+ * Returns bytes consumed, possibly zero.
+ */
+
+int alsapcm_null_write(struct alsapcm *alsapcm,const void *src,int srcc) {
+  alsapcm_null_sync(alsapcm);
+  if (alsapcm->syncptr.s.status.state==SNDRV_PCM_STATE_XRUN) {
+    if (alsapcm_recover(alsapcm)<0) return -1;
+  }
+  int avail=alsapcm_avail(alsapcm);
+  if (avail<1) {
+    if (alsapcm_wait(alsapcm,alsapcm->periodframec)<0) return -1;
+    return 0;
+  }
+  int framesize=alsapcm->chanc*sizeof(int16_t);
+  int offset=alsapcm->syncptr.c.control.appl_ptr%alsapcm->hwbufframec;
+  int framec=srcc/framesize;
+  if (framec>avail) framec=avail;
+  if (framec>alsapcm->hwbufframec-offset) framec=alsapcm->hwbufframec-offset;
+  memcpy((char*)alsapcm->data+offset*framesize,src,framec*framesize);
+  if (alsapcm_commit(alsapcm,framec)<0) return -1;
+  if (alsapcm->syncptr.s.status.state==SNDRV_PCM_STATE_PREPARED) alsapcm_start(alsapcm);
+  return framec*framesize;
+}
+
+/* Record output latency: Frames queued ahead of the hardware, right after a transfer.
+ */
+
+void alsapcm_latency_sample(struct alsapcm *alsapcm) {
+  int queued;
+  if (alsapcm->mmap||alsapcm->null) {
+    queued=alsapcm->hwbufframec-alsapcm_avail(alsapcm);
+  } else {
+    snd_pcm_sframes_t delay=0;
+    if (ioctl(alsapcm->fd,SNDRV_PCM_IOCTL_DELAY,&delay)<0) return;
+    queued=(int)delay;
+  }
+  __atomic_store_n(&alsapcm->latency_last,queued,__ATOMIC_RELAXED);
+  if (queued>alsapcm->latency_max) __atomic_store_n(&alsapcm->latency_max,queued,__ATOMIC_RELAXED);
+  __atomic_add_fetch(&alsapcm->latency_sum,queued,__ATOMIC_RELAXED);
+  __atomic_add_fetch(&alsapcm->latency_samplec,1,__ATOMIC_RELAXED);
+}
@@ -1,8 +1,9 @@
 /* cheapsynth.h
  * "Cheap" as in easy to write. Not necessarily high-performance.
- * The only thing we can play are non-sustaining PCM dumps.
- * We generate those dumps synchronously when you request them.
- * Sound effects are a single voice of FM.
+ * Sound effects are a single voice of FM, non-sustaining.
+ * By default we print them to PCM synchronously when you intern them, and play those dumps.
+ * In real-time mode, we instead render the FM live, in blocks, from a fixed pool of voices.
+ * That costs a little CPU per voice played, but interning is free.
  * Only mono output is supported, and you can ask for float or int16_t.
  */
  
@@ -39,6 +40,22 @@ struct cheapsynth_sound_config {
 void cheapsynth_del(struct cheapsynth *cs);
 struct cheapsynth *cheapsynth_new(int rate,int chanc);
 
+/* Nonzero to render sounds interned from now on in real time, instead of printing them.
+ * Sounds already interned keep whatever mode they had.
+ */
+void cheapsynth_set_realtime(struct cheapsynth *cs,int realtime);
+
+/* Nonzero to print on a worker thread instead, so interning is always cheap.
+ * Until its PCM is ready, a sound plays in real time.
+ * Ignored for sounds interned in real-time mode.
+ */
+void cheapsynth_set_async(struct cheapsynth *cs,int async);
+
+/* Keep printed PCM in this directory, keyed by the config (except id) and our rate.
+ * We create the directory if needed but not its parents. Null to disable, the default.
+ */
+int cheapsynth_set_cache_directory(struct cheapsynth *cs,const char *path);
+
 /* Print a sound effect or pull it from our cache.
  * Returns a WEAK reference that you can deliver to cheapsynth_sound_play().
  * Once created, sound effects exist and are immutable for as long as the synthesizer lives.
@@ -59,4 +76,9 @@ void cheapsynth_sound_play(struct cheapsynth *cs,struct cheapsynth_sound *sound)
 void cheapsynth_updatef(float *v,int c,struct cheapsynth *cs);
 void cheapsynth_updatei(int16_t *v,int c,struct cheapsynth *cs);
 
+/* Render the real-time voice pool flat out and log how many voices one core can sustain.
+ * Also logs the cost of printing the same sound, for comparison.
+ */
+int cheapsynth_benchmark(int rate);
+
 #endif
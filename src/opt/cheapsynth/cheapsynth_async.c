@@ -0,0 +1,66 @@
+#include "cheapsynth_internal.h"
+
+/* Worker thread.
+ * Take sounds off the front of the queue one at a time, and don't hold the lock while printing.
+ */
+
+static void *cheapsynth_async_main(void *arg) {
+  struct cheapsynth *cs=arg;
+  pthread_mutex_lock(&cs->mutex);
+  while (1) {
+    while (!cs->worker_stop&&!cs->queuec) pthread_cond_wait(&cs->cond,&cs->mutex);
+    if (cs->worker_stop) break;
+    struct cheapsynth_sound *sound=cs->queuev[0];
+    cs->queuec--;
+    memmove(cs->queuev,cs->queuev+1,sizeof(void*)*cs->queuec);
+    pthread_mutex_unlock(&cs->mutex);
+    float *v=cheapsynth_sound_get_pcm(cs,sound);
+    if (v) __atomic_store_n(&sound->v,v,__ATOMIC_RELEASE);
+    pthread_mutex_lock(&cs->mutex);
+  }
+  pthread_mutex_unlock(&cs->mutex);
+  return 0;
+}
+
+/* Stop, and drop whatever's still queued. Those sounds stay real-time.
+ */
+
+void cheapsynth_async_stop(struct cheapsynth *cs) {
+  if (!cs->worker_running) return;
+  pthread_mutex_lock(&cs->mutex);
+  cs->worker_stop=1;
+  cs->queuec=0;
+  pthread_cond_signal(&cs->cond);
+  pthread_mutex_unlock(&cs->mutex);
+  pthread_join(cs->worker,0);
+  cs->worker_running=0;
+}
+
+/* Enqueue.
+ */
+
+int cheapsynth_async_enqueue(struct cheapsynth *cs,struct cheapsynth_sound *sound) {
+  pthread_mutex_lock(&cs->mutex);
+  if (cs->queuec>=cs->queuea) {
+    int na=cs->queuea+16;
+    void *nv=realloc(cs->queuev,sizeof(void*)*na);
+    if (!nv) {
+      pthread_mutex_unlock(&cs->mutex);
+      return -1;
+    }
+    cs->queuev=nv;
+    cs->queuea=na;
+  }
+  if (!cs->worker_running) {
+    cs->worker_stop=0;
+    if (pthread_create(&cs->worker,0,cheapsynth_async_main,cs)) {
+      pthread_mutex_unlock(&cs->mutex);
+      return -1;
+    }
+    cs->worker_running=1;
+  }
+  cs->queuev[cs->queuec++]=sound;
+  pthread_cond_signal(&cs->cond);
+  pthread_mutex_unlock(&cs->mutex);
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "cheapsynth_internal.h"
+#include <time.h>
+
+/* Something like the menu's sounds, but as long as we allow, so voices don't drop out mid-run.
+ */
+
+static const struct cheapsynth_sound_config cheapsynth_benchmark_relative={
+  .id=1,
+  .master=0.030f,
+  .modrate=2.0f,
+  .modabsolute=0,
+  .level={{20,1.0f},{40,0.30f},{2900,0.0f}},
+  .pitch={{0,300.0f},{1500,900.0f},{1460,200.0f}},
+  .mod={{0,0.5f},{500,5.0f},{2460,1.0f}},
+};
+
+static const struct cheapsynth_sound_config cheapsynth_benchmark_absolute={
+  .id=2,
+  .master=0.030f,
+  .modrate=37.0f,
+  .modabsolute=1,
+  .level={{20,1.0f},{40,0.30f},{2900,0.0f}},
+  .pitch={{0,300.0f},{1500,900.0f},{1460,200.0f}},
+  .mod={{0,0.5f},{500,5.0f},{2460,1.0f}},
+};
+
+static int64_t cheapsynth_benchmark_now_ns() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+  return (int64_t)ts.tv_sec*1000000000ll+ts.tv_nsec;
+}
+
+/* One case: Fill the pool, render 2.5 seconds of mono in driver-sized chunks.
+ */
+
+static int cheapsynth_benchmark_case(int rate,const struct cheapsynth_sound_config *config,const char *desc) {
+  struct cheapsynth *cs=cheapsynth_new(rate,1);
+  if (!cs) return -1;
+  cheapsynth_set_realtime(cs,1);
+  struct cheapsynth_sound *sound=cheapsynth_sound_intern(cs,config);
+  if (!sound) {
+    cheapsynth_del(cs);
+    return -1;
+  }
+  int i=CHEAPSYNTH_FM_VOICE_LIMIT+1; // One extra, to steal.
+  while (i-->0) cheapsynth_sound_play(cs,sound);
+  int voicec=cs->fmc;
+  int soundc=sound->c;
+
+  float v[CHEAPSYNTH_QBUF_SIZE];
+  int framec=(rate*5)/2;
+  float peak=0.0f;
+  int64_t starttime=cheapsynth_benchmark_now_ns();
+  for (i=framec;i>0;i-=CHEAPSYNTH_QBUF_SIZE) {
+    int c=(i>CHEAPSYNTH_QBUF_SIZE)?CHEAPSYNTH_QBUF_SIZE:i;
+    cheapsynth_updatef(v,c,cs);
+    if (v[0]>peak) peak=v[0];
+  }
+  int64_t elapsed=cheapsynth_benchmark_now_ns()-starttime;
+  int stillc=cs->fmc;
+
+  // Printing the same sound, which is what we'd otherwise do at intern.
+  int64_t printstart=cheapsynth_benchmark_now_ns();
+  struct cheapsynth_sound *printed=cheapsynth_sound_print(cs,config);
+  int64_t printtime=cheapsynth_benchmark_now_ns()-printstart;
+  cheapsynth_sound_del(printed);
+  cheapsynth_del(cs);
+
+  if ((elapsed<1)||(voicec<1)||(stillc!=voicec)) {
+    fprintf(stderr,"  %-8s voices=%d after=%d elapsed=%lld ns: invalid run\n",desc,voicec,stillc,(long long)elapsed);
+    return -1;
+  }
+  double ns_per_voice_frame=(double)elapsed/((double)voicec*framec);
+  double voices_per_core=1000000000.0/(ns_per_voice_frame*rate);
+  fprintf(stderr,
+    "  %-8s %6.2f ns/voice/frame, %6.0f voices/core. Printing %d frames: %.2f ms. (peak %.3f)\n",
+    desc,ns_per_voice_frame,voices_per_core,soundc,printtime/1000000.0,peak
+  );
+  return 0;
+}
+
+/* Benchmark, main entry point.
+ */
+
+int cheapsynth_benchmark(int rate) {
+  if (rate<1) rate=48000;
+  fprintf(stderr,"cheapsynth real-time benchmark, %d Hz, %d voices, block %d:\n",rate,CHEAPSYNTH_FM_VOICE_LIMIT,CHEAPSYNTH_BLOCK_SIZE);
+  if (cheapsynth_benchmark_case(rate,&cheapsynth_benchmark_relative,"relative")<0) return -1;
+  if (cheapsynth_benchmark_case(rate,&cheapsynth_benchmark_absolute,"absolute")<0) return -1;
+  return 0;
+}
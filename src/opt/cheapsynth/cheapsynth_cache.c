@@ -0,0 +1,90 @@
+#include "cheapsynth_internal.h"
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* Cache files are named for a hash of the key, and begin with the key in full.
+ * So a hash collision is just a miss.
+ * Everything is native byte order: The cache is local to one machine.
+ */
+
+#define CHEAPSYNTH_CACHE_MAGIC "CSP1"
+
+struct cheapsynth_cache_header {
+  char magic[4];
+  int rate;
+  int c;
+  struct cheapsynth_sound_config config; // (id) zero.
+};
+
+static void cheapsynth_cache_header_init(struct cheapsynth_cache_header *header,struct cheapsynth *cs,const struct cheapsynth_sound *sound) {
+  memset(header,0,sizeof(struct cheapsynth_cache_header));
+  memcpy(header->magic,CHEAPSYNTH_CACHE_MAGIC,4);
+  header->rate=cs->rate;
+  header->c=sound->c;
+  header->config=sound->config;
+  header->config.id=0;
+}
+
+/* Compose path. FNV-1a over the header, which covers config and rate.
+ */
+
+static int cheapsynth_cache_path(char *dst,int dsta,struct cheapsynth *cs,const struct cheapsynth_cache_header *header) {
+  if (!cs->cache_path) return -1;
+  uint64_t hash=0xcbf29ce484222325ull;
+  const uint8_t *src=(const uint8_t*)header;
+  int i=sizeof(struct cheapsynth_cache_header);
+  for (;i-->0;src++) {
+    hash^=*src;
+    hash*=0x100000001b3ull;
+  }
+  int dstc=snprintf(dst,dsta,"%.*s/%016llx.pcm",cs->cache_pathc,cs->cache_path,(unsigned long long)hash);
+  if ((dstc<1)||(dstc>=dsta)) return -1;
+  return dstc;
+}
+
+/* Load.
+ */
+
+float *cheapsynth_cache_load(struct cheapsynth *cs,const struct cheapsynth_sound *sound) {
+  struct cheapsynth_cache_header expect,header;
+  cheapsynth_cache_header_init(&expect,cs,sound);
+  char path[1024];
+  if (cheapsynth_cache_path(path,sizeof(path),cs,&expect)<0) return 0;
+  FILE *f=fopen(path,"rb");
+  if (!f) return 0;
+  float *v=0;
+  if (
+    (fread(&header,sizeof(header),1,f)==1)&&
+    !memcmp(&header,&expect,sizeof(header))&&
+    (v=malloc(sizeof(float)*sound->c))
+  ) {
+    if (fread(v,sizeof(float),sound->c,f)!=sound->c) {
+      free(v);
+      v=0;
+    }
+  }
+  fclose(f);
+  return v;
+}
+
+/* Save.
+ * Write to a temp file and rename, since the menu's warm spares might be doing the same thing at the same time.
+ */
+
+void cheapsynth_cache_save(struct cheapsynth *cs,const struct cheapsynth_sound *sound,const float *v) {
+  struct cheapsynth_cache_header header;
+  cheapsynth_cache_header_init(&header,cs,sound);
+  char path[1024],tmppath[1100];
+  int pathc=cheapsynth_cache_path(path,sizeof(path),cs,&header);
+  if (pathc<0) return;
+  snprintf(tmppath,sizeof(tmppath),"%s.%d.tmp",path,(int)getpid());
+  mkdir(cs->cache_path,0775);
+  FILE *f=fopen(tmppath,"wb");
+  if (!f) return;
+  int ok=(
+    (fwrite(&header,sizeof(header),1,f)==1)&&
+    (fwrite(v,sizeof(float),sound->c,f)==sound->c)
+  );
+  if (fclose(f)) ok=0;
+  if (!ok||rename(tmppath,path)) unlink(tmppath);
+}
@@ -5,10 +5,18 @@
  
 void cheapsynth_del(struct cheapsynth *cs) {
   if (!cs) return;
+  cheapsynth_async_stop(cs);
+  if (cs->cache_hitc||cs->printc) {
+    fprintf(stderr,"cheapsynth: Printed %d sounds, %d from cache.\n",cs->printc+cs->cache_hitc,cs->cache_hitc);
+  }
   if (cs->soundv) {
-    while (cs->soundc-->0) free(cs->soundv[cs->soundc]);
+    while (cs->soundc-->0) cheapsynth_sound_del(cs->soundv[cs->soundc]);
     free(cs->soundv);
   }
+  if (cs->queuev) free(cs->queuev);
+  if (cs->cache_path) free(cs->cache_path);
+  pthread_mutex_destroy(&cs->mutex);
+  pthread_cond_destroy(&cs->cond);
   free(cs);
 }
 
@@ -23,9 +31,43 @@ struct cheapsynth *cheapsynth_new(int rate,int chanc) {
   if (!cs) return 0;
   cs->rate=rate;
   cs->chanc=chanc;
+  cs->timescale=(float)rate/1000.0f;
+  cs->pitchscale=(M_PI*2.0f)/(float)rate;
+  pthread_mutex_init(&cs->mutex,0);
+  pthread_cond_init(&cs->cond,0);
   return cs;
 }
 
+/* Real-time mode.
+ */
+
+void cheapsynth_set_realtime(struct cheapsynth *cs,int realtime) {
+  if (!cs) return;
+  cs->realtime=realtime?1:0;
+}
+
+/* Background printing and cache.
+ */
+
+void cheapsynth_set_async(struct cheapsynth *cs,int async) {
+  if (!cs) return;
+  cs->async=async?1:0;
+}
+
+int cheapsynth_set_cache_directory(struct cheapsynth *cs,const char *path) {
+  if (!cs) return -1;
+  char *nv=0;
+  int nc=0;
+  if (path&&path[0]) {
+    nc=strlen(path);
+    if (!(nv=strdup(path))) return -1;
+  }
+  if (cs->cache_path) free(cs->cache_path);
+  cs->cache_path=nv;
+  cs->cache_pathc=nc;
+  return 0;
+}
+
 /* Search sound list.
  */
  
@@ -57,7 +99,21 @@ struct cheapsynth_sound *cheapsynth_sound_intern(struct cheapsynth *cs,const str
     cs->soundv=nv;
     cs->sounda=na;
   }
-  struct cheapsynth_sound *sound=cheapsynth_sound_print(cs,config);
+  struct cheapsynth_sound *sound;
+  if (cs->realtime) {
+    sound=cheapsynth_sound_describe(cs,config);
+  } else if (cs->async) {
+    if (!(sound=cheapsynth_sound_describe(cs,config))) return 0;
+    sound->printed=1;
+    if (cheapsynth_async_enqueue(cs,sound)<0) {
+      if (!(sound->v=cheapsynth_sound_get_pcm(cs,sound))) {
+        cheapsynth_sound_del(sound);
+        return 0;
+      }
+    }
+  } else {
+    sound=cheapsynth_sound_print(cs,config);
+  }
   if (!sound) return 0;
   memmove(cs->soundv+p+1,cs->soundv+p,sizeof(void*)*(cs->soundc-p));
   cs->soundc++;
@@ -71,6 +127,12 @@ struct cheapsynth_sound *cheapsynth_sound_intern(struct cheapsynth *cs,const str
 void cheapsynth_sound_play(struct cheapsynth *cs,struct cheapsynth_sound *sound) {
   if (!cs||!sound) return;
   
+  // Real-time sounds, and printed ones still in the queue.
+  if (!sound->printed||!__atomic_load_n(&sound->v,__ATOMIC_ACQUIRE)) {
+    cheapsynth_fm_play(cs,sound);
+    return;
+  }
+  
   /* Find an unused voice, or overwrite the oldest.
    */
   struct cheapsynth_voice *voice=0;
@@ -136,6 +198,8 @@ static void cheapsynth_updatef_mono(float *v,int c,struct cheapsynth *cs) {
       memmove(cs->voicev+i,cs->voicev+i+1,sizeof(struct cheapsynth_voice)*(cs->voicec-i));
     }
   }
+  
+  if (cs->fmc) cheapsynth_fm_update(v,c,cs);
 }
 
 /* Generate floating-point signal, any channel count.
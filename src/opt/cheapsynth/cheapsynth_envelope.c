@@ -0,0 +1,78 @@
+#include "cheapsynth_internal.h"
+
+/* Envelope runner.
+ * All legs progress linearly.
+ */
+
+void cheapsynth_envelope_runner_init(
+  struct cheapsynth_envelope_runner *runner,
+  const struct cheapsynth_envelope_point *pointv,
+  int pointc,
+  float timescale // frames per millisecond
+) {
+  runner->pointv=pointv;
+  runner->pointc=pointc;
+  runner->timescale=timescale;
+  runner->pointp=0;
+  if ((runner->pointc>0)&&!runner->pointv[0].delay_ms) {
+    runner->v=runner->pointv[0].v;
+    runner->pointp++;
+  } else {
+    runner->v=0.0f;
+  }
+  if (runner->pointp>=runner->pointc) {
+    runner->dv=0.0f;
+    runner->finished=1;
+    runner->remaining=0;
+  } else {
+    runner->finished=0;
+    if ((runner->remaining=runner->pointv[runner->pointp].delay_ms*runner->timescale)<1) runner->remaining=1;
+    runner->dv=(runner->pointv[runner->pointp].v-runner->v)/runner->remaining;
+  }
+}
+
+float cheapsynth_envelope_runner_update(struct cheapsynth_envelope_runner *runner) {
+  if (!runner->finished) {
+    if (runner->remaining) {
+      runner->remaining--;
+      runner->v+=runner->dv;
+    } else {
+      runner->pointp++;
+      if (runner->pointp>=runner->pointc) {
+        runner->finished=1;
+      } else {
+        if ((runner->remaining=runner->pointv[runner->pointp].delay_ms*runner->timescale)<1) runner->remaining=1;
+        runner->dv=(runner->pointv[runner->pointp].v-runner->v)/runner->remaining;
+      }
+    }
+  }
+  return runner->v;
+}
+
+/* Same as (c) calls to cheapsynth_envelope_runner_update, but the body of each leg is a flat ramp.
+ * Only the leg transitions go through the scalar path.
+ */
+
+void cheapsynth_envelope_runner_updatev(float *v,int c,struct cheapsynth_envelope_runner *runner) {
+  while (c>0) {
+    if (runner->finished) {
+      float k=runner->v;
+      for (;c-->0;v++) *v=k;
+      return;
+    }
+    if (!runner->remaining) {
+      *v=cheapsynth_envelope_runner_update(runner);
+      v++;
+      c--;
+      continue;
+    }
+    int n=runner->remaining;
+    if (n>c) n=c;
+    float base=runner->v,dv=runner->dv;
+    int i=0; for (;i<n;i++) v[i]=base+dv*(float)(i+1);
+    runner->v=v[n-1];
+    runner->remaining-=n;
+    v+=n;
+    c-=n;
+  }
+}
@@ -8,11 +8,25 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <math.h>
+#include <pthread.h>
 
 #define CHEAPSYNTH_VOICE_LIMIT 16 /* arbitrary */
 #define CHEAPSYNTH_QBUF_SIZE 512
 #define CHEAPSYNTH_DURATION_SANITY_LIMIT 3.0f
 #define CHEAPSYNTH_DURATION_SAMPLES_LIMIT 1000000 /* Hard stop at INT_MAX/sizeof(int), but realistically much lower. */
+#define CHEAPSYNTH_FM_VOICE_LIMIT 32 /* Real-time voices. Past this, we steal the quietest. */
+#define CHEAPSYNTH_BLOCK_SIZE 64 /* Real-time voices render in blocks of this many frames. Multiple of 4. */
+
+struct cheapsynth_envelope_runner {
+  const struct cheapsynth_envelope_point *pointv;
+  int pointc;
+  int pointp;
+  int remaining;
+  int finished;
+  float v;
+  float dv;
+  float timescale;
+};
 
 struct cheapsynth {
   int rate;
@@ -26,21 +40,104 @@ struct cheapsynth {
   } voicev[CHEAPSYNTH_VOICE_LIMIT];
   int voicec;
   
+  /* Real-time FM voices, same sparseness rules as (voicev).
+   */
+  int realtime;
+  struct cheapsynth_fm_voice {
+    struct cheapsynth_sound *sound;
+    struct cheapsynth_envelope_runner levelenv,pitchenv,modenv;
+    float carp,modp; // -pi..pi
+    int remaining; // frames
+    int serial; // Start order, to break ties when stealing.
+  } fmv[CHEAPSYNTH_FM_VOICE_LIMIT];
+  int fmc;
+  int fmserial;
+  float timescale; // frames/ms
+  float pitchscale; // radians/frame per Hz
+  
+  /* Background printing.
+   * (queuev) is guarded by (mutex). Sounds in it are also in (soundv), the queue is WEAK.
+   */
+  int async;
+  pthread_t worker;
+  int worker_running;
+  int worker_stop;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  struct cheapsynth_sound **queuev;
+  int queuec,queuea;
+  
+  char *cache_path; // Directory, or null for no disk cache.
+  int cache_pathc;
+  int cache_hitc,printc; // Stats, logged at del. Worker and main thread both count: __atomic only.
+  
   struct cheapsynth_sound **soundv;
   int soundc,sounda;
   
   float qbuf[CHEAPSYNTH_QBUF_SIZE];
 };
 
+/* Printed sounds have (c) samples of PCM in (v).
+ * Real-time sounds have no (v), just the config, and (c) is their duration in frames.
+ * While a printed sound is in the background queue, (v) is null and it plays as real-time.
+ * The worker publishes (v) atomically, and after that it never changes.
+ */
 struct cheapsynth_sound {
   int id;
   int c;
-  float v[];
+  int printed;
+  struct cheapsynth_sound_config config;
+  int levelc,pitchc,modc; // Length of each config envelope.
+  float *v;
 };
 
+/* Validate (config) and fill in everything but (v).
+ * Returns the duration in frames, or <0 if invalid.
+ */
+int cheapsynth_sound_measure(struct cheapsynth_sound *sound,const struct cheapsynth_sound_config *config,int rate);
+
 struct cheapsynth_sound *cheapsynth_sound_print(
   struct cheapsynth *cs,
   const struct cheapsynth_sound_config *config
 );
 
+struct cheapsynth_sound *cheapsynth_sound_describe(
+  struct cheapsynth *cs,
+  const struct cheapsynth_sound_config *config
+);
+
+void cheapsynth_sound_del(struct cheapsynth_sound *sound);
+
+/* New PCM for a described sound, from the disk cache or printed fresh (and then cached).
+ * Safe to call from any thread, provided nobody else is touching (sound).
+ */
+float *cheapsynth_sound_get_pcm(struct cheapsynth *cs,const struct cheapsynth_sound *sound);
+
+/* Disk cache, keyed by everything in the config except (id), plus the rate.
+ * Load returns null if absent or invalid, save fails quietly.
+ */
+float *cheapsynth_cache_load(struct cheapsynth *cs,const struct cheapsynth_sound *sound);
+void cheapsynth_cache_save(struct cheapsynth *cs,const struct cheapsynth_sound *sound,const float *v);
+
+/* Hand a described sound to the worker thread, starting it if needed.
+ * Returns <0 if we couldn't, and you should print it yourself.
+ */
+int cheapsynth_async_enqueue(struct cheapsynth *cs,struct cheapsynth_sound *sound);
+void cheapsynth_async_stop(struct cheapsynth *cs);
+
+void cheapsynth_envelope_runner_init(
+  struct cheapsynth_envelope_runner *runner,
+  const struct cheapsynth_envelope_point *pointv,
+  int pointc,
+  float timescale // frames per millisecond
+);
+float cheapsynth_envelope_runner_update(struct cheapsynth_envelope_runner *runner);
+void cheapsynth_envelope_runner_updatev(float *v,int c,struct cheapsynth_envelope_runner *runner);
+
+void cheapsynth_fm_play(struct cheapsynth *cs,struct cheapsynth_sound *sound);
+
+/* Add all real-time voices to (v), mono.
+ */
+void cheapsynth_fm_update(float *v,int c,struct cheapsynth *cs);
+
 #endif
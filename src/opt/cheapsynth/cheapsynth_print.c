@@ -4,119 +4,66 @@
  */
  
 struct cheapsynth_printer {
-  struct cheapsynth *cs;
+  int rate;
+  const struct cheapsynth_sound *sound;
   const struct cheapsynth_sound_config *config;
-  struct cheapsynth_sound *sound;
-  int levelc,pitchc,modc; // Length of each config envelope.
+  float *v;
   float timescale; // frames/ms
   float pitchscale; // radians/frame
 };
 
 static void cheapsynth_printer_cleanup(struct cheapsynth_printer *printer) {
-  if (printer->sound) free(printer->sound);
+  if (printer->v) free(printer->v);
 }
 
-/* Validate, measure, and allocate (sound).
+/* Validate and measure.
  */
  
-static int cheapsynth_printer_setup(struct cheapsynth_printer *printer) {
-  if (!printer->cs) return -1;
-  if (!printer->config) return -1;
-  
-  printer->timescale=(float)printer->cs->rate/1000.0f;
-  printer->pitchscale=(M_PI*2.0f)/(float)printer->cs->rate;
+int cheapsynth_sound_measure(struct cheapsynth_sound *sound,const struct cheapsynth_sound_config *config,int rate) {
   
-  printer->levelc=CHEAPSYNTH_LEVEL_LIMIT;
-  while (printer->levelc&&!printer->config->level[printer->levelc-1].delay_ms) printer->levelc--;
-  if (!printer->levelc) return -1;
-  if (!printer->config->level[0].delay_ms) return -1; // First level delay must be nonzero. There is an implicit (0,0) at the start.
-  if (printer->config->level[printer->levelc-1].v>0.0f) return -1; // Last level must be zero.
+  sound->levelc=CHEAPSYNTH_LEVEL_LIMIT;
+  while (sound->levelc&&!config->level[sound->levelc-1].delay_ms) sound->levelc--;
+  if (!sound->levelc) return -1;
+  if (!config->level[0].delay_ms) return -1; // First level delay must be nonzero. There is an implicit (0,0) at the start.
+  if (config->level[sound->levelc-1].v>0.0f) return -1; // Last level must be zero.
   
-  printer->pitchc=CHEAPSYNTH_PITCH_LIMIT;
-  while ((printer->pitchc>1)&&!printer->config->pitch[printer->pitchc-1].delay_ms) printer->pitchc--;
-  if (printer->config->pitch[0].delay_ms) return -1;  // First pitch must be at time zero.
+  sound->pitchc=CHEAPSYNTH_PITCH_LIMIT;
+  while ((sound->pitchc>1)&&!config->pitch[sound->pitchc-1].delay_ms) sound->pitchc--;
+  if (config->pitch[0].delay_ms) return -1;  // First pitch must be at time zero.
   
-  printer->modc=CHEAPSYNTH_MOD_LIMIT;
-  while ((printer->modc>1)&&!printer->config->mod[printer->modc-1].delay_ms) printer->modc--;
-  if (printer->config->mod[0].delay_ms) return -1; // First modulation must be at time zero.
+  sound->modc=CHEAPSYNTH_MOD_LIMIT;
+  while ((sound->modc>1)&&!config->mod[sound->modc-1].delay_ms) sound->modc--;
+  if (config->mod[0].delay_ms) return -1; // First modulation must be at time zero.
   
   // Calculate total duration.
   float durs=0.0f;
-  const struct cheapsynth_envelope_point *point=printer->config->level;
-  int i=printer->levelc;
+  const struct cheapsynth_envelope_point *point=config->level;
+  int i=sound->levelc;
   for (;i-->0;point++) {
     durs+=(float)point->delay_ms/1000.0f;
   }
   if (durs>CHEAPSYNTH_DURATION_SANITY_LIMIT) return -1;
-  int samplec=(int)(durs*printer->cs->rate);
+  int samplec=(int)(durs*rate);
   if (samplec<1) return -1;
   if (samplec>CHEAPSYNTH_DURATION_SAMPLES_LIMIT) return -1;
   
-  if (!(printer->sound=malloc(sizeof(struct cheapsynth_sound)+sizeof(float)*samplec))) return -1;
-  printer->sound->id=printer->config->id;
-  printer->sound->c=samplec;
-  
-  return 0;
+  sound->id=config->id;
+  sound->c=samplec;
+  sound->config=*config;
+  return samplec;
 }
 
-/* Envelope runner.
- * All legs progress linearly.
+/* Allocate output.
  */
  
-struct cheapsynth_envelope_runner {
-  const struct cheapsynth_envelope_point *pointv;
-  int pointc;
-  int pointp;
-  int remaining;
-  int finished;
-  float v;
-  float dv;
-  float timescale;
-};
-
-static void cheapsynth_envelope_runner_init(
-  struct cheapsynth_envelope_runner *runner,
-  const struct cheapsynth_envelope_point *pointv,
-  int pointc,
-  float timescale // frames per millisecond
-) {
-  runner->pointv=pointv;
-  runner->pointc=pointc;
-  runner->timescale=timescale;
-  runner->pointp=0;
-  if ((runner->pointc>0)&&!runner->pointv[0].delay_ms) {
-    runner->v=runner->pointv[0].v;
-    runner->pointp++;
-  } else {
-    runner->v=0.0f;
-  }
-  if (runner->pointp>=runner->pointc) {
-    runner->dv=0.0f;
-    runner->finished=1;
-    runner->remaining=0;
-  } else {
-    runner->finished=0;
-    if ((runner->remaining=runner->pointv[runner->pointp].delay_ms*runner->timescale)<1) runner->remaining=1;
-    runner->dv=(runner->pointv[runner->pointp].v-runner->v)/runner->remaining;
-  }
-}
-
-static float cheapsynth_envelope_runner_update(struct cheapsynth_envelope_runner *runner) {
-  if (!runner->finished) {
-    if (runner->remaining) {
-      runner->remaining--;
-      runner->v+=runner->dv;
-    } else {
-      runner->pointp++;
-      if (runner->pointp>=runner->pointc) {
-        runner->finished=1;
-      } else {
-        if ((runner->remaining=runner->pointv[runner->pointp].delay_ms*runner->timescale)<1) runner->remaining=1;
-        runner->dv=(runner->pointv[runner->pointp].v-runner->v)/runner->remaining;
-      }
-    }
-  }
-  return runner->v;
+static int cheapsynth_printer_setup(struct cheapsynth_printer *printer) {
+  if (!printer->sound) return -1;
+  if (printer->sound->c<1) return -1;
+  printer->config=&printer->sound->config;
+  printer->timescale=(float)printer->rate/1000.0f;
+  printer->pitchscale=(M_PI*2.0f)/(float)printer->rate;
+  if (!(printer->v=malloc(sizeof(float)*printer->sound->c))) return -1;
+  return 0;
 }
 
 /* With the context validated and sound allocated, generate the PCM.
@@ -127,11 +74,11 @@ static void cheapsynth_printer_run(struct cheapsynth_printer *printer) {
   float carp=0.0f; // Carrier phase, -pi..pi
   float modp=0.0f; // Modulator phase, -pi..pi
   struct cheapsynth_envelope_runner levelenv,pitchenv,modenv;
-  cheapsynth_envelope_runner_init(&levelenv,printer->config->level,printer->levelc,printer->timescale);
-  cheapsynth_envelope_runner_init(&pitchenv,printer->config->pitch,printer->pitchc,printer->timescale);
-  cheapsynth_envelope_runner_init(&modenv,printer->config->mod,printer->modc,printer->timescale);
+  cheapsynth_envelope_runner_init(&levelenv,printer->config->level,printer->sound->levelc,printer->timescale);
+  cheapsynth_envelope_runner_init(&pitchenv,printer->config->pitch,printer->sound->pitchc,printer->timescale);
+  cheapsynth_envelope_runner_init(&modenv,printer->config->mod,printer->sound->modc,printer->timescale);
 
-  float *dst=printer->sound->v;
+  float *dst=printer->v;
   int dsti=printer->sound->c;
   
   if (printer->config->modabsolute) { // absolute modulator
@@ -168,27 +115,78 @@ static void cheapsynth_printer_run(struct cheapsynth_printer *printer) {
  
 static void cheapsynth_printer_normalize(struct cheapsynth_printer *printer) {
   float adj=printer->config->master;
-  float *v=printer->sound->v;
+  float *v=printer->v;
   int i=printer->sound->c;
   for (;i-->0;v++) (*v)*=adj;
 }
 
-/* Print sound, main entry point.
+/* Print PCM for a described sound.
  */
  
-struct cheapsynth_sound *cheapsynth_sound_print(
-  struct cheapsynth *cs,
-  const struct cheapsynth_sound_config *config
-) {
+static float *cheapsynth_sound_print_pcm(const struct cheapsynth_sound *sound,int rate) {
   struct cheapsynth_printer printer={
-    .cs=cs,
-    .config=config,
+    .rate=rate,
+    .sound=sound,
   };
   if (cheapsynth_printer_setup(&printer)<0) { cheapsynth_printer_cleanup(&printer); return 0; }
   cheapsynth_printer_run(&printer);
   cheapsynth_printer_normalize(&printer);
-  struct cheapsynth_sound *sound=printer.sound;
-  printer.sound=0;
+  float *v=printer.v;
+  printer.v=0;
   cheapsynth_printer_cleanup(&printer);
+  return v;
+}
+
+/* PCM from cache or printer.
+ */
+ 
+float *cheapsynth_sound_get_pcm(struct cheapsynth *cs,const struct cheapsynth_sound *sound) {
+  float *v=cheapsynth_cache_load(cs,sound);
+  if (v) {
+    __atomic_add_fetch(&cs->cache_hitc,1,__ATOMIC_RELAXED);
+    return v;
+  }
+  if (!(v=cheapsynth_sound_print_pcm(sound,cs->rate))) return 0;
+  __atomic_add_fetch(&cs->printc,1,__ATOMIC_RELAXED);
+  cheapsynth_cache_save(cs,sound,v);
+  return v;
+}
+
+/* Print sound, main entry point.
+ */
+ 
+struct cheapsynth_sound *cheapsynth_sound_print(
+  struct cheapsynth *cs,
+  const struct cheapsynth_sound_config *config
+) {
+  struct cheapsynth_sound *sound=cheapsynth_sound_describe(cs,config);
+  if (!sound) return 0;
+  sound->printed=1;
+  if (!(sound->v=cheapsynth_sound_get_pcm(cs,sound))) {
+    cheapsynth_sound_del(sound);
+    return 0;
+  }
   return sound;
 }
+
+/* Real-time sound: Same validation, but no PCM.
+ */
+ 
+struct cheapsynth_sound *cheapsynth_sound_describe(
+  struct cheapsynth *cs,
+  const struct cheapsynth_sound_config *config
+) {
+  struct cheapsynth_sound *sound=calloc(1,sizeof(struct cheapsynth_sound));
+  if (!sound) return 0;
+  if (cheapsynth_sound_measure(sound,config,cs->rate)<1) {
+    free(sound);
+    return 0;
+  }
+  return sound;
+}
+
+void cheapsynth_sound_del(struct cheapsynth_sound *sound) {
+  if (!sound) return;
+  if (sound->v) free(sound->v);
+  free(sound);
+}
@@ -1,12 +1,14 @@
 /* eh_drm.h
  * Linux Direct Rendering Manager.
+ * Swaps don't wait for the flip: Up to (flipdepth) frames queue for scanout while you render the next.
+ * No GPU needed to try it: `modprobe vkms` gives a virtual KMS device, and Mesa renders to it in software.
  */
  
 #ifndef EH_DRM_H
 #define EH_DRM_H
 
 void eh_drm_quit();
-int eh_drm_init(const char *device);
+int eh_drm_init(const char *device,int flipdepth); // (flipdepth) 1..3, or zero for default.
 int eh_drm_swap();
 
 #endif
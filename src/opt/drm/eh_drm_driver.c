@@ -12,25 +12,37 @@ static void drm_fb_cleanup(struct drm_fb *fb) {
     drmModeRmFB(eh_drm.fd,fb->fbid);
   }
 }
+
+static void drm_frame_release(struct drm_frame *frame) {
+  if (!frame->bo) return;
+  gbm_surface_release_buffer(eh_drm.gbmsurface,frame->bo);
+  frame->bo=0;
+}
+
+static int drm_poll_file(int to_ms);
  
 void eh_drm_quit() {
 
+  // Drop queued frames, so the flip handler doesn't submit them while we drain.
+  while (eh_drm.queuec>0) drm_frame_release(eh_drm.queuev+(--(eh_drm.queuec)));
+
   // If waiting for a page flip, we must let it finish first.
-  if ((eh_drm.fd>=0)&&eh_drm.flip_pending) {
-    struct pollfd pollfd={.fd=eh_drm.fd,.events=POLLIN|POLLERR|POLLHUP};
-    if (poll(&pollfd,1,500)>0) {
-      char dummy[64];
-      if (read(eh_drm.fd,dummy,sizeof(dummy))) ;
+  if (eh_drm.fd>=0) {
+    int panic=5;
+    while (eh_drm.flipping.bo&&(panic-->0)) {
+      if (drm_poll_file(100)<0) break;
     }
   }
   
-  if (eh_drm.eglcontext) eglDestroyContext(eh_drm.egldisplay,eh_drm.eglcontext);
-  if (eh_drm.eglsurface) eglDestroySurface(eh_drm.egldisplay,eh_drm.eglsurface);
-  if (eh_drm.egldisplay) eglTerminate(eh_drm.egldisplay);
-  
-  drm_fb_cleanup(eh_drm.fbv+0);
-  drm_fb_cleanup(eh_drm.fbv+1);
+  if (eh_drm.flipc) {
+    fprintf(stderr,
+      "drm: %d flips, queue depth %d. %d repeated vblanks, %d dropped frames. Swap to scanout avg %d us, max %d us.\n",
+      eh_drm.flipc,eh_drm.flipdepth,eh_drm.repeatc,eh_drm.dropc,
+      (int)(eh_drm.latency_sum_us/eh_drm.flipc),eh_drm.latency_max_us
+    );
+  }
   
+  // Put the old framebuffer back before removing ours, so we're not pulling the one on screen.
   if (eh_drm.crtc_restore&&(eh_drm.fd>=0)) {
     drmModeCrtcPtr crtc=eh_drm.crtc_restore;
     drmModeSetCrtc(
@@ -40,6 +52,19 @@ void eh_drm_quit() {
     drmModeFreeCrtc(eh_drm.crtc_restore);
   }
   
+  // Buffers go back to the surface before it's destroyed. (flipping) only if the drain timed out.
+  drm_frame_release(&eh_drm.flipping);
+  drm_frame_release(&eh_drm.scanout);
+  
+  int i=eh_drm.fbc;
+  while (i-->0) drm_fb_cleanup(eh_drm.fbv+i);
+  
+  if (eh_drm.eglcontext) eglDestroyContext(eh_drm.egldisplay,eh_drm.eglcontext);
+  if (eh_drm.eglsurface) eglDestroySurface(eh_drm.egldisplay,eh_drm.eglsurface);
+  if (eh_drm.egldisplay) eglTerminate(eh_drm.egldisplay);
+  if (eh_drm.gbmsurface) gbm_surface_destroy(eh_drm.gbmsurface);
+  if (eh_drm.gbmdevice) gbm_device_destroy(eh_drm.gbmdevice);
+  
   if (eh_drm.fd>=0) close(eh_drm.fd);
   
   memset(&eh_drm,0,sizeof(eh_drm));
@@ -49,10 +74,13 @@ void eh_drm_quit() {
 /* Init.
  */
  
-int eh_drm_init(const char *device) {
+int eh_drm_init(const char *device,int flipdepth) {
 
   eh_drm.fd=-1;
   eh_drm.crtcunset=1;
+  if (flipdepth<1) flipdepth=DRM_FLIP_QUEUE_DEFAULT;
+  else if (flipdepth>DRM_FLIP_QUEUE_LIMIT) flipdepth=DRM_FLIP_QUEUE_LIMIT;
+  eh_drm.flipdepth=flipdepth;
 
   if (!drmAvailable()) {
     fprintf(stderr,"DRM not available.\n");
@@ -68,6 +96,23 @@ int eh_drm_init(const char *device) {
   return 0;
 }
 
+/* Submit the next queued frame, if the kernel is free to take it.
+ */
+ 
+static int drm_flip_next() {
+  if (eh_drm.flipping.bo||!eh_drm.queuec) return 0;
+  struct drm_frame frame=eh_drm.queuev[0];
+  eh_drm.queuec--;
+  memmove(eh_drm.queuev,eh_drm.queuev+1,sizeof(struct drm_frame)*eh_drm.queuec);
+  if (drmModePageFlip(eh_drm.fd,eh_drm.crtcid,frame.fbid,DRM_MODE_PAGE_FLIP_EVENT,0)<0) {
+    fprintf(stderr,"drmModePageFlip: %m\n");
+    drm_frame_release(&frame);
+    return -1;
+  }
+  eh_drm.flipping=frame;
+  return 0;
+}
+
 /* Poll file.
  */
  
@@ -78,7 +123,24 @@ static void drm_cb_vblank(
 static void drm_cb_page1(
   int fd,unsigned int seq,unsigned int times,unsigned int timeus,void *userdata
 ) {
-  eh_drm.flip_pending=0;
+  if (!eh_drm.flipping.bo) return;
+  
+  // Sequence numbers tell us how many vblanks the outgoing frame was up for.
+  if (eh_drm.flipc&&(seq-eh_drm.lastseq>1)&&(seq-eh_drm.lastseq<1000)) {
+    eh_drm.repeatc+=seq-eh_drm.lastseq-1;
+  }
+  eh_drm.lastseq=seq;
+  eh_drm.flipc++;
+  int64_t latency=(int64_t)times*1000000+timeus-eh_drm.flipping.swap_us;
+  if (latency>=0) {
+    eh_drm.latency_sum_us+=latency;
+    if (latency>eh_drm.latency_max_us) eh_drm.latency_max_us=(latency>INT_MAX)?INT_MAX:(int)latency;
+  }
+  
+  drm_frame_release(&eh_drm.scanout);
+  eh_drm.scanout=eh_drm.flipping;
+  eh_drm.flipping.bo=0;
+  drm_flip_next();
 }
  
 static void drm_cb_page2(
@@ -106,76 +168,100 @@ static int drm_poll_file(int to_ms) {
   return 0;
 }
 
-/* Swap.
+/* Framebuffer for a gbm buffer, creating if needed.
  */
  
-static int drm_swap_egl(uint32_t *fbid) { 
-  eglSwapBuffers(eh_drm.egldisplay,eh_drm.eglsurface);
-  
-  struct gbm_bo *bo=gbm_surface_lock_front_buffer(eh_drm.gbmsurface);
-  if (!bo) return -1;
-  
+static int drm_fb_for_bo(uint32_t *fbid,struct gbm_bo *bo) {
   int handle=gbm_bo_get_handle(bo).u32;
-  struct drm_fb *fb;
-  if (!eh_drm.fbv[0].handle) {
-    fb=eh_drm.fbv;
-  } else if (handle==eh_drm.fbv[0].handle) {
-    fb=eh_drm.fbv;
-  } else {
-    fb=eh_drm.fbv+1;
-  }
-  
-  if (!fb->fbid) {
-    int width=gbm_bo_get_width(bo);
-    int height=gbm_bo_get_height(bo);
-    int stride=gbm_bo_get_stride(bo);
-    fb->handle=handle;
-    if (drmModeAddFB(eh_drm.fd,width,height,24,32,stride,fb->handle,&fb->fbid)<0) return -1;
-    
-    if (eh_drm.crtcunset) {
-      if (drmModeSetCrtc(
-        eh_drm.fd,eh_drm.crtcid,fb->fbid,0,0,
-        &eh_drm.connid,1,&eh_drm.mode
-      )<0) {
-        fprintf(stderr,"drmModeSetCrtc: %m\n");
-        return -1;
-      }
-      eh_drm.crtcunset=0;
+  struct drm_fb *fb=eh_drm.fbv;
+  int i=eh_drm.fbc;
+  for (;i-->0;fb++) {
+    if (fb->handle==handle) {
+      *fbid=fb->fbid;
+      return 0;
     }
   }
-  
+  if (eh_drm.fbc>=DRM_FB_LIMIT) return -1;
+  fb=eh_drm.fbv+eh_drm.fbc;
+  int width=gbm_bo_get_width(bo);
+  int height=gbm_bo_get_height(bo);
+  int stride=gbm_bo_get_stride(bo);
+  if (drmModeAddFB(eh_drm.fd,width,height,24,32,stride,handle,&fb->fbid)<0) return -1;
+  fb->handle=handle;
+  eh_drm.fbc++;
   *fbid=fb->fbid;
-  if (eh_drm.bo_pending) {
-    gbm_surface_release_buffer(eh_drm.gbmsurface,eh_drm.bo_pending);
-  }
-  eh_drm.bo_pending=bo;
-  
   return 0;
 }
 
+static int64_t drm_now_us() {
+  struct timespec ts={0};
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  return (int64_t)ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
+/* Swap.
+ * Never waits on the display unless we're out of room.
+ * Out of room means more than (flipdepth) frames in flight, or gbm has no buffer left for the next render.
+ * With vsync, wait for a flip to free something up: The clock relies on us for pacing.
+ * Otherwise, drop the oldest queued frame, never the newest.
+ */
+
+static int drm_out_of_room() {
+  int inflight=eh_drm.queuec+(eh_drm.flipping.bo?1:0);
+  if (inflight>eh_drm.flipdepth) return 1;
+  if (!gbm_surface_has_free_buffers(eh_drm.gbmsurface)) return 1;
+  return 0;
+}
+ 
 int eh_drm_swap() {
 
-  // There must be no more than one page flip in flight at a time.
-  // If one is pending -- likely -- give it a chance to finish.
-  if (eh_drm.flip_pending) {
-    if (drm_poll_file(20)<0) return -1;
-    if (eh_drm.flip_pending) {
-      // Page flip didn't complete after a 20 ms delay? Drop the frame, no worries.
-      return 0;
+  // Collect any finished flips, without waiting.
+  if (drm_poll_file(0)<0) return -1;
+
+  eglSwapBuffers(eh_drm.egldisplay,eh_drm.eglsurface);
+  struct drm_frame frame={.swap_us=drm_now_us()};
+  if (!(frame.bo=gbm_surface_lock_front_buffer(eh_drm.gbmsurface))) return -1;
+  if (drm_fb_for_bo(&frame.fbid,frame.bo)<0) {
+    drm_frame_release(&frame);
+    return -1;
+  }
+  
+  // Very first frame goes straight to the CRTC.
+  if (eh_drm.crtcunset) {
+    if (drmModeSetCrtc(
+      eh_drm.fd,eh_drm.crtcid,frame.fbid,0,0,
+      &eh_drm.connid,1,&eh_drm.mode
+    )<0) {
+      fprintf(stderr,"drmModeSetCrtc: %m\n");
+      drm_frame_release(&frame);
+      return -1;
     }
+    eh_drm.crtcunset=0;
+    eh_drm.scanout=frame;
+    return 0;
   }
-  eh_drm.flip_pending=1;
   
-  uint32_t fbid=0;
-  if (drm_swap_egl(&fbid)<0) {
-    eh_drm.flip_pending=0;
-    return -1;
+  if (eh_drm.queuec>=DRM_FLIP_QUEUE_LIMIT) {
+    drm_frame_release(eh_drm.queuev);
+    eh_drm.queuec--;
+    memmove(eh_drm.queuev,eh_drm.queuev+1,sizeof(struct drm_frame)*eh_drm.queuec);
+    eh_drm.dropc++;
   }
+  eh_drm.queuev[eh_drm.queuec++]=frame;
+  if (drm_flip_next()<0) return -1;
   
-  if (drmModePageFlip(eh_drm.fd,eh_drm.crtcid,fbid,DRM_MODE_PAGE_FLIP_EVENT,0)<0) {
-    fprintf(stderr,"drmModePageFlip: %m\n");
-    eh_drm.flip_pending=0;
-    return -1;
+  int panic=10;
+  while (drm_out_of_room()) {
+    if (!eh_drm.vsync&&(eh_drm.queuec>1)) {
+      drm_frame_release(eh_drm.queuev);
+      eh_drm.queuec--;
+      memmove(eh_drm.queuev,eh_drm.queuev+1,sizeof(struct drm_frame)*eh_drm.queuec);
+      eh_drm.dropc++;
+      continue;
+    }
+    if (!eh_drm.flipping.bo) break; // Nothing will change by waiting.
+    if (panic--<=0) break;
+    if (drm_poll_file(20)<0) return -1;
   }
 
   return 0;
@@ -18,13 +18,20 @@ static void _drm_del(struct eh_video_driver *driver) {
 
 static int _drm_init(struct eh_video_driver *driver,const struct eh_video_setup *config) {
 
-  if (eh_drm_init(config->device)<0) {
+  if (eh_drm_init(config->device,config->flipdepth)<0) {
     fprintf(stderr,"eh_drm_init failed\n");
     return -1;
   }
   
   driver->w=eh_drm.w;
   driver->h=eh_drm.h;
+  driver->rate=eh_drm.rate;
+  
+  // Page flips always land on vblank. With (vsync) we just promise never to skip one.
+  if (config->vsync) {
+    eh_drm.vsync=1;
+    driver->vsync=1;
+  }
 
   return 0;
 }
@@ -21,12 +21,24 @@
 #include <EGL/eglext.h>
 #include <GL/gl.h>
 
+#define DRM_FB_LIMIT 8 /* Distinct buffers we'll see from gbm. Mesa uses up to 4. */
+#define DRM_FLIP_QUEUE_LIMIT 3
+#define DRM_FLIP_QUEUE_DEFAULT 2
+
 struct drm_fb {
   uint32_t fbid;
   int handle;
   int size;
 };
 
+/* A locked gbm buffer, on its way to the screen or on it.
+ */
+struct drm_frame {
+  struct gbm_bo *bo; // Null if unused.
+  uint32_t fbid;
+  int64_t swap_us; // CLOCK_MONOTONIC, when we got it from EGL. Same clock as DRM's event timestamps.
+};
+
 extern struct eh_drm_driver {
   int fd;
   
@@ -37,12 +49,28 @@ extern struct eh_drm_driver {
   int connid,encid,crtcid;
   drmModeCrtcPtr crtc_restore;
   
-  int flip_pending;
-  struct drm_fb fbv[2];
-  int fbp;
-  struct gbm_bo *bo_pending;
+  int vsync; // Wait for every flip, never drop a frame. The clock relies on us for pacing.
+  struct drm_fb fbv[DRM_FB_LIMIT];
+  int fbc;
   int crtcunset;
   
+  /* Flip queue. The kernel takes only one flip at a time, so the rest wait in (queuev).
+   * (flipdepth) is how many frames may be between eh_drm_swap and the screen, counting (flipping).
+   */
+  int flipdepth;
+  struct drm_frame scanout;
+  struct drm_frame flipping;
+  struct drm_frame queuev[DRM_FLIP_QUEUE_LIMIT];
+  int queuec;
+  
+  // Stats, logged at quit.
+  unsigned int lastseq;
+  int flipc; // Flips completed.
+  int repeatc; // Vblanks where we had nothing new, and the previous frame showed again.
+  int dropc; // Frames we discarded from the queue without showing.
+  int64_t latency_sum_us; // Swap to flip completion.
+  int latency_max_us;
+  
   struct gbm_device *gbmdevice;
   struct gbm_surface *gbmsurface;
   EGLDisplay egldisplay;
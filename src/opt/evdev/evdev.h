@@ -38,6 +38,15 @@ void *evdev_get_userdata(const struct evdev *evdev);
 int evdev_update(struct evdev *evdev,int toms);
 int evdev_update_fd(struct evdev *evdev,int fd);
 
+/* Or run it on a thread of your own, with epoll.
+ * evdev_epoll_init() creates an epoll fd covering inotify and every device, and we keep it current as devices come and go.
+ * evdev_epoll_wait() blocks for up to (toms) and fills (fdv) with ready fds. It doesn't touch anything else, no need to lock around it.
+ * evdev_update_fds() processes those, and any pending rescan. All delegate callbacks happen here.
+ */
+int evdev_epoll_init(struct evdev *evdev);
+int evdev_epoll_wait(struct evdev *evdev,int *fdv,int fda,int toms);
+int evdev_update_fds(struct evdev *evdev,const int *fdv,int fdc);
+
 /* Request to manually scan the device directory at next update.
  * This does not perform any IO immediately.
  */
@@ -87,4 +96,12 @@ int evdev_device_enumerate(
 
 int evdev_guess_hid_usage(int type,int code);
 
+/* Virtual gamepad via /dev/uinput, for exercising the input path without hardware.
+ * It has the four face buttons, Start, and Select, and shows up like any other device, including to us.
+ * Open returns an fd, which you close when done. Needs write permission on /dev/uinput.
+ * Button reports the change and a SYN_REPORT; (code) is eg BTN_SOUTH.
+ */
+int evdev_uinput_open(const char *name);
+int evdev_uinput_button(int fd,int code,int value);
+
 #endif
@@ -6,6 +6,7 @@
 void evdev_del(struct evdev *evdev) {
   if (!evdev) return;
   if (evdev->infd>=0) close(evdev->infd);
+  if (evdev->epfd>=0) close(evdev->epfd);
   if (evdev->devicev) {
     while (evdev->devicec-->0) evdev_device_del(evdev->devicev[evdev->devicec]);
     free(evdev->devicev);
@@ -46,7 +47,9 @@ struct evdev *evdev_new(
   struct evdev *evdev=calloc(1,sizeof(struct evdev));
   if (!evdev) return 0;
   evdev->infd=-1;
+  evdev->epfd=-1;
   evdev->rescan=1;
+  evdev->pollfd_dirty=1;
   
   if (delegate) evdev->delegate=*delegate;
   
@@ -147,6 +150,7 @@ void evdev_drop_device(struct evdev *evdev,struct evdev_device *device,int fire_
     }
   }
   if (p<0) return;
+  evdev->pollfd_dirty=1;
   evdev->devicec--;
   memmove(evdev->devicev+p,evdev->devicev+p+1,sizeof(void*)*(evdev->devicec-p));
   if (fire_event&&evdev->delegate.cb_disconnect) {
@@ -5,18 +5,28 @@
  
 #include "evdev.h"
 #include "lib/eh_driver.h"
+#include <stdio.h>
+#include <pthread.h>
 
 #define FMN_EVDEV_UPDATE_TIMEOUT_MS 2
+#define FMN_EVDEV_THREAD_TIMEOUT_MS 100 /* Only matters for noticing that we should stop. */
 
 struct eh_input_driver_evdev {
   struct eh_input_driver hdr;
   struct evdev *evdev;
   char name_storage[256];
+  pthread_t thread;
+  int thread_running;
+  int thread_stop; // __atomic only.
 };
 
 #define DRIVER ((struct eh_input_driver_evdev*)driver)
 
 static void _evdev_del(struct eh_input_driver *driver) {
+  if (DRIVER->thread_running) {
+    __atomic_store_n(&DRIVER->thread_stop,1,__ATOMIC_RELEASE);
+    pthread_join(DRIVER->thread,0);
+  }
   evdev_del(DRIVER->evdev);
 }
 
@@ -28,9 +38,41 @@ static int _evdev_init(struct eh_input_driver *driver) {
 }
 
 static int _evdev_update(struct eh_input_driver *driver) {
+  if (DRIVER->thread_running) return 0;
   return evdev_update(DRIVER->evdev,FMN_EVDEV_UPDATE_TIMEOUT_MS);
 }
 
+/* Input thread.
+ * Wait without the lock, then take it to process whatever's ready.
+ */
+
+static void *_evdev_thread(void *arg) {
+  struct eh_input_driver *driver=arg;
+  int fdv[16],fdc=0;
+  while (!__atomic_load_n(&DRIVER->thread_stop,__ATOMIC_ACQUIRE)) {
+    eh_input_lock();
+    int err=__atomic_load_n(&DRIVER->thread_stop,__ATOMIC_ACQUIRE)?0:evdev_update_fds(DRIVER->evdev,fdv,fdc);
+    eh_input_unlock();
+    if (err<0) {
+      fprintf(stderr,"evdev: Error processing input. Input thread terminating.\n");
+      break;
+    }
+    if ((fdc=evdev_epoll_wait(DRIVER->evdev,fdv,sizeof(fdv)/sizeof(fdv[0]),FMN_EVDEV_THREAD_TIMEOUT_MS))<0) {
+      fprintf(stderr,"evdev: epoll_wait failed. Input thread terminating.\n");
+      break;
+    }
+  }
+  return 0;
+}
+
+static int _evdev_start_thread(struct eh_input_driver *driver) {
+  if (DRIVER->thread_running) return 0;
+  if (evdev_epoll_init(DRIVER->evdev)<0) return -1;
+  if (pthread_create(&DRIVER->thread,0,_evdev_thread,driver)) return -1;
+  DRIVER->thread_running=1;
+  return 0;
+}
+
 static const char *_evdev_get_ids(int *vid,int *pid,int *version,struct eh_input_driver *driver,int devid) {
   struct evdev_device *device=evdev_device_by_devid(DRIVER->evdev,devid);
   if (!device) return 0;
@@ -83,4 +125,5 @@ const struct eh_input_type eh_input_type_evdev={
   .get_ids=_evdev_get_ids,
   .list_buttons=_evdev_for_each_button,
   .has_device=_evdev_has_device,
+  .start_thread=_evdev_start_thread,
 };
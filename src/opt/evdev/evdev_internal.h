@@ -13,6 +13,8 @@
 #include <unistd.h>
 #include <linux/input.h>
 #include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <errno.h>
 
 struct evdev {
   char *path;
@@ -28,6 +30,8 @@ struct evdev {
   
   struct pollfd *pollfdv;
   int pollfdc,pollfda;
+  int pollfd_dirty; // Device list changed since we built (pollfdv).
+  int epfd; // evdev_epoll_init(), or -1.
 };
 
 struct evdev_device {
@@ -35,6 +39,7 @@ struct evdev_device {
   int kid;
   int devid;
   int vid,pid,version,bustype;
+  int monotonic; // Event timestamps are CLOCK_MONOTONIC. If not, we don't report them.
   struct evdev *evdev; // WEAK
 };
 
@@ -0,0 +1,45 @@
+#include "evdev_internal.h"
+#include <linux/uinput.h>
+
+/* Open.
+ */
+ 
+int evdev_uinput_open(const char *name) {
+  int fd=open("/dev/uinput",O_WRONLY|O_NONBLOCK);
+  if (fd<0) return -1;
+  static const int codev[]={BTN_SOUTH,BTN_EAST,BTN_WEST,BTN_NORTH,BTN_START,BTN_SELECT};
+  int i=sizeof(codev)/sizeof(codev[0]);
+  if (ioctl(fd,UI_SET_EVBIT,EV_KEY)<0) { close(fd); return -1; }
+  while (i-->0) {
+    if (ioctl(fd,UI_SET_KEYBIT,codev[i])<0) { close(fd); return -1; }
+  }
+  struct uinput_setup setup={
+    .id={
+      .bustype=BUS_VIRTUAL,
+      .vendor=0xfeed,
+      .product=0x0001,
+      .version=1,
+    },
+  };
+  if (name) strncpy(setup.name,name,sizeof(setup.name)-1);
+  if (
+    (ioctl(fd,UI_DEV_SETUP,&setup)<0)||
+    (ioctl(fd,UI_DEV_CREATE)<0)
+  ) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+/* Button.
+ */
+ 
+int evdev_uinput_button(int fd,int code,int value) {
+  struct input_event eventv[2]={
+    {.type=EV_KEY,.code=code,.value=value},
+    {.type=EV_SYN,.code=SYN_REPORT},
+  };
+  if (write(fd,eventv,sizeof(eventv))!=sizeof(eventv)) return -1;
+  return 0;
+}
@@ -1,5 +1,6 @@
 #include "evdev_internal.h"
 #include <dirent.h>
+#include <time.h>
 
 /* Consider one file under the device directory.
  */
@@ -33,7 +34,7 @@ static int evdev_check_file(struct evdev *evdev,const char *base,int basec) {
   char path[1024];
   int pathc=snprintf(path,sizeof(path),"%s/%.*s",evdev->path,basec,base);
   if ((pathc<1)||(pathc>=sizeof(path))) return 0;
-  int fd=open(path,O_RDONLY);
+  int fd=open(path,O_RDONLY|O_NONBLOCK);
   if (fd<0) return 0;
   
   // Validate evdev version, and implicitly assert that it really is an evdev file.
@@ -50,6 +51,11 @@ static int evdev_check_file(struct evdev *evdev,const char *base,int basec) {
     ioctl(fd,EVIOCGRAB,&grab);
   }
   
+  // Timestamp on the monotonic clock, so they're comparable to eh_now_mono_ns(). Default is realtime.
+  // Older kernels and some drivers refuse; those devices report without timestamps.
+  int clockid=CLOCK_MONOTONIC;
+  int monotonic=(ioctl(fd,EVIOCSCLOCKID,&clockid)>=0);
+  
   // I'd like to use EVIOCSMASK to disable SYN_REPORT and MSC_SCAN, but I only ever get EINVAL from it.
   
   // Create a new device.
@@ -63,6 +69,12 @@ static int evdev_check_file(struct evdev *evdev,const char *base,int basec) {
   device->fd=fd;
   device->kid=kid;
   device->devid=eh_input_devid_next();
+  device->monotonic=monotonic;
+  evdev->pollfd_dirty=1;
+  if (evdev->epfd>=0) {
+    struct epoll_event event={.events=EPOLLIN,.data={.fd=fd}};
+    epoll_ctl(evdev->epfd,EPOLL_CTL_ADD,fd,&event);
+  }
   
   // Tell our owner, and we're done.
   if (evdev->delegate.cb_connect) evdev->delegate.cb_connect(device->devid,evdev->delegate.userdata);
@@ -103,6 +115,7 @@ static int evdev_update_inotify(struct evdev *evdev) {
   if (bufc<=0) {
     close(evdev->infd);
     evdev->infd=-1;
+    evdev->pollfd_dirty=1;
     return 0;
   }
   int bufp=0;
@@ -123,31 +136,41 @@ static int evdev_update_inotify(struct evdev *evdev) {
  */
  
 static int evdev_update_device(struct evdev *evdev,struct evdev_device *device) {
+  // Drain it. Nonblocking, so EAGAIN is how we know it's empty.
   struct input_event eventv[16];
-  int eventc=read(device->fd,eventv,sizeof(eventv));
-  if (eventc<=0) {
-    evdev_drop_device(evdev,device,1);
-    return 0;
-  }
-  if (evdev->delegate.cb_button) {
-    eventc/=sizeof(struct input_event);
-    const struct input_event *event=eventv;
-    for (;eventc-->0;event++) {
-    
-      // Would be preferable to filter these out with the event mask, EVIOCSMASK, but I can't seem to get that working.
-      if (event->type==EV_SYN) {
-        // These are noisy and not interesting.
-        continue;
-      }
-      if ((event->type==EV_MSC)&&(event->code==MSC_SCAN)) {
-        // Everything useful we can get from these, we got it during enumeration.
-        continue;
+  for (;;) {
+    int eventc=read(device->fd,eventv,sizeof(eventv));
+    if (eventc<=0) {
+      if ((eventc<0)&&((errno==EAGAIN)||(errno==EINTR))) return 0;
+      evdev_drop_device(evdev,device,1);
+      return 0;
+    }
+    int full=(eventc==sizeof(eventv));
+    if (evdev->delegate.cb_button||evdev->delegate.cb_button_timed) {
+      eventc/=sizeof(struct input_event);
+      const struct input_event *event=eventv;
+      for (;eventc-->0;event++) {
+      
+        // Would be preferable to filter these out with the event mask, EVIOCSMASK, but I can't seem to get that working.
+        if (event->type==EV_SYN) {
+          // These are noisy and not interesting.
+          continue;
+        }
+        if ((event->type==EV_MSC)&&(event->code==MSC_SCAN)) {
+          // Everything useful we can get from these, we got it during enumeration.
+          continue;
+        }
+      
+        if (device->monotonic&&evdev->delegate.cb_button_timed) {
+          int64_t time_ns=(int64_t)event->input_event_sec*1000000000ll+(int64_t)event->input_event_usec*1000ll;
+          evdev->delegate.cb_button_timed(device->devid,(event->type<<16)|event->code,event->value,time_ns,evdev->delegate.userdata);
+        } else if (evdev->delegate.cb_button) {
+          evdev->delegate.cb_button(device->devid,(event->type<<16)|event->code,event->value,evdev->delegate.userdata);
+        }
       }
-    
-      evdev->delegate.cb_button(device->devid,(event->type<<16)|event->code,event->value,evdev->delegate.userdata);
     }
+    if (!full) return 0;
   }
-  return 0;
 }
 
 /* Update one file.
@@ -166,6 +189,8 @@ int evdev_update_fd(struct evdev *evdev,int fd) {
  */
  
 static int evdev_rebuild_pollfdv(struct evdev *evdev) {
+  if (!evdev->pollfd_dirty) return 0;
+  evdev->pollfd_dirty=0;
   evdev->pollfdc=0;
   
   int na=evdev->devicec;
@@ -222,3 +247,46 @@ int evdev_update(struct evdev *evdev,int toms) {
   }
   return err;
 }
+
+/* Epoll, for a dedicated thread.
+ */
+ 
+int evdev_epoll_init(struct evdev *evdev) {
+  if (!evdev) return -1;
+  if (evdev->epfd>=0) return evdev->epfd;
+  if ((evdev->epfd=epoll_create1(EPOLL_CLOEXEC))<0) return -1;
+  struct epoll_event event={.events=EPOLLIN};
+  if (evdev->infd>=0) {
+    event.data.fd=evdev->infd;
+    if (epoll_ctl(evdev->epfd,EPOLL_CTL_ADD,evdev->infd,&event)<0) return -1;
+  }
+  int i=evdev->devicec;
+  while (i-->0) {
+    event.data.fd=evdev->devicev[i]->fd;
+    if (epoll_ctl(evdev->epfd,EPOLL_CTL_ADD,event.data.fd,&event)<0) return -1;
+  }
+  return evdev->epfd;
+}
+
+int evdev_epoll_wait(struct evdev *evdev,int *fdv,int fda,int toms) {
+  if (!evdev||(evdev->epfd<0)) return -1;
+  struct epoll_event eventv[16];
+  if (fda>16) fda=16;
+  int eventc=epoll_wait(evdev->epfd,eventv,fda,toms);
+  if (eventc<0) return (errno==EINTR)?0:-1;
+  int i=0;
+  for (;i<eventc;i++) fdv[i]=eventv[i].data.fd;
+  return eventc;
+}
+
+int evdev_update_fds(struct evdev *evdev,const int *fdv,int fdc) {
+  if (!evdev) return -1;
+  if (evdev->rescan) {
+    evdev->rescan=0;
+    if (evdev_scan_now(evdev)<0) return -1;
+  }
+  for (;fdc-->0;fdv++) {
+    if (evdev_update_fd(evdev,*fdv)<0) return -1;
+  }
+  return 0;
+}
@@ -10,6 +10,18 @@
  *   ... payload
  * No packet fragmentation.
  *
+ * Extension "long", for payloads of 64 kB and up:
+ * Client adds a header to the request: "Fakews-Extensions: long"
+ * A server that supports it responds with a packet: opcode 0, payload "long".
+ * Old servers ignore the header and never respond, and then we stay with the original framing.
+ * Client answers the ack with the same packet, so the server knows where its short framing ends.
+ * After the ack (server to client) or the answer (client to server), a length of 0xffff is an escape, and the real length follows as u32:
+ *   u8  opcode
+ *   u16 0xffff
+ *   u32 len
+ *   ... payload
+ * Opcode zero is reserved for these protocol-level messages and never reaches the client.
+ *
  * A fakews instance is bound to one remote host and port.
  * The instance is alive and valid whether connected or not.
  * When disconnected, we will automatically try to reconnect periodically.
@@ -20,6 +32,7 @@
 #define FAKEWS_H
 
 struct fakews;
+struct iovec;
 
 void fakews_del(struct fakews *fakews);
 
@@ -44,4 +57,19 @@ int fakews_connect_now(struct fakews *fakews);
  */
 int fakews_send(struct fakews *fakews,int opcode,const void *v,int c);
 
+/* Send one packet whose payload is the concatenation of (iovc) buffers.
+ * If nothing is queued, we write straight from your buffers and copy only what the socket doesn't take right away.
+ * Payloads over 0xffff fail unless the server has acknowledged the "long" extension.
+ */
+int fakews_sendv(struct fakews *fakews,int opcode,const struct iovec *iov,int iovc);
+
+/* Nonzero if the server acknowledged the "long" extension. Until then, payloads are limited to 0xffff bytes.
+ */
+int fakews_is_long(const struct fakews *fakews);
+
+/* Bytes queued but not yet accepted by the socket.
+ * Large senders should check this and back off, rather than growing the queue without bound.
+ */
+int fakews_get_pending(const struct fakews *fakews);
+
 #endif
@@ -8,14 +8,18 @@
 #include <limits.h>
 #include <stdint.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/poll.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <errno.h>
 #include <sys/time.h>
 
-#define FAKEWS_WBUF_SANITY_LIMIT 0x01000000
-#define FAKEWS_RBUF_SANITY_LIMIT 0x00020000 /* Max packet size is 65538. If it gets this large, something is truly borked. */
+#define FAKEWS_WBUF_SANITY_LIMIT 0x02000000
+#define FAKEWS_PACKET_LIMIT 0x01000000 /* Payload, with the "long" extension. Without it, 0xffff. */
+#define FAKEWS_RBUF_SANITY_LIMIT (FAKEWS_PACKET_LIMIT+7)
+#define FAKEWS_IOV_LIMIT 8
 #define FAKEWS_AUTOCONNECT_INTERVAL_US 10000000
 
 struct fakews {
@@ -35,6 +39,7 @@ struct fakews {
   char *rbuf;
   int rbufp,rbufc,rbufa;
   int64_t next_autoconnect_time;
+  int long_ok; // Server acknowledged the "long" extension on this connection.
   
   void (*cb_connect)(void *userdata);
   void (*cb_disconnect)(void *userdata);
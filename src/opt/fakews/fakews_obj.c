@@ -1,5 +1,7 @@
 #include "fakews_internal.h"
 
+static int fakews_wbuf_append(struct fakews *fakews,const void *src,int srcc);
+
 /* Delete.
  */
 
@@ -57,6 +59,7 @@ struct fakews *fakews_new(
   fakews->cb_connect=cb_connect;
   fakews->cb_disconnect=cb_disconnect;
   fakews->cb_message=cb_message;
+  fakews->userdata=userdata;
   
   return fakews;
 }
@@ -83,11 +86,13 @@ static int fakews_require_connection(struct fakews *fakews) {
 }
 
 /* Write from buffer to socket.
+ * Never blocks: Whatever the kernel won't take now stays queued for the next update.
  */
  
 static int fakews_write(struct fakews *fakews) {
   if (fakews->wbufc<1) return 0;
-  int err=write(fakews->fd,fakews->wbuf+fakews->wbufp,fakews->wbufc);
+  int err=send(fakews->fd,fakews->wbuf+fakews->wbufp,fakews->wbufc,MSG_DONTWAIT|MSG_NOSIGNAL);
+  if ((err<0)&&((errno==EAGAIN)||(errno==EWOULDBLOCK))) return 0;
   if (err<=0) return -1;
   if (fakews->wbufc-=err) fakews->wbufp+=err;
   else fakews->wbufp=0;
@@ -97,33 +102,61 @@ static int fakews_write(struct fakews *fakews) {
 /* Read from socket to buffer.
  */
  
-static int fakews_read(struct fakews *fakews) {
-  
-  if (fakews->rbufp+fakews->rbufc>=fakews->rbufa) {
-    if (fakews->rbufp) {
-      memmove(fakews->rbuf,fakews->rbuf+fakews->rbufp,fakews->rbufc);
-      fakews->rbufp=0;
-    } else {
-      if (fakews->rbufa>=FAKEWS_RBUF_SANITY_LIMIT) return -1;
-      int na=fakews->rbufa+1024;
-      void *nv=realloc(fakews->rbuf,na);
-      if (!nv) return -1;
-      fakews->rbuf=nv;
-      fakews->rbufa=na;
-    }
+static int fakews_rbuf_require(struct fakews *fakews,int c) {
+  if (fakews->rbufp+c<=fakews->rbufa) return 0;
+  if (fakews->rbufp) {
+    memmove(fakews->rbuf,fakews->rbuf+fakews->rbufp,fakews->rbufc);
+    fakews->rbufp=0;
+    if (c<=fakews->rbufa) return 0;
+  }
+  if (c>FAKEWS_RBUF_SANITY_LIMIT) return -1;
+  int na=(c+1023)&~1023;
+  void *nv=realloc(fakews->rbuf,na);
+  if (!nv) return -1;
+  fakews->rbuf=nv;
+  fakews->rbufa=na;
+  return 0;
+}
+
+/* Protocol-level packet from the server, opcode zero.
+ */
+ 
+static int fakews_receive_control(struct fakews *fakews,const void *v,int c) {
+  if ((c==4)&&!memcmp(v,"long",4)&&!fakews->long_ok) {
+    // Anything we sent before this was short-framed, even at 0xffff. Tell the server where that stops.
+    if (fakews_wbuf_append(fakews,"\0\0\4long",7)<0) return -1;
+    fakews->long_ok=1;
   }
+  return 0;
+}
+ 
+static int fakews_read(struct fakews *fakews) {
   
+  if (fakews_rbuf_require(fakews,fakews->rbufc+1024)<0) return -1;
   int err=read(fakews->fd,fakews->rbuf+fakews->rbufp+fakews->rbufc,fakews->rbufa-fakews->rbufc-fakews->rbufp);
   if (err<=0) return -1;
   fakews->rbufc+=err;
   
   while (fakews->rbufc>=3) {
     const uint8_t *src=(uint8_t*)fakews->rbuf+fakews->rbufp;
+    int hdrlen=3;
     int paylen=(src[1]<<8)|src[2];
-    int pktlen=3+paylen;
-    if (fakews->rbufc<pktlen) break;
-    if (fakews->cb_message) {
-      fakews->cb_message(src[0],src+3,paylen,fakews->userdata);
+    if ((paylen==0xffff)&&fakews->long_ok) {
+      if (fakews->rbufc<7) break;
+      hdrlen=7;
+      paylen=(src[3]<<24)|(src[4]<<16)|(src[5]<<8)|src[6];
+      if ((paylen<0)||(paylen>FAKEWS_PACKET_LIMIT)) return -1;
+    }
+    int pktlen=hdrlen+paylen;
+    if (fakews->rbufc<pktlen) {
+      // Make room for the whole packet now, rather than creeping up on it.
+      if (fakews_rbuf_require(fakews,pktlen)<0) return -1;
+      break;
+    }
+    if (!src[0]) {
+      if (fakews_receive_control(fakews,src+hdrlen,paylen)<0) return -1;
+    } else if (fakews->cb_message) {
+      fakews->cb_message(src[0],src+hdrlen,paylen,fakews->userdata);
     }
     fakews->rbufp+=pktlen;
     fakews->rbufc-=pktlen;
@@ -172,6 +205,16 @@ int fakews_is_connected(const struct fakews *fakews) {
   return (fakews->fd>=0)?1:0;
 }
 
+int fakews_is_long(const struct fakews *fakews) {
+  if (!fakews||(fakews->fd<0)) return 0;
+  return fakews->long_ok;
+}
+
+int fakews_get_pending(const struct fakews *fakews) {
+  if (!fakews||(fakews->fd<0)) return 0;
+  return fakews->wbufc;
+}
+
 /* Connect.
  */
   
@@ -230,7 +273,7 @@ int fakews_connect_now(struct fakews *fakews) {
   /* Create and connect socket.
    */
   char req[256];
-  int reqc=snprintf(req,sizeof(req),"FAKEWEBSOCKET %.*s HTTP/1.1\r\n\r\n",fakews->pathc,fakews->path);
+  int reqc=snprintf(req,sizeof(req),"FAKEWEBSOCKET %.*s HTTP/1.1\r\nFakews-Extensions: long\r\n\r\n",fakews->pathc,fakews->path);
   if ((reqc<1)||(reqc>=sizeof(req))) return -1;
   if ((fakews->fd=socket(fakews->family,fakews->socktype,fakews->protocol))<0) return -1;
   if (connect(fakews->fd,fakews->raddr,fakews->raddrc)<0) {
@@ -246,28 +289,28 @@ int fakews_connect_now(struct fakews *fakews) {
     fakews->fd=-1;
     return -1;
   }
+  fakews->long_ok=0;
+  fakews->wbufp=fakews->wbufc=0;
+  fakews->rbufp=fakews->rbufc=0;
   fprintf(stderr,"Connected to %.*s:%d\n",fakews->hostc,fakews->host,fakews->port);
   if (fakews->cb_connect) fakews->cb_connect(fakews->userdata);
   
   return 0;
 }
 
-/* Queue packet for delivery.
+/* Append to write buffer.
  */
  
-int fakews_send(struct fakews *fakews,int opcode,const void *v,int c) {
-  if (!fakews||(fakews->fd<0)) return -1;
-  if ((opcode<0)||(opcode>0xff)) return -1;
-  if ((c<0)||(c>0xffff)||(c&&!v)) return -1;
-  
-  int addc=3+c;
-  if (fakews->wbufp+fakews->wbufc>fakews->wbufa-addc) {
+static int fakews_wbuf_append(struct fakews *fakews,const void *src,int srcc) {
+  if (srcc<1) return 0;
+  if (fakews->wbufp+fakews->wbufc>fakews->wbufa-srcc) {
     if (fakews->wbufp) {
       memmove(fakews->wbuf,fakews->wbuf+fakews->wbufp,fakews->wbufc);
       fakews->wbufp=0;
     }
-    int na=fakews->wbufc+addc;
-    if (na<INT_MAX-1024) na=(na+1024)&~1023;
+    if (fakews->wbufc>INT_MAX-srcc-1024) return -1;
+    int na=fakews->wbufc+srcc;
+    na=(na+1024)&~1023;
     if (na>FAKEWS_WBUF_SANITY_LIMIT) return -1;
     if (na>fakews->wbufa) {
       void *nv=realloc(fakews->wbuf,na);
@@ -276,13 +319,78 @@ int fakews_send(struct fakews *fakews,int opcode,const void *v,int c) {
       fakews->wbufa=na;
     }
   }
+  memcpy(fakews->wbuf+fakews->wbufp+fakews->wbufc,src,srcc);
+  fakews->wbufc+=srcc;
+  return 0;
+}
+
+/* Queue packet for delivery.
+ */
+ 
+int fakews_sendv(struct fakews *fakews,int opcode,const struct iovec *iov,int iovc) {
+  if (!fakews||(fakews->fd<0)) return -1;
+  if ((opcode<1)||(opcode>0xff)) return -1;
+  if ((iovc<0)||(iovc>FAKEWS_IOV_LIMIT)||(iovc&&!iov)) return -1;
+  
+  int c=0,i=0;
+  for (;i<iovc;i++) {
+    if ((iov[i].iov_len>FAKEWS_PACKET_LIMIT)||(iov[i].iov_len&&!iov[i].iov_base)) return -1;
+    c+=iov[i].iov_len;
+    if (c>FAKEWS_PACKET_LIMIT) return -1;
+  }
   
-  char *dst=fakews->wbuf+fakews->wbufp+fakews->wbufc;
-  *dst++=opcode;
-  *dst++=c>>8;
-  *dst++=c;
-  memcpy(dst,v,c);
-  fakews->wbufc+=addc;
+  uint8_t hdr[7];
+  int hdrc=0;
+  hdr[hdrc++]=opcode;
+  if ((c<0xffff)||((c==0xffff)&&!fakews->long_ok)) {
+    hdr[hdrc++]=c>>8;
+    hdr[hdrc++]=c;
+  } else if (fakews->long_ok) {
+    hdr[hdrc++]=0xff;
+    hdr[hdrc++]=0xff;
+    hdr[hdrc++]=c>>24;
+    hdr[hdrc++]=c>>16;
+    hdr[hdrc++]=c>>8;
+    hdr[hdrc++]=c;
+  } else {
+    return -1;
+  }
+  if (fakews->wbufc>FAKEWS_WBUF_SANITY_LIMIT-hdrc-c) return -1;
+  
+  /* If nothing is queued, try writing straight from the caller's buffers.
+   * Whatever the socket doesn't take, we copy.
+   */
+  struct iovec v[1+FAKEWS_IOV_LIMIT];
+  v[0].iov_base=hdr;
+  v[0].iov_len=hdrc;
+  memcpy(v+1,iov,sizeof(struct iovec)*iovc);
+  int vc=1+iovc;
+  int sent=0;
+  if (!fakews->wbufc) {
+    struct msghdr msg={.msg_iov=v,.msg_iovlen=vc};
+    if ((sent=sendmsg(fakews->fd,&msg,MSG_DONTWAIT|MSG_NOSIGNAL))<0) {
+      // Real errors will come back at the next update. Queue it as if nothing happened.
+      sent=0;
+    }
+  }
+  for (i=0;i<vc;i++) {
+    if (sent>=v[i].iov_len) {
+      sent-=v[i].iov_len;
+      continue;
+    }
+    if (fakews_wbuf_append(fakews,(char*)v[i].iov_base+sent,v[i].iov_len-sent)<0) {
+      // Part of the packet may be on the wire already. No way to recover the stream.
+      fakews_close(fakews);
+      return -1;
+    }
+    sent=0;
+  }
   
   return 0;
 }
+ 
+int fakews_send(struct fakews *fakews,int opcode,const void *v,int c) {
+  if ((c<0)||(c&&!v)) return -1;
+  struct iovec iov={.iov_base=(void*)v,.iov_len=c};
+  return fakews_sendv(fakews,opcode,&iov,1);
+}
@@ -167,11 +167,55 @@ static int eh_glx_init_window_gx(struct eh_video_driver *driver,const struct eh_
   return 0;
 }
 
+/* Set swap interval 1, if any of the usual extensions is available.
+ * Failure is not an error; we leave (driver->vsync) unset and the clock paces instead.
+ */
+ 
+static int eh_glx_has_extension(const char *extv,const char *name) {
+  if (!extv) return 0;
+  int namec=0; while (name[namec]) namec++;
+  while (*extv) {
+    while (*extv==' ') extv++;
+    int c=0; while (extv[c]&&(extv[c]!=' ')) c++;
+    if ((c==namec)&&!memcmp(extv,name,c)) return 1;
+    extv+=c;
+  }
+  return 0;
+}
+ 
+static void eh_glx_init_vsync(struct eh_video_driver *driver) {
+  const char *extv=glXQueryExtensionsString(DRIVER->dpy,DRIVER->screen);
+  if (eh_glx_has_extension(extv,"GLX_EXT_swap_control")) {
+    void (*fn)(Display*,GLXDrawable,int)=(void*)glXGetProcAddress((const GLubyte*)"glXSwapIntervalEXT");
+    if (fn) {
+      fn(DRIVER->dpy,DRIVER->win,1);
+      driver->vsync=1;
+      return;
+    }
+  }
+  if (eh_glx_has_extension(extv,"GLX_MESA_swap_control")) {
+    int (*fn)(unsigned int)=(void*)glXGetProcAddress((const GLubyte*)"glXSwapIntervalMESA");
+    if (fn&&!fn(1)) {
+      driver->vsync=1;
+      return;
+    }
+  }
+  if (eh_glx_has_extension(extv,"GLX_SGI_swap_control")) {
+    int (*fn)(int)=(void*)glXGetProcAddress((const GLubyte*)"glXSwapIntervalSGI");
+    if (fn&&!fn(1)) {
+      driver->vsync=1;
+      return;
+    }
+  }
+  fprintf(stderr,"glx: No swap control extension, can't sync to vblank.\n");
+}
+
 /* Init public OpenGL context.
  */
  
 int eh_glx_init_opengl(struct eh_video_driver *driver,const struct eh_video_setup *setup) {
   if (eh_glx_init_window_gx(driver,setup)<0) return -1;
+  if (setup->vsync) eh_glx_init_vsync(driver);
   return 0;
 }
 
@@ -9,10 +9,12 @@
   // MinGW doesn't give us sys/poll.h. Not going to bother figuring it out; I won't need the editor under Windows.
   #include "fake_poll.h"
   #include <Windows.h>
+  struct iovec { void *iov_base; size_t iov_len; };
 #else
   #include <sys/poll.h>
   #include <netdb.h>
   #include <sys/socket.h>
+  #include <sys/uio.h>
 #endif
 #include <unistd.h>
 #include <fcntl.h>
@@ -38,6 +38,19 @@ static int http_xfer_upgrade_websocket(struct http_socket *socket,struct http_xf
     if (http_listener_ref(listener)<0) return -1;
     if (socket->listener) http_listener_del(socket->listener);
     socket->listener=listener;
+    
+    // Acknowledge "long" before the app gets a chance to send anything.
+    const char *ext=0;
+    int extc=http_xfer_get_header(&ext,xfer,"Fakews-Extensions",17);
+    int extp=0;
+    for (;extp<=extc-4;extp++) {
+      if (!memcmp(ext+extp,"long",4)) {
+        if (http_socket_wbuf_append(socket,"\0\0\4long",7)<0) return -1;
+        socket->fakews_long=1;
+        break;
+      }
+    }
+    
     if (socket->listener->cb_connect) {
       if (socket->listener->cb_connect(socket,socket->listener->userdata)<0) return -1;
     }
@@ -311,13 +324,24 @@ static int http_protocol_ws_input(struct http_socket *socket,uint8_t *src,int sr
 
 static int http_protocol_fakews_input(struct http_socket *socket,uint8_t *src,int srcc) {
   if (srcc<3) return 0;
+  int hdrlen=3;
   int paylen=(src[1]<<8)|src[2];
-  int pktlen=3+paylen;
+  if ((paylen==0xffff)&&socket->fakews_long_in) {
+    if (srcc<7) return 0;
+    hdrlen=7;
+    paylen=(src[3]<<24)|(src[4]<<16)|(src[5]<<8)|src[6];
+    if ((paylen<0)||(paylen>HTTP_FAKEWS_PACKET_LIMIT)) return -1;
+  }
+  int pktlen=hdrlen+paylen;
   if (srcc<pktlen) return 0;
+  if (!src[0]) { // Opcode zero is protocol-level. Clients only send "long", answering our ack.
+    if (socket->fakews_long&&(paylen==4)&&!memcmp(src+hdrlen,"long",4)) socket->fakews_long_in=1;
+    return pktlen;
+  }
   if (socket->cb_message) {
-    if (socket->cb_message(socket,src[0],src+3,paylen,socket->userdata)<0) return -1;
+    if (socket->cb_message(socket,src[0],src+hdrlen,paylen,socket->userdata)<0) return -1;
   } else if (socket->listener&&socket->listener->cb_message) {
-    if (socket->listener->cb_message(socket,src[0],src+3,paylen,socket->listener->userdata)<0) return -1;
+    if (socket->listener->cb_message(socket,src[0],src+hdrlen,paylen,socket->listener->userdata)<0) return -1;
   }
   return pktlen;
 }
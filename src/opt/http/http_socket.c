@@ -140,6 +140,30 @@ int http_socket_wbuf_appendf(struct http_socket *socket,const char *fmt,...) {
   }
 }
 
+/* Scatter write.
+ */
+ 
+int http_socket_sendv(struct http_socket *socket,const struct iovec *iov,int iovc) {
+  if (!socket||(iovc<0)||(iovc>HTTP_SENDV_LIMIT)) return -1;
+  int sent=0;
+  #if !FMN_USE_mswin
+    if (!socket->wbufc&&(socket->fd>=0)) {
+      struct msghdr msg={.msg_iov=(struct iovec*)iov,.msg_iovlen=iovc};
+      if ((sent=sendmsg(socket->fd,&msg,MSG_DONTWAIT|MSG_NOSIGNAL))<0) sent=0; // Real errors surface at the next poll.
+    }
+  #endif
+  int i=0;
+  for (;i<iovc;i++) {
+    if (sent>=iov[i].iov_len) {
+      sent-=iov[i].iov_len;
+      continue;
+    }
+    if (http_socket_wbuf_append(socket,(char*)iov[i].iov_base+sent,iov[i].iov_len-sent)<0) return -1;
+    sent=0;
+  }
+  return 0;
+}
+
 /* Done writing.
  */
  
@@ -231,17 +255,30 @@ int http_websocket_send(struct http_socket *socket,int type,const void *v,int c)
       preamble[preamblec++]=c>>8;
       preamble[preamblec++]=c;
     }
-    if (http_socket_wbuf_append(socket,preamble,preamblec)<0) return -1;
-    if (http_socket_wbuf_append(socket,v,c)<0) return -1;
-    return 0;
+    struct iovec iov[2]={{preamble,preamblec},{(void*)v,c}};
+    return http_socket_sendv(socket,iov,2);
   }
   
   if (socket->protocol==HTTP_PROTOCOL_FAKEWEBSOCKET) {
-    if ((type<0)||(type>0xff)||(c>0xffff)) return -1;
-    char preamble[3]={type,c>>8,c};
-    if (http_socket_wbuf_append(socket,preamble,sizeof(preamble))<0) return -1;
-    if (http_socket_wbuf_append(socket,v,c)<0) return -1;
-    return 0;
+    if ((type<1)||(type>0xff)) return -1;
+    char preamble[7];
+    int preamblec=0;
+    preamble[preamblec++]=type;
+    if ((c<0xffff)||((c==0xffff)&&!socket->fakews_long)) {
+      preamble[preamblec++]=c>>8;
+      preamble[preamblec++]=c;
+    } else if (socket->fakews_long&&(c<=HTTP_FAKEWS_PACKET_LIMIT)) {
+      preamble[preamblec++]=0xff;
+      preamble[preamblec++]=0xff;
+      preamble[preamblec++]=c>>24;
+      preamble[preamblec++]=c>>16;
+      preamble[preamblec++]=c>>8;
+      preamble[preamblec++]=c;
+    } else {
+      return -1;
+    }
+    struct iovec iov[2]={{preamble,preamblec},{(void*)v,c}};
+    return http_socket_sendv(socket,iov,2);
   }
   
   return 0;
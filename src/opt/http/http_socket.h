@@ -11,11 +11,16 @@
 #define HTTP_PROTOCOL_WEBSOCKET 3
 #define HTTP_PROTOCOL_FAKEWEBSOCKET 4
 
+#define HTTP_FAKEWS_PACKET_LIMIT 0x01000000 /* With the "long" extension, see src/opt/fakews/fakews.h */
+#define HTTP_SENDV_LIMIT 4
+
 struct http_socket {
   int refc;
   struct http_context *context;
   int fd;
   int protocol;
+  int fakews_long; // FAKEWEBSOCKET client asked for the "long" extension and we acknowledged it. Governs our output.
+  int fakews_long_in; // Client answered our ack, so its packets from here on may be long. Governs input.
   
   /* Two transfer buffers.
    * These have a moving head and tail but are not circular.
@@ -64,6 +69,12 @@ int http_socket_rbuf_consume(struct http_socket *socket,int c);
 int http_socket_wbuf_append(struct http_socket *socket,const void *src,int srcc);
 int http_socket_wbuf_appendf(struct http_socket *socket,const char *fmt,...);
 
+/* Send a sequence of buffers.
+ * If nothing is queued, we write straight from them, and copy into (wbuf) only what the socket doesn't take.
+ */
+struct iovec;
+int http_socket_sendv(struct http_socket *socket,const struct iovec *iov,int iovc);
+
 /* Flush content between the file and my buffers.
  * Owner should call these whenever the socket polls.
  */
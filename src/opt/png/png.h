@@ -120,4 +120,9 @@ struct png_image *png_decode_finish(struct png_decoder *decoder); // => STRONG
 
 int png_encode(void *dstpp,const struct png_image *image);
 
+/* Same thing with a zlib compression level, 0..9.
+ * png_encode() uses 9, the smallest and slowest.
+ */
+int png_encode_level(void *dstpp,const struct png_image *image,int level);
+
 #endif
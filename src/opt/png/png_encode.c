@@ -17,6 +17,7 @@ struct png_encoder {
   int zinit;
   int pixelsize; // bits
   int rowlen; // output stride in bytes (image->stride is allowed to overshoot)
+  int level; // zlib
 };
 
 static void png_encoder_cleanup(struct png_encoder *encoder) {
@@ -136,7 +137,7 @@ static int png_encode_IDAT(struct png_encoder *encoder) {
   if (encoder->rowbuf||encoder->zinit) return -1;
   encoder->rowbufc=1+encoder->rowlen;
   if (!(encoder->rowbuf=malloc(encoder->rowbufc))) return -1;
-  if (deflateInit(&encoder->z,Z_BEST_COMPRESSION)<0) return -1;
+  if (deflateInit(&encoder->z,encoder->level)<0) return -1;
   encoder->zinit=1;
   int xstride=(encoder->pixelsize+7)>>3;
   
@@ -213,11 +214,18 @@ static int png_encode_inner(struct png_encoder *encoder) {
  */
  
 int png_encode(void *dstpp,const struct png_image *image) {
+  return png_encode_level(dstpp,image,Z_BEST_COMPRESSION);
+}
+
+int png_encode_level(void *dstpp,const struct png_image *image,int level) {
   if (!dstpp||!image) return -1;
   if ((image->w<1)||(image->h<1)) return -1;
   if (!image->pixels) return -1;
+  if (level<Z_NO_COMPRESSION) level=Z_NO_COMPRESSION;
+  else if (level>Z_BEST_COMPRESSION) level=Z_BEST_COMPRESSION;
   struct png_encoder encoder={
     .image=image,
+    .level=level,
   };
   if (png_encode_inner(&encoder)<0) {
     png_encoder_cleanup(&encoder);
@@ -69,3 +69,75 @@ const struct eh_audio_type eh_audio_type_pulse={
   .lock=_pulse_lock,
   .unlock=_pulse_unlock,
 };
+
+/* Async variant.
+ ******************************************************************/
+ 
+struct eh_audio_driver_pulseasync {
+  struct eh_audio_driver hdr;
+  struct pulseasync *pulseasync;
+};
+
+#define ADRIVER ((struct eh_audio_driver_pulseasync*)driver)
+
+static void _pulseasync_del(struct eh_audio_driver *driver) {
+  pulseasync_del(ADRIVER->pulseasync);
+}
+
+/* (tlength) is the whole buffer we'd ask of alsa, and (minreq) one period.
+ */
+static int _pulseasync_init(
+  struct eh_audio_driver *driver,
+  const struct eh_audio_setup *config
+) {
+  int tlength=0,minreq=0;
+  if (config) {
+    driver->rate=config->rate;
+    driver->chanc=config->chanc;
+    if (config->periodsize>0) {
+      minreq=config->periodsize;
+      if (config->periodc>0) tlength=config->periodsize*config->periodc;
+    }
+  }
+  if (!driver->rate) driver->rate=44100;
+  if (!driver->chanc) driver->chanc=2;
+  if (!(ADRIVER->pulseasync=pulseasync_new(
+    driver->rate,driver->chanc,
+    tlength,minreq,
+    driver->delegate.cb_pcm,driver->delegate.userdata,
+    ""
+  ))) return -1;
+  driver->rate=pulseasync_get_rate(ADRIVER->pulseasync);
+  driver->chanc=pulseasync_get_chanc(ADRIVER->pulseasync);
+  driver->format=EH_AUDIO_FORMAT_S16N;
+  return 0;
+}
+
+static void _pulseasync_play(struct eh_audio_driver *driver,int play) {
+  pulseasync_play(ADRIVER->pulseasync,play);
+  driver->playing=play?1:0;
+}
+
+static int _pulseasync_update(struct eh_audio_driver *driver) {
+  return pulseasync_update(ADRIVER->pulseasync);
+}
+
+static int _pulseasync_lock(struct eh_audio_driver *driver) {
+  return pulseasync_lock(ADRIVER->pulseasync);
+}
+
+static void _pulseasync_unlock(struct eh_audio_driver *driver) {
+  pulseasync_unlock(ADRIVER->pulseasync);
+}
+
+const struct eh_audio_type eh_audio_type_pulseasync={
+  .name="pulseasync",
+  .desc="PulseAudio with the async API: Targets a latency, and doesn't block at quit.",
+  .objlen=sizeof(struct eh_audio_driver_pulseasync),
+  .del=_pulseasync_del,
+  .init=_pulseasync_init,
+  .play=_pulseasync_play,
+  .update=_pulseasync_update,
+  .lock=_pulseasync_lock,
+  .unlock=_pulseasync_unlock,
+};
@@ -2,8 +2,10 @@
 #define PULSE_INTERNAL_H
 
 #include "pulse.h"
+#include "pulseasync.h"
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <stdio.h>
 #include <endian.h>
 #include <pthread.h>
@@ -30,4 +32,24 @@ struct pulse {
   int playing;
 };
 
+struct pulseasync {
+  void (*cb)(int16_t *v,int c,void *userdata);
+  void *userdata;
+  int rate,chanc;
+  int tlength,minreq; // frames, as agreed by the server.
+  
+  pa_threaded_mainloop *mainloop;
+  pa_context *context;
+  pa_stream *stream;
+  
+  int playing;
+  int closing; // Set under lock at teardown, callbacks must not touch the client after.
+  int ioerror;
+  
+  // Statistics, written by the mainloop thread:
+  int underflowc;
+  int latency_last,latency_max; // us
+  int64_t latency_sum,latency_samplec;
+};
+
 #endif
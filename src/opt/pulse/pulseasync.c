@@ -0,0 +1,284 @@
+#include "pulse_internal.h"
+
+/* Delete.
+ * Detach callbacks and disconnect with the lock held: Neither blocks, they just queue work for the mainloop.
+ * Then stop the mainloop. Its thread sleeps only in poll, and stop wakes it, so the join is immediate.
+ */
+
+void pulseasync_del(struct pulseasync *pulseasync) {
+  if (!pulseasync) return;
+
+  if (pulseasync->mainloop) {
+    pa_threaded_mainloop_lock(pulseasync->mainloop);
+    pulseasync->closing=1;
+    if (pulseasync->stream) {
+      pa_stream_set_write_callback(pulseasync->stream,0,0);
+      pa_stream_set_underflow_callback(pulseasync->stream,0,0);
+      pa_stream_set_state_callback(pulseasync->stream,0,0);
+      pa_stream_disconnect(pulseasync->stream);
+    }
+    if (pulseasync->context) {
+      pa_context_set_state_callback(pulseasync->context,0,0);
+      pa_context_disconnect(pulseasync->context);
+    }
+    pa_threaded_mainloop_unlock(pulseasync->mainloop);
+    pa_threaded_mainloop_stop(pulseasync->mainloop);
+  }
+
+  /* Stats are written by the mainloop thread; only safe to read once it's stopped. */
+  if (pulseasync->latency_samplec) {
+    fprintf(stderr,
+      "pulse: %d underflows. Output latency avg %d ms, max %d ms. tlength %d frames, minreq %d.\n",
+      pulseasync->underflowc,
+      (int)(pulseasync->latency_sum/(pulseasync->latency_samplec*1000)),
+      pulseasync->latency_max/1000,
+      pulseasync->tlength,pulseasync->minreq
+    );
+  }
+
+  if (pulseasync->stream) pa_stream_unref(pulseasync->stream);
+  if (pulseasync->context) pa_context_unref(pulseasync->context);
+  if (pulseasync->mainloop) pa_threaded_mainloop_free(pulseasync->mainloop);
+  free(pulseasync);
+}
+
+/* Callbacks from PulseAudio. All on the mainloop thread, with the lock held.
+ */
+
+static void pulseasync_cb_context_state(pa_context *context,void *userdata) {
+  struct pulseasync *pulseasync=userdata;
+  switch (pa_context_get_state(context)) {
+    case PA_CONTEXT_READY: pa_threaded_mainloop_signal(pulseasync->mainloop,0); break;
+    case PA_CONTEXT_FAILED:
+    case PA_CONTEXT_TERMINATED: {
+        pulseasync->ioerror=-1;
+        pa_threaded_mainloop_signal(pulseasync->mainloop,0);
+      } break;
+    default: break;
+  }
+}
+
+static void pulseasync_cb_stream_state(pa_stream *stream,void *userdata) {
+  struct pulseasync *pulseasync=userdata;
+  switch (pa_stream_get_state(stream)) {
+    case PA_STREAM_READY: pa_threaded_mainloop_signal(pulseasync->mainloop,0); break;
+    case PA_STREAM_FAILED:
+    case PA_STREAM_TERMINATED: {
+        pulseasync->ioerror=-1;
+        pa_threaded_mainloop_signal(pulseasync->mainloop,0);
+      } break;
+    default: break;
+  }
+}
+
+static void pulseasync_cb_underflow(pa_stream *stream,void *userdata) {
+  struct pulseasync *pulseasync=userdata;
+  pulseasync->underflowc++;
+}
+
+static void pulseasync_cb_write(pa_stream *stream,size_t nbytes,void *userdata) {
+  struct pulseasync *pulseasync=userdata;
+  if (pulseasync->closing) return;
+  size_t framesize=sizeof(int16_t)*pulseasync->chanc;
+  while (nbytes>=framesize) {
+
+    // Let Pulse provide the buffer, saves a copy.
+    void *dst=0;
+    size_t dstc=nbytes;
+    if ((pa_stream_begin_write(stream,&dst,&dstc)<0)||!dst) {
+      pulseasync->ioerror=-1;
+      return;
+    }
+    dstc-=dstc%framesize;
+    if (!dstc) {
+      pa_stream_cancel_write(stream);
+      break;
+    }
+
+    int samplec=dstc/sizeof(int16_t);
+    if (pulseasync->playing) {
+      pulseasync->cb(dst,samplec,pulseasync->userdata);
+    } else {
+      memset(dst,0,dstc);
+    }
+    if (pa_stream_write(stream,dst,dstc,0,0,PA_SEEK_RELATIVE)<0) {
+      pulseasync->ioerror=-1;
+      return;
+    }
+    nbytes-=dstc;
+  }
+
+  // With AUTO_TIMING_UPDATE and INTERPOLATE_TIMING, this is cheap. It doesn't talk to the server.
+  pa_usec_t usec=0;
+  int negative=0;
+  if (pa_stream_get_latency(stream,&usec,&negative)>=0) {
+    int latency=negative?0:(usec>INT_MAX)?INT_MAX:(int)usec;
+    pulseasync->latency_last=latency;
+    if (latency>pulseasync->latency_max) pulseasync->latency_max=latency;
+    pulseasync->latency_sum+=latency;
+    pulseasync->latency_samplec++;
+  }
+}
+
+/* Init. Caller holds the lock, and the mainloop is running.
+ */
+
+static int pulseasync_init_context(struct pulseasync *pulseasync,const char *appname) {
+  if (!(pulseasync->context=pa_context_new(pa_threaded_mainloop_get_api(pulseasync->mainloop),appname))) return -1;
+  pa_context_set_state_callback(pulseasync->context,pulseasync_cb_context_state,pulseasync);
+  if (pa_context_connect(pulseasync->context,0,PA_CONTEXT_NOFLAGS,0)<0) return -1;
+  while (1) {
+    pa_context_state_t state=pa_context_get_state(pulseasync->context);
+    if (state==PA_CONTEXT_READY) return 0;
+    if (!PA_CONTEXT_IS_GOOD(state)) return -1;
+    pa_threaded_mainloop_wait(pulseasync->mainloop);
+  }
+}
+
+static int pulseasync_init_stream(struct pulseasync *pulseasync,const char *appname) {
+  pa_sample_spec sample_spec={
+    #if BYTE_ORDER==BIG_ENDIAN
+      .format=PA_SAMPLE_S16BE,
+    #else
+      .format=PA_SAMPLE_S16LE,
+    #endif
+    .rate=pulseasync->rate,
+    .channels=pulseasync->chanc,
+  };
+  if (!(pulseasync->stream=pa_stream_new(pulseasync->context,appname,&sample_spec,0))) return -1;
+  pa_stream_set_state_callback(pulseasync->stream,pulseasync_cb_stream_state,pulseasync);
+  pa_stream_set_write_callback(pulseasync->stream,pulseasync_cb_write,pulseasync);
+  pa_stream_set_underflow_callback(pulseasync->stream,pulseasync_cb_underflow,pulseasync);
+
+  // ADJUST_LATENCY makes (tlength) the end-to-end target, rather than just our side of the buffer.
+  size_t framesize=sizeof(int16_t)*pulseasync->chanc;
+  pa_buffer_attr buffer_attr={
+    .maxlength=(uint32_t)-1,
+    .tlength=pulseasync->tlength*framesize,
+    .prebuf=(uint32_t)-1,
+    .minreq=pulseasync->minreq*framesize,
+    .fragsize=(uint32_t)-1,
+  };
+  pa_stream_flags_t flags=PA_STREAM_ADJUST_LATENCY|PA_STREAM_AUTO_TIMING_UPDATE|PA_STREAM_INTERPOLATE_TIMING;
+  if (pa_stream_connect_playback(pulseasync->stream,0,&buffer_attr,flags,0,0)<0) return -1;
+  while (1) {
+    pa_stream_state_t state=pa_stream_get_state(pulseasync->stream);
+    if (state==PA_STREAM_READY) break;
+    if (!PA_STREAM_IS_GOOD(state)) return -1;
+    pa_threaded_mainloop_wait(pulseasync->mainloop);
+  }
+
+  // Read back what the server agreed to.
+  const pa_sample_spec *final_spec=pa_stream_get_sample_spec(pulseasync->stream);
+  if (final_spec) {
+    pulseasync->rate=final_spec->rate;
+    pulseasync->chanc=final_spec->channels;
+    framesize=sizeof(int16_t)*pulseasync->chanc;
+  }
+  const pa_buffer_attr *final_attr=pa_stream_get_buffer_attr(pulseasync->stream);
+  if (final_attr) {
+    pulseasync->tlength=final_attr->tlength/framesize;
+    pulseasync->minreq=final_attr->minreq/framesize;
+  }
+  return 0;
+}
+
+/* New.
+ */
+
+struct pulseasync *pulseasync_new(
+  int rate,int chanc,
+  int tlength,int minreq,
+  void (*cb)(int16_t *v,int c,void *userdata),
+  void *userdata,
+  const char *appname
+) {
+  if (!cb) return 0;
+  if ((rate<1)||(chanc<1)||(chanc>PA_CHANNELS_MAX)) return 0;
+  struct pulseasync *pulseasync=calloc(1,sizeof(struct pulseasync));
+  if (!pulseasync) return 0;
+
+  pulseasync->rate=rate;
+  pulseasync->chanc=chanc;
+  pulseasync->cb=cb;
+  pulseasync->userdata=userdata;
+
+  // Default to 50 ms, like (pulse), but asking for it in 4 pieces.
+  if (tlength<1) tlength=rate/20;
+  if (tlength<20) tlength=20;
+  if ((minreq<1)||(minreq>tlength)) minreq=tlength>>2;
+  pulseasync->tlength=tlength;
+  pulseasync->minreq=minreq;
+
+  if (!appname||!appname[0]) appname="emuhost";
+  if (!(pulseasync->mainloop=pa_threaded_mainloop_new())) {
+    pulseasync_del(pulseasync);
+    return 0;
+  }
+  if (pa_threaded_mainloop_start(pulseasync->mainloop)<0) {
+    pa_threaded_mainloop_free(pulseasync->mainloop);
+    pulseasync->mainloop=0;
+    pulseasync_del(pulseasync);
+    return 0;
+  }
+  pa_threaded_mainloop_lock(pulseasync->mainloop);
+  if (
+    (pulseasync_init_context(pulseasync,appname)<0)||
+    (pulseasync_init_stream(pulseasync,appname)<0)
+  ) {
+    pa_threaded_mainloop_unlock(pulseasync->mainloop);
+    pulseasync_del(pulseasync);
+    return 0;
+  }
+  pulseasync->ioerror=0;
+  pa_threaded_mainloop_unlock(pulseasync->mainloop);
+
+  return pulseasync;
+}
+
+/* Trivial accessors.
+ */
+
+void *pulseasync_get_userdata(const struct pulseasync *pulseasync) {
+  return pulseasync?pulseasync->userdata:0;
+}
+
+int pulseasync_get_rate(const struct pulseasync *pulseasync) {
+  return pulseasync?pulseasync->rate:0;
+}
+
+int pulseasync_get_chanc(const struct pulseasync *pulseasync) {
+  return pulseasync?pulseasync->chanc:0;
+}
+
+void pulseasync_play(struct pulseasync *pulseasync,int play) {
+  if (!pulseasync) return;
+  pulseasync->playing=play?1:0;
+}
+
+int pulseasync_lock(struct pulseasync *pulseasync) {
+  if (!pulseasync) return -1;
+  pa_threaded_mainloop_lock(pulseasync->mainloop);
+  return 0;
+}
+
+void pulseasync_unlock(struct pulseasync *pulseasync) {
+  if (!pulseasync) return;
+  pa_threaded_mainloop_unlock(pulseasync->mainloop);
+}
+
+int pulseasync_update(struct pulseasync *pulseasync) {
+  if (!pulseasync) return 0;
+  return pulseasync->ioerror;
+}
+
+void pulseasync_get_latency(int *last,int *avg,int *max,const struct pulseasync *pulseasync) {
+  if (!pulseasync) return;
+  if (last) *last=pulseasync->latency_last;
+  if (avg) *avg=pulseasync->latency_samplec?(int)(pulseasync->latency_sum/pulseasync->latency_samplec):0;
+  if (max) *max=pulseasync->latency_max;
+}
+
+int pulseasync_get_underflow_count(const struct pulseasync *pulseasync) {
+  return pulseasync?pulseasync->underflowc:0;
+}
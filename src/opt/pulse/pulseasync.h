@@ -0,0 +1,53 @@
+/* pulseasync.h
+ * Interface to PulseAudio via its asynchronous API, on a pa_threaded_mainloop.
+ * Unlike (pulse), we ask for a specific latency (tlength) and request size (minreq),
+ * the server calls us when it wants more, and we measure the latency it actually delivers.
+ *
+ * Teardown doesn't wait on I/O: We disconnect under the mainloop lock, which doesn't block,
+ * then stop the mainloop, whose thread only ever sleeps in poll.
+ *
+ * To test without sound hardware, run a private daemon with only a null sink:
+ *   pulseaudio -n --daemonize=no --exit-idle-time=-1 \
+ *     -L module-null-sink -L "module-native-protocol-unix socket=/tmp/pulse.sock"
+ *   PULSE_SERVER=unix:/tmp/pulse.sock out/romassist-menu --audio=pulseasync
+ */
+ 
+#ifndef PULSEASYNC_H
+#define PULSEASYNC_H
+
+#include <stdint.h>
+
+struct pulseasync;
+
+void pulseasync_del(struct pulseasync *pulseasync);
+
+/* (tlength) and (minreq) in frames, zero for defaults.
+ * The server may adjust them, and you can't read back what it chose until after this returns.
+ * (cb) is called on the mainloop thread, with our lock held.
+ */
+struct pulseasync *pulseasync_new(
+  int rate,int chanc,
+  int tlength,int minreq,
+  void (*cb)(int16_t *v,int c,void *userdata),
+  void *userdata,
+  const char *appname
+);
+
+void *pulseasync_get_userdata(const struct pulseasync *pulseasync);
+int pulseasync_get_rate(const struct pulseasync *pulseasync);
+int pulseasync_get_chanc(const struct pulseasync *pulseasync);
+void pulseasync_play(struct pulseasync *pulseasync,int play);
+int pulseasync_lock(struct pulseasync *pulseasync);
+void pulseasync_unlock(struct pulseasync *pulseasync);
+
+/* Nonzero if the connection has failed since creation.
+ */
+int pulseasync_update(struct pulseasync *pulseasync);
+
+/* Latency as reported by pa_stream_get_latency(), sampled each time the server asks for data.
+ * (last), (avg), and (max) in microseconds. Any may be null.
+ */
+void pulseasync_get_latency(int *last,int *avg,int *max,const struct pulseasync *pulseasync);
+int pulseasync_get_underflow_count(const struct pulseasync *pulseasync);
+
+#endif
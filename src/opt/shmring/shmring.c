@@ -0,0 +1,239 @@
+#include "shmring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Layout of the shared object.
+ */
+
+#define SHMRING_MAGIC "EHSR"
+#define SHMRING_VERSION 1
+#define SHMRING_NAME_PREFIX "/ehsr-" /* Then pid and sequence, in decimal, dash-separated. */
+
+struct shmring_header {
+  char magic[4];
+  uint32_t version;
+  uint32_t slotc;
+  uint32_t slotsize;
+};
+
+struct shmring_slot {
+  uint32_t seq; // Odd while writing.
+  uint32_t reserved;
+  struct shmring_frame frame;
+  // ...pixels
+};
+
+/* Instance.
+ */
+
+struct shmring {
+  char name[32];
+  int writer;
+  void *map;
+  int mapsize;
+  int slotsize; // Pixels only.
+  int slotstride; // Header and pixels, rounded up.
+  int slotp; // Writer: slot in progress or next to write.
+  uint32_t frameid; // Writer: last committed.
+};
+
+static struct shmring_slot *shmring_slot(const struct shmring *ring,int p) {
+  return (struct shmring_slot*)((char*)ring->map+sizeof(struct shmring_header)+p*ring->slotstride);
+}
+
+static int shmring_measure(struct shmring *ring,int slotsize) {
+  if ((slotsize<1)||(slotsize>0x10000000)) return -1;
+  ring->slotsize=slotsize;
+  ring->slotstride=(sizeof(struct shmring_slot)+slotsize+63)&~63;
+  int64_t total=sizeof(struct shmring_header)+(int64_t)ring->slotstride*SHMRING_SLOT_COUNT;
+  if (total>INT_MAX) return -1;
+  ring->mapsize=total;
+  return 0;
+}
+
+/* Delete.
+ */
+
+void shmring_del(struct shmring *ring) {
+  if (!ring) return;
+  if (ring->map) munmap(ring->map,ring->mapsize);
+  if (ring->writer&&ring->name[0]) shm_unlink(ring->name);
+  free(ring);
+}
+
+/* New, writer.
+ */
+
+struct shmring *shmring_new(int slotsize) {
+  static int seq=0;
+  struct shmring *ring=calloc(1,sizeof(struct shmring));
+  if (!ring) return 0;
+  ring->writer=1;
+  if (shmring_measure(ring,slotsize)<0) {
+    free(ring);
+    return 0;
+  }
+  snprintf(ring->name,sizeof(ring->name),SHMRING_NAME_PREFIX"%d-%d",(int)getpid(),++seq);
+  int fd=shm_open(ring->name,O_RDWR|O_CREAT|O_EXCL,0600);
+  if (fd<0) {
+    ring->name[0]=0;
+    shmring_del(ring);
+    return 0;
+  }
+  if (ftruncate(fd,ring->mapsize)<0) {
+    close(fd);
+    shmring_del(ring);
+    return 0;
+  }
+  ring->map=mmap(0,ring->mapsize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  close(fd);
+  if (ring->map==MAP_FAILED) {
+    ring->map=0;
+    shmring_del(ring);
+    return 0;
+  }
+  // ftruncate zeroes it, so slots start with seq zero and frameid zero.
+  struct shmring_header *header=ring->map;
+  header->version=SHMRING_VERSION;
+  header->slotc=SHMRING_SLOT_COUNT;
+  header->slotsize=ring->slotsize;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(header->magic,SHMRING_MAGIC,4);
+  return ring;
+}
+
+/* Open, reader.
+ * (name) comes from another process, so it must look exactly like one of ours.
+ * We unlink it only after confirming it's a ring, otherwise we'd be deleting arbitrary shm objects on request.
+ */
+
+static int shmring_name_valid(const char *name,int namec) {
+  int prefixc=sizeof(SHMRING_NAME_PREFIX)-1;
+  if ((namec<=prefixc)||memcmp(name,SHMRING_NAME_PREFIX,prefixc)) return 0;
+  int i=prefixc; for (;i<namec;i++) {
+    if ((name[i]>='0')&&(name[i]<='9')) continue;
+    if (name[i]=='-') continue;
+    return 0;
+  }
+  return 1;
+}
+
+struct shmring *shmring_open(const char *name,int namec) {
+  if (!name) return 0;
+  if (namec<0) { namec=0; while (name[namec]) namec++; }
+  char zname[32];
+  if ((namec>=sizeof(zname))||!shmring_name_valid(name,namec)) return 0;
+  memcpy(zname,name,namec);
+  zname[namec]=0;
+  int fd=shm_open(zname,O_RDONLY,0);
+  if (fd<0) return 0;
+
+  struct shmring_header header={0};
+  struct stat st={0};
+  struct shmring *ring=0;
+  if (
+    (fstat(fd,&st)>=0)&&
+    (pread(fd,&header,sizeof(header),0)==sizeof(header))&&
+    !memcmp(header.magic,SHMRING_MAGIC,4)&&
+    (header.version==SHMRING_VERSION)&&
+    (header.slotc==SHMRING_SLOT_COUNT)&&
+    (ring=calloc(1,sizeof(struct shmring)))
+  ) {
+    if ((shmring_measure(ring,header.slotsize)<0)||(st.st_size<ring->mapsize)) {
+      free(ring);
+      ring=0;
+    } else {
+      ring->map=mmap(0,ring->mapsize,PROT_READ,MAP_SHARED,fd,0);
+      if (ring->map==MAP_FAILED) {
+        free(ring);
+        ring=0;
+      } else {
+        shm_unlink(zname);
+      }
+    }
+  }
+  close(fd);
+  return ring;
+}
+
+/* Trivial accessors.
+ */
+
+const char *shmring_get_name(const struct shmring *ring) {
+  return ring?ring->name:"";
+}
+
+int shmring_get_slot_size(const struct shmring *ring) {
+  return ring?ring->slotsize:0;
+}
+
+/* Write.
+ */
+
+void *shmring_begin(struct shmring_frame **frame,struct shmring *ring) {
+  if (!ring||!ring->writer) return 0;
+  struct shmring_slot *slot=shmring_slot(ring,ring->slotp);
+  if (!(slot->seq&1)) {
+    __atomic_store_n(&slot->seq,slot->seq+1,__ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+  }
+  *frame=&slot->frame;
+  return slot+1;
+}
+
+int shmring_commit(struct shmring *ring) {
+  if (!ring||!ring->writer) return -1;
+  struct shmring_slot *slot=shmring_slot(ring,ring->slotp);
+  if (!++(ring->frameid)) ring->frameid=1;
+  slot->frame.frameid=ring->frameid;
+  __atomic_store_n(&slot->seq,slot->seq+1,__ATOMIC_RELEASE);
+  if (++(ring->slotp)>=SHMRING_SLOT_COUNT) ring->slotp=0;
+  return ring->frameid;
+}
+
+/* Read.
+ */
+
+int shmring_read(struct shmring_frame *frame,void **pixels,int *pixelsa,struct shmring *ring,int frameid) {
+  if (!frame||!pixels||!pixelsa||!ring||!ring->map) return -1;
+  int attempt=3;
+  while (attempt-->0) {
+
+    // Pick the slot: newest, or the one with (frameid).
+    struct shmring_slot *slot=0;
+    uint32_t seq=0;
+    int i=0; for (;i<SHMRING_SLOT_COUNT;i++) {
+      struct shmring_slot *q=shmring_slot(ring,i);
+      uint32_t qseq=__atomic_load_n(&q->seq,__ATOMIC_ACQUIRE);
+      if (qseq&1) continue;
+      uint32_t qid=q->frame.frameid;
+      if (!qid) continue;
+      if (frameid) {
+        if (qid!=frameid) continue;
+      } else if (slot&&((int32_t)(qid-slot->frame.frameid)<=0)) continue;
+      slot=q;
+      seq=qseq;
+    }
+    if (!slot) return -1;
+
+    // Copy out, then confirm the writer didn't touch it meanwhile.
+    memcpy(frame,&slot->frame,sizeof(struct shmring_frame));
+    if ((frame->len<0)||(frame->len>ring->slotsize)) return -1;
+    if (frame->len>*pixelsa) {
+      void *nv=realloc(*pixels,frame->len);
+      if (!nv) return -1;
+      *pixels=nv;
+      *pixelsa=frame->len;
+    }
+    memcpy(*pixels,slot+1,frame->len);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->seq,__ATOMIC_RELAXED)==seq) return frame->frameid;
+  }
+  return -1;
+}
@@ -0,0 +1,64 @@
+/* shmring.h
+ * Ring of video frames in POSIX shared memory, so a game can hand screencaps to Romassist without encoding them.
+ *
+ * The writer (Emuhost) creates a named object and tells Romassist its name over fakews ("shmring").
+ * The reader maps it read-only and unlinks the name once the header checks out, so nothing lingers in /dev/shm if the writer crashes.
+ * Readers only accept names in our own pattern ("/ehsr-PID-N").
+ * Only useful when both ends are on the same host. If open fails, the writer just never hears about it.
+ *
+ * Each slot has a sequence counter, odd while the writer is in it.
+ * Readers copy the frame out and then confirm the counter didn't move.
+ * One writer only.
+ */
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdint.h>
+
+#define SHMRING_SLOT_COUNT 3
+
+/* Pixels are ready to drop into a PNG: (depth,colortype,stride) in PNG terms, with (ctab) for colortype 3.
+ * Except if (rgb32): Then pixels are native 32-bit words, with 8-bit channels at (rshift,gshift,bshift).
+ */
+struct shmring_frame {
+  uint32_t frameid; // Increments at each publish, zero if the slot was never written.
+  int32_t w,h,stride;
+  uint8_t depth,colortype;
+  uint8_t rgb32;
+  uint8_t rshift,gshift,bshift;
+  uint16_t ctabc; // Colors in (ctab).
+  uint8_t ctab[768];
+  int32_t len; // Bytes of pixels.
+};
+
+struct shmring;
+
+void shmring_del(struct shmring *ring);
+
+/* Writer: Create a new object with room for (slotsize) bytes of pixels per slot.
+ */
+struct shmring *shmring_new(int slotsize);
+
+/* Reader: Map a ring by name, and unlink the name.
+ * Fails without touching anything if the name isn't one shmring_new() would make, or the object isn't a ring.
+ */
+struct shmring *shmring_open(const char *name,int namec);
+
+const char *shmring_get_name(const struct shmring *ring); // Empty after open.
+int shmring_get_slot_size(const struct shmring *ring);
+
+/* Writer: Get the next slot, fill in (frame) and up to slot-size bytes of pixels, then commit.
+ * Returns the pixel buffer, or null if not a writer.
+ * Commit returns the new frame's ID.
+ */
+void *shmring_begin(struct shmring_frame **frame,struct shmring *ring);
+int shmring_commit(struct shmring *ring);
+
+/* Reader: Copy out the newest complete frame, or (frameid) exactly if nonzero.
+ * We reallocate (*pixels) as needed; free it when you're done.
+ * Returns the frame ID, or <0 if there's nothing suitable.
+ */
+int shmring_read(struct shmring_frame *frame,void **pixels,int *pixelsa,struct shmring *ring,int frameid);
+
+#endif
@@ -0,0 +1,331 @@
+#include "ra_internal.h"
+#include "opt/serial/serial.h"
+#include "opt/fs/fs.h"
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* Current real time.
+ */
+
+static int64_t ra_acm_now() {
+  struct timeval tv={0};
+  gettimeofday(&tv,0);
+  return tv.tv_sec*1000000ll+tv.tv_usec;
+}
+
+/* Worker's directory.
+ */
+
+static int ra_acm_compose_dir(char *dst,int dsta,uint32_t gameid) {
+  int dstc=snprintf(dst,dsta,"%s/acm/%d",ra.dbroot,gameid);
+  if ((dstc<1)||(dstc>=dsta)) return -1;
+  return dstc;
+}
+
+static int ra_acm_rmdir_cb(const char *path,const char *base,char type,void *userdata) {
+  file_unlink(path);
+  return 0;
+}
+
+static void ra_acm_rmdir(const char *path) {
+  dir_read(path,ra_acm_rmdir_cb,0);
+  rmdir(path);
+}
+
+/* Allocate workers on first use.
+ */
+
+static int ra_acm_require_workers() {
+  if (ra.acm.workerv) return 0;
+  int workerc=ra.acm_workers;
+  if (workerc<1) {
+    workerc=sysconf(_SC_NPROCESSORS_ONLN);
+    if (workerc<1) workerc=1;
+  }
+  if (!(ra.acm.workerv=calloc(workerc,sizeof(struct ra_acm_worker)))) return -1;
+  ra.acm.workerc=workerc;
+  return 0;
+}
+
+/* Begin.
+ */
+
+static int ra_acm_check_scap_cb(uint32_t gameid,const char *type,int typec,const char *time,int timec,const char *path,void *userdata) {
+  if ((typec==4)&&!memcmp(type,"scap",4)) return 1;
+  return 0;
+}
+
+static int ra_acm_is_pending(uint32_t gameid) {
+  int i=ra.acm.queuep;
+  for (;i<ra.acm.queuec;i++) if (ra.acm.queuev[i]==gameid) return 1;
+  struct ra_acm_worker *worker=ra.acm.workerv;
+  for (i=ra.acm.workerc;i-->0;worker++) if (worker->pid&&(worker->gameid==gameid)) return 1;
+  return 0;
+}
+
+int ra_acm_begin(const char *platform,int platformc,int limit) {
+  if (ra_acm_require_workers()<0) return -1;
+  uint32_t platformid=0;
+  if (platform&&platformc) {
+    if (!(platformid=db_string_lookup(ra.db,platform,platformc))) return 0;
+  }
+  int addc=0,p=0;
+  for (;;p++) {
+    if ((limit>0)&&(addc>=limit)) break;
+    const struct db_game *game=db_game_get_by_index(ra.db,p);
+    if (!game) break;
+    if (platformid&&(game->platform!=platformid)) continue;
+    if (db_blob_for_gameid(ra.db,game->gameid,0,ra_acm_check_scap_cb,0)) continue;
+    if (!db_launcher_for_gameid(ra.db,game->gameid)) continue;
+    if (ra_acm_is_pending(game->gameid)) continue;
+    if (ra.acm.queuec>=ra.acm.queuea) {
+      int na=ra.acm.queuea+256;
+      if (na>INT_MAX/sizeof(uint32_t)) return -1;
+      void *nv=realloc(ra.acm.queuev,sizeof(uint32_t)*na);
+      if (!nv) return -1;
+      ra.acm.queuev=nv;
+      ra.acm.queuea=na;
+    }
+    ra.acm.queuev[ra.acm.queuec++]=game->gameid;
+    addc++;
+  }
+  if (addc) fprintf(stderr,"%s: Queued %d games for metadata collection, %d workers.\n",ra.exename,addc,ra.acm.workerc);
+  return addc;
+}
+
+/* Cancel.
+ */
+
+void ra_acm_cancel() {
+  ra.acm.queuec=ra.acm.queuep=0;
+}
+
+/* Launch one worker.
+ */
+
+static int ra_acm_launch(struct ra_acm_worker *worker,uint32_t gameid) {
+  const struct db_game *game=db_game_get_by_id(ra.db,gameid);
+  if (!game) return -1;
+  const struct db_launcher *launcher=db_launcher_for_gameid(ra.db,gameid);
+  if (!launcher) return -1;
+  const char *cmd=0;
+  int cmdc=db_string_get(&cmd,ra.db,launcher->cmd);
+  if (cmdc<1) return -1;
+  char path[1024];
+  int pathc=db_game_get_path(path,sizeof(path),ra.db,game);
+  if ((pathc<1)||(pathc>=sizeof(path))) return -1;
+  char dir[1024];
+  int dirc=ra_acm_compose_dir(dir,sizeof(dir),gameid);
+  if (dirc<0) return -1;
+  if (dir_mkdirp(dir)<0) {
+    fprintf(stderr,"%s: Failed to create directory.\n",dir);
+    return -1;
+  }
+  char logpath[1100];
+  snprintf(logpath,sizeof(logpath),"%s/log",dir);
+
+  char *combined=ra_process_combine_command(cmd,cmdc,path,pathc,gameid);
+  if (!combined) return -1;
+  struct sr_encoder cmdstr={0};
+  if (
+    (sr_encode_fmt(&cmdstr,"%s --auto-collect-metadata=%d --acm-output=%.*s",combined,ra.acm_frames,dirc,dir)<0)||
+    (sr_encoder_terminate(&cmdstr)<0)
+  ) {
+    free(combined);
+    sr_encoder_cleanup(&cmdstr);
+    return -1;
+  }
+  free(combined);
+  int pid=ra_process_spawn(cmdstr.v,logpath,0);
+  sr_encoder_cleanup(&cmdstr);
+  if (pid<0) return -1;
+
+  worker->pid=pid;
+  worker->gameid=gameid;
+  worker->start_time=ra_acm_now();
+  worker->killc=0;
+  return 0;
+}
+
+/* Read report.json, import screencaps and player count.
+ */
+
+static int ra_acm_import_screencap(uint32_t gameid,const char *dir,const char *name,int namec) {
+  if ((namec<1)||memchr(name,'/',namec)) return -1;
+  char path[1100];
+  int pathc=snprintf(path,sizeof(path),"%s/%.*s",dir,namec,name);
+  if ((pathc<1)||(pathc>=sizeof(path))) return -1;
+  void *serial=0;
+  int serialc=file_read(&serial,path);
+  if (serialc<0) return -1;
+  char *blobpath=db_blob_compose_path(ra.db,gameid,"scap",4,".png",4);
+  if (!blobpath) {
+    free(serial);
+    return -1;
+  }
+  int err=file_write(blobpath,serial,serialc);
+  if (err<0) fprintf(stderr,"%s: Failed to write file, %d bytes.\n",blobpath,serialc);
+  free(blobpath);
+  free(serial);
+  return err;
+}
+
+static int ra_acm_set_players(uint32_t gameid,int playerc) {
+  const uint32_t mask=DB_FLAG_player1|DB_FLAG_player2|DB_FLAG_player3|DB_FLAG_player4|DB_FLAG_playermore;
+  struct db_game *game=db_game_get_by_id(ra.db,gameid);
+  if (!game) return -1;
+  if (game->flags&mask) return 0; // Somebody already said, and they're more reliable than us.
+  uint32_t flag;
+  switch (playerc) {
+    case 0: return 0;
+    case 1: flag=DB_FLAG_player1; break;
+    case 2: flag=DB_FLAG_player2; break;
+    case 3: flag=DB_FLAG_player3; break;
+    case 4: flag=DB_FLAG_player4; break;
+    default: flag=DB_FLAG_playermore; break;
+  }
+  if (db_game_set_flags(ra.db,game,game->flags|flag)<0) return -1;
+  return 1;
+}
+
+static int ra_acm_import(uint32_t gameid,const char *dir) {
+  char path[1100];
+  snprintf(path,sizeof(path),"%s/report.json",dir);
+  void *serial=0;
+  int serialc=file_read(&serial,path);
+  if (serialc<0) return -1;
+  struct sr_decoder decoder={.v=serial,.c=serialc};
+  int playerc=0,scapc=0;
+  int jsonctx=sr_decode_json_object_start(&decoder);
+  const char *k;
+  int kc;
+  while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+    if ((kc==7)&&!memcmp(k,"players",7)) {
+      if (sr_decode_json_int(&playerc,&decoder)<0) break;
+    } else if ((kc==10)&&!memcmp(k,"screencaps",10)) {
+      int arrayctx=sr_decode_json_array_start(&decoder);
+      while (sr_decode_json_next(0,&decoder)>0) {
+        char name[64];
+        int namec=sr_decode_json_string(name,sizeof(name),&decoder);
+        if ((namec<0)||(namec>sizeof(name))) continue;
+        if (ra_acm_import_screencap(gameid,dir,name,namec)>=0) scapc++;
+      }
+      if (sr_decode_json_end(&decoder,arrayctx)<0) break;
+    } else {
+      if (sr_decode_json_skip(&decoder)<0) break;
+    }
+  }
+  int err=sr_decode_json_end(&decoder,jsonctx);
+  free(serial);
+  if (err<0) return -1;
+  if (scapc) db_invalidate_blobs_for_gameid(ra.db,gameid);
+  if (ra_acm_set_players(gameid,playerc)>0) ra.acm.playerc++;
+  ra.acm.scapc+=scapc;
+  fprintf(stderr,"%s: Collected metadata for game %d: %d screencaps, %d players.\n",ra.exename,gameid,scapc,playerc);
+  return 0;
+}
+
+/* Worker finished, with or without success.
+ */
+
+static void ra_acm_finish(struct ra_acm_worker *worker,int wstatus) {
+  char dir[1024];
+  if (ra_acm_compose_dir(dir,sizeof(dir),worker->gameid)>=0) {
+    if (ra_acm_import(worker->gameid,dir)>=0) {
+      ra.acm.donec++;
+      ra_acm_rmdir(dir);
+    } else {
+      ra.acm.errc++;
+      if (WIFEXITED(wstatus)) {
+        fprintf(stderr,"%s: Metadata collection for game %d failed, status %d. See %s/log\n",ra.exename,worker->gameid,WEXITSTATUS(wstatus),dir);
+      } else {
+        fprintf(stderr,"%s: Metadata collection for game %d failed, abnormal exit. See %s/log\n",ra.exename,worker->gameid,dir);
+      }
+    }
+  }
+  worker->pid=0;
+  worker->gameid=0;
+}
+
+/* Update.
+ */
+
+int ra_acm_update() {
+  if (!ra.acm.workerv) return 0;
+  int64_t now=ra_acm_now();
+  int64_t timeout=(ra.acm_timeout>0)?(ra.acm_timeout*1000000ll):0;
+  struct ra_acm_worker *worker=ra.acm.workerv;
+  int i=ra.acm.workerc;
+  for (;i-->0;worker++) {
+
+    // Check running workers. Ask nicely at the timeout, then not so nicely every few seconds after.
+    if (worker->pid) {
+      int wstatus=0;
+      int err=waitpid(worker->pid,&wstatus,WNOHANG);
+      if (err>0) {
+        ra_acm_finish(worker,wstatus);
+      } else if (err<0) {
+        fprintf(stderr,"%s:WARNING: waitpid() error. Assuming metadata worker %d was lost somehow.\n",ra.exename,worker->pid);
+        ra_acm_finish(worker,0);
+      } else if (timeout&&(now-worker->start_time>=timeout+worker->killc*5000000ll)) {
+        kill(worker->pid,worker->killc?SIGKILL:SIGINT);
+        worker->killc++;
+      }
+    }
+
+    // Idle workers take the next thing off the queue.
+    while (!worker->pid&&(ra.acm.queuep<ra.acm.queuec)) {
+      uint32_t gameid=ra.acm.queuev[ra.acm.queuep++];
+      if (ra_acm_launch(worker,gameid)<0) {
+        fprintf(stderr,"%s: Failed to launch metadata collection for game %d.\n",ra.exename,gameid);
+        ra.acm.errc++;
+      }
+    }
+  }
+  if (ra.acm.queuep>=ra.acm.queuec) ra.acm.queuec=ra.acm.queuep=0;
+  return 0;
+}
+
+/* Cleanup.
+ */
+
+void ra_acm_cleanup() {
+  ra_acm_cancel();
+  if (ra.acm.workerv) {
+    int runc=0;
+    struct ra_acm_worker *worker=ra.acm.workerv;
+    int i=ra.acm.workerc;
+    for (;i-->0;worker++) {
+      if (!worker->pid) continue;
+      kill(worker->pid,SIGKILL);
+      waitpid(worker->pid,0,0);
+      runc++;
+    }
+    if (runc) fprintf(stderr,"%s: Killed %d metadata workers.\n",ra.exename,runc);
+    free(ra.acm.workerv);
+  }
+  if (ra.acm.queuev) free(ra.acm.queuev);
+  memset(&ra.acm,0,sizeof(struct ra_acm));
+}
+
+/* Status.
+ */
+
+int ra_acm_encode_status(struct sr_encoder *dst) {
+  int runc=0;
+  const struct ra_acm_worker *worker=ra.acm.workerv;
+  int i=ra.acm.workerc;
+  for (;i-->0;worker++) if (worker->pid) runc++;
+  int jsonctx=sr_encode_json_object_start(dst,0,0);
+  if (jsonctx<0) return -1;
+  if (sr_encode_json_int(dst,"workers",7,ra.acm.workerc)<0) return -1;
+  if (sr_encode_json_int(dst,"running",7,runc)<0) return -1;
+  if (sr_encode_json_int(dst,"queued",6,ra.acm.queuec-ra.acm.queuep)<0) return -1;
+  if (sr_encode_json_int(dst,"done",4,ra.acm.donec)<0) return -1;
+  if (sr_encode_json_int(dst,"errors",6,ra.acm.errc)<0) return -1;
+  if (sr_encode_json_int(dst,"screencaps",10,ra.acm.scapc)<0) return -1;
+  if (sr_encode_json_int(dst,"playersSet",10,ra.acm.playerc)<0) return -1;
+  return sr_encode_json_object_end(dst,jsonctx);
+}
@@ -0,0 +1,49 @@
+/* ra_acm.h
+ * Auto-collect metadata: Run games headless in a pool of background processes, to backfill screencaps and player counts.
+ * Each worker runs the game's regular launcher command, plus:
+ *   --auto-collect-metadata=FRAMES --acm-output=DBROOT/acm/GAMEID
+ * See src/lib/eh_auto_collect_metadata.h. Launchers that aren't Emuhost won't understand that, they'll hit the timeout.
+ * When a worker exits, we import its screencaps as "scap" blobs, and set the player count if the game doesn't have one yet.
+ * Its directory is deleted on success, and left in place on failure, with the child's output in "log".
+ *
+ * Independent of ra.process; the menu and games keep running normally while we work.
+ */
+
+#ifndef RA_ACM_H
+#define RA_ACM_H
+
+struct sr_encoder;
+
+struct ra_acm {
+  struct ra_acm_worker {
+    int pid; // Zero if idle.
+    uint32_t gameid;
+    int64_t start_time; // us
+    int killc; // How many signals we've sent it.
+  } *workerv;
+  int workerc;
+  uint32_t *queuev;
+  int queuec,queuea,queuep;
+  int donec,errc,scapc,playerc; // For reporting.
+};
+
+/* Null (platform) for all. Games that already have a screencap, or no launcher, are skipped.
+ * Returns the count of games queued, which may be zero.
+ */
+int ra_acm_begin(const char *platform,int platformc,int limit);
+
+/* Drop anything not yet started. Running workers finish normally.
+ */
+void ra_acm_cancel();
+
+/* Call regularly, it's where the work happens.
+ */
+int ra_acm_update();
+
+/* Kill workers and wait for them, at shutdown.
+ */
+void ra_acm_cleanup();
+
+int ra_acm_encode_status(struct sr_encoder *dst);
+
+#endif
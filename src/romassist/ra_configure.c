@@ -19,6 +19,11 @@ static void ra_print_usage(const char *topic,int topicc) {
     "  --poweroff=0        Nonzero to call `poweroff` at POST /api/shutdown. Otherwise just quit.\n"
     "  --update=1          Automatically upgrade everything we can.\n"
     "  --migrate=HOST:PORT Pull content from another installation, then terminate.\n"
+    "  --acm-workers=0     Processes for POST /api/autocollect. Zero for one per core.\n"
+    "  --acm-frames=3600   How long each game runs for metadata collection.\n"
+    "  --acm-timeout=120   Seconds before we kill a metadata collection process.\n"
+    "  --warm-menu=0       Keep a menu process on standby while games run, for a faster return.\n"
+    "  --warm-game=0       Keep the most-played launcher on standby while the menu runs. Emuhost launchers only.\n"
     "\n"
   );
 }
@@ -76,6 +81,11 @@ static int ra_configure_kv(const char *k,int kc,const char *v,int vc) {
   INTOPT("poweroff",allow_poweroff,0,1)
   INTOPT("update",update_enable,0,1)
   STROPT("migrate",migrate)
+  INTOPT("acm-workers",acm_workers,0,256)
+  INTOPT("acm-frames",acm_frames,1,INT_MAX)
+  INTOPT("acm-timeout",acm_timeout,0,INT_MAX)
+  INTOPT("warm-menu",warm_menu,0,1)
+  INTOPT("warm-game",warm_game,0,1)
   
   #undef STROPT
   #undef INTOPT
@@ -155,6 +165,8 @@ int ra_configure(int argc,char **argv) {
   ra.public_port=0;
   ra.terminable=1;
   ra.update_enable=1;
+  ra.acm_frames=3600;
+  ra.acm_timeout=120;
   
   //TODO config file?
   
@@ -1170,8 +1170,10 @@ static int ra_http_launch(struct http_xfer *req,struct http_xfer *rsp) {
   if (http_xfer_get_query_int(&gameid,req,"gameid",6)<0) return http_xfer_set_status(rsp,400,"gameid required");
   const struct db_game *game=db_game_get_by_id(ra.db,gameid);
   if (!game) return http_xfer_set_status(rsp,404,"Not found");
+  int traceid=ra_trace_begin(gameid,"request");
   const struct db_launcher *launcher=db_launcher_for_gameid(ra.db,gameid);
   if (!launcher) return http_xfer_set_status(rsp,500,"No suitable launcher");
+  ra_trace_mark(traceid,"launcher",8,0);
   
   const char *cmd=0;
   int cmdc=db_string_get(&cmd,ra.db,launcher->cmd);
@@ -1183,6 +1185,8 @@ static int ra_http_launch(struct http_xfer *req,struct http_xfer *rsp) {
   if (ra_process_prepare_launch(&ra.process,cmd,cmdc,path,pathc,game->gameid)<0) {
     return http_xfer_set_status(rsp,500,"Failed to launch");
   }
+  ra.process.trace_id=traceid;
+  ra_trace_mark(traceid,"prepared",8,0);
   
   struct db_play playref={
     .gameid=gameid,
@@ -1242,8 +1246,10 @@ static int ra_http_random(struct http_xfer *req,struct http_xfer *rsp) {
   // Not dry-running, this is the wet run: Do about what POST /api/launch does.
   const struct db_game *game=db_game_get_by_id(ra.db,gameid);
   if (!game) return http_xfer_set_status(rsp,404,"Not found");
+  int traceid=ra_trace_begin(gameid,"request");
   const struct db_launcher *launcher=db_launcher_for_gameid(ra.db,gameid);
   if (!launcher) return http_xfer_set_status(rsp,500,"No suitable launcher");
+  ra_trace_mark(traceid,"launcher",8,0);
   
   const char *cmd=0;
   int cmdc=db_string_get(&cmd,ra.db,launcher->cmd);
@@ -1255,6 +1261,8 @@ static int ra_http_random(struct http_xfer *req,struct http_xfer *rsp) {
   if (ra_process_prepare_launch(&ra.process,cmd,cmdc,path,pathc,game->gameid)<0) {
     return http_xfer_set_status(rsp,500,"Failed to launch");
   }
+  ra.process.trace_id=traceid;
+  ra_trace_mark(traceid,"prepared",8,0);
   
   struct db_play playref={
     .gameid=gameid,
@@ -1265,6 +1273,13 @@ static int ra_http_random(struct http_xfer *req,struct http_xfer *rsp) {
   return db_play_encode(http_xfer_get_body_encoder(rsp),ra.db,play,DB_FORMAT_json,DB_DETAIL_record);
 }
 
+/* GET /api/launch/trace
+ */
+ 
+static int ra_http_get_launch_trace(struct http_xfer *req,struct http_xfer *rsp) {
+  return ra_trace_encode(http_xfer_get_body_encoder(rsp));
+}
+
 /* POST /api/terminate
  */
  
@@ -1427,6 +1442,30 @@ static int ra_http_autoscreencap(struct http_xfer *req,struct http_xfer *rsp) {
   return sr_encode_json_object_end(dst,0);
 }
 
+/* POST /api/autocollect
+ * GET /api/autocollect
+ * DELETE /api/autocollect
+ */
+ 
+static int ra_http_post_autocollect(struct http_xfer *req,struct http_xfer *rsp) {
+  char platform[64];
+  int platformc=http_xfer_get_query_string(platform,sizeof(platform),req,"platform",8);
+  if ((platformc<0)||(platformc>sizeof(platform))) platformc=0;
+  int limit=0;
+  http_xfer_get_query_int(&limit,req,"limit",5);
+  if (ra_acm_begin(platform,platformc,limit)<0) return http_xfer_set_status(rsp,500,"Failed to queue metadata collection");
+  return ra_acm_encode_status(http_xfer_get_body_encoder(rsp));
+}
+ 
+static int ra_http_get_autocollect(struct http_xfer *req,struct http_xfer *rsp) {
+  return ra_acm_encode_status(http_xfer_get_body_encoder(rsp));
+}
+ 
+static int ra_http_delete_autocollect(struct http_xfer *req,struct http_xfer *rsp) {
+  ra_acm_cancel();
+  return ra_acm_encode_status(http_xfer_get_body_encoder(rsp));
+}
+
 /* GET /api/export
  */
  
@@ -1584,6 +1623,7 @@ int ra_http_api(struct http_xfer *req,struct http_xfer *rsp,void *userdata) {
   _(POST,"/api/query",ra_http_query)
   _(GET,"/api/histograms",ra_http_histograms)
   _(POST,"/api/launch",ra_http_launch)
+  _(GET,"/api/launch/trace",ra_http_get_launch_trace)
   _(POST,"/api/random",ra_http_random)
   _(POST,"/api/terminate",ra_http_terminate)
   _(POST,"/api/shutdown",ra_http_shutdown)
@@ -1591,6 +1631,9 @@ int ra_http_api(struct http_xfer *req,struct http_xfer *rsp,void *userdata) {
   _(POST,"/api/enable-public",ra_http_enable_public)
   
   _(POST,"/api/autoscreencap",ra_http_autoscreencap)
+  _(POST,"/api/autocollect",ra_http_post_autocollect)
+  _(GET,"/api/autocollect",ra_http_get_autocollect)
+  _(DELETE,"/api/autocollect",ra_http_delete_autocollect)
   
   _(GET,"/api/export",ra_http_export)
   
@@ -10,13 +10,20 @@
 #include "opt/http/http.h"
 #include "ra_process.h"
 #include "ra_upgrade.h"
+#include "ra_acm.h"
 
-// I doubt we'll ever see more than 2 at a time. 8 is plenty.
-#define RA_WEBSOCKET_LIMIT 8
+struct shmring;
+#include "ra_trace.h"
+
+// Usually 2 or 3 at a time, but every open stream viewer takes one too.
+#define RA_WEBSOCKET_LIMIT 16
 
 #define RA_WEBSOCKET_ROLE_NONE 0 /* extra slot not in use */
 #define RA_WEBSOCKET_ROLE_MENU 1
 #define RA_WEBSOCKET_ROLE_GAME 2
+#define RA_WEBSOCKET_ROLE_STREAM 3 /* Game's framebuffer stream, see src/lib/render/eh_stream.h */
+#define RA_WEBSOCKET_ROLE_VIEWER 4 /* Web client watching the stream. */
+#define RA_WEBSOCKET_ROLE_SPARE 5 /* Emuhost in standby, see ra_process.h. Becomes MENU or GAME when we wake it. */
 
 /* So many consecutive terminations of the menu with the same db timestamp (ie 1 minute),
  * if no game launched in between, we abort hard.
@@ -37,6 +44,11 @@ extern struct ra {
   int allow_poweroff; // If nonzero, POST /api/shutdown calls `poweroff`. Zero, only this process terminates.
   int update_enable;
   char *migrate; // "host:port", to pull content from that installation, instead of normal operation
+  int acm_workers; // Zero for one per core.
+  int acm_frames;
+  int acm_timeout; // s
+  int warm_menu; // Keep a spare menu process ready while games run.
+  int warm_game; // Keep a spare for the most-played launcher while the menu runs.
   
   volatile int sigc;
   struct db *db;
@@ -45,12 +57,18 @@ extern struct ra {
   uint32_t menu_termv[RA_MENU_TERM_LIMIT]; // timestamps of menu terminations since the last game launch.
   int menu_termc;
   struct ra_upgrade upgrade;
+  struct ra_acm acm;
+  struct ra_trace trace;
   
   struct ra_websocket_extra {
     int role;
     struct http_socket *socket; // WEAK. socket's userdata points back to this struct.
     int64_t screencap_request_time;
+    int pid; // SPARE only, what it told us.
+    struct shmring *shmring; // Frames shared by an Emuhost client on this host, see opt/shmring.
   } websocket_extrav[RA_WEBSOCKET_LIMIT];
+  void *shmpixels; // Scratch for copying frames out of a shmring.
+  int shmpixelsa;
   uint32_t gameid_reported; // What our menus currently think is running.
   
 } ra;
@@ -62,11 +80,19 @@ int ra_http_static(struct http_xfer *req,struct http_xfer *rsp,void *userdata);
 int ra_http_api(struct http_xfer *req,struct http_xfer *rsp,void *userdata);
 int ra_ws_connect_menu(struct http_socket *sock,void *userdata);
 int ra_ws_connect_game(struct http_socket *sock,void *userdata);
+int ra_ws_connect_stream(struct http_socket *sock,void *userdata);
+int ra_ws_connect_view(struct http_socket *sock,void *userdata);
+int ra_ws_connect_spare(struct http_socket *sock,void *userdata);
 int ra_ws_disconnect(struct http_socket *sock,void *userdata);
 int ra_ws_message(struct http_socket *sock,int type,const void *v,int c,void *userdata);
 
 int ra_websocket_send_to_role(int role,int packet_type,const void *v,int c);
 
+/* Find the SPARE connection for this process, tell it to wake up with this ROM (optional), and change its role.
+ * Fails if it isn't connected yet.
+ */
+int ra_websocket_wake_spare(int pid,int role,const char *rom,int trace_id);
+
 /* The meat of the operation, for one file.
  * Some additional outer layers live in ra_http.c.
  */
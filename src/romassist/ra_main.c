@@ -108,6 +108,9 @@ static int ra_init_http() {
   if (!http_listen(ra.http,0,"/api/**",ra_http_api,0)) return -1;
   if (!http_listen_websocket(ra.http,"/ws/menu",ra_ws_connect_menu,ra_ws_disconnect,ra_ws_message,0)) return -1;
   if (!http_listen_websocket(ra.http,"/ws/game",ra_ws_connect_game,ra_ws_disconnect,ra_ws_message,0)) return -1;
+  if (!http_listen_websocket(ra.http,"/ws/stream",ra_ws_connect_stream,ra_ws_disconnect,ra_ws_message,0)) return -1;
+  if (!http_listen_websocket(ra.http,"/ws/view",ra_ws_connect_view,ra_ws_disconnect,ra_ws_message,0)) return -1;
+  if (!http_listen_websocket(ra.http,"/ws/spare",ra_ws_connect_spare,ra_ws_disconnect,ra_ws_message,0)) return -1;
   if (!http_listen(ra.http,HTTP_METHOD_GET,"/**",ra_http_static,0)) return -1;
   
   if (server) fprintf(stderr,"%s: Serving HTTP on port %d.\n",ra.exename,ra.http_port);
@@ -183,7 +186,8 @@ int main(int argc,char **argv) {
       }
     }
 
-    if (http_update(ra.http,1000)<0) {
+    // Poll briefly while a launch is pending, we're waiting on the old process to exit.
+    if (http_update(ra.http,ra.process.next_launch?10:1000)<0) {
       fprintf(stderr,"%s: Error updating HTTP (could be anything).\n",ra.exename);
       status=1;
       break;
@@ -196,6 +200,9 @@ int main(int argc,char **argv) {
     if (db_save(ra.db)<0) {
       fprintf(stderr,"%s:!!! Error saving database. Will keep open and try again soon.\n",ra.exename);
     }
+    if (ra_acm_update()<0) {
+      fprintf(stderr,"%s: Error updating metadata collection.\n",ra.exename);
+    }
     if (ra_process_update(&ra.process)<0) {
       fprintf(stderr,"%s: Error updating child process.\n",ra.exename);
       status=1;
@@ -212,6 +219,7 @@ int main(int argc,char **argv) {
   // It seems ridiculous, but I'm finding under GLX, the menu process typically takes 300-700 ms to terminate.
   // Why is it so long???
   ra_process_terminate_and_wait(&ra.process,1000);
+  ra_acm_cleanup();
   
   if (!status) db_save(ra.db);
   db_del(ra.db);
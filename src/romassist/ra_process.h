@@ -5,6 +5,9 @@
 #ifndef RA_PROCESS_H
 #define RA_PROCESS_H
 
+// Spares must wait so long after the foreground process starts, and must survive so long themselves.
+#define RA_PROCESS_SPARE_DELAY 5000000ll /* us */
+
 struct ra_process {
 
   /* If nonzero, we will try to launch this the next time our child quits.
@@ -28,6 +31,35 @@ struct ra_process {
    * (That's appropriate for kiosk environments, where the menu shouldn't have been allowed to quit anyway).
    */
   int menu_terminated;
+  
+  /* Raw launcher command and game path for (next_launch), so we can tell whether a warm spare can take it.
+   */
+  char *next_cmd;
+  char *next_path;
+  
+  /* Warm spares, if enabled (--warm-menu, --warm-game).
+   * Processes started with "--standby", they connect at /ws/spare and wait for us to wake them with a ROM path.
+   * The menu spare exists while a game runs, and the game spare, for the most-played launcher, while the menu runs.
+   */
+  struct ra_process_spare {
+    int pid;
+    char *cmd; // Game spare only, the launcher's raw command.
+    int64_t start_time; // us
+  } menu_spare,game_spare;
+  int64_t start_time; // us, when (pid) was launched or woken.
+  
+  /* Time-to-first-frame. We start the clock when a game is requested or when a game exits,
+   * and stop it when the new process reports its first frame.
+   */
+  int64_t request_time; // us, zero if not measuring.
+  uint32_t request_gameid; // Zero for the menu.
+  int request_warm;
+  int ttff_game_ms,ttff_menu_ms; // Most recent.
+  
+  /* Launch trace (ra_trace.h) for the pending or most recent launch, zero if none.
+   * Whoever requests a launch begins the trace and sets this after ra_process_prepare_launch().
+   */
+  int trace_id;
 };
 
 void ra_process_cleanup(struct ra_process *process);
@@ -69,9 +101,25 @@ int ra_process_prepare_launch(
 int ra_process_terminate_game(struct ra_process *process);
 int ra_process_restart_menu(struct ra_process *process);
 
+/* Resolve variables in a launcher's command, eg "$FILE" => (path).
+ * Returns a new NUL-terminated string on success, which the caller must free.
+ */
+char *ra_process_combine_command(const char *cmd,int cmdc,const char *path,int pathc,uint32_t gameid);
+
+/* Fork and exec a combined command, without tracking it in any way. Returns pid.
+ * Caller must reap it.
+ * With (logpath), the child's stdout and stderr go to that file instead of ours.
+ * With (env), eg "KEY=value", add that to the child's environment.
+ */
+int ra_process_spawn(const char *cmdstr,const char *logpath,const char *env);
+
 /* If we have a child process, whether menu or game, terminate it and wait up to (toms) ms for it to die.
  * It's advisable to do this before shutdown.
  */
 void ra_process_terminate_and_wait(struct ra_process *process,int toms);
 
+/* The running process says its first frame went out (agoms) ms ago.
+ */
+void ra_process_first_frame(struct ra_process *process,int agoms);
+
 #endif
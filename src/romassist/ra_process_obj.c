@@ -5,14 +5,20 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 /* Cleanup.
  */
  
 void ra_process_cleanup(struct ra_process *process) {
   if (process->next_launch) free(process->next_launch);
+  if (process->next_cmd) free(process->next_cmd);
+  if (process->next_path) free(process->next_path);
+  if (process->game_spare.cmd) free(process->game_spare.cmd);
 }
 
+static int64_t ra_process_now();
+
 /* Helper for splitting up the text of a command.
  */
  
@@ -105,19 +111,22 @@ static int ra_process_split_command(struct ra_cmd *cmd,const char *src) {
     }
     src+=tokenc;
   }
-  // Assert that there is at least one arg -- argv[0] is required -- and terminate both lists.
+  // Assert that there is at least one arg -- argv[0] is required. Caller terminates the lists.
   if (cmd->argc<1) return -1;
-  if (ra_cmd_terminate(cmd)<0) return -1;
   return 0;
 }
 
-/* Launch command.
+/* Spawn command.
  */
  
-static int ra_process_launch_command(struct ra_process *process,const char *cmdstr) {
+int ra_process_spawn(const char *cmdstr,const char *logpath,const char *env) {
   
   struct ra_cmd cmd={0};
-  if (ra_process_split_command(&cmd,cmdstr)<0) {
+  if (
+    (ra_process_split_command(&cmd,cmdstr)<0)||
+    (env&&(ra_cmd_envv_append(&cmd,env,-1)<0))||
+    (ra_cmd_terminate(&cmd)<0)
+  ) {
     ra_cmd_cleanup(&cmd);
     return -1;
   }
@@ -131,17 +140,24 @@ static int ra_process_launch_command(struct ra_process *process,const char *cmds
     return -1;
   }
   
-  /* Parent? Record the pid and we're done.
+  /* Parent? Return the pid and we're done.
    */
   if (pid) {
-    process->pid=pid;
     ra_cmd_cleanup(&cmd);
-    return 0;
+    return pid;
   }
   
   /* We are the child.
-   * TODO: Working directory? Capture stdout/stderr? Other housekeeping?
+   * TODO: Working directory? Other housekeeping?
    */
+  if (logpath) {
+    int fd=open(logpath,O_WRONLY|O_CREAT|O_TRUNC,0666);
+    if (fd>=0) {
+      dup2(fd,STDOUT_FILENO);
+      dup2(fd,STDERR_FILENO);
+      close(fd);
+    }
+  }
   if (cmd.envc) execvpe(cmd.argv[0],cmd.argv,cmd.envv);
   else execvp(cmd.argv[0],cmd.argv);
   fprintf(stderr,"%s: execvp: %m\n",ra.exename);
@@ -149,6 +165,155 @@ static int ra_process_launch_command(struct ra_process *process,const char *cmds
   return -1;
 }
 
+/* Launch command.
+ */
+ 
+static int ra_process_launch_command(struct ra_process *process,const char *cmdstr) {
+  char env[32]="";
+  if (process->trace_id) snprintf(env,sizeof(env),"RA_TRACE=%d",process->trace_id);
+  int pid=ra_process_spawn(cmdstr,0,env[0]?env:0);
+  if (pid<0) return -1;
+  process->pid=pid;
+  return 0;
+}
+
+/* Warm spares.
+ */
+ 
+static void ra_process_spare_drop(struct ra_process_spare *spare) {
+  spare->pid=0;
+  if (spare->cmd) {
+    free(spare->cmd);
+    spare->cmd=0;
+  }
+}
+
+static void ra_process_spare_reap(struct ra_process_spare *spare,int *enable) {
+  if (!spare->pid) return;
+  int wstatus=0;
+  int err=waitpid(spare->pid,&wstatus,WNOHANG);
+  if (!err) return;
+  // Quitting on its own right away, it probably doesn't understand --standby. Stop trying.
+  if ((err>0)&&(ra_process_now()-spare->start_time<RA_PROCESS_SPARE_DELAY)) {
+    fprintf(stderr,"%s: Warm spare %d exitted immediately. Disabling warm spares of that kind.\n",ra.exename,spare->pid);
+    *enable=0;
+  } else {
+    fprintf(stderr,"%s: Lost warm spare %d.\n",ra.exename,spare->pid);
+  }
+  ra_process_spare_drop(spare);
+}
+
+static int ra_process_spare_spawn(struct ra_process_spare *spare,const char *cmd) {
+  char *cmdstr=malloc(strlen(cmd)+11);
+  if (!cmdstr) return -1;
+  sprintf(cmdstr,"%s --standby",cmd);
+  int pid=ra_process_spawn(cmdstr,0,0);
+  free(cmdstr);
+  if (pid<0) return -1;
+  spare->pid=pid;
+  spare->start_time=ra_process_now();
+  fprintf(stderr,"%s: Started warm spare %d: %s\n",ra.exename,pid,cmd);
+  return 0;
+}
+
+// Most-played launcher among recent plays. Launchers with comment variables can't be spares, the command depends on the game.
+static const struct db_launcher *ra_process_choose_spare_launcher() {
+  struct { uint32_t launcherid; int c; } countv[16];
+  int countc=0,best=-1;
+  int p=db_play_count(ra.db),stop=p-100;
+  if (stop<0) stop=0;
+  while (p-->stop) {
+    const struct db_play *play=db_play_get_by_index(ra.db,p);
+    if (!play) continue;
+    const struct db_launcher *launcher=db_launcher_for_gameid(ra.db,play->gameid);
+    if (!launcher) continue;
+    int i=0;
+    for (;i<countc;i++) if (countv[i].launcherid==launcher->launcherid) break;
+    if (i>=countc) {
+      if (countc>=16) continue;
+      countv[countc].launcherid=launcher->launcherid;
+      countv[countc].c=0;
+      countc++;
+    }
+    countv[i].c++;
+    if ((best<0)||(countv[i].c>countv[best].c)) best=i;
+  }
+  if (best<0) return 0;
+  const struct db_launcher *launcher=db_launcher_get_by_id(ra.db,countv[best].launcherid);
+  if (!launcher) return 0;
+  const char *cmd=0;
+  int cmdc=db_string_get(&cmd,ra.db,launcher->cmd);
+  if (cmdc<1) return 0;
+  int i=0; for (;i<cmdc-9;i++) if (!memcmp(cmd+i,"$COMMENT:",9)) return 0;
+  return launcher;
+}
+
+static void ra_process_update_spares(struct ra_process *process) {
+  ra_process_spare_reap(&process->menu_spare,&ra.warm_menu);
+  ra_process_spare_reap(&process->game_spare,&ra.warm_game);
+  
+  // Give the foreground process a few seconds to itself before we start anything.
+  if (!process->pid||process->next_launch) return;
+  if (ra_process_now()-process->start_time<RA_PROCESS_SPARE_DELAY) return;
+  
+  if (process->gameid) {
+    if (ra.warm_menu&&ra.menu&&!process->menu_spare.pid) {
+      if (ra_process_spare_spawn(&process->menu_spare,ra.menu)<0) ra.warm_menu=0;
+    }
+  } else {
+    if (ra.warm_game&&!process->game_spare.pid) {
+      const struct db_launcher *launcher=ra_process_choose_spare_launcher();
+      if (!launcher) return;
+      const char *cmd=0;
+      int cmdc=db_string_get(&cmd,ra.db,launcher->cmd);
+      char *combined=ra_process_combine_command(cmd,cmdc,0,0,0);
+      if (!combined) return;
+      if (
+        !(process->game_spare.cmd=malloc(cmdc+1))||
+        (ra_process_spare_spawn(&process->game_spare,combined)<0)
+      ) {
+        ra.warm_game=0;
+        ra_process_spare_drop(&process->game_spare);
+      } else {
+        memcpy(process->game_spare.cmd,cmd,cmdc);
+        process->game_spare.cmd[cmdc]=0;
+      }
+      free(combined);
+    }
+  }
+}
+
+// Take over a spare if it matches the pending launch. Zero if we didn't.
+static int ra_process_wake_spare(struct ra_process *process) {
+  struct ra_process_spare *spare;
+  int role;
+  const char *rom=0;
+  if (process->next_launch) {
+    spare=&process->game_spare;
+    if (!spare->pid||!spare->cmd||!process->next_cmd||strcmp(spare->cmd,process->next_cmd)) return 0;
+    role=RA_WEBSOCKET_ROLE_GAME;
+    rom=process->next_path;
+  } else {
+    spare=&process->menu_spare;
+    if (!spare->pid) return 0;
+    role=RA_WEBSOCKET_ROLE_MENU;
+  }
+  if (ra_websocket_wake_spare(spare->pid,role,rom,process->trace_id)<0) return 0;
+  process->pid=spare->pid;
+  fprintf(stderr,"%s: Woke warm spare %d.\n",ra.exename,spare->pid);
+  ra_process_spare_drop(spare);
+  return 1;
+}
+
+/* Record the launch of (pid) in the current trace.
+ */
+ 
+static void ra_process_trace_launch(struct ra_process *process) {
+  ra_trace_set_warm(process->trace_id,process->request_warm);
+  if (process->request_warm) ra_trace_mark(process->trace_id,"woke",4,process->start_time);
+  else ra_trace_mark(process->trace_id,"spawn",5,process->start_time);
+}
+
 /* Update.
  */
  
@@ -170,6 +335,13 @@ int ra_process_update(struct ra_process *process) {
       }
       if (process->gameid) db_play_finish(ra.db,process->gameid);
       if (!process->gameid&&!process->next_launch) process->menu_terminated=1;
+      if (process->gameid&&!process->next_launch) {
+        process->request_time=ra_process_now();
+        process->request_gameid=0;
+        process->trace_id=ra_trace_begin(0,"exit");
+      } else if (process->next_launch) {
+        ra_trace_mark(process->trace_id,"exit",4,0);
+      }
       process->pid=0;
       if (!process->next_launch) process->gameid=0;
       ra_report_gameid(0);
@@ -188,24 +360,53 @@ int ra_process_update(struct ra_process *process) {
    */
   if (!process->pid) {
     if (process->next_launch) {
-      if (ra_process_launch_command(process,process->next_launch)<0) {
+      process->request_warm=ra_process_wake_spare(process);
+      if (!process->request_warm&&(ra_process_launch_command(process,process->next_launch)<0)) {
         return -1;
       }
+      process->start_time=ra_process_now();
+      ra_process_trace_launch(process);
       free(process->next_launch);
       process->next_launch=0;
       ra_report_gameid(ra.process.gameid);
     } else if (process->menu_terminated) {
       // Wait for main to acknowledge, or quit if it decides to.
     } else if (ra.menu&&http_context_get_server_by_index(ra.http,0)) {
-      if (ra_process_launch_command(process,ra.menu)<0) {
+      if (!process->request_time) {
+        process->request_time=ra_process_now();
+        process->request_gameid=0;
+        process->trace_id=ra_trace_begin(0,"boot");
+      }
+      process->request_warm=ra_process_wake_spare(process);
+      if (!process->request_warm&&(ra_process_launch_command(process,ra.menu)<0)) {
         return -2;
       }
+      process->start_time=ra_process_now();
+      ra_process_trace_launch(process);
     }
   }
+  
+  ra_process_update_spares(process);
 
   return 0;
 }
 
+/* First frame reported.
+ */
+ 
+void ra_process_first_frame(struct ra_process *process,int agoms) {
+  if (!process->request_time) return;
+  int ms=(int)((ra_process_now()-process->request_time)/1000)-agoms;
+  if (process->request_gameid) {
+    process->ttff_game_ms=ms;
+    fprintf(stderr,"%s: Game %d first frame %d ms after launch request (%s).\n",ra.exename,process->request_gameid,ms,process->request_warm?"warm":"cold");
+  } else {
+    process->ttff_menu_ms=ms;
+    fprintf(stderr,"%s: Menu first frame %d ms after game exit (%s).\n",ra.exename,ms,process->request_warm?"warm":"cold");
+  }
+  process->request_time=0;
+}
+
 /* Status.
  */
  
@@ -256,7 +457,7 @@ static int ra_process_insert_command_variable(struct sr_encoder *dst,const char
 /* Insert (path) in (cmd), to a newly allocated string.
  */
  
-static char *ra_process_combine_command(const char *cmd,int cmdc,const char *path,int pathc,uint32_t gameid) {
+char *ra_process_combine_command(const char *cmd,int cmdc,const char *path,int pathc,uint32_t gameid) {
   struct sr_encoder dst={0};
   int cmdp=0;
   while (cmdp<cmdc) {
@@ -306,13 +507,27 @@ int ra_process_prepare_launch(
   
   char *nv=ra_process_combine_command(cmd,cmdc,path,pathc,gameid);
   if (!nv) return -1;
-  if (ra_process_restart_menu(process)<0) {
+  char *ncmd=malloc(cmdc+1);
+  char *npath=malloc(pathc+1);
+  if (!ncmd||!npath||(ra_process_restart_menu(process)<0)) {
     free(nv);
+    if (ncmd) free(ncmd);
+    if (npath) free(npath);
     return -1;
   }
+  memcpy(ncmd,cmd,cmdc);
+  ncmd[cmdc]=0;
+  memcpy(npath,path,pathc);
+  npath[pathc]=0;
   if (process->next_launch) free(process->next_launch);
   process->next_launch=nv;
+  if (process->next_cmd) free(process->next_cmd);
+  process->next_cmd=ncmd;
+  if (process->next_path) free(process->next_path);
+  process->next_path=npath;
   process->gameid=gameid;
+  process->request_time=ra_process_now();
+  process->request_gameid=gameid;
   
   return 0;
 }
@@ -345,24 +560,29 @@ int ra_process_restart_menu(struct ra_process *process) {
 }
 
 void ra_process_terminate_and_wait(struct ra_process *process,int toms) {
-  if (!process->pid) return;
-  if (kill(process->pid,SIGINT)<0) return;
-  if (toms>0) {
-    int64_t stoptime=ra_process_now()+toms*1000ll;
-    while (1) {
-      int err,wstatus=0;
+  // Signal everybody first, so they shut down in parallel. Then reap all of them within the same deadline.
+  if (process->menu_spare.pid&&(kill(process->menu_spare.pid,SIGINT)<0)) ra_process_spare_drop(&process->menu_spare);
+  if (process->game_spare.pid&&(kill(process->game_spare.pid,SIGINT)<0)) ra_process_spare_drop(&process->game_spare);
+  if (process->pid&&(kill(process->pid,SIGINT)<0)) process->pid=0;
+  if (toms<=0) return;
+  int64_t stoptime=ra_process_now()+toms*1000ll;
+  while (process->pid||process->menu_spare.pid||process->game_spare.pid) {
+    int err,wstatus=0;
+    if (process->pid) {
       err=waitpid(process->pid,&wstatus,WNOHANG);
-      if (err<0) break;
       if (err) {
-        int status=WEXITSTATUS(wstatus);
-        fprintf(stderr,"%s: Child process %d (gameid %d) exitted with status %d.\n",ra.exename,process->pid,process->gameid,status);
+        if (err>0) {
+          int status=WEXITSTATUS(wstatus);
+          fprintf(stderr,"%s: Child process %d (gameid %d) exitted with status %d.\n",ra.exename,process->pid,process->gameid,status);
+        }
         process->pid=0;
         if (!process->next_launch) process->gameid=0;
-        break;
       }
-      int64_t now=ra_process_now();
-      if (now>=stoptime) break;
-      usleep(5000);
     }
+    if (process->menu_spare.pid&&waitpid(process->menu_spare.pid,&wstatus,WNOHANG)) ra_process_spare_drop(&process->menu_spare);
+    if (process->game_spare.pid&&waitpid(process->game_spare.pid,&wstatus,WNOHANG)) ra_process_spare_drop(&process->game_spare);
+    int64_t now=ra_process_now();
+    if (now>=stoptime) break;
+    usleep(5000);
   }
 }
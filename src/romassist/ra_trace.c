@@ -0,0 +1,92 @@
+#include "ra_internal.h"
+#include "opt/serial/serial.h"
+#include <sys/time.h>
+
+/* Current real time.
+ */
+
+int64_t ra_trace_now() {
+  struct timeval tv={0};
+  gettimeofday(&tv,0);
+  return tv.tv_sec*1000000ll+tv.tv_usec;
+}
+
+/* Find launch.
+ */
+
+static struct ra_trace_launch *ra_trace_find(int id) {
+  if (id<1) return 0;
+  struct ra_trace_launch *launch=ra.trace.launchv;
+  int i=RA_TRACE_LIMIT;
+  for (;i-->0;launch++) if (launch->id==id) return launch;
+  return 0;
+}
+
+/* Begin.
+ */
+
+int ra_trace_begin(uint32_t gameid,const char *name) {
+  struct ra_trace_launch *launch=ra.trace.launchv+ra.trace.launchp++;
+  if (ra.trace.launchp>=RA_TRACE_LIMIT) ra.trace.launchp=0;
+  memset(launch,0,sizeof(struct ra_trace_launch));
+  if (++(ra.trace.idnext)>=INT_MAX) ra.trace.idnext=1;
+  launch->id=ra.trace.idnext;
+  launch->gameid=gameid;
+  launch->start_time=ra_trace_now();
+  ra_trace_mark(launch->id,name,-1,launch->start_time);
+  return launch->id;
+}
+
+/* Mark.
+ */
+
+void ra_trace_mark(int id,const char *name,int namec,int64_t time) {
+  struct ra_trace_launch *launch=ra_trace_find(id);
+  if (!launch) return;
+  if (launch->stagec>=RA_TRACE_STAGE_LIMIT) return;
+  if (!name) namec=0; else if (namec<0) { namec=0; while (name[namec]) namec++; }
+  if (namec>=sizeof(launch->stagev[0].name)) namec=sizeof(launch->stagev[0].name)-1;
+  if (!time) time=ra_trace_now();
+  struct ra_trace_stage *stage=launch->stagev+launch->stagec++;
+  memcpy(stage->name,name,namec);
+  stage->name[namec]=0;
+  stage->ms=(int)((time-launch->start_time)/1000);
+}
+
+void ra_trace_set_warm(int id,int warm) {
+  struct ra_trace_launch *launch=ra_trace_find(id);
+  if (launch) launch->warm=warm;
+}
+
+/* Encode.
+ */
+
+int ra_trace_encode(struct sr_encoder *dst) {
+  int arrayctx=sr_encode_json_array_start(dst,0,0);
+  if (arrayctx<0) return -1;
+  int i=RA_TRACE_LIMIT,p=ra.trace.launchp;
+  while (i-->0) {
+    if (--p<0) p=RA_TRACE_LIMIT-1;
+    const struct ra_trace_launch *launch=ra.trace.launchv+p;
+    if (!launch->id) continue;
+    int jsonctx=sr_encode_json_object_start(dst,0,0);
+    if (jsonctx<0) return -1;
+    if (sr_encode_json_int(dst,"trace",5,launch->id)<0) return -1;
+    if (sr_encode_json_int(dst,"gameid",6,launch->gameid)<0) return -1;
+    if (sr_encode_json_boolean(dst,"warm",4,launch->warm)<0) return -1;
+    int stagesctx=sr_encode_json_array_start(dst,"stages",6);
+    if (stagesctx<0) return -1;
+    const struct ra_trace_stage *stage=launch->stagev;
+    int stagei=launch->stagec;
+    for (;stagei-->0;stage++) {
+      int stagectx=sr_encode_json_object_start(dst,0,0);
+      if (stagectx<0) return -1;
+      if (sr_encode_json_string(dst,"stage",5,stage->name,-1)<0) return -1;
+      if (sr_encode_json_int(dst,"ms",2,stage->ms)<0) return -1;
+      if (sr_encode_json_object_end(dst,stagectx)<0) return -1;
+    }
+    if (sr_encode_json_array_end(dst,stagesctx)<0) return -1;
+    if (sr_encode_json_object_end(dst,jsonctx)<0) return -1;
+  }
+  return sr_encode_json_array_end(dst,arrayctx);
+}
@@ -0,0 +1,57 @@
+/* ra_trace.h
+ * Timelines of recent launches, for GET /api/launch/trace.
+ * Each launch gets an ID, which we pass to the new process as RA_TRACE in its environment,
+ * or in the "wake" message for warm spares. Emuhost reports its own milestones against that ID, see src/lib/eh_trace.h.
+ * Returning to the menu after a game counts as a launch too, with gameid zero.
+ *
+ * Our stages, in the order they usually happen:
+ *   request   HTTP request received. Always zero, it's the reference point. (menu: "exit", or "boot" the first time)
+ *   launcher  Launcher selected.
+ *   prepared  Command composed, previous process signalled.
+ *   exit      Previous process reaped.
+ *   spawn     Forked. Or "woke" if a warm spare took it.
+ */
+
+#ifndef RA_TRACE_H
+#define RA_TRACE_H
+
+#define RA_TRACE_LIMIT 16
+#define RA_TRACE_STAGE_LIMIT 24
+
+struct sr_encoder;
+
+struct ra_trace {
+  struct ra_trace_launch {
+    int id; // Zero if unused.
+    uint32_t gameid;
+    int warm;
+    int64_t start_time; // us
+    struct ra_trace_stage {
+      char name[16];
+      int ms;
+    } stagev[RA_TRACE_STAGE_LIMIT];
+    int stagec;
+  } launchv[RA_TRACE_LIMIT];
+  int launchp; // Next to overwrite.
+  int idnext;
+};
+
+/* Start a new timeline, with stage (name) at time zero. Returns its ID.
+ */
+int ra_trace_begin(uint32_t gameid,const char *name);
+
+/* Add a stage to an existing timeline. Noop if we've dropped it.
+ * (time) in us from our clock, or zero for now.
+ */
+void ra_trace_mark(int id,const char *name,int namec,int64_t time);
+
+void ra_trace_set_warm(int id,int warm);
+
+int64_t ra_trace_now();
+
+/* JSON array of recent launches, newest first:
+ *   [{trace,gameid,warm,stages:[{stage,ms}...]}...]
+ */
+int ra_trace_encode(struct sr_encoder *dst);
+
+#endif
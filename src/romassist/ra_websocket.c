@@ -6,6 +6,9 @@
 #include "opt/http/http_dict.h"
 #include "opt/http/http_xfer.h"
 #include <sys/time.h>
+#if USE_shmring
+  #include "opt/shmring/shmring.h"
+#endif
 
 /* Current time.
  */
@@ -23,6 +26,9 @@ static const char *ra_ws_role_repr(int role) {
   switch (role) {
     case RA_WEBSOCKET_ROLE_MENU: return "MENU";
     case RA_WEBSOCKET_ROLE_GAME: return "GAME";
+    case RA_WEBSOCKET_ROLE_STREAM: return "STREAM";
+    case RA_WEBSOCKET_ROLE_VIEWER: return "VIEWER";
+    case RA_WEBSOCKET_ROLE_SPARE: return "SPARE";
   }
   return "?";
 }
@@ -42,6 +48,34 @@ int ra_websocket_send_to_role(int role,int packet_type,const void *v,int c) {
   return 0;
 }
 
+/* Wake a spare.
+ */
+ 
+static int ra_ws_compose_handshake(struct ra_websocket_extra *extra);
+ 
+int ra_websocket_wake_spare(int pid,int role,const char *rom,int trace_id) {
+  struct ra_websocket_extra *extra=ra.websocket_extrav;
+  int i=RA_WEBSOCKET_LIMIT;
+  for (;i-->0;extra++) {
+    if (extra->role!=RA_WEBSOCKET_ROLE_SPARE) continue;
+    if (extra->pid!=pid) continue;
+    if (!extra->socket) continue;
+    struct sr_encoder encoder={0};
+    sr_encode_json_object_start(&encoder,0,0);
+    sr_encode_json_string(&encoder,"id",2,"wake",4);
+    if (rom) sr_encode_json_string(&encoder,"rom",3,rom,-1);
+    if (trace_id) sr_encode_json_int(&encoder,"trace",5,trace_id);
+    int err=sr_encode_json_object_end(&encoder,0);
+    if (err>=0) err=http_websocket_send(extra->socket,1,encoder.v,encoder.c);
+    sr_encoder_cleanup(&encoder);
+    if (err<0) return -1;
+    extra->role=role;
+    extra->pid=0;
+    return ra_ws_compose_handshake(extra);
+  }
+  return -1;
+}
+
 /* id="hello"
  */
  
@@ -110,6 +144,112 @@ static int ra_ws_rcv_step(struct ra_websocket_extra *extra,const void *v,int c)
   return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_GAME,1,v,c);
 }
     
+/* id="input"
+ * Button states from a web client, for the running game. See src/lib/eh_remote_input.h.
+ */
+ 
+static int ra_ws_rcv_input(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_MENU) return 0;
+  return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_GAME,1,v,c);
+}
+    
+/* id="inputApplied"
+ * Game's acknowledgement of "input", back to the web clients for latency measurement.
+ */
+ 
+static int ra_ws_rcv_inputApplied(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_GAME) return 0;
+  return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_MENU,1,v,c);
+}
+    
+/* id="spare"
+ * Emuhost in standby introducing itself.
+ */
+ 
+static int ra_ws_rcv_spare(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_SPARE) return 0;
+  struct sr_decoder decoder={.v=v,.c=c};
+  if (sr_decode_json_object_start(&decoder)<0) return 0;
+  const char *k;
+  int kc;
+  while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+    if ((kc==3)&&!memcmp(k,"pid",3)) {
+      if (sr_decode_json_int(&extra->pid,&decoder)<0) return 0;
+    } else {
+      if (sr_decode_json_skip(&decoder)<0) return 0;
+    }
+  }
+  return 0;
+}
+    
+/* id="firstFrame"
+ * Game or menu reporting that it's up, for launch timing.
+ */
+ 
+static int ra_ws_rcv_firstFrame(struct ra_websocket_extra *extra,const void *v,int c) {
+  if ((extra->role!=RA_WEBSOCKET_ROLE_GAME)&&(extra->role!=RA_WEBSOCKET_ROLE_MENU)) return 0;
+  int agoms=0;
+  struct sr_decoder decoder={.v=v,.c=c};
+  if (sr_decode_json_object_start(&decoder)<0) return 0;
+  const char *k;
+  int kc;
+  while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+    if ((kc==5)&&!memcmp(k,"agoMs",5)) {
+      if (sr_decode_json_int(&agoms,&decoder)<0) return 0;
+    } else {
+      if (sr_decode_json_skip(&decoder)<0) return 0;
+    }
+  }
+  ra_process_first_frame(&ra.process,agoms);
+  return 0;
+}
+    
+/* id="trace"
+ * Startup milestone from the game or menu, see ra_trace.h.
+ */
+ 
+static int ra_ws_rcv_trace(struct ra_websocket_extra *extra,const void *v,int c) {
+  if ((extra->role!=RA_WEBSOCKET_ROLE_GAME)&&(extra->role!=RA_WEBSOCKET_ROLE_MENU)) return 0;
+  int traceid=0,agoms=0,stagec=0;
+  char stage[16];
+  struct sr_decoder decoder={.v=v,.c=c};
+  if (sr_decode_json_object_start(&decoder)<0) return 0;
+  const char *k;
+  int kc;
+  while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+    if ((kc==5)&&!memcmp(k,"trace",5)) {
+      if (sr_decode_json_int(&traceid,&decoder)<0) return 0;
+    } else if ((kc==5)&&!memcmp(k,"agoMs",5)) {
+      if (sr_decode_json_int(&agoms,&decoder)<0) return 0;
+    } else if ((kc==5)&&!memcmp(k,"stage",5)) {
+      if ((stagec=sr_decode_json_string(stage,sizeof(stage),&decoder))<0) return 0;
+      if (stagec>sizeof(stage)) stagec=0;
+    } else {
+      if (sr_decode_json_skip(&decoder)<0) return 0;
+    }
+  }
+  if (!stagec) return 0;
+  ra_trace_mark(traceid,stage,stagec,ra_trace_now()-agoms*1000ll);
+  return 0;
+}
+    
+/* id="requestPerf"
+ * Web app wants the game's frame timing ring. It polls, so we don't need to track who asked.
+ */
+ 
+static int ra_ws_rcv_requestPerf(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_MENU) return 0;
+  return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_GAME,1,v,c);
+}
+    
+/* id="perf"
+ */
+ 
+static int ra_ws_rcv_perf(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_GAME) return 0;
+  return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_MENU,1,v,c);
+}
+
 /* id="comment"
  */
  
@@ -119,6 +259,32 @@ static int ra_ws_rcv_comment(struct ra_websocket_extra *extra,const void *v,int
   return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_MENU,1,v,c);
 }
 
+/* id="streamStats"
+ */
+ 
+static int ra_ws_rcv_streamStats(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_STREAM) return 0;
+  return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_VIEWER,1,v,c);
+}
+    
+/* id="streamKeyframe"
+ * Viewers may ask when they lose sync. We also fake one on their behalf at connect.
+ */
+ 
+static int ra_ws_rcv_streamKeyframe(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_VIEWER) return 0;
+  return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_STREAM,1,v,c);
+}
+
+/* Binary: Framebuffer stream.
+ * We don't look inside, just fan out to the viewers.
+ */
+ 
+static int ra_ws_rcv_stream(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_STREAM) return 0;
+  return ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_VIEWER,2,v,c);
+}
+
 /* Binary: PNG
  */
  
@@ -176,6 +342,143 @@ static int ra_ws_rcv_png(struct ra_websocket_extra *extra,const void *v,int c) {
   return 0;
 }
 
+/* id="shmring"
+ * Emuhost offering a shared-memory frame ring. If we can open it, say so, and it will start sending "shmScreencap".
+ */
+ 
+static int ra_ws_rcv_shmring(struct ra_websocket_extra *extra,const void *v,int c) {
+  #if USE_shmring
+    char name[32];
+    int namec=-1;
+    struct sr_decoder decoder={.v=v,.c=c};
+    if (sr_decode_json_object_start(&decoder)<0) return 0;
+    const char *k;
+    int kc;
+    while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+      if ((kc==4)&&!memcmp(k,"name",4)) {
+        namec=sr_decode_json_string(name,sizeof(name),&decoder);
+        if ((namec<0)||(namec>sizeof(name))) return 0;
+      } else {
+        if (sr_decode_json_skip(&decoder)<0) return 0;
+      }
+    }
+    if (namec<1) return 0;
+    shmring_del(extra->shmring);
+    if (!(extra->shmring=shmring_open(name,namec))) {
+      fprintf(stderr,"%s: Failed to open shared framebuffer '%.*s'. Screencaps will arrive as PNG.\n",ra.exename,namec,name);
+      return 0;
+    }
+    const char msg[]="{\"id\":\"shmringOk\"}";
+    return http_websocket_send(extra->socket,1,msg,sizeof(msg)-1);
+  #else
+    return 0;
+  #endif
+}
+
+/* id="shmScreencap"
+ * Screencap waiting in the client's shmring. Encode it here and deliver as if it had arrived as PNG.
+ */
+ 
+static int ra_ws_rcv_shmScreencap(struct ra_websocket_extra *extra,const void *v,int c) {
+  #if USE_shmring
+    if (!extra->shmring) return 0;
+    int frameid=0;
+    struct sr_decoder decoder={.v=v,.c=c};
+    if (sr_decode_json_object_start(&decoder)<0) return 0;
+    const char *k;
+    int kc;
+    while ((kc=sr_decode_json_next(&k,&decoder))>0) {
+      if ((kc==5)&&!memcmp(k,"frame",5)) {
+        if (sr_decode_json_int(&frameid,&decoder)<0) return 0;
+      } else {
+        if (sr_decode_json_skip(&decoder)<0) return 0;
+      }
+    }
+    struct shmring_frame frame;
+    if (shmring_read(&frame,&ra.shmpixels,&ra.shmpixelsa,extra->shmring,frameid)<0) {
+      fprintf(stderr,"%s: Screencap frame %d no longer in shared memory.\n",ra.exename,frameid);
+      return 0;
+    }
+    // Everything in (frame) came from another process. The encoder trusts (w,h,stride,depth,colortype) to stay within (len).
+    if ((frame.w<1)||(frame.h<1)||(frame.stride<1)||(frame.stride>frame.len/frame.h)) return 0;
+    
+    // Native RGB32 is the only thing that needs converting. Everything else the game already made PNG-ready.
+    struct png_image *image;
+    if (frame.rgb32) {
+      if (frame.w>frame.stride/4) return 0;
+      if ((frame.rshift>24)||(frame.gshift>24)||(frame.bshift>24)) return 0;
+      if (!(image=png_image_new(frame.w,frame.h,8,2))) return 0;
+      uint8_t *dstrow=image->pixels;
+      const uint8_t *srcrow=ra.shmpixels;
+      int yi=frame.h;
+      for (;yi-->0;dstrow+=image->stride,srcrow+=frame.stride) {
+        uint8_t *dstp=dstrow;
+        const uint32_t *srcp=(const uint32_t*)srcrow;
+        int xi=frame.w;
+        for (;xi-->0;dstp+=3,srcp++) {
+          dstp[0]=(*srcp)>>frame.rshift;
+          dstp[1]=(*srcp)>>frame.gshift;
+          dstp[2]=(*srcp)>>frame.bshift;
+        }
+      }
+    } else {
+      uint8_t depth=frame.depth,colortype=frame.colortype;
+      png_depth_colortype_legal(&depth,&colortype);
+      if ((depth!=frame.depth)||(colortype!=frame.colortype)) return 0;
+      int64_t minstride=((int64_t)frame.w*png_channel_count_for_colortype(colortype)*depth+7)>>3;
+      if (frame.stride<minstride) return 0;
+      if (!(image=png_image_new(0,0,0,0))) return 0;
+      image->w=frame.w;
+      image->h=frame.h;
+      image->depth=frame.depth;
+      image->colortype=frame.colortype;
+      image->stride=frame.stride;
+      image->pixels=ra.shmpixels;
+      image->ownpixels=0;
+      if (frame.ctabc&&(frame.ctabc<=256)) {
+        if (png_image_add_chunk(image,PNG_CHUNKID_PLTE,frame.ctab,frame.ctabc*3)<0) {
+          png_image_del(image);
+          return 0;
+        }
+      }
+    }
+    void *serial=0;
+    int serialc=png_encode(&serial,image);
+    png_image_del(image);
+    if (serialc<0) {
+      if (serial) free(serial);
+      return 0;
+    }
+    int err=ra_ws_rcv_png(extra,serial,serialc);
+    free(serial);
+    return err;
+  #else
+    return 0;
+  #endif
+}
+
+/* Binary: Input movie, see src/lib/eh_movie.h.
+ * Only games send them, and we save as a blob of the running game.
+ */
+ 
+static int ra_ws_rcv_movie(struct ra_websocket_extra *extra,const void *v,int c) {
+  if (extra->role!=RA_WEBSOCKET_ROLE_GAME) return 0;
+  if (!ra.process.gameid) {
+    fprintf(stderr,"%s: Ignoring %d-byte movie, no game ID.\n",ra.exename,c);
+    return 0;
+  }
+  char *blobpath=db_blob_compose_path(ra.db,ra.process.gameid,"movie",5,".ehmv",5);
+  if (!blobpath) return 0;
+  if (file_write(blobpath,v,c)>=0) {
+    db_invalidate_blobs_for_gameid(ra.db,ra.process.gameid);
+    fprintf(stderr,"%s: Saved movie.\n",blobpath);
+  } else {
+    fprintf(stderr,"%s: Failed to write file, %d bytes.\n",blobpath,c);
+  }
+  free(blobpath);
+  return 0;
+}
+
 /* id="http"
  */
 
@@ -391,6 +694,11 @@ static int ra_ws_compose_handshake(struct ra_websocket_extra *extra) {
         }
       } break;
       
+    case RA_WEBSOCKET_ROLE_VIEWER: {
+        const char msg[]="{\"id\":\"streamKeyframe\"}";
+        ra_websocket_send_to_role(RA_WEBSOCKET_ROLE_STREAM,1,msg,sizeof(msg)-1);
+      } break;
+      
   }
   return 0;
 }
@@ -428,6 +736,18 @@ int ra_ws_connect_menu(struct http_socket *sock,void *userdata) {
 int ra_ws_connect_game(struct http_socket *sock,void *userdata) {
   return ra_ws_connect(sock,RA_WEBSOCKET_ROLE_GAME);
 }
+ 
+int ra_ws_connect_stream(struct http_socket *sock,void *userdata) {
+  return ra_ws_connect(sock,RA_WEBSOCKET_ROLE_STREAM);
+}
+ 
+int ra_ws_connect_view(struct http_socket *sock,void *userdata) {
+  return ra_ws_connect(sock,RA_WEBSOCKET_ROLE_VIEWER);
+}
+ 
+int ra_ws_connect_spare(struct http_socket *sock,void *userdata) {
+  return ra_ws_connect(sock,RA_WEBSOCKET_ROLE_SPARE);
+}
 
 /* Lost WebSocket connection.
  */
@@ -439,6 +759,12 @@ int ra_ws_disconnect(struct http_socket *sock,void *userdata) {
     extra->role=RA_WEBSOCKET_ROLE_NONE;
     extra->socket=0;
   }
+  #if USE_shmring
+    if (extra&&extra->shmring) {
+      shmring_del(extra->shmring);
+      extra->shmring=0;
+    }
+  #endif
   return 0;
 }
 
@@ -487,6 +813,17 @@ int ra_ws_message(struct http_socket *sock,int type,const void *v,int c,void *us
     _(step)
     _(comment)
     _(http)
+    _(streamStats)
+    _(streamKeyframe)
+    _(input)
+    _(inputApplied)
+    _(requestPerf)
+    _(perf)
+    _(spare)
+    _(firstFrame)
+    _(trace)
+    _(shmring)
+    _(shmScreencap)
     #undef _
     
     fprintf(stderr,"%s: Unknown WebSocket packet ID '%.*s' from %s client.\n",ra.exename,idc,id,ra_ws_role_repr(extra->role));
@@ -498,6 +835,8 @@ int ra_ws_message(struct http_socket *sock,int type,const void *v,int c,void *us
    */
   if (type==2) {
     if ((c>=8)&&!memcmp(v,"\x89PNG\r\n\x1a\n",8)) return ra_ws_rcv_png(extra,v,c);
+    if ((c>=4)&&!memcmp(v,"EHFS",4)) return ra_ws_rcv_stream(extra,v,c);
+    if ((c>=4)&&!memcmp(v,"EHMV",4)) return ra_ws_rcv_movie(extra,v,c);
     fprintf(stderr,"%s: Ignoring %d-byte binary WebSocket message from %s client, unknown format.\n",ra.exename,c,ra_ws_role_repr(extra->role));
     return 0;
   }
@@ -35,9 +35,9 @@ export class GameBlobsForm {
   populate() {
     this.element.innerHTML = "";
     if (!this.game?.blobs) return;
-    //TODO Filter to "scap" only.
     //TODO Limit two? Arrange an artificial test.
     for (const path of this.game.blobs) {
+      if (!path.match(/-scap-.*\.png$/)) continue; // eg input movies
       this.dom.spawn(this.element, "IMG", { src: "/api/blob?path=" + path, "on-click": () => this.onClick(path) });
     }
   }
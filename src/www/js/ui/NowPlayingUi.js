@@ -4,6 +4,9 @@
 import { Dom } from "../Dom.js";
 import { Comm } from "../Comm.js";
 import { GameDetailsModal } from "./GameDetailsModal.js";
+import { StreamViewerUi } from "./StreamViewerUi.js";
+import { RemoteInputUi } from "./RemoteInputUi.js";
+import { PerfChartUi } from "./PerfChartUi.js";
 import { DbService } from "../model/DbService.js";
  
 export class NowPlayingUi {
@@ -36,10 +39,16 @@ export class NowPlayingUi {
     this.dom.spawn(controlsRow, "INPUT", { type: "button", value: "Resume", disabled: "disabled", "on-click": () => this.onParamlessJson("resume") });
     this.dom.spawn(controlsRow, "INPUT", { type: "button", value: "Step", disabled: "disabled", "on-click": () => this.onParamlessJson("step") });
     this.dom.spawn(this.element, "INPUT", { type: "button", value: "Terminate", disabled: "disabled", "on-click": () => this.onTerminate() });
+    this.dom.spawn(this.element, "INPUT", { type: "button", value: "Watch", disabled: "disabled", "on-click": () => this.onToggleStream() });
+    this.dom.spawn(this.element, "INPUT", { type: "button", value: "Remote Input", disabled: "disabled", "on-click": () => this.onToggleRemoteInput() });
+    this.dom.spawn(this.element, "INPUT", { type: "button", value: "Timing", disabled: "disabled", "on-click": () => this.onTogglePerf() });
   }
   
   populateUiNone() {
     this.element.querySelector(".title").innerText = "";
+    this.element.querySelector(".StreamViewerUi")?.remove();
+    this.element.querySelector(".RemoteInputUi")?.remove();
+    this.element.querySelector(".PerfChartUi")?.remove();
     for (const input of this.element.querySelectorAll("input")) input.disabled = true;
   }
   
@@ -59,6 +68,26 @@ export class NowPlayingUi {
     this.comm.sendWsJson({ id });
   }
   
+  /* Only works if the game was launched with --stream.
+   */
+  onToggleStream() {
+    const existing = this.element.querySelector(".StreamViewerUi");
+    if (existing) existing.remove();
+    else this.dom.spawnController(this.element, StreamViewerUi);
+  }
+  
+  onToggleRemoteInput() {
+    const existing = this.element.querySelector(".RemoteInputUi");
+    if (existing) existing.remove();
+    else this.dom.spawnController(this.element, RemoteInputUi).element.focus();
+  }
+  
+  onTogglePerf() {
+    const existing = this.element.querySelector(".PerfChartUi");
+    if (existing) existing.remove();
+    else this.dom.spawnController(this.element, PerfChartUi);
+  }
+  
   onTerminate() {
     this.comm.http("POST", "/api/terminate");
   }
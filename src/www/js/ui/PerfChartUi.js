@@ -0,0 +1,87 @@
+/* PerfChartUi.js
+ * Frame timing from the running game, a few seconds' worth, refreshed every second.
+ * Same picture as the game's own overlay (EH_BTN_DEBUG). Format is documented at src/lib/eh_perf.h.
+ */
+
+import { Dom } from "../Dom.js";
+import { Comm } from "../Comm.js";
+
+export class PerfChartUi {
+  static getDependencies() {
+    return [HTMLElement, Dom, Comm, Window];
+  }
+  constructor(element, dom, comm, window) {
+    this.element = element;
+    this.dom = dom;
+    this.comm = comm;
+    this.window = window;
+
+    this.buildUi();
+    this.wsListener = this.comm.listenWs((type, packet) => this.onWsRcv(type, packet));
+    this.pollInterval = this.window.setInterval(() => this.comm.sendWsJson({ id: "requestPerf" }), 1000);
+    this.comm.sendWsJson({ id: "requestPerf" });
+  }
+
+  onRemoveFromDom() {
+    this.comm.unlistenWs(this.wsListener);
+    this.window.clearInterval(this.pollInterval);
+  }
+
+  buildUi() {
+    this.element.innerHTML = "";
+    const canvas = this.dom.spawn(this.element, "CANVAS", ["chart"]);
+    canvas.width = 510;
+    canvas.height = 120;
+    const legend = this.dom.spawn(this.element, "DIV", ["legend"]);
+    PerfChartUi.STAGE_COLORS.forEach((color, i) => {
+      this.dom.spawn(legend, "SPAN", { style: `color: ${color}` }, `■ ${PerfChartUi.STAGE_NAMES[i]} `);
+    });
+    this.dom.spawn(this.element, "DIV", ["stats"], "Waiting for game...");
+  }
+
+  onWsRcv(type, packet) {
+    if (type !== "json") return;
+    if (packet.id !== "perf") return;
+    this.render(packet);
+  }
+
+  render(packet) {
+    const canvas = this.element.querySelector(".chart");
+    const ctx = canvas.getContext("2d");
+    const frames = packet.frames || [];
+    const budget = packet.frameUs || 16667;
+    const yscale = canvas.height / (budget * 2);
+    const colw = canvas.width / 255;
+    ctx.fillStyle = "#000";
+    ctx.fillRect(0, 0, canvas.width, canvas.height);
+    let x = canvas.width - frames.length * colw;
+    for (const frame of frames) {
+      ctx.fillStyle = "#444";
+      ctx.fillRect(x, canvas.height - frame[0] * yscale, colw, frame[0] * yscale);
+      let y = canvas.height;
+      for (let i = 1; i < frame.length; i++) {
+        const h = frame[i] * yscale;
+        ctx.fillStyle = PerfChartUi.STAGE_COLORS[i - 1] || "#fff";
+        ctx.fillRect(x, y - h, colw, h);
+        y -= h;
+      }
+      x += colw;
+    }
+    ctx.fillStyle = "#fff";
+    ctx.fillRect(0, canvas.height / 2, canvas.width, 1);
+
+    const intervals = frames.map(f => f[0]).sort((a, b) => a - b);
+    if (!intervals.length) return;
+    const p50 = intervals[Math.floor(intervals.length * 0.5)];
+    const p99 = intervals[Math.min(intervals.length - 1, Math.floor(intervals.length * 0.99))];
+    const over = intervals.filter(v => v > budget * 1.5).length;
+    this.element.querySelector(".stats").innerText =
+      `Frame interval p50 ${(p50 / 1000).toFixed(2)} ms, p99 ${(p99 / 1000).toFixed(2)} ms, ` +
+      `max ${(intervals[intervals.length - 1] / 1000).toFixed(2)} ms, budget ${(budget / 1000).toFixed(2)} ms. ` +
+      `${over} of ${intervals.length} frames late.`;
+  }
+}
+
+// Keep in sync with src/lib/eh_perf.h and render/eh_render_overlay.c.
+PerfChartUi.STAGE_NAMES = ["input", "video", "fakews", "update", "fbcvt", "upload", "swap"];
+PerfChartUi.STAGE_COLORS = ["#ff0", "#0ff", "#f0f", "#0f0", "#f80", "#46f", "#f00"];
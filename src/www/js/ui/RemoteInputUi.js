@@ -0,0 +1,148 @@
+/* RemoteInputUi.js
+ * Play the running game from the browser. Click the panel, then use the keyboard.
+ * We send full player states, only when something changed and at most once per animation frame.
+ * While anything is held, we repeat it every second, so the game knows we're still here.
+ * Protocol is documented at src/lib/eh_remote_input.h.
+ */
+
+import { Dom } from "../Dom.js";
+import { Comm } from "../Comm.js";
+
+export class RemoteInputUi {
+  static getDependencies() {
+    return [HTMLElement, Dom, Comm, Window];
+  }
+  constructor(element, dom, comm, window) {
+    this.element = element;
+    this.dom = dom;
+    this.comm = comm;
+    this.window = window;
+
+    this.playerid = 1;
+    this.state = 0; // What the keyboard says now.
+    this.pressedSinceSend = 0; // Bits pressed and maybe released since the last send, so quick taps don't vanish.
+    this.sentState = 0;
+    this.seq = 1;
+    this.sendPending = false;
+    this.lastSendTime = 0;
+    this.keepaliveInterval = null;
+    this.latencies = []; // ms, send to ack, most recent last.
+
+    this.buildUi();
+    this.wsListener = this.comm.listenWs((type, packet) => this.onWsRcv(type, packet));
+    this.keepaliveInterval = this.window.setInterval(() => this.onKeepalive(), 1000);
+  }
+
+  onRemoveFromDom() {
+    this.comm.unlistenWs(this.wsListener);
+    this.window.clearInterval(this.keepaliveInterval);
+    if (this.sentState) {
+      this.state = 0;
+      this.pressedSinceSend = 0;
+      this.send();
+    }
+  }
+
+  buildUi() {
+    this.element.innerHTML = "";
+    this.element.tabIndex = 0;
+    const playerSelect = this.dom.spawn(this.element, "SELECT", { "on-change": () => this.onPlayerChanged() });
+    for (let i = 1; i <= 4; i++) this.dom.spawn(playerSelect, "OPTION", { value: i }, `Player ${i}`);
+    this.dom.spawn(this.element, "DIV", ["help"], "Click here, then: Arrows, Z=South X=West A=East S=North, Q/W=L1/R1, Enter=Aux1 Space=Aux2");
+    this.dom.spawn(this.element, "DIV", ["state"], "");
+    this.dom.spawn(this.element, "DIV", ["latency"], "");
+    this.element.addEventListener("keydown", e => this.onKey(e, true));
+    this.element.addEventListener("keyup", e => this.onKey(e, false));
+    this.element.addEventListener("blur", () => this.releaseAll());
+  }
+
+  onPlayerChanged() {
+    this.releaseAll();
+    this.playerid = +this.element.querySelector("select").value || 1;
+  }
+
+  releaseAll() {
+    if (!this.state && !this.sentState) return;
+    this.state = 0;
+    this.pressedSinceSend = 0;
+    this.send();
+  }
+
+  onKey(event, value) {
+    const btnid = RemoteInputUi.KEYMAP[event.code];
+    if (!btnid) return;
+    event.preventDefault();
+    event.stopPropagation();
+    if (event.repeat) return;
+    if (value) {
+      this.state |= btnid;
+      this.pressedSinceSend |= btnid;
+    } else {
+      this.state &= ~btnid;
+    }
+    this.element.querySelector(".state").innerText = `0x${this.state.toString(16).padStart(4, "0")}`;
+    this.scheduleSend();
+  }
+
+  scheduleSend() {
+    if (this.sendPending) return;
+    this.sendPending = true;
+    this.window.requestAnimationFrame(() => {
+      this.sendPending = false;
+      this.send();
+    });
+  }
+
+  send() {
+    let state = this.state | this.pressedSinceSend;
+    this.pressedSinceSend = 0;
+    // If a tap got folded into this batch, it still needs its release, next frame.
+    if (state !== this.state) this.scheduleSend();
+    if ((state === this.sentState) && (Date.now() - this.lastSendTime < 1000)) return;
+    this.sentState = state;
+    this.lastSendTime = Date.now();
+    this.comm.sendWsJson({
+      id: "input",
+      seq: this.seq++,
+      t: performance.now(),
+      states: [this.playerid, state],
+    });
+  }
+
+  onKeepalive() {
+    if (!this.sentState) return;
+    if (Date.now() - this.lastSendTime < 1000) return;
+    this.send();
+  }
+
+  onWsRcv(type, packet) {
+    if (type !== "json") return;
+    if (packet.id !== "inputApplied") return;
+    const ms = performance.now() - packet.t;
+    if ((ms < 0) || (ms > 60000)) return; // Not ours, eg another browser tab.
+    this.latencies.push(ms);
+    if (this.latencies.length > 100) this.latencies.splice(0, this.latencies.length - 100);
+    const sorted = [...this.latencies].sort((a, b) => a - b);
+    const p50 = sorted[Math.floor(sorted.length * 0.5)];
+    const p99 = sorted[Math.min(sorted.length - 1, Math.floor(sorted.length * 0.99))];
+    this.element.querySelector(".latency").innerText =
+      `Send to apply and back: ${ms.toFixed(1)} ms (p50 ${p50.toFixed(1)}, p99 ${p99.toFixed(1)}, n=${sorted.length}). ` +
+      `Waited in game ${(packet.localUs / 1000).toFixed(1)} ms, applied at frame ${packet.frame}.`;
+  }
+}
+
+// Keep in sync with INMGR_BTN_* in src/lib/inmgr/inmgr.h.
+RemoteInputUi.KEYMAP = {
+  ArrowLeft: 0x0001,
+  ArrowRight: 0x0002,
+  ArrowUp: 0x0004,
+  ArrowDown: 0x0008,
+  KeyZ: 0x0010,
+  KeyX: 0x0020,
+  KeyA: 0x0040,
+  KeyS: 0x0080,
+  KeyQ: 0x0100,
+  KeyW: 0x0200,
+  Enter: 0x1000,
+  Space: 0x2000,
+};
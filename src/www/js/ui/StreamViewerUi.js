@@ -0,0 +1,192 @@
+/* StreamViewerUi.js
+ * Live view of the running game's framebuffer, if it was launched with --stream.
+ * We open our own WebSocket, so frames don't clog up Comm's.
+ * Packet format is documented at src/lib/render/eh_stream.h.
+ */
+
+import { Dom } from "../Dom.js";
+
+export class StreamViewerUi {
+  static getDependencies() {
+    return [HTMLElement, Dom, Window];
+  }
+  constructor(element, dom, window) {
+    this.element = element;
+    this.dom = dom;
+    this.window = window;
+
+    this.socket = null;
+    this.imageData = null;
+    this.palette = null;
+    this.seq = -1; // Sequence of the frame in progress. Negative if we're waiting for a keyframe.
+    this.byteCount = 0;
+    this.frameCount = 0;
+    this.countStartTime = Date.now();
+
+    this.buildUi();
+    this.connect();
+  }
+
+  onRemoveFromDom() {
+    if (this.socket) {
+      this.socket.close();
+      this.socket = null;
+    }
+  }
+
+  buildUi() {
+    this.element.innerHTML = "";
+    this.dom.spawn(this.element, "CANVAS", ["screen"]);
+    this.dom.spawn(this.element, "DIV", ["stats"], "Waiting for stream...");
+  }
+
+  connect() {
+    this.socket = new WebSocket(`ws://${this.window.location.host}/ws/view`);
+    this.socket.binaryType = "arraybuffer";
+    this.socket.addEventListener("message", event => this.onMessage(event));
+    this.socket.addEventListener("close", () => {
+      this.element.querySelector(".stats").innerText = "Disconnected.";
+    });
+  }
+
+  onMessage(event) {
+    if (typeof(event.data) === "string") {
+      try {
+        const packet = JSON.parse(event.data);
+        if (packet.id === "streamStats") this.onStats(packet);
+      } catch (e) {}
+    } else if (event.data instanceof ArrayBuffer) {
+      this.byteCount += event.data.byteLength;
+      this.decodePacket(new Uint8Array(event.data));
+    }
+  }
+
+  /* Stats from the game are about what it sent. We report what we received too, they differ when a network is congested.
+   */
+  onStats(packet) {
+    const now = Date.now();
+    const elapsed = (now - this.countStartTime) / 1000;
+    const kbps = elapsed ? (this.byteCount * 8) / (elapsed * 1000) : 0;
+    const fps = elapsed ? this.frameCount / elapsed : 0;
+    this.byteCount = 0;
+    this.frameCount = 0;
+    this.countStartTime = now;
+    this.element.querySelector(".stats").innerText =
+      `${packet.w}x${packet.h}, sent ${packet.fps.toFixed(1)} fps ${packet.kbps.toFixed(0)} kb/s, ` +
+      `encode ${packet.encodeUs} us (max ${packet.encodeMaxUs}), dropped ${packet.dropc}; ` +
+      `received ${fps.toFixed(1)} fps ${kbps.toFixed(0)} kb/s`;
+  }
+
+  requestKeyframe() {
+    this.seq = -1;
+    if (this.socket?.readyState === WebSocket.OPEN) {
+      this.socket.send(JSON.stringify({ id: "streamKeyframe" }));
+    }
+  }
+
+  decodePacket(src) {
+    if ((src.length < 17) || (src[0] !== 0x45) || (src[1] !== 0x48) || (src[2] !== 0x46) || (src[3] !== 0x53)) return;
+    if (src[4] !== 1) return;
+    const flags = src[5];
+    const w = (src[6] << 8) | src[7];
+    const h = (src[8] << 8) | src[9];
+    const seq = ((src[10] << 24) | (src[11] << 16) | (src[12] << 8) | src[13]) >>> 0;
+    const tileSize = src[14];
+    let tileCount = (src[15] << 8) | src[16];
+    let srcp = 17;
+
+    if (flags & 0x01) { // Keyframe: Start fresh.
+      this.seq = seq;
+      this.requireImage(w, h);
+    } else if ((seq !== this.seq) && (seq !== this.seq + 1)) { // Missed something.
+      if (this.seq >= 0) this.requestKeyframe();
+      return;
+    } else {
+      this.seq = seq;
+    }
+    if (!this.imageData || (this.imageData.width !== w) || (this.imageData.height !== h)) return;
+
+    const indexed = flags & 0x04;
+    if (flags & 0x08) {
+      if (srcp + 768 > src.length) return;
+      this.palette = src.slice(srcp, srcp + 768);
+      srcp += 768;
+    }
+    if (indexed && !this.palette) return this.requestKeyframe();
+    const pixelSize = indexed ? 1 : 3;
+    const colc = Math.ceil(w / tileSize);
+
+    while (tileCount-- > 0) {
+      if (srcp + 3 > src.length) return this.requestKeyframe();
+      const tileId = (src[srcp] << 8) | src[srcp + 1];
+      const encoding = src[srcp + 2];
+      srcp += 3;
+      const x = (tileId % colc) * tileSize;
+      const y = Math.floor(tileId / colc) * tileSize;
+      const tw = Math.min(tileSize, w - x);
+      const th = Math.min(tileSize, h - y);
+      switch (encoding) {
+        case 0: {
+            this.fillTile(x, y, tw, th, src, srcp, indexed);
+            srcp += pixelSize;
+          } break;
+        case 1: {
+            for (let yi = 0, p = srcp; yi < th; yi++) {
+              for (let xi = 0; xi < tw; xi++, p += pixelSize) this.setPixel(x + xi, y + yi, src, p, indexed);
+            }
+            srcp += tw * th * pixelSize;
+          } break;
+        case 2: {
+            const colorc = src[srcp++];
+            const colorp = srcp;
+            srcp += colorc * pixelSize;
+            for (let yi = 0, bitp = 0; yi < th; yi++) {
+              for (let xi = 0; xi < tw; xi++, bitp++) {
+                const b = src[srcp + (bitp >> 1)];
+                const ix = (bitp & 1) ? (b & 15) : (b >> 4);
+                this.setPixel(x + xi, y + yi, src, colorp + ix * pixelSize, indexed);
+              }
+            }
+            srcp += (tw * th + 1) >> 1;
+          } break;
+        default: return this.requestKeyframe();
+      }
+    }
+
+    if (flags & 0x02) {
+      this.frameCount++;
+      const canvas = this.element.querySelector(".screen");
+      canvas.getContext("2d").putImageData(this.imageData, 0, 0);
+    }
+  }
+
+  requireImage(w, h) {
+    if (this.imageData && (this.imageData.width === w) && (this.imageData.height === h)) return;
+    const canvas = this.element.querySelector(".screen");
+    canvas.width = w;
+    canvas.height = h;
+    this.imageData = canvas.getContext("2d").createImageData(w, h);
+  }
+
+  setPixel(x, y, src, srcp, indexed) {
+    const dst = this.imageData.data;
+    const dstp = (y * this.imageData.width + x) << 2;
+    if (indexed) {
+      const p = src[srcp] * 3;
+      dst[dstp] = this.palette[p];
+      dst[dstp + 1] = this.palette[p + 1];
+      dst[dstp + 2] = this.palette[p + 2];
+    } else {
+      dst[dstp] = src[srcp];
+      dst[dstp + 1] = src[srcp + 1];
+      dst[dstp + 2] = src[srcp + 2];
+    }
+    dst[dstp + 3] = 0xff;
+  }
+
+  fillTile(x, y, w, h, src, srcp, indexed) {
+    for (let yi = 0; yi < h; yi++) {
+      for (let xi = 0; xi < w; xi++) this.setPixel(x + xi, y + yi, src, srcp, indexed);
+    }
+  }
+}